@@ -0,0 +1,379 @@
+// End-to-end render benchmark on synthetic inputs; needs ffmpeg but no network or Quran data.
+//
+// A testsrc2 background, sine-tone verse audio of realistic lengths and generated verse text are
+// created once in the work directory. Each scenario (range x resolution x preset) then runs
+// VideoGenerator::generateVideo in a forked child, so peak RSS and CPU are measured per scenario.
+//
+//   qvm_e2e_bench [--ranges short,medium] [--resolutions 720p,1080p] [--presets ultrafast,veryfast]
+//                 [--baseline old.json] [--threshold 0.15] [--out results.json]
+//
+// Exits with 2 when a scenario regresses past --threshold against --baseline.
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include "cxxopts.hpp"
+#include "config_loader.h"
+#include "LibavRenderEngine.h"
+#include "SystemProcessExecutor.h"
+#include "render/plan_runner.h"
+#include "tracing.h"
+#include "types.h"
+#include "video_generator.h"
+
+#ifndef QVM_VERSION
+#define QVM_VERSION "dev"
+#endif
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+// Verse lengths drawn for the synthetic recitation, from a few seconds to a long verse.
+const std::vector<double> kVerseSeconds = {3.8, 6.2, 9.5, 12.4, 17.1, 23.6};
+const std::map<std::string, int> kRanges = {{"short", 7}, {"medium", 40}, {"long", 120}};
+const std::map<std::string, std::pair<int, int>> kResolutions = {{"720p", {1280, 720}}, {"1080p", {1920, 1080}}};
+
+const std::vector<std::string> kArabicWords = {
+    "ٱللَّهِ", "ٱلرَّحْمَٰنِ", "ٱلرَّحِيمِ", "ٱلْحَمْدُ", "رَبِّ", "ٱلْعَٰلَمِينَ", "مَٰلِكِ", "يَوْمِ",
+    "ٱلدِّينِ", "إِيَّاكَ", "نَعْبُدُ", "وَإِيَّاكَ", "نَسْتَعِينُ", "ٱهْدِنَا", "ٱلصِّرَٰطَ", "ٱلْمُسْتَقِيمَ"
+};
+const std::vector<std::string> kEnglishWords = {
+    "the", "mercy", "of", "guidance", "to", "those", "who", "believe", "and", "path", "straight",
+    "praise", "lord", "worlds", "day", "judgement", "we", "worship", "seek", "help"
+};
+
+fs::path project_root() {
+    static const fs::path root = fs::absolute(fs::path(__FILE__)).parent_path().parent_path();
+    return root;
+}
+
+std::vector<std::string> split_list(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+struct Assets {
+    fs::path background;
+    std::vector<fs::path> verseAudio;  // one clip per kVerseSeconds entry
+};
+
+void render_lavfi(const std::string& source, const fs::path& destination, const Render::OptionList& options,
+                  const std::shared_ptr<Interfaces::IProcessExecutor>& executor) {
+    Render::Plan plan;
+    Render::Input input;
+    input.format = "lavfi";
+    input.path = source;
+    plan.inputs.push_back(input);
+    Render::Output output;
+    output.path = destination.generic_string();
+    output.options = options;
+    plan.outputs.push_back(output);
+    Render::runPlan(plan, executor, nullptr);
+    if (!fs::exists(destination)) throw std::runtime_error("Failed to generate " + destination.string());
+}
+
+Assets generate_assets(const fs::path& workDir, const std::shared_ptr<Interfaces::IProcessExecutor>& executor) {
+    Assets assets;
+    assets.background = workDir / "background.mp4";
+    if (!fs::exists(assets.background)) {
+        render_lavfi("testsrc2=size=1920x1080:rate=30:duration=12", assets.background,
+                     {{"c:v", "libx264"}, {"preset", "ultrafast"}, {"pix_fmt", "yuv420p"}}, executor);
+    }
+    for (size_t i = 0; i < kVerseSeconds.size(); ++i) {
+        fs::path clip = workDir / ("verse-" + std::to_string(i) + ".m4a");
+        if (!fs::exists(clip)) {
+            std::ostringstream source;
+            source << "sine=frequency=" << 220 + 55 * i << ":sample_rate=44100:duration=" << kVerseSeconds[i];
+            render_lavfi(source.str(), clip, {{"c:a", "aac"}, {"b:a", "128k"}, {"ac", "2"}}, executor);
+        }
+        assets.verseAudio.push_back(clip);
+    }
+    return assets;
+}
+
+// Verse text grows with the verse length (about two words per second), like real recitations.
+std::vector<VerseData> synthetic_verses(int count, const Assets& assets, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> clip(0, kVerseSeconds.size() - 1);
+    std::vector<VerseData> verses;
+    for (int i = 1; i <= count; ++i) {
+        size_t index = clip(rng);
+        VerseData verse;
+        verse.verseKey = "2:" + std::to_string(i);
+        verse.durationInSeconds = kVerseSeconds[index];
+        verse.localAudioPath = assets.verseAudio[index].string();
+        verse.timestampFromMs = 0;
+        verse.timestampToMs = static_cast<int>(verse.durationInSeconds * 1000);
+        int words = std::max(3, static_cast<int>(verse.durationInSeconds * 2.0));
+        for (int w = 0; w < words; ++w) {
+            verse.text += kArabicWords[rng() % kArabicWords.size()] + " ";
+            verse.translation += kEnglishWords[rng() % kEnglishWords.size()] + " ";
+        }
+        verses.push_back(verse);
+    }
+    return verses;
+}
+
+struct Scenario {
+    std::string name;
+    std::string range;
+    std::string resolution;
+    std::string preset;
+};
+
+// Runs in the forked child; everything it reports comes back to the parent as JSON.
+json run_scenario(const Scenario& scenario, const Assets& assets, const fs::path& workDir,
+                  const std::string& renderEngine, unsigned int seed) {
+    CLIOptions options;
+    options.surah = 2;
+    options.from = 1;
+    options.to = kRanges.at(scenario.range);
+    options.width = kResolutions.at(scenario.resolution).first;
+    options.height = kResolutions.at(scenario.resolution).second;
+    options.preset = scenario.preset;
+    options.presetProvided = true;
+    options.noCache = true;  // every run pays the full cost
+    options.renderEngine = renderEngine;
+    options.output = (workDir / (scenario.name + ".mp4")).string();
+    AppConfig config = loadConfig((project_root() / "config.json").string(), options);
+    config.assetBgVideo = assets.background.string();
+    config.videoSelection.enableDynamicBackgrounds = false;
+
+    auto verses = synthetic_verses(options.to, assets, seed);
+    double video_seconds = config.introDuration + config.pauseAfterIntroDuration;
+    for (const auto& verse : verses) video_seconds += verse.durationInSeconds;
+
+    auto executor = makeProcessExecutor();
+    std::shared_ptr<Interfaces::IRenderEngine> engine;
+    if (renderEngine == "libav") engine = std::make_shared<LibavRenderEngine>();
+
+    auto session = std::make_shared<Tracing::Session>();
+    bool rendered = false;
+    auto start = std::chrono::steady_clock::now();
+    {
+        Tracing::ScopedSession scope(session);
+        rendered = VideoGenerator::generateVideo(options, config, verses, executor, nullptr, engine);
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::error_code ec;
+    fs::remove(options.output, ec);
+
+    json stages = json::object();
+    double encode_seconds = 0.0;
+    for (const auto& [name, span] : session->summary()["spans"].items()) {
+        double seconds = span["totalSeconds"].get<double>();
+        double cpu = span["cpuSeconds"].get<double>();
+        stages[name] = {{"seconds", seconds}, {"cpuSeconds", cpu}, {"cpuUtilisation", seconds > 0.0 ? cpu / seconds : 0.0}};
+        if (span["category"] == "encode") encode_seconds += seconds;
+    }
+    double frames = video_seconds * config.fps;
+    return {
+        {"name", scenario.name},
+        {"range", scenario.range},
+        {"verses", options.to},
+        {"resolution", scenario.resolution},
+        {"preset", scenario.preset},
+        {"succeeded", rendered},
+        {"videoSeconds", video_seconds},
+        {"wallSeconds", wall},
+        {"encodeSeconds", encode_seconds},
+        {"encodeFps", encode_seconds > 0.0 ? frames / encode_seconds : 0.0},
+        {"speed", wall > 0.0 ? video_seconds / wall : 0.0},
+        {"stages", stages}
+    };
+}
+
+json run_isolated(const Scenario& scenario, const Assets& assets, const fs::path& workDir,
+                  const std::string& renderEngine, unsigned int seed) {
+    int fds[2];
+    if (pipe(fds) != 0) throw std::runtime_error("pipe() failed");
+    pid_t pid = fork();
+    if (pid < 0) throw std::runtime_error("fork() failed");
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(STDERR_FILENO, STDOUT_FILENO);  // keep render logs out of the JSON report
+        std::string payload;
+        try {
+            payload = run_scenario(scenario, assets, workDir, renderEngine, seed).dump();
+        } catch (const std::exception& e) {
+            payload = json{{"name", scenario.name}, {"succeeded", false}, {"error", e.what()}}.dump();
+        }
+        size_t written = 0;
+        while (written < payload.size()) {
+            ssize_t n = write(fds[1], payload.data() + written, payload.size() - written);
+            if (n <= 0) break;
+            written += static_cast<size_t>(n);
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string payload;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) payload.append(buffer, static_cast<size_t>(n));
+    close(fds[0]);
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+
+    json result = json::parse(payload, nullptr, false);
+    if (result.is_discarded()) result = {{"name", scenario.name}, {"succeeded", false}, {"error", "no result"}};
+#ifdef __APPLE__
+    double peak_mb = usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+    double peak_mb = usage.ru_maxrss / 1024.0;             // kilobytes
+#endif
+    double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result["peakRssMb"] = peak_mb;
+    result["cpuSeconds"] = cpu;
+    if (result.contains("wallSeconds") && result["wallSeconds"].get<double>() > 0.0) {
+        result["cpuUtilisation"] = cpu / result["wallSeconds"].get<double>();
+    }
+    return result;
+}
+
+// Wall time and peak memory are compared; anything over (1 + threshold) x baseline regresses.
+json compare_to_baseline(const json& scenarios, const json& baseline, double threshold, bool& regressed) {
+    std::map<std::string, json> previous;
+    for (const auto& scenario : baseline.value("scenarios", json::array())) previous[scenario.value("name", "")] = scenario;
+
+    json comparison = json::array();
+    for (const auto& scenario : scenarios) {
+        auto it = previous.find(scenario.value("name", ""));
+        if (it == previous.end()) continue;
+        for (const char* metric : {"wallSeconds", "peakRssMb"}) {
+            if (!scenario.contains(metric) || !it->second.contains(metric)) continue;
+            double before = it->second[metric].get<double>();
+            double now = scenario[metric].get<double>();
+            double change = before > 0.0 ? now / before - 1.0 : 0.0;
+            bool regression = change > threshold;
+            regressed = regressed || regression;
+            comparison.push_back({{"name", scenario["name"]}, {"metric", metric}, {"baseline", before},
+                                  {"current", now}, {"change", change}, {"regression", regression}});
+            if (regression) {
+                std::cerr << "REGRESSION " << scenario["name"].get<std::string>() << " " << metric << ": "
+                          << before << " -> " << now << " (+" << change * 100.0 << "%)" << std::endl;
+            }
+        }
+    }
+    return comparison;
+}
+
+std::string utc_timestamp() {
+    std::time_t now = std::time(nullptr);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options cli("qvm_e2e_bench", "End-to-end render benchmark on synthetic inputs");
+    cli.add_options()
+        ("ranges", "Comma-separated ranges: short (7 verses), medium (40), long (120)", cxxopts::value<std::string>()->default_value("short,medium"))
+        ("resolutions", "Comma-separated resolutions: 720p, 1080p", cxxopts::value<std::string>()->default_value("720p,1080p"))
+        ("presets", "Comma-separated x264 presets", cxxopts::value<std::string>()->default_value("ultrafast,veryfast"))
+        ("render-engine", "ffmpeg or libav", cxxopts::value<std::string>()->default_value("ffmpeg"))
+        ("seed", "Seed for the synthetic verse lengths and text", cxxopts::value<unsigned int>()->default_value("7"))
+        ("work-dir", "Directory for the synthetic inputs (reused across runs)", cxxopts::value<std::string>())
+        ("baseline", "Previous results to compare against", cxxopts::value<std::string>())
+        ("threshold", "Allowed slowdown / memory growth before a regression is reported", cxxopts::value<double>()->default_value("0.15"))
+        ("out", "Write the JSON results to this file instead of stdout", cxxopts::value<std::string>())
+        ("h,help", "Print usage");
+    auto args = cli.parse(argc, argv);
+    if (args.count("help")) {
+        std::cout << cli.help() << std::endl;
+        return 0;
+    }
+
+    std::vector<Scenario> scenarios;
+    for (const auto& range : split_list(args["ranges"].as<std::string>())) {
+        for (const auto& resolution : split_list(args["resolutions"].as<std::string>())) {
+            for (const auto& preset : split_list(args["presets"].as<std::string>())) {
+                if (!kRanges.count(range) || !kResolutions.count(resolution)) {
+                    std::cerr << "Error: Unknown range '" << range << "' or resolution '" << resolution << "'" << std::endl;
+                    return 1;
+                }
+                scenarios.push_back({range + "-" + resolution + "-" + preset, range, resolution, preset});
+            }
+        }
+    }
+
+    fs::path work_dir = args.count("work-dir") ? fs::path(args["work-dir"].as<std::string>())
+                                               : fs::temp_directory_path() / "qvm-e2e-bench";
+    fs::create_directories(work_dir);
+    Assets assets;
+    try {
+        assets = generate_assets(work_dir, makeProcessExecutor());
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Could not generate synthetic inputs (is ffmpeg on PATH?): " << e.what() << std::endl;
+        return 1;
+    }
+
+    unsigned int seed = args["seed"].as<unsigned int>();
+    std::string render_engine = args["render-engine"].as<std::string>();
+    json results = json::array();
+    for (const auto& scenario : scenarios) {
+        std::cerr << "=== " << scenario.name << " ===" << std::endl;
+        results.push_back(run_isolated(scenario, assets, work_dir, render_engine, seed));
+        const auto& result = results.back();
+        if (result.value("succeeded", false)) {
+            std::cerr << scenario.name << ": " << result["wallSeconds"].get<double>() << " s wall, "
+                      << result["speed"].get<double>() << "x realtime, peak " << result["peakRssMb"].get<double>()
+                      << " MB" << std::endl;
+        }
+    }
+
+    json report = {
+        {"version", QVM_VERSION},
+        {"timestamp", utc_timestamp()},
+        {"seed", seed},
+        {"renderEngine", render_engine},
+        {"scenarios", results}
+    };
+
+    bool regressed = false;
+    if (args.count("baseline")) {
+        std::ifstream in(args["baseline"].as<std::string>());
+        json baseline = json::parse(in, nullptr, false);
+        if (baseline.is_discarded()) {
+            std::cerr << "Error: Cannot read baseline " << args["baseline"].as<std::string>() << std::endl;
+            return 1;
+        }
+        report["threshold"] = args["threshold"].as<double>();
+        report["comparison"] = compare_to_baseline(results, baseline, args["threshold"].as<double>(), regressed);
+    }
+
+    if (args.count("out")) {
+        std::ofstream out(args["out"].as<std::string>());
+        out << report.dump(2) << std::endl;
+    } else {
+        std::cout << report.dump(2) << std::endl;
+    }
+    for (const auto& result : results) {
+        if (!result.value("succeeded", false)) return 1;
+    }
+    return regressed ? 2 : 0;
+}
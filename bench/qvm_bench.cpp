@@ -0,0 +1,302 @@
+// Microbenchmarks for the CPU-bound parts of a render: text layout, subtitle generation,
+// timing parsing and data loading. Results are printed as JSON for tracking across versions.
+//
+//   qvm_bench [--iterations N] [--filter name] [--out results.json]
+//
+// Run from the repository root (fonts and fixtures are resolved from ./assets and the repo files).
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "cxxopts.hpp"
+#include "cache_utils.h"
+#include "config_loader.h"
+#include "subtitle_builder.h"
+#include "text/text_layout.h"
+#include "text/utf8.h"
+#include "timing_parser.h"
+#include "types.h"
+#include "verse_segmentation.h"
+
+#ifndef QVM_VERSION
+#define QVM_VERSION "dev"
+#endif
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+fs::path project_root() {
+    static const fs::path root = fs::absolute(fs::path(__FILE__)).parent_path().parent_path();
+    return root;
+}
+
+struct Fixtures {
+    AppConfig config;
+    CLIOptions options;
+    std::vector<VerseData> longVerses;   // verses from segments_002.json, joined back together
+    std::vector<VerseData> baqarah;      // 2:1-286
+    std::unique_ptr<VerseSegmentation::Manager> segments;
+    std::string verseTextSource;         // "qpc" when the Quran data is installed, else "segments"
+};
+
+VerseData make_verse(const std::string& key, const std::string& text, const std::string& translation, double seconds) {
+    VerseData verse;
+    verse.verseKey = key;
+    verse.text = text;
+    verse.translation = translation;
+    verse.durationInSeconds = seconds;
+    verse.timestampFromMs = 0;
+    verse.timestampToMs = static_cast<int>(seconds * 1000);
+    return verse;
+}
+
+// QPC word-by-word text for surah 2, or an empty map when the data archive is not installed.
+std::map<int, std::string> load_baqarah_text(const AppConfig& config) {
+    std::map<int, std::map<int, std::string>> words;
+    std::ifstream file(CacheUtils::resolveDataPath(config.quranWordByWordPath));
+    if (!file.is_open()) return {};
+    json data = json::parse(file, nullptr, false);
+    if (data.is_discarded()) return {};
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        const std::string& key = it.key();
+        if (key.rfind("2:", 0) != 0) continue;
+        size_t second = key.find(':', 2);
+        if (second == std::string::npos) continue;
+        words[std::stoi(key.substr(2, second - 2))][std::stoi(key.substr(second + 1))] = it.value().value("text", "");
+    }
+    std::map<int, std::string> verses;
+    for (const auto& [verse, verseWords] : words) {
+        for (const auto& [index, word] : verseWords) verses[verse] += word + " ";
+    }
+    return verses;
+}
+
+Fixtures build_fixtures() {
+    Fixtures fixtures;
+    fixtures.options.surah = 2;
+    fixtures.options.from = 1;
+    fixtures.options.to = 286;
+    fixtures.options.output = (fs::temp_directory_path() / "qvm-bench.mp4").string();
+    fixtures.config = loadConfig((project_root() / "config.json").string(), fixtures.options);
+    // Layout benchmarks measure shaping and wrapping; the layout cache has its own entry.
+    fixtures.config.layoutCache = false;
+
+    std::ifstream segmentFile(project_root() / "segments_002.json");
+    json segmentData = json::parse(segmentFile);
+    std::vector<std::pair<std::string, std::string>> pieces;
+    for (const auto& [key, segments] : segmentData.items()) {
+        std::string arabic;
+        std::string translation;
+        double seconds = 0.0;
+        for (const auto& segment : segments) {
+            arabic += segment.value("arabic", "") + " ";
+            translation += segment.value("translation", "") + " ";
+            seconds = std::max(seconds, segment.value("end", 0.0));
+            pieces.emplace_back(segment.value("arabic", ""), segment.value("translation", ""));
+        }
+        fixtures.longVerses.push_back(make_verse(key, arabic, translation, seconds));
+    }
+
+    auto qpc = load_baqarah_text(fixtures.config);
+    fixtures.verseTextSource = qpc.empty() ? "segments" : "qpc";
+    for (int verse = 1; verse <= 286; ++verse) {
+        std::string key = "2:" + std::to_string(verse);
+        const auto& piece = pieces[(verse - 1) % pieces.size()];
+        std::string text = qpc.count(verse) ? qpc[verse] : piece.first;
+        std::string translation = piece.second;
+        try {
+            std::string installed = CacheUtils::getTranslationText(fixtures.config.translationId, key);
+            if (!installed.empty()) translation = installed;
+        } catch (const std::exception&) {
+            // Translation data not installed; keep the segment translation.
+        }
+        fixtures.baqarah.push_back(make_verse(key, text, translation, 8.0));
+    }
+
+    fixtures.segments = VerseSegmentation::createManager(
+        true, (project_root() / "metadata/long-verses.json").string(), (project_root() / "segments_002.json").string());
+    return fixtures;
+}
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> body;
+    std::function<void()> setup;  // runs before every iteration, untimed
+};
+
+json run_benchmark(const Benchmark& benchmark, int iterations) {
+    std::vector<double> samples;
+    try {
+        if (benchmark.setup) benchmark.setup();
+        benchmark.body();  // warm-up
+        for (int i = 0; i < iterations; ++i) {
+            if (benchmark.setup) benchmark.setup();
+            auto start = std::chrono::steady_clock::now();
+            benchmark.body();
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: " << benchmark.name << " skipped: " << e.what() << std::endl;
+        return {{"name", benchmark.name}, {"skipped", e.what()}};
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double sample : samples) total += sample;
+    json result = {
+        {"name", benchmark.name},
+        {"iterations", iterations},
+        {"meanMs", total / samples.size()},
+        {"medianMs", samples[samples.size() / 2]},
+        {"minMs", samples.front()},
+        {"maxMs", samples.back()}
+    };
+    std::cerr << benchmark.name << ": median " << result["medianMs"].get<double>() << " ms" << std::endl;
+    return result;
+}
+
+std::string utc_timestamp() {
+    std::time_t now = std::time(nullptr);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options cli("qvm_bench", "Microbenchmarks for layout, subtitles, timing parsing and data loading");
+    cli.add_options()
+        ("iterations", "Timed iterations per benchmark", cxxopts::value<int>()->default_value("10"))
+        ("filter", "Only run benchmarks whose name contains this string", cxxopts::value<std::string>()->default_value(""))
+        ("out", "Write the JSON results to this file instead of stdout", cxxopts::value<std::string>())
+        ("h,help", "Print usage");
+    auto args = cli.parse(argc, argv);
+    if (args.count("help")) {
+        std::cout << cli.help() << std::endl;
+        return 0;
+    }
+    int iterations = std::max(1, args["iterations"].as<int>());
+    std::string filter = args["filter"].as<std::string>();
+
+    Fixtures fixtures;
+    try {
+        fixtures = build_fixtures();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Failed to build fixtures (run from the repository root): " << e.what() << std::endl;
+        return 1;
+    }
+    const AppConfig& config = fixtures.config;
+    TextLayout::Engine engine(config);
+    // Served from the in-memory layout cache after one pass; nothing is saved to disk.
+    AppConfig cachedConfig = config;
+    cachedConfig.layoutCache = true;
+    TextLayout::Engine cachedEngine(cachedConfig);
+    for (const auto& verse : fixtures.longVerses) cachedEngine.layoutVerse(verse);
+
+    std::vector<Benchmark> benchmarks = {
+        {"TextLayout::Engine::layoutVerse/long-verses", [&]() {
+            for (const auto& verse : fixtures.longVerses) engine.layoutVerse(verse);
+        }, nullptr},
+        {"TextLayout::Engine::layoutVerse/long-verses+layout-cache", [&]() {
+            for (const auto& verse : fixtures.longVerses) cachedEngine.layoutVerse(verse);
+        }, nullptr},
+        {"SubtitleBuilder::buildAssFile/2:1-286", [&]() {
+            fs::remove(SubtitleBuilder::buildAssFile(config, fixtures.options, fixtures.baqarah,
+                                                     config.introDuration, config.pauseAfterIntroDuration));
+        }, nullptr},
+        {"SubtitleBuilder::buildAssFile/2:1-286+segments", [&]() {
+            fs::remove(SubtitleBuilder::buildAssFile(config, fixtures.options, fixtures.baqarah,
+                                                     config.introDuration, config.pauseAfterIntroDuration,
+                                                     fixtures.segments.get()));
+        }, nullptr},
+        {"TimingParser::parseTimingFile/19.vtt", [&]() {
+            TimingParser::parseTimingFile((project_root() / "assets/custom_audio_test/19.vtt").string());
+        }, nullptr},
+        {"SubtitleBuilder::applyLatinFontFallback/2:1-286", [&]() {
+            for (const auto& verse : fixtures.baqarah) {
+                SubtitleBuilder::applyLatinFontFallback(verse.translation, config.translationFallbackFontFamily,
+                                                        config.translationFont.family);
+            }
+        }, nullptr},
+        {"CacheUtils::getTranslationData/cold", [&]() {
+            CacheUtils::getTranslationData(config.translationId);
+        }, []() { CacheUtils::clearMemoryCaches(); }},
+        {"CacheUtils::getTranslationData/warm", [&]() {
+            CacheUtils::getTranslationData(config.translationId);
+        }, nullptr},
+    };
+    // The UTF-8 scans every text path shares, byte by byte and with the widest SIMD kernel.
+    std::vector<Utf8::Kernel> kernels = {Utf8::Kernel::Scalar};
+    if (Utf8::bestKernel() != Utf8::Kernel::Scalar) kernels.push_back(Utf8::bestKernel());
+    for (Utf8::Kernel kernel : kernels) {
+        benchmarks.push_back({std::string("Utf8::scan/2:1-286 [") + Utf8::kernelName(kernel) + "]", [&]() {
+            for (const auto& verse : fixtures.baqarah) {
+                Utf8::containsArabic(verse.translation);
+                Utf8::countWords(verse.text);
+                Utf8::arabicDigitsToAscii(verse.text);
+                SubtitleBuilder::applyLatinFontFallback(verse.translation, config.translationFallbackFontFamily,
+                                                        config.translationFont.family);
+            }
+        }, [kernel]() { Utf8::useKernel(kernel); }});
+    }
+
+    json results = json::array();
+    for (const auto& benchmark : benchmarks) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+        results.push_back(run_benchmark(benchmark, iterations));
+    }
+    Utf8::useKernel(Utf8::bestKernel());
+
+    json report = {
+        {"version", QVM_VERSION},
+        {"timestamp", utc_timestamp()},
+        {"fixtures", {
+            {"longVerses", fixtures.longVerses.size()},
+            {"rangeVerses", fixtures.baqarah.size()},
+            {"verseText", fixtures.verseTextSource},
+            {"width", config.width},
+            {"height", config.height}
+        }},
+        {"utf8Kernel", Utf8::kernelName(Utf8::bestKernel())},
+        {"benchmarks", results}
+    };
+    // Context reuse across every layoutVerse call above (one FT_Library per thread, one face per
+    // font file); misses should stay at the number of distinct pixel sizes and scripts.
+    auto fonts = engine.fontStats();
+    report["fontPool"] = {
+        {"libraries", fonts.libraries},
+        {"faceLoads", fonts.faceLoads},
+        {"fontHits", fonts.fontHits},
+        {"fontMisses", fonts.fontMisses},
+        {"shapePlanHits", fonts.shapePlanHits},
+        {"shapePlanMisses", fonts.shapePlanMisses}
+    };
+    auto layouts = TextLayout::LayoutCache::shared().stats();
+    report["layoutCache"] = {
+        {"hits", layouts.hits},
+        {"misses", layouts.misses},
+        {"stores", layouts.stores}
+    };
+    if (args.count("out")) {
+        std::ofstream out(args["out"].as<std::string>());
+        if (!out.is_open()) {
+            std::cerr << "Error: Cannot write " << args["out"].as<std::string>() << std::endl;
+            return 1;
+        }
+        out << report.dump(2) << std::endl;
+    } else {
+        std::cout << report.dump(2) << std::endl;
+    }
+    return 0;
+}
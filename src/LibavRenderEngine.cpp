@@ -0,0 +1,864 @@
+#include "LibavRenderEngine.h"
+#include "progress.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+// The engine relies on the AVChannelLayout API introduced in FFmpeg 5.1.
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+#define QVM_LIBAV_ENGINE_SUPPORTED 1
+#endif
+
+#ifdef QVM_LIBAV_ENGINE_SUPPORTED
+
+namespace {
+
+std::string av_error_string(int err) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, buffer, sizeof(buffer));
+    return buffer;
+}
+
+void check(int ret, const std::string& what) {
+    if (ret < 0) {
+        throw std::runtime_error(what + ": " + av_error_string(ret));
+    }
+}
+
+struct InputFormatDeleter {
+    void operator()(AVFormatContext* ctx) const { avformat_close_input(&ctx); }
+};
+struct OutputFormatDeleter {
+    void operator()(AVFormatContext* ctx) const {
+        if (!ctx) return;
+        if (ctx->pb && !(ctx->oformat->flags & AVFMT_NOFILE)) avio_closep(&ctx->pb);
+        avformat_free_context(ctx);
+    }
+};
+struct CodecContextDeleter {
+    void operator()(AVCodecContext* ctx) const { avcodec_free_context(&ctx); }
+};
+struct FilterGraphDeleter {
+    void operator()(AVFilterGraph* graph) const { avfilter_graph_free(&graph); }
+};
+struct FrameDeleter {
+    void operator()(AVFrame* frame) const { av_frame_free(&frame); }
+};
+struct PacketDeleter {
+    void operator()(AVPacket* packet) const { av_packet_free(&packet); }
+};
+struct InOutDeleter {
+    void operator()(AVFilterInOut* inout) const { avfilter_inout_free(&inout); }
+};
+
+using FramePtr = std::unique_ptr<AVFrame, FrameDeleter>;
+using PacketPtr = std::unique_ptr<AVPacket, PacketDeleter>;
+
+struct Dictionary {
+    AVDictionary* entries = nullptr;
+    Dictionary() = default;
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+    ~Dictionary() { av_dict_free(&entries); }
+    void set(const std::string& key, const std::string& value) {
+        av_dict_set(&entries, key.c_str(), value.c_str(), 0);
+    }
+};
+
+void replace_all(std::string& text, const std::string& from, const std::string& to) {
+    size_t pos = 0;
+    while ((pos = text.find(from, pos)) != std::string::npos) {
+        text.replace(pos, from.size(), to);
+        pos += to.size();
+    }
+}
+
+std::string strip_label(const std::string& map) {
+    if (map.size() >= 2 && map.front() == '[' && map.back() == ']') {
+        return map.substr(1, map.size() - 2);
+    }
+    return map;
+}
+
+// Parses "N:v" / "N:a" input stream references.
+bool parse_stream_ref(const std::string& ref, int& inputIndex, AVMediaType& type) {
+    auto colon = ref.find(':');
+    if (colon == std::string::npos || colon == 0 || colon + 2 != ref.size()) return false;
+    try {
+        inputIndex = std::stoi(ref.substr(0, colon));
+    } catch (...) {
+        return false;
+    }
+    char kind = ref[colon + 1];
+    if (kind == 'v') type = AVMEDIA_TYPE_VIDEO;
+    else if (kind == 'a') type = AVMEDIA_TYPE_AUDIO;
+    else return false;
+    return true;
+}
+
+AVSampleFormat preferred_sample_format(const AVCodec* codec) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void* configs = nullptr;
+    int count = 0;
+    if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_SAMPLE_FORMAT, 0, &configs, &count) >= 0 &&
+        configs && count > 0) {
+        return static_cast<const AVSampleFormat*>(configs)[0];
+    }
+#else
+    if (codec->sample_fmts) return codec->sample_fmts[0];
+#endif
+    return AV_SAMPLE_FMT_FLTP;
+}
+
+AVPixelFormat preferred_pixel_format(const AVCodec* codec) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void* configs = nullptr;
+    int count = 0;
+    if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_PIX_FORMAT, 0, &configs, &count) >= 0 &&
+        configs && count > 0) {
+        return static_cast<const AVPixelFormat*>(configs)[0];
+    }
+#else
+    if (codec->pix_fmts) return codec->pix_fmts[0];
+#endif
+    return AV_PIX_FMT_YUV420P;
+}
+
+// Output options translated from ffmpeg CLI spelling.
+struct OutputSettings {
+    std::string muxer;
+    std::string videoCodec;
+    std::string audioCodec;
+    std::string pixelFormat;
+    long long maxVideoFrames = -1;
+    int videoQuality = -1;
+    std::vector<double> forcedKeyframes;  // -force_key_frames time list, ascending seconds
+    Dictionary videoOptions;
+    Dictionary audioOptions;
+    Dictionary muxerOptions;
+};
+
+void parse_output_options(const Render::OptionList& options, OutputSettings& settings) {
+    static const std::map<std::string, std::string> videoPassthrough = {
+        {"preset", "preset"}, {"crf", "crf"}, {"tune", "tune"}, {"x264-params", "x264-params"},
+        {"b:v", "b"}, {"maxrate", "maxrate"}, {"bufsize", "bufsize"}, {"g", "g"},
+        {"profile:v", "profile"}, {"allow_sw", "allow_sw"}, {"forced-idr", "forced-idr"}
+    };
+    for (const auto& [key, value] : options) {
+        if (key == "c:v") {
+            settings.videoCodec = value;
+        } else if (key == "c:a") {
+            settings.audioCodec = value;
+        } else if (key == "b:a") {
+            settings.audioOptions.set("b", value);
+        } else if (key == "pix_fmt") {
+            settings.pixelFormat = value;
+        } else if (key == "threads") {
+            settings.videoOptions.set("threads", value);
+            settings.audioOptions.set("threads", value);
+        } else if (key == "fps_mode") {
+            // Filter graph timestamps are always passed through, so vfr needs no extra handling.
+            if (value != "vfr" && value != "passthrough") {
+                throw Render::UnsupportedPlanError("-fps_mode " + value + " is not supported in-process");
+            }
+        } else if (key == "movflags") {
+            settings.muxerOptions.set("movflags", value);
+        } else if (key == "f") {
+            settings.muxer = value;
+        } else if (key == "frames:v") {
+            settings.maxVideoFrames = std::stoll(value);
+        } else if (key == "q:v") {
+            settings.videoQuality = std::stoi(value);
+        } else if (key == "force_key_frames") {
+            // Only the plain time list form; expressions stay with the CLI.
+            if (value.rfind("expr:", 0) == 0 || value.rfind("source", 0) == 0) {
+                throw Render::UnsupportedPlanError("-force_key_frames " + value + " is not supported in-process");
+            }
+            std::stringstream times(value);
+            std::string time;
+            while (std::getline(times, time, ',')) settings.forcedKeyframes.push_back(std::stod(time));
+            std::sort(settings.forcedKeyframes.begin(), settings.forcedKeyframes.end());
+        } else if (videoPassthrough.count(key)) {
+            settings.videoOptions.set(videoPassthrough.at(key), value);
+        } else {
+            throw Render::UnsupportedPlanError("Option -" + key + " is not supported in-process");
+        }
+    }
+    if (settings.videoCodec == "copy" || settings.audioCodec == "copy") {
+        throw Render::UnsupportedPlanError("Stream copy is not supported in-process");
+    }
+}
+
+struct DecoderState {
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    AVStream* stream = nullptr;
+    std::unique_ptr<AVCodecContext, CodecContextDeleter> codec;
+    std::vector<AVFilterContext*> sources;
+    double frameDurationSeconds = 0.0;
+    bool finished = false;
+};
+
+struct InputState {
+    const Render::Input* spec = nullptr;
+    std::unique_ptr<AVFormatContext, InputFormatDeleter> format;
+    std::vector<std::unique_ptr<DecoderState>> decoders;
+    int loopsRemaining = 0;
+    double startSeconds = 0.0;
+    double loopOffsetSeconds = 0.0;
+    double iterationEndSeconds = 0.0;
+    double clockSeconds = 0.0;
+    bool finished = false;
+
+    DecoderState* decoderFor(AVMediaType type) {
+        for (auto& decoder : decoders) {
+            if (decoder->type == type) return decoder.get();
+        }
+        return nullptr;
+    }
+    DecoderState* decoderForStream(int streamIndex) {
+        for (auto& decoder : decoders) {
+            if (decoder->stream->index == streamIndex) return decoder.get();
+        }
+        return nullptr;
+    }
+};
+
+struct OutputFile;
+
+struct OutputStream {
+    OutputFile* file = nullptr;
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    AVFilterContext* sink = nullptr;
+    const AVCodec* codec = nullptr;
+    std::unique_ptr<AVCodecContext, CodecContextDeleter> encoder;
+    AVStream* stream = nullptr;
+    long long framesWritten = 0;
+    size_t nextKeyframe = 0;  // index into OutputSettings::forcedKeyframes
+    bool done = false;
+};
+
+struct OutputFile {
+    const Render::Output* spec = nullptr;
+    OutputSettings settings;
+    std::unique_ptr<AVFormatContext, OutputFormatDeleter> format;
+    std::vector<std::unique_ptr<OutputStream>> streams;
+};
+
+class Renderer {
+public:
+    explicit Renderer(const Render::Plan& plan) : plan_(plan) {}
+
+    void run() {
+        prepareOutputs();
+        openInputs();
+        buildGraph();
+        openEncoders();
+        process();
+        finish();
+    }
+
+private:
+    const Render::Plan& plan_;
+    std::vector<std::unique_ptr<InputState>> inputs_;
+    std::vector<std::unique_ptr<OutputFile>> outputs_;
+    std::unique_ptr<AVFilterGraph, FilterGraphDeleter> graph_;
+    std::string graphDescription_;
+    std::chrono::steady_clock::time_point startTime_ = std::chrono::steady_clock::now();
+    double lastProgressSeconds_ = -1.0;
+    double encodedSeconds_ = 0.0;
+
+    void prepareOutputs() {
+        if (plan_.outputs.empty()) throw Render::UnsupportedPlanError("Plan has no outputs");
+        graphDescription_ = plan_.filterComplex;
+
+        // Direct stream maps ("1:a") become pass-through filter chains so every output is fed by a sink.
+        int passthroughIndex = 0;
+        for (const auto& outputSpec : plan_.outputs) {
+            auto file = std::make_unique<OutputFile>();
+            file->spec = &outputSpec;
+            parse_output_options(outputSpec.options, file->settings);
+            outputs_.push_back(std::move(file));
+        }
+        for (auto& file : outputs_) {
+            for (const auto& map : file->spec->maps) {
+                bool isLabel = map.size() >= 2 && map.front() == '[';
+                int inputIndex = 0;
+                AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+                if (!isLabel && !parse_stream_ref(map, inputIndex, type)) {
+                    throw Render::UnsupportedPlanError("Unsupported stream map: " + map);
+                }
+                std::string label = isLabel ? strip_label(map) : "qvm_map" + std::to_string(passthroughIndex++);
+                if (!isLabel) {
+                    if (!graphDescription_.empty()) graphDescription_ += ";";
+                    graphDescription_ += "[" + map + "]" + (type == AVMEDIA_TYPE_VIDEO ? "null" : "anull") +
+                                      "[" + label + "]";
+                }
+                auto stream = std::make_unique<OutputStream>();
+                stream->file = file.get();
+                stream->type = type;  // resolved from the graph for labels
+                stream->codec = nullptr;
+                file->streams.push_back(std::move(stream));
+                streamLabels_.push_back(label);
+            }
+        }
+
+        // lavfi inputs are spliced into the graph as source filters.
+        for (size_t i = 0; i < plan_.inputs.size(); ++i) {
+            const auto& input = plan_.inputs[i];
+            if (input.format != "lavfi") continue;
+            for (char kind : {'a', 'v'}) {
+                std::string ref = "[" + std::to_string(i) + ":" + kind + "]";
+                if (graphDescription_.find(ref) == std::string::npos) continue;
+                std::string label = "qvm_lavfi" + std::to_string(i) + kind;
+                replace_all(graphDescription_, ref, "[" + label + "]");
+                std::string chain = input.path;
+                if (input.durationSeconds >= 0.0) {
+                    std::ostringstream trim;
+                    trim << (kind == 'a' ? ",atrim" : ",trim") << "=duration=" << input.durationSeconds;
+                    chain += trim.str();
+                }
+                graphDescription_ = chain + "[" + label + "];" + graphDescription_;
+            }
+        }
+    }
+
+    std::vector<std::string> streamLabels_;
+
+    void openInputs() {
+        for (const auto& spec : plan_.inputs) {
+            auto state = std::make_unique<InputState>();
+            state->spec = &spec;
+            if (spec.format == "lavfi") {
+                state->finished = true;
+                inputs_.push_back(std::move(state));
+                continue;
+            }
+            if (spec.streamLoop < 0 && !std::any_of(plan_.outputs.begin(), plan_.outputs.end(),
+                    [](const Render::Output& o) { return o.durationSeconds >= 0.0; })) {
+                throw Render::UnsupportedPlanError("Endless input loop without an output duration");
+            }
+
+            const AVInputFormat* inputFormat = nullptr;
+            if (!spec.format.empty()) {
+                inputFormat = av_find_input_format(spec.format.c_str());
+                if (!inputFormat) throw Render::UnsupportedPlanError("Unknown input format: " + spec.format);
+            }
+            Dictionary options;
+            for (const auto& [key, value] : spec.options) options.set(key, value);
+
+            AVFormatContext* rawContext = nullptr;
+            check(avformat_open_input(&rawContext, spec.path.c_str(), inputFormat, &options.entries),
+                  "Failed to open input " + spec.path);
+            state->format.reset(rawContext);
+            check(avformat_find_stream_info(rawContext, nullptr), "Failed to read stream info for " + spec.path);
+
+            state->loopsRemaining = spec.streamLoop;
+            if (rawContext->start_time != AV_NOPTS_VALUE) {
+                state->startSeconds = static_cast<double>(rawContext->start_time) / AV_TIME_BASE;
+            }
+            seekToStart(*state);
+            inputs_.push_back(std::move(state));
+        }
+    }
+
+    void seekToStart(InputState& input) {
+        double target = input.startSeconds + std::max(0.0, input.spec->seekSeconds);
+        if (target <= input.startSeconds && input.loopOffsetSeconds == 0.0) return;
+        int64_t ts = static_cast<int64_t>(target * AV_TIME_BASE);
+        if (avformat_seek_file(input.format.get(), -1, std::numeric_limits<int64_t>::min(), ts, ts, 0) < 0) {
+            // Fall back to decoding from the beginning; frames before the target are dropped.
+            av_seek_frame(input.format.get(), -1, 0, AVSEEK_FLAG_BACKWARD);
+        }
+    }
+
+    DecoderState& openDecoder(InputState& input, AVMediaType type) {
+        if (auto* existing = input.decoderFor(type)) return *existing;
+        if (!input.format) throw Render::UnsupportedPlanError("Input has no demuxer");
+
+        const AVCodec* decoderCodec = nullptr;
+        int streamIndex = av_find_best_stream(input.format.get(), type, -1, -1, &decoderCodec, 0);
+        check(streamIndex, "No matching stream in " + input.spec->path);
+
+        auto decoder = std::make_unique<DecoderState>();
+        decoder->type = type;
+        decoder->stream = input.format->streams[streamIndex];
+        decoder->codec.reset(avcodec_alloc_context3(decoderCodec));
+        if (!decoder->codec) throw std::runtime_error("Failed to allocate decoder");
+        check(avcodec_parameters_to_context(decoder->codec.get(), decoder->stream->codecpar),
+              "Failed to copy decoder parameters");
+        decoder->codec->pkt_timebase = decoder->stream->time_base;
+        if (type == AVMEDIA_TYPE_VIDEO) {
+            decoder->codec->framerate = av_guess_frame_rate(input.format.get(), decoder->stream, nullptr);
+            if (decoder->codec->framerate.num > 0 && decoder->codec->framerate.den > 0) {
+                decoder->frameDurationSeconds = av_q2d(av_inv_q(decoder->codec->framerate));
+            }
+        }
+        decoder->codec->thread_count = 0;
+        check(avcodec_open2(decoder->codec.get(), decoderCodec, nullptr), "Failed to open decoder");
+        input.decoders.push_back(std::move(decoder));
+        return *input.decoders.back();
+    }
+
+    AVFilterContext* createSource(DecoderState& decoder, const std::string& name) {
+        AVCodecContext* codec = decoder.codec.get();
+        AVRational tb = decoder.stream->time_base;
+        std::ostringstream args;
+        const AVFilter* filter = nullptr;
+        if (decoder.type == AVMEDIA_TYPE_VIDEO) {
+            filter = avfilter_get_by_name("buffer");
+            AVRational sar = codec->sample_aspect_ratio.num ? codec->sample_aspect_ratio : AVRational{1, 1};
+            args << "video_size=" << codec->width << "x" << codec->height
+                 << ":pix_fmt=" << codec->pix_fmt
+                 << ":time_base=" << tb.num << "/" << tb.den
+                 << ":pixel_aspect=" << sar.num << "/" << sar.den;
+            if (codec->framerate.num > 0 && codec->framerate.den > 0) {
+                args << ":frame_rate=" << codec->framerate.num << "/" << codec->framerate.den;
+            }
+        } else {
+            filter = avfilter_get_by_name("abuffer");
+            char layout[64] = {0};
+            av_channel_layout_describe(&codec->ch_layout, layout, sizeof(layout));
+            args << "time_base=" << tb.num << "/" << tb.den
+                 << ":sample_rate=" << codec->sample_rate
+                 << ":sample_fmt=" << av_get_sample_fmt_name(codec->sample_fmt)
+                 << ":channel_layout=" << layout;
+        }
+        AVFilterContext* source = nullptr;
+        check(avfilter_graph_create_filter(&source, filter, name.c_str(), args.str().c_str(), nullptr, graph_.get()),
+              "Failed to create buffer source");
+        return source;
+    }
+
+    void buildGraph() {
+        graph_.reset(avfilter_graph_alloc());
+        if (!graph_) throw std::runtime_error("Failed to allocate filter graph");
+        if (plan_.filterThreads > 0) graph_->nb_threads = plan_.filterThreads;
+
+        AVFilterInOut* rawInputs = nullptr;
+        AVFilterInOut* rawOutputs = nullptr;
+        check(avfilter_graph_parse2(graph_.get(), graphDescription_.c_str(), &rawInputs, &rawOutputs),
+              "Failed to parse filter graph");
+        std::unique_ptr<AVFilterInOut, InOutDeleter> openInputs(rawInputs);
+        std::unique_ptr<AVFilterInOut, InOutDeleter> openOutputs(rawOutputs);
+
+        int sourceIndex = 0;
+        for (AVFilterInOut* in = openInputs.get(); in; in = in->next) {
+            int inputIndex = 0;
+            AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+            if (!in->name || !parse_stream_ref(in->name, inputIndex, type) ||
+                inputIndex < 0 || inputIndex >= static_cast<int>(inputs_.size())) {
+                throw Render::UnsupportedPlanError(std::string("Unsupported graph input: ") +
+                                                (in->name ? in->name : "<unlabeled>"));
+            }
+            DecoderState& decoder = openDecoder(*inputs_[inputIndex], type);
+            AVFilterContext* source = createSource(decoder, "src" + std::to_string(sourceIndex++));
+            check(avfilter_link(source, 0, in->filter_ctx, in->pad_idx), "Failed to link graph input");
+            decoder.sources.push_back(source);
+        }
+
+        size_t labelIndex = 0;
+        for (auto& file : outputs_) {
+            for (auto& stream : file->streams) {
+                const std::string& label = streamLabels_[labelIndex++];
+                AVFilterInOut* match = nullptr;
+                for (AVFilterInOut* out = openOutputs.get(); out; out = out->next) {
+                    if (out->name && label == out->name) {
+                        match = out;
+                        break;
+                    }
+                }
+                if (!match) throw Render::UnsupportedPlanError("Unknown output label: " + label);
+                stream->type = avfilter_pad_get_type(match->filter_ctx->output_pads, match->pad_idx);
+                attachSink(*file, *stream, match, label);
+            }
+        }
+        check(avfilter_graph_config(graph_.get(), nullptr), "Failed to configure filter graph");
+    }
+
+    void attachSink(OutputFile& file, OutputStream& stream, AVFilterInOut* out, const std::string& label) {
+        const bool isVideo = stream.type == AVMEDIA_TYPE_VIDEO;
+        const std::string& codecName = isVideo ? file.settings.videoCodec : file.settings.audioCodec;
+        if (codecName.empty()) throw Render::UnsupportedPlanError("No encoder configured for " + label);
+        stream.codec = avcodec_find_encoder_by_name(codecName.c_str());
+        if (!stream.codec) throw Render::UnsupportedPlanError("Encoder not available: " + codecName);
+
+        std::string formatArgs;
+        if (isVideo) {
+            std::string pixelFormat = file.settings.pixelFormat;
+            if (pixelFormat.empty()) pixelFormat = av_get_pix_fmt_name(preferred_pixel_format(stream.codec));
+            formatArgs = "pix_fmts=" + pixelFormat;
+        } else {
+            formatArgs = std::string("sample_fmts=") + av_get_sample_fmt_name(preferred_sample_format(stream.codec));
+        }
+
+        AVFilterContext* formatFilter = nullptr;
+        check(avfilter_graph_create_filter(&formatFilter, avfilter_get_by_name(isVideo ? "format" : "aformat"),
+                                        ("fmt_" + label).c_str(), formatArgs.c_str(), nullptr, graph_.get()),
+              "Failed to create format filter");
+        check(avfilter_graph_create_filter(&stream.sink, avfilter_get_by_name(isVideo ? "buffersink" : "abuffersink"),
+                                        ("sink_" + label).c_str(), nullptr, nullptr, graph_.get()),
+              "Failed to create buffer sink");
+        check(avfilter_link(out->filter_ctx, out->pad_idx, formatFilter, 0), "Failed to link output");
+        check(avfilter_link(formatFilter, 0, stream.sink, 0), "Failed to link sink");
+    }
+
+    void openEncoders() {
+        for (auto& file : outputs_) {
+            AVFormatContext* rawContext = nullptr;
+            const char* muxer = file->settings.muxer.empty() ? nullptr : file->settings.muxer.c_str();
+            check(avformat_alloc_output_context2(&rawContext, nullptr, muxer, file->spec->path.c_str()),
+                  "Failed to create output context for " + file->spec->path);
+            file->format.reset(rawContext);
+
+            for (auto& stream : file->streams) {
+                stream->encoder.reset(avcodec_alloc_context3(stream->codec));
+                if (!stream->encoder) throw std::runtime_error("Failed to allocate encoder");
+                AVCodecContext* enc = stream->encoder.get();
+                Dictionary options;
+                AVDictionary* source = stream->type == AVMEDIA_TYPE_VIDEO
+                    ? file->settings.videoOptions.entries
+                    : file->settings.audioOptions.entries;
+                av_dict_copy(&options.entries, source, 0);
+
+                if (stream->type == AVMEDIA_TYPE_VIDEO) {
+                    enc->width = av_buffersink_get_w(stream->sink);
+                    enc->height = av_buffersink_get_h(stream->sink);
+                    enc->pix_fmt = static_cast<AVPixelFormat>(av_buffersink_get_format(stream->sink));
+                    enc->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(stream->sink);
+                    AVRational frameRate = av_buffersink_get_frame_rate(stream->sink);
+                    if (frameRate.num > 0 && frameRate.den > 0) {
+                        enc->framerate = frameRate;
+                        enc->time_base = av_inv_q(frameRate);
+                    } else {
+                        enc->time_base = av_buffersink_get_time_base(stream->sink);
+                    }
+                    if (file->settings.videoQuality >= 0) {
+                        enc->flags |= AV_CODEC_FLAG_QSCALE;
+                        enc->global_quality = FF_QP2LAMBDA * file->settings.videoQuality;
+                    }
+                } else {
+                    enc->sample_rate = av_buffersink_get_sample_rate(stream->sink);
+                    enc->sample_fmt = static_cast<AVSampleFormat>(av_buffersink_get_format(stream->sink));
+                    check(av_buffersink_get_ch_layout(stream->sink, &enc->ch_layout), "Failed to read channel layout");
+                    enc->time_base = AVRational{1, enc->sample_rate};
+                }
+                if (file->format->oformat->flags & AVFMT_GLOBALHEADER) {
+                    enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+                }
+                check(avcodec_open2(enc, stream->codec, &options.entries), "Failed to open encoder " +
+                      std::string(stream->codec->name));
+                if (options.entries) {
+                    const AVDictionaryEntry* unused = av_dict_get(options.entries, "", nullptr, AV_DICT_IGNORE_SUFFIX);
+                    throw Render::UnsupportedPlanError(std::string("Encoder option not recognised: ") + unused->key);
+                }
+                if (stream->type == AVMEDIA_TYPE_AUDIO &&
+                    !(stream->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+                    av_buffersink_set_frame_size(stream->sink, enc->frame_size);
+                }
+
+                stream->stream = avformat_new_stream(file->format.get(), nullptr);
+                if (!stream->stream) throw std::runtime_error("Failed to create output stream");
+                check(avcodec_parameters_from_context(stream->stream->codecpar, enc), "Failed to copy encoder parameters");
+                stream->stream->time_base = enc->time_base;
+            }
+
+            if (!(file->format->oformat->flags & AVFMT_NOFILE)) {
+                check(avio_open(&file->format->pb, file->spec->path.c_str(), AVIO_FLAG_WRITE),
+                      "Failed to open " + file->spec->path);
+            }
+            Dictionary muxerOptions;
+            av_dict_copy(&muxerOptions.entries, file->settings.muxerOptions.entries, 0);
+            check(avformat_write_header(file->format.get(), &muxerOptions.entries), "Failed to write header");
+        }
+    }
+
+    bool allOutputsDone() const {
+        for (const auto& file : outputs_) {
+            for (const auto& stream : file->streams) {
+                if (!stream->done) return false;
+            }
+        }
+        return true;
+    }
+
+    InputState* pickInput() {
+        InputState* best = nullptr;
+        unsigned bestRequests = 0;
+        for (auto& input : inputs_) {
+            if (input->finished) continue;
+            unsigned requests = 0;
+            for (auto& decoder : input->decoders) {
+                for (auto* source : decoder->sources) requests += av_buffersrc_get_nb_failed_requests(source);
+            }
+            if (!best || requests > bestRequests ||
+                (requests == bestRequests && input->clockSeconds < best->clockSeconds)) {
+                best = input.get();
+                bestRequests = requests;
+            }
+        }
+        return best;
+    }
+
+    void process() {
+        // Inputs whose streams are not referenced by the graph are never read.
+        for (auto& input : inputs_) {
+            if (input->decoders.empty()) input->finished = true;
+        }
+
+        PacketPtr packet(av_packet_alloc());
+        FramePtr frame(av_frame_alloc());
+        if (!packet || !frame) throw std::runtime_error("Failed to allocate packet/frame");
+
+        while (!allOutputsDone()) {
+            InputState* input = pickInput();
+            if (!input) break;
+
+            int ret = av_read_frame(input->format.get(), packet.get());
+            if (ret == AVERROR_EOF) {
+                handleEndOfInput(*input, frame.get());
+            } else {
+                check(ret, "Failed to read from " + input->spec->path);
+                if (DecoderState* decoder = input->decoderForStream(packet->stream_index)) {
+                    if (!decoder->finished) {
+                        check(avcodec_send_packet(decoder->codec.get(), packet.get()), "Failed to decode packet");
+                        receiveFrames(*input, *decoder, frame.get());
+                    }
+                }
+                av_packet_unref(packet.get());
+                if (std::all_of(input->decoders.begin(), input->decoders.end(),
+                             [](const auto& d) { return d->finished; })) {
+                    closeInput(*input);
+                }
+            }
+            drainSinks(frame.get());
+        }
+
+        for (auto& input : inputs_) {
+            if (!input->finished) closeInput(*input);
+        }
+        drainSinks(frame.get());
+    }
+
+    void receiveFrames(InputState& input, DecoderState& decoder, AVFrame* frame) {
+        while (true) {
+            int ret = avcodec_receive_frame(decoder.codec.get(), frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return;
+            check(ret, "Failed to decode frame");
+            if (!decoder.finished) submitFrame(input, decoder, frame);
+            av_frame_unref(frame);
+        }
+    }
+
+    void submitFrame(InputState& input, DecoderState& decoder, AVFrame* frame) {
+        int64_t ts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+        if (ts == AV_NOPTS_VALUE) return;
+        const double timeBase = av_q2d(decoder.stream->time_base);
+        double duration = decoder.type == AVMEDIA_TYPE_AUDIO && frame->sample_rate > 0
+            ? static_cast<double>(frame->nb_samples) / frame->sample_rate
+            : decoder.frameDurationSeconds;
+        double relative = ts * timeBase - input.startSeconds;
+
+        const double seek = std::max(0.0, input.spec->seekSeconds);
+        if (relative + duration <= seek) return;
+        relative -= seek;
+        input.iterationEndSeconds = std::max(input.iterationEndSeconds, relative + duration);
+
+        double limit = input.spec->durationSeconds;
+        if (limit >= 0.0 && input.loopOffsetSeconds + relative >= limit) {
+            decoder.finished = true;
+            return;
+        }
+
+        double outputSeconds = input.loopOffsetSeconds + relative + input.spec->offsetSeconds;
+        frame->pts = static_cast<int64_t>(std::llround(outputSeconds / timeBase));
+        input.clockSeconds = outputSeconds;
+        for (auto* source : decoder.sources) {
+            check(av_buffersrc_add_frame_flags(source, frame, AV_BUFFERSRC_FLAG_KEEP_REF),
+                  "Failed to feed filter graph");
+        }
+    }
+
+    void handleEndOfInput(InputState& input, AVFrame* frame) {
+        for (auto& decoder : input.decoders) {
+            avcodec_send_packet(decoder->codec.get(), nullptr);
+            receiveFrames(input, *decoder, frame);
+        }
+        const bool canLoop = input.loopsRemaining != 0 && input.iterationEndSeconds > 0.0 &&
+                          std::any_of(input.decoders.begin(), input.decoders.end(),
+                                      [](const auto& d) { return !d->finished; });
+        if (!canLoop) {
+            closeInput(input);
+            return;
+        }
+        if (input.loopsRemaining > 0) --input.loopsRemaining;
+        input.loopOffsetSeconds += input.iterationEndSeconds;
+        input.iterationEndSeconds = 0.0;
+        for (auto& decoder : input.decoders) avcodec_flush_buffers(decoder->codec.get());
+        seekToStart(input);
+    }
+
+    void closeInput(InputState& input) {
+        if (input.finished) return;
+        input.finished = true;
+        for (auto& decoder : input.decoders) {
+            decoder->finished = true;
+            for (auto* source : decoder->sources) {
+                check(av_buffersrc_add_frame_flags(source, nullptr, 0), "Failed to close filter input");
+            }
+        }
+    }
+
+    void drainSinks(AVFrame* frame) {
+        for (auto& file : outputs_) {
+            for (auto& stream : file->streams) {
+                while (true) {
+                    int ret = av_buffersink_get_frame(stream->sink, frame);
+                    if (ret == AVERROR(EAGAIN)) break;
+                    if (ret == AVERROR_EOF) {
+                        finishStream(*stream);
+                        break;
+                    }
+                    check(ret, "Failed to pull from filter graph");
+                    if (!stream->done) writeFrame(*stream, frame);
+                    av_frame_unref(frame);
+                }
+            }
+        }
+    }
+
+    void writeFrame(OutputStream& stream, AVFrame* frame) {
+        const OutputFile& file = *stream.file;
+        AVRational sinkTimeBase = av_buffersink_get_time_base(stream.sink);
+        double seconds = frame->pts == AV_NOPTS_VALUE ? 0.0 : frame->pts * av_q2d(sinkTimeBase);
+        double limit = file.spec->durationSeconds;
+        if (limit >= 0.0 && seconds >= limit) {
+            finishStream(stream);
+            return;
+        }
+        if (stream.type == AVMEDIA_TYPE_VIDEO && file.settings.maxVideoFrames >= 0 &&
+            stream.framesWritten >= file.settings.maxVideoFrames) {
+            finishStream(stream);
+            return;
+        }
+
+        if (frame->pts != AV_NOPTS_VALUE) {
+            frame->pts = av_rescale_q(frame->pts, sinkTimeBase, stream.encoder->time_base);
+        }
+        if (stream.type == AVMEDIA_TYPE_VIDEO) {
+            frame->pict_type = AV_PICTURE_TYPE_NONE;
+            // Like the CLI: the first frame at or after each forced time becomes a keyframe.
+            const auto& forced = file.settings.forcedKeyframes;
+            if (stream.nextKeyframe < forced.size() && seconds >= forced[stream.nextKeyframe] - 1e-6) {
+                frame->pict_type = AV_PICTURE_TYPE_I;
+                while (stream.nextKeyframe < forced.size() && forced[stream.nextKeyframe] <= seconds + 1e-6) {
+                    ++stream.nextKeyframe;
+                }
+            }
+            if (file.settings.videoQuality >= 0) frame->quality = stream.encoder->global_quality;
+        }
+        encode(stream, frame);
+        ++stream.framesWritten;
+        if (stream.type == AVMEDIA_TYPE_VIDEO) {
+            encodedSeconds_ = std::max(encodedSeconds_, seconds);
+            reportProgress(false);
+        }
+    }
+
+    void finishStream(OutputStream& stream) {
+        if (stream.done) return;
+        stream.done = true;
+        encode(stream, nullptr);
+    }
+
+    void encode(OutputStream& stream, AVFrame* frame) {
+        check(avcodec_send_frame(stream.encoder.get(), frame), "Failed to encode frame");
+        PacketPtr packet(av_packet_alloc());
+        while (true) {
+            int ret = avcodec_receive_packet(stream.encoder.get(), packet.get());
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return;
+            check(ret, "Failed to receive encoded packet");
+            packet->stream_index = stream.stream->index;
+            av_packet_rescale_ts(packet.get(), stream.encoder->time_base, stream.stream->time_base);
+            check(av_interleaved_write_frame(stream.file->format.get(), packet.get()), "Failed to write packet");
+        }
+    }
+
+    void reportProgress(bool finished) {
+        if (!plan_.emitProgress) return;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+        if (!finished && lastProgressSeconds_ >= 0.0 && elapsed - lastProgressSeconds_ < 1.0) return;
+        lastProgressSeconds_ = elapsed;
+
+        double total = plan_.totalDurationSeconds;
+        double percent = finished ? 100.0
+            : (total > 0.0 ? std::clamp((encodedSeconds_ / total) * 100.0, 0.0, 100.0) : -1.0);
+        double eta = -1.0;
+        if (finished) {
+            eta = 0.0;
+        } else if (percent > 0.0 && percent < 100.0) {
+            double ratio = percent / 100.0;
+            eta = elapsed * ((1.0 - ratio) / ratio);
+        }
+        Progress::emit("encoding",
+                       finished ? "completed" : "running",
+                       percent,
+                       elapsed,
+                       eta,
+                       finished ? "Encoding complete" : "Encoding in progress");
+    }
+
+    void finish() {
+        for (auto& file : outputs_) {
+            for (auto& stream : file->streams) finishStream(*stream);
+            check(av_write_trailer(file->format.get()), "Failed to finalize " + file->spec->path);
+        }
+        reportProgress(true);
+    }
+};
+
+} // namespace
+
+void LibavRenderEngine::render(const Render::Plan& plan) {
+    if (plan.emitProgress) {
+        Progress::emit("encoding", "running", 0.0, 0.0, -1.0, "In-process encoder started");
+    }
+    try {
+        Renderer renderer(plan);
+        renderer.run();
+    } catch (const Render::UnsupportedPlanError&) {
+        throw;
+    } catch (const std::exception&) {
+        if (plan.emitProgress) {
+            Progress::emit("encoding", "failed", -1.0, -1.0, -1.0, "In-process encoder failed");
+        }
+        throw;
+    }
+}
+
+#else
+
+void LibavRenderEngine::render(const Render::Plan&) {
+    throw Render::UnsupportedPlanError("In-process rendering requires FFmpeg 5.1 or newer");
+}
+
+#endif
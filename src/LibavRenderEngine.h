@@ -0,0 +1,9 @@
+#pragma once
+#include "interfaces/IRenderEngine.h"
+
+// Executes render plans in-process with libavformat/libavcodec/libavfilter,
+// avoiding a shell and an ffmpeg process per render.
+class LibavRenderEngine : public Interfaces::IRenderEngine {
+public:
+    void render(const Render::Plan& plan) override;
+};
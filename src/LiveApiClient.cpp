@@ -3,6 +3,9 @@
 #include "timing_parser.h"
 #include "cache_utils.h"
 #include "recitation_utils.h"
+#include "tracing.h"
+#include "render_workspace.h"
+#include "text/utf8.h"
 #include "audio/custom_audio_processor.h"
 #include <iostream>
 #include <fstream>
@@ -118,6 +121,7 @@ using json = nlohmann::json;
         std::cout << "  - Using GAPLESS mode (surah-by-surah)" << std::endl;
         
         std::string localAudioPath;
+        std::string sourceAudioUrl;  // where the surah audio came from; identifies it across runs
         std::map<std::string, TimingEntry> timings;
         std::vector<TimingEntry> sequentialTimings;
         std::map<int, std::deque<TimingEntry>> verseBuckets;
@@ -198,6 +202,7 @@ using json = nlohmann::json;
                 throw std::runtime_error("Surah " + surahKey + " not found in surah.json");
 
             std::string audioUrl = surahData[surahKey]["audio_url"].get<std::string>();
+            sourceAudioUrl = audioUrl;
             
             // Download the full surah audio
             localAudioPath = (audioDir / ("surah_" + std::to_string(surah) + "_r" + std::to_string(config.reciterId) + ".mp3")).string();
@@ -249,7 +254,7 @@ using json = nlohmann::json;
                 ? std::to_string(surah) + ":" + std::to_string(timing.verseNumber)
                 : timing.verseKey;
             verse.verseKey = normalizedKey;
-            verse.audioUrl = "";
+            verse.audioUrl = sourceAudioUrl;
             verse.localAudioPath = localAudioPath;
             verse.timestampFromMs = timing.startMs;
             verse.timestampToMs = timing.endMs;
@@ -333,46 +338,30 @@ using json = nlohmann::json;
         return results;
     }
 
-void pop_back_utf8(std::string& s) {
-    if (s.empty()) return;
-    size_t i = s.size() - 1;
-    while (i > 0 && (s[i] & 0xC0) == 0x80) {
-        --i;
-    }
-    s.erase(i);
-}
-
-void trim_last_word(std::string& s) {
-    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
-        s.pop_back();
-    }
-    while (!s.empty() && !std::isspace(static_cast<unsigned char>(s.back()))) {
-        pop_back_utf8(s);
-    }
-    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
-        s.pop_back();
-    }
-}
-
 std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options, const AppConfig& config) {
     std::cout << "Fetching data for Surah " << options.surah << ", verses " << options.from << "-" << options.to << "..." << std::endl;
     
+    // Uncached downloads live as long as the job's workspace; they are needed until the encode.
     auto uniqueSuffix = std::chrono::steady_clock::now().time_since_epoch().count();
-    fs::path audioDir = fs::temp_directory_path() / ("quran_video_audio_" + std::to_string(uniqueSuffix));
-    std::error_code ec;
-    fs::create_directories(audioDir, ec);
+    fs::path audioDir = scratchDirectory("quran_video_audio_" + std::to_string(uniqueSuffix));
 
     std::vector<VerseData> results;
     std::optional<TimingEntry> customBismillahTiming;
     
     // Choose mode based on config
     if (config.recitationMode == RecitationMode::GAPLESS) {
+        Tracing::Span span("fetchVersesGapless", "fetch");
         results = fetch_verses_gapless(options.surah, options.from, options.to, config, !options.noCache, audioDir, options, &customBismillahTiming);
     } else {
         // GAPPED mode - parallel fetch
         std::vector<std::future<VerseData>> futures;
+        auto trace_session = Tracing::currentSession();
         for (int i = options.from; i <= options.to; ++i) {
-            futures.push_back(std::async(std::launch::async, fetch_single_verse_gapped, options.surah, i, config, !options.noCache, audioDir));
+            futures.push_back(std::async(std::launch::async, [&, trace_session, i]() {
+                Tracing::ScopedSession trace_scope(trace_session);
+                Tracing::Span span("fetchVerse", "fetch");
+                return fetch_single_verse_gapped(options.surah, i, config, !options.noCache, audioDir);
+            }));
         }
 
         results.reserve(futures.size());
@@ -437,7 +426,7 @@ std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options,
     // Remove last word from Bismillah if it's not Surah 1 or 9
     if (options.surah != 1 && options.surah != 9) {
         if (!results.empty() && !results[0].text.empty()) {
-            trim_last_word(results[0].text);
+            Utf8::dropLastWord(results[0].text);
         }
     }
 
@@ -445,7 +434,7 @@ std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options,
                           !options.customAudioPath.empty();
     bool shouldSpliceCustomClip = hasCustomRange && options.from > 1;
     if (shouldSpliceCustomClip) {
-        Audio::CustomAudioProcessor::spliceRange(results, options, audioDir);
+        Audio::CustomAudioProcessor::spliceRange(results, options, audioDir, processExecutor_);
     } else if (hasCustomRange) {
         for (auto& verse : results) {
             verse.fromCustomAudio = false;
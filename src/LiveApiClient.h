@@ -1,7 +1,16 @@
 #pragma once
 #include "interfaces/IApiClient.h"
+#include "interfaces/IProcessExecutor.h"
+#include <memory>
 
 class LiveApiClient : public Interfaces::IApiClient {
 public:
+    // processExecutor runs the ffmpeg trims and concats of custom-audio splicing.
+    explicit LiveApiClient(std::shared_ptr<Interfaces::IProcessExecutor> processExecutor)
+        : processExecutor_(std::move(processExecutor)) {}
+
     std::vector<VerseData> fetchQuranData(const CLIOptions& options, const AppConfig& config) override;
+
+private:
+    std::shared_ptr<Interfaces::IProcessExecutor> processExecutor_;
 };
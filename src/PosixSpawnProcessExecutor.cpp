@@ -0,0 +1,315 @@
+#include "PosixSpawnProcessExecutor.h"
+
+#ifndef _WIN32
+
+#include "progress.h"
+#include "tracing.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+constexpr size_t kStderrTailLines = 20;
+constexpr int kPollMillis = 100;
+
+// Both ends close on exec, so children spawned concurrently by other jobs never inherit them
+// (which would keep our read ends from seeing EOF).
+void make_pipe(int fds[2]) {
+#if defined(__linux__)
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        throw std::runtime_error(std::string("Failed to create pipe: ") + std::strerror(errno));
+    }
+#else
+    if (pipe(fds) != 0) {
+        throw std::runtime_error(std::string("Failed to create pipe: ") + std::strerror(errno));
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+}
+
+// Splits a byte stream into non-empty lines. ffmpeg ends its stats lines with '\r', so that
+// counts as a line end too.
+class LineBuffer {
+public:
+    template <typename OnLine>
+    void feed(const char* data, size_t size, OnLine&& onLine) {
+        pending_.append(data, size);
+        size_t start = 0;
+        for (size_t end; (end = pending_.find_first_of("\r\n", start)) != std::string::npos; start = end + 1) {
+            if (end > start) onLine(pending_.substr(start, end - start));
+        }
+        pending_.erase(0, start);
+    }
+
+    template <typename OnLine>
+    void flush(OnLine&& onLine) {
+        if (!pending_.empty()) onLine(pending_);
+        pending_.clear();
+    }
+
+private:
+    std::string pending_;
+};
+
+double seconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+double seconds_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+void print_usage(const PosixSpawnProcessExecutor::Usage& usage) {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2) << "[" << usage.program << " pid " << usage.pid << "] ";
+    if (usage.termination == "exited") {
+        line << "exited " << usage.exitCode;
+    } else {
+        line << usage.termination;
+    }
+    line << " after " << usage.wallSeconds << "s: cpu " << usage.userSeconds << "s user + " << usage.systemSeconds
+         << "s sys, peak RSS " << std::setprecision(1) << usage.maxRssKb / 1024.0 << " MB";
+    std::cerr << line.str() << std::endl;
+}
+
+std::string program_name(const std::vector<std::string>& argv) {
+    return argv.front() == "/bin/sh" && argv.size() > 2 ? "sh" : argv.front();
+}
+
+} // namespace
+
+PosixSpawnProcessExecutor::PosixSpawnProcessExecutor() : PosixSpawnProcessExecutor(Options{}) {}
+
+PosixSpawnProcessExecutor::PosixSpawnProcessExecutor(Options options, UsageSink sink)
+    : options_(options), sink_(std::move(sink)) {
+    if (!sink_ && options_.printUsage) sink_ = print_usage;
+}
+
+int PosixSpawnProcessExecutor::execute(const std::string& command) {
+    return run({"/bin/sh", "-c", command}, false, 0.0);
+}
+
+void PosixSpawnProcessExecutor::executeWithProgress(const std::string& command, double totalDurationSeconds) {
+    run({"/bin/sh", "-c", command}, true, totalDurationSeconds);
+}
+
+int PosixSpawnProcessExecutor::executeArgs(const std::vector<std::string>& argv) {
+    return run(argv, false, 0.0);
+}
+
+void PosixSpawnProcessExecutor::executeArgsWithProgress(const std::vector<std::string>& argv, double totalDurationSeconds) {
+    run(argv, true, totalDurationSeconds);
+}
+
+void PosixSpawnProcessExecutor::cancel() {
+    ++cancelGeneration_;
+}
+
+std::vector<PosixSpawnProcessExecutor::Usage> PosixSpawnProcessExecutor::history() const {
+    std::lock_guard<std::mutex> lock(historyMutex_);
+    return history_;
+}
+
+int PosixSpawnProcessExecutor::run(const std::vector<std::string>& argv, bool progress, double totalDurationSeconds) {
+    if (argv.empty()) throw std::invalid_argument("No program to run");
+    Tracing::Span span(program_name(argv), "process");
+    const unsigned long long generation = cancelGeneration_;
+
+    std::optional<Progress::EncodeTracker> tracker;
+    if (progress) tracker.emplace(totalDurationSeconds);
+
+    std::vector<char*> args;
+    for (const auto& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+    args.push_back(nullptr);
+
+    int out[2];
+    int err[2];
+    make_pipe(out);
+    try {
+        make_pipe(err);
+    } catch (...) {
+        close(out[0]);
+        close(out[1]);
+        throw;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    // ffmpeg reads interactive commands from stdin; children must never consume ours.
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    int spawn_error = posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out[1]);
+    close(err[1]);
+    if (spawn_error != 0) {
+        close(out[0]);
+        close(err[0]);
+        if (tracker) tracker->fail("Failed to start FFmpeg");
+        throw std::runtime_error("Failed to start " + argv.front() + ": " + std::strerror(spawn_error));
+    }
+
+    std::deque<std::string> stderr_tail;
+    LineBuffer stdout_lines;
+    LineBuffer stderr_lines;
+    auto on_stdout = [&](const std::string& line) {
+        if (tracker) {
+            tracker->consume(line);
+        } else {
+            std::cout << line << '\n';
+        }
+    };
+    auto on_stderr = [&](const std::string& line) {
+        stderr_tail.push_back(line);
+        if (stderr_tail.size() > kStderrTailLines) stderr_tail.pop_front();
+    };
+
+    // Watchdog: the first reason to stop the child wins; SIGKILL follows after the grace period.
+    std::string termination;
+    std::chrono::steady_clock::time_point terminated_at;
+    bool killed = false;
+    auto terminate = [&](const char* reason) {
+        if (!termination.empty()) return;
+        termination = reason;
+        terminated_at = std::chrono::steady_clock::now();
+        kill(pid, SIGTERM);
+    };
+
+    pollfd fds[2] = {{out[0], POLLIN, 0}, {err[0], POLLIN, 0}};
+    int open_fds = 2;
+    int status = 0;
+    rusage usage{};
+    bool reaped = false;
+    while (open_fds > 0) {
+        int ready = poll(fds, 2, kPollMillis);
+        if (ready < 0 && errno != EINTR) break;
+        for (int i = 0; ready > 0 && i < 2; ++i) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            char buffer[4096];
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                if (i == 0) {
+                    stdout_lines.feed(buffer, static_cast<size_t>(n), on_stdout);
+                } else {
+                    stderr_lines.feed(buffer, static_cast<size_t>(n), on_stderr);
+                }
+            } else if (n == 0 || errno != EINTR) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open_fds;
+            }
+        }
+
+        // Only progress runs report how far they got, so only they are checked for stalls; quiet
+        // runs (probes, stream copies, standalone extracts) are bounded by timeoutSeconds.
+        auto now = std::chrono::steady_clock::now();
+        if (cancelGeneration_ != generation) {
+            terminate("cancelled");
+        } else if (options_.timeoutSeconds > 0.0 && seconds_between(start, now) > options_.timeoutSeconds) {
+            terminate("timeout");
+        } else if (tracker && options_.stallTimeoutSeconds > 0.0 &&
+                   seconds_between(tracker->lastAdvance(), now) > options_.stallTimeoutSeconds) {
+            terminate("stalled");
+        }
+        if (!termination.empty()) {
+            if (!killed && seconds_between(terminated_at, now) > options_.killGraceSeconds) {
+                kill(pid, SIGKILL);
+                killed = true;
+            }
+            // A grandchild (sh -c) may still hold the pipes open; stop once our child is gone.
+            if (wait4(pid, &status, WNOHANG, &usage) == pid) {
+                reaped = true;
+                break;
+            }
+        }
+    }
+    for (auto& fd : fds) {
+        if (fd.fd >= 0) close(fd.fd);
+    }
+    stdout_lines.flush(on_stdout);
+    stderr_lines.flush(on_stderr);
+    std::cout.flush();
+    while (!reaped) {
+        if (wait4(pid, &status, 0, &usage) == pid) {
+            reaped = true;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+
+    Usage record;
+    record.program = program_name(argv);
+    record.pid = static_cast<int>(pid);
+    record.wallSeconds = seconds_between(start, std::chrono::steady_clock::now());
+    record.userSeconds = seconds(usage.ru_utime);
+    record.systemSeconds = seconds(usage.ru_stime);
+#if defined(__APPLE__)
+    record.maxRssKb = static_cast<long>(usage.ru_maxrss / 1024);  // bytes on macOS
+#else
+    record.maxRssKb = static_cast<long>(usage.ru_maxrss);
+#endif
+    if (reaped && WIFEXITED(status)) record.exitCode = WEXITSTATUS(status);
+    if (reaped && WIFSIGNALED(status)) record.signal = WTERMSIG(status);
+    record.termination = !termination.empty() ? termination : (record.signal != 0 ? "signaled" : "exited");
+    {
+        std::lock_guard<std::mutex> lock(historyMutex_);
+        history_.push_back(record);
+    }
+    if (sink_) sink_(record);
+
+    int code = record.exitCode >= 0 ? record.exitCode : 128 + record.signal;
+    if (code == 0 && termination.empty()) {
+        if (tracker) tracker->finish();
+        return 0;
+    }
+    if (code == 0) code = 128 + SIGTERM;  // exited cleanly on our SIGTERM, still a failed run
+
+    std::ostringstream reason;
+    if (termination == "stalled") {
+        reason << "no progress for " << options_.stallTimeoutSeconds << "s";
+    } else if (termination == "timeout") {
+        reason << "timed out after " << options_.timeoutSeconds << "s";
+    } else if (termination == "cancelled") {
+        reason << "cancelled";
+    } else if (record.signal != 0) {
+        reason << "killed by signal " << record.signal;
+    } else {
+        reason << "exit code " << record.exitCode;
+    }
+    std::cerr << record.program << " failed (" << reason.str() << ")";
+    if (!stderr_tail.empty()) {
+        std::cerr << "; last stderr lines:";
+        for (const auto& line : stderr_tail) std::cerr << "\n  " << line;
+    }
+    std::cerr << std::endl;
+
+    if (tracker) {
+        tracker->fail("FFmpeg exited with error");
+        throw std::runtime_error("FFmpeg execution failed (" + reason.str() + ")");
+    }
+    return code;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+#include "interfaces/IProcessExecutor.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Launches children with posix_spawnp and an explicit argv (no shell parse for argv runs),
+// with stdout and stderr on separate pipes. Progress runs parse ffmpeg's `-progress` output
+// from stdout and are killed when out_time_ms stops advancing; other runs only by the
+// wall-clock timeout. stderr is kept out of our logs and only its tail is reported when a child fails.
+// Every child is reaped with wait4 and traced as a span; its CPU time and peak RSS go to the
+// usage sink and history(). Not available on Windows.
+class PosixSpawnProcessExecutor : public Interfaces::IProcessExecutor {
+public:
+    struct Options {
+        double stallTimeoutSeconds = 120.0;  // progress runs: kill when out_time_ms stalls this long (0 = off)
+        double timeoutSeconds = 0.0;         // any run: wall-clock limit (0 = none)
+        double killGraceSeconds = 5.0;       // SIGTERM first, SIGKILL when still running after this
+        bool printUsage = false;             // default sink prints one usage line per child to stderr
+    };
+
+    // Resource accounting of one finished child.
+    struct Usage {
+        std::string program;
+        int pid = 0;
+        int exitCode = -1;         // -1 when the child was ended by a signal
+        int signal = 0;
+        double wallSeconds = 0.0;
+        double userSeconds = 0.0;
+        double systemSeconds = 0.0;
+        long maxRssKb = 0;
+        std::string termination = "exited";  // "exited", "signaled", "stalled", "timeout" or "cancelled"
+    };
+    // Receives the usage of each child; the default prints it only with Options::printUsage.
+    using UsageSink = std::function<void(const Usage&)>;
+
+    PosixSpawnProcessExecutor();
+    explicit PosixSpawnProcessExecutor(Options options, UsageSink sink = nullptr);
+
+    // Shell command strings run through /bin/sh -c, with the same pipes, limits and accounting.
+    int execute(const std::string& command) override;
+    void executeWithProgress(const std::string& command, double totalDurationSeconds) override;
+    int executeArgs(const std::vector<std::string>& argv) override;
+    void executeArgsWithProgress(const std::vector<std::string>& argv, double totalDurationSeconds) override;
+
+    // Terminates every child running at the time of the call (SIGTERM, then SIGKILL after the
+    // grace period); those runs fail as "cancelled". Runs started afterwards are unaffected, so
+    // a shared executor stays usable for the next job. Safe to call from any thread.
+    void cancel();
+
+    // Usage of every child reaped so far, oldest first.
+    std::vector<Usage> history() const;
+
+private:
+    // Returns the exit code (128 + signal for signaled children). Throws when the child cannot
+    // be started or, with progress, when it fails.
+    int run(const std::vector<std::string>& argv, bool progress, double totalDurationSeconds);
+
+    Options options_;
+    UsageSink sink_;
+    std::atomic<unsigned long long> cancelGeneration_{0};  // bumped by cancel(); runs compare theirs
+    mutable std::mutex historyMutex_;
+    std::vector<Usage> history_;
+};
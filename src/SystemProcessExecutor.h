@@ -1,8 +1,16 @@
 #pragma once
 #include "interfaces/IProcessExecutor.h"
+#include <memory>
 
+// Runs commands through the platform shell (system/popen). Used on Windows; POSIX builds use
+// PosixSpawnProcessExecutor.
 class SystemProcessExecutor : public Interfaces::IProcessExecutor {
 public:
     int execute(const std::string& command) override;
     void executeWithProgress(const std::string& command, double totalDurationSeconds) override;
 };
+
+// The executor for this platform: PosixSpawnProcessExecutor with the given stall watchdog (and
+// per-child usage lines with printUsage) on POSIX, SystemProcessExecutor on Windows.
+std::shared_ptr<Interfaces::IProcessExecutor> makeProcessExecutor(double stallTimeoutSeconds = 120.0,
+                                                                  bool printUsage = false);
@@ -24,33 +24,40 @@ fs::path make_temp_audio_path(const fs::path& baseDir,
     return baseDir / (prefix + "_" + std::to_string(stamp) + ext);
 }
 
-void run_ffmpeg_command(const std::string& cmd) {
-    int code = std::system(cmd.c_str());
+std::string seconds_arg(double seconds) {
+    std::ostringstream value;
+    value << std::fixed << std::setprecision(3) << seconds;
+    return value.str();
+}
+
+void run_ffmpeg_command(Interfaces::IProcessExecutor& executor, const std::vector<std::string>& args) {
+    int code = executor.executeArgs(args);
     if (code != 0) {
-        throw std::runtime_error("FFmpeg command failed: " + cmd);
+        throw std::runtime_error("FFmpeg command failed: " + Interfaces::IProcessExecutor::joinCommand(args));
     }
 }
 
-fs::path trim_audio_segment(const std::string& source,
+fs::path trim_audio_segment(Interfaces::IProcessExecutor& executor,
+                            const std::string& source,
                             double startSec,
                             double endSec,
                             const fs::path& audioDir,
                             const std::string& label) {
     fs::path output = make_temp_audio_path(audioDir, label);
-    std::ostringstream cmd;
-    cmd << "ffmpeg -y ";
+    std::vector<std::string> args = {"ffmpeg", "-y"};
     if (startSec > 0.0) {
-        cmd << "-ss " << std::fixed << std::setprecision(3) << startSec << " ";
+        args.insert(args.end(), {"-ss", seconds_arg(startSec)});
     }
     if (endSec > 0.0 && endSec > startSec) {
-        cmd << "-to " << std::fixed << std::setprecision(3) << endSec << " ";
+        args.insert(args.end(), {"-to", seconds_arg(endSec)});
     }
-    cmd << "-i \"" << source << "\" -c copy \"" << output.string() << "\"";
-    run_ffmpeg_command(cmd.str());
+    args.insert(args.end(), {"-i", source, "-c", "copy", output.string()});
+    run_ffmpeg_command(executor, args);
     return output;
 }
 
-fs::path concat_audio_segments(const std::vector<std::string>& segments,
+fs::path concat_audio_segments(Interfaces::IProcessExecutor& executor,
+                               const std::vector<std::string>& segments,
                                const fs::path& audioDir,
                                const std::string& label) {
     if (segments.empty()) {
@@ -60,17 +67,17 @@ fs::path concat_audio_segments(const std::vector<std::string>& segments,
         return fs::path(segments.front());
     }
     fs::path output = make_temp_audio_path(audioDir, label);
-    std::ostringstream cmd;
-    cmd << "ffmpeg -y ";
+    std::vector<std::string> args = {"ffmpeg", "-y"};
     for (const auto& segment : segments) {
-        cmd << "-i \"" << segment << "\" ";
+        args.insert(args.end(), {"-i", segment});
     }
-    cmd << "-filter_complex \"";
+    std::ostringstream filter;
     for (size_t i = 0; i < segments.size(); ++i) {
-        cmd << "[" << i << ":a]";
+        filter << "[" << i << ":a]";
     }
-    cmd << "concat=n=" << segments.size() << ":v=0:a=1[out]\" -map \"[out]\" \"" << output.string() << "\"";
-    run_ffmpeg_command(cmd.str());
+    filter << "concat=n=" << segments.size() << ":v=0:a=1[out]";
+    args.insert(args.end(), {"-filter_complex", filter.str(), "-map", "[out]", output.string()});
+    run_ffmpeg_command(executor, args);
     return output;
 }
 
@@ -149,11 +156,13 @@ SplicePlan CustomAudioProcessor::buildSplicePlan(const std::vector<VerseData>& v
 
 void CustomAudioProcessor::spliceRange(std::vector<VerseData>& verses,
                                        const CLIOptions& options,
-                                       const std::filesystem::path& audioDir) {
+                                       const std::filesystem::path& audioDir,
+                                       const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor) {
     SplicePlan plan = buildSplicePlan(verses, options);
     if (!plan.enabled) return;
 
-    fs::path mainTrimmed = trim_audio_segment(plan.sourceAudioPath,
+    fs::path mainTrimmed = trim_audio_segment(*processExecutor,
+                                              plan.sourceAudioPath,
                                               plan.mainStartMs / 1000.0,
                                               plan.mainEndMs / 1000.0,
                                               audioDir,
@@ -169,6 +178,7 @@ void CustomAudioProcessor::spliceRange(std::vector<VerseData>& verses,
                 ? bismVerse.sourceAudioPath
                 : plan.sourceAudioPath;
             fs::path bismTrimmed = trim_audio_segment(
+                *processExecutor,
                 bismSource,
                 plan.bismillahStartMs / 1000.0,
                 plan.bismillahEndMs / 1000.0,
@@ -185,7 +195,7 @@ void CustomAudioProcessor::spliceRange(std::vector<VerseData>& verses,
     }
 
     segments.push_back(mainTrimmed.string());
-    fs::path finalAudio = concat_audio_segments(segments, audioDir, "custom_splice");
+    fs::path finalAudio = concat_audio_segments(*processExecutor, segments, audioDir, "custom_splice");
 
     double offsetMs = plan.hasBismillah ? bismDurationMs : 0.0;
 
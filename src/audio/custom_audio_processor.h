@@ -1,7 +1,9 @@
 #pragma once
 
 #include "types.h"
+#include "interfaces/IProcessExecutor.h"
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -27,7 +29,8 @@ public:
                                       const CLIOptions& options);
     static void spliceRange(std::vector<VerseData>& verses,
                             const CLIOptions& options,
-                            const std::filesystem::path& audioDir);
+                            const std::filesystem::path& audioDir,
+                            const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor);
 };
 
 } // namespace Audio
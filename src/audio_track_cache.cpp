@@ -0,0 +1,67 @@
+#include "audio_track_cache.h"
+#include "cache_utils.h"
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace AudioTrack {
+
+namespace {
+    // Bump when the audio graph changes so stale tracks are not reused.
+    constexpr const char* kTrackVersion = "audio-track-v1";
+}
+
+Render::OptionList encodeOptions() {
+    return {{"c:a", "aac"}, {"b:a", "128k"}};
+}
+
+std::string trackKey(const AppConfig& config, const CLIOptions& options, const std::vector<VerseData>& verses) {
+    std::ostringstream key;
+    key << kTrackVersion << '|' << config.reciterId << '|' << options.surah << ':' << options.from << '-' << options.to
+        << '|' << (config.recitationMode == RecitationMode::GAPLESS ? "gapless" : "gapped")
+        << '|' << config.introDuration << '|' << config.pauseAfterIntroDuration;
+    for (const auto& [name, value] : encodeOptions()) key << '|' << name << '=' << value;
+
+    // Local paths can be per-run download locations, so recitations are keyed by their source:
+    // the audio URL (with the reciter above), or the contents for custom audio, which can also
+    // be replaced in place.
+    std::string hashed_path;
+    std::string hashed_contents;
+    for (const auto& verse : verses) {
+        key << '\n' << verse.verseKey << '|';
+        if (verse.fromCustomAudio) {
+            if (verse.localAudioPath != hashed_path) {
+                hashed_path = verse.localAudioPath;
+                hashed_contents = CacheUtils::hashFile(verse.localAudioPath);
+            }
+            key << hashed_contents;
+        } else {
+            key << (verse.audioUrl.empty() ? verse.localAudioPath : verse.audioUrl);
+        }
+        key << '|' << verse.timestampFromMs << '|' << verse.timestampToMs << '|' << verse.durationInSeconds;
+    }
+    return CacheUtils::hashString(key.str());
+}
+
+fs::path trackPath(const std::string& key) {
+    fs::path dir = CacheUtils::getCacheRoot() / "audio-tracks";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return dir / (key + ".m4a");
+}
+
+bool store(const fs::path& partial, const fs::path& track) {
+    if (!CacheUtils::fileIsValid(partial)) return false;
+    std::error_code ec;
+    fs::rename(partial, track, ec);
+    if (ec) {
+        std::cerr << "Warning: Failed to store audio track: " << ec.message() << std::endl;
+        fs::remove(partial, ec);
+        return false;
+    }
+    return true;
+}
+
+} // namespace AudioTrack
@@ -0,0 +1,23 @@
+#pragma once
+#include "types.h"
+#include "render/render_plan.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace AudioTrack {
+
+// AAC settings of every encoded audio track; part of the cache key.
+Render::OptionList encodeOptions();
+
+// Content key for the final mixed track of a render: reciter, verse range and timings, recitation
+// mode, intro/pause padding and the AAC settings. Recitations are identified by their audio URL
+// (the local path when there is none) or, for custom audio, by the file contents.
+std::string trackKey(const AppConfig& config, const CLIOptions& options, const std::vector<VerseData>& verses);
+std::filesystem::path trackPath(const std::string& key);
+
+// Moves a freshly encoded partial track into the cache. Returns false (after a warning) when
+// it was not produced.
+bool store(const std::filesystem::path& partial, const std::filesystem::path& track);
+
+} // namespace AudioTrack
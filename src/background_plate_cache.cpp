@@ -0,0 +1,160 @@
+#include "background_plate_cache.h"
+#include "cache_utils.h"
+#include "render/plan_runner.h"
+#include "tracing.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace BackgroundPlate {
+
+namespace {
+    // Bump when the plate recipe changes so stale plates are not reused.
+    constexpr const char* kPlateVersion = "plate-v1";
+
+    // Plates are intermediates that get re-encoded by every render, so keep them close to lossless.
+    constexpr const char* kPlateCrf = "12";
+
+    struct SourceHash {
+        std::uintmax_t size = 0;
+        fs::file_time_type modified;
+        std::string hash;
+    };
+
+    std::mutex source_hashes_mutex;
+    std::map<std::string, SourceHash> source_hashes;
+
+    // Content hash of a background source, remembered while its size and mtime are unchanged
+    // (as LayoutCache does for fonts), so each render does not re-read the whole video.
+    std::string source_hash(const std::string& path) {
+        std::error_code ec;
+        std::uintmax_t size = fs::file_size(path, ec);
+        fs::file_time_type modified;
+        if (!ec) modified = fs::last_write_time(path, ec);
+        if (ec) return CacheUtils::hashFile(path);
+        {
+            std::lock_guard<std::mutex> lock(source_hashes_mutex);
+            auto it = source_hashes.find(path);
+            if (it != source_hashes.end() && it->second.size == size && it->second.modified == modified) {
+                return it->second.hash;
+            }
+        }
+        std::string hash = CacheUtils::hashFile(path);
+        std::lock_guard<std::mutex> lock(source_hashes_mutex);
+        source_hashes[path] = SourceHash{size, modified, hash};
+        return hash;
+    }
+}
+
+PlateSpec specFromConfig(const AppConfig& config, bool applyOverlay) {
+    PlateSpec spec;
+    spec.sourcePath = config.assetBgVideo;
+    spec.width = config.width;
+    spec.height = config.height;
+    spec.fps = config.fps;
+    spec.pixelFormat = config.pixelFormat;
+    if (applyOverlay) spec.overlayColor = config.overlayColor;
+    return spec;
+}
+
+bool isStillImage(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".webp" || ext == ".bmp";
+}
+
+std::string plateKey(const PlateSpec& spec) {
+    std::ostringstream key;
+    key << kPlateVersion << '|' << source_hash(spec.sourcePath)
+        << '|' << spec.width << 'x' << spec.height << '@' << spec.fps
+        << '|' << spec.pixelFormat << '|' << spec.overlayColor << (spec.still ? "|still" : "");
+    return CacheUtils::hashString(key.str());
+}
+
+fs::path platePath(const PlateSpec& spec) {
+    fs::path dir = CacheUtils::getCacheRoot() / "plates";
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return dir / (plateKey(spec) + (spec.still ? ".png" : ".mp4"));
+}
+
+bool renderPlate(const PlateSpec& spec,
+                 const fs::path& destination,
+                 const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                 const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    // Concurrent jobs can build the same plate; each writes its own partial and renames it.
+    fs::path partial = CacheUtils::uniquePartialPath(destination);
+
+    std::ostringstream chain;
+    chain << "[0:v]setpts=PTS-STARTPTS,scale=" << spec.width << ":" << spec.height;
+    if (!spec.still) chain << ",fps=" << spec.fps << ",format=" << spec.pixelFormat;
+    if (!spec.overlayColor.empty()) {
+        chain << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << spec.overlayColor << ":t=fill";
+    }
+    chain << "[v]";
+
+    Render::Plan plan;
+    Render::Input source;
+    source.path = fs::path(spec.sourcePath).generic_string();
+    plan.inputs.push_back(source);
+    plan.filterComplex = chain.str();
+    Render::Output output;
+    output.path = partial.generic_string();
+    output.maps.push_back("[v]");
+    if (spec.still) {
+        output.options = {{"frames:v", "1"}, {"c:v", "png"}};
+    } else {
+        output.options = {
+            {"c:v", "libx264"},
+            {"preset", "veryfast"},
+            {"crf", kPlateCrf},
+            {"g", std::to_string(spec.fps)},
+            {"pix_fmt", spec.pixelFormat},
+            {"movflags", "+faststart"}
+        };
+    }
+    plan.outputs.push_back(output);
+    Render::runPlan(plan, processExecutor, renderEngine);
+
+    if (!CacheUtils::fileIsValid(partial)) return false;
+    std::error_code ec;
+    fs::rename(partial, destination, ec);
+    if (ec) {
+        std::cerr << "Warning: Failed to store background plate: " << ec.message() << std::endl;
+        fs::remove(partial, ec);
+        return false;
+    }
+    return true;
+}
+
+std::string ensurePlate(const PlateSpec& spec,
+                        const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                        const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    try {
+        Tracing::Span span(spec.still ? "backgroundStill" : "backgroundPlate", "background");
+        fs::path path = platePath(spec);
+        if (CacheUtils::fileIsValid(path)) {
+            std::cout << "Using cached background plate: " << path.string() << std::endl;
+            return path.string();
+        }
+
+        std::cout << "Building background " << (spec.still ? "still" : "plate") << " (" << spec.width << "x"
+                  << spec.height << (spec.still ? "" : " @ " + std::to_string(spec.fps) + "fps") << ")..." << std::endl;
+        if (!renderPlate(spec, path, processExecutor, renderEngine)) {
+            std::cerr << "Warning: Background plate was not produced, using source video." << std::endl;
+            return "";
+        }
+        return path.string();
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Background plate cache unavailable: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+} // namespace BackgroundPlate
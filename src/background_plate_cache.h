@@ -0,0 +1,44 @@
+#pragma once
+#include "types.h"
+#include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace BackgroundPlate {
+
+// Everything that affects the pixels of a plate: the source video plus the
+// scale/fps/format normalization and the overlay baked into it.
+struct PlateSpec {
+    std::string sourcePath;
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    std::string pixelFormat;
+    std::string overlayColor;  // empty when no overlay is baked in
+    bool still = false;        // a single PNG frame (first frame of the source) instead of a video
+};
+
+PlateSpec specFromConfig(const AppConfig& config, bool applyOverlay);
+
+// True for image files (png, jpg, jpeg, webp, bmp), which only ever need one frame.
+bool isStillImage(const std::string& path);
+
+// Content-addressed key from the source file hash and the normalization parameters.
+std::string plateKey(const PlateSpec& spec);
+std::filesystem::path platePath(const PlateSpec& spec);
+
+// Renders the plate for spec to destination. Returns false when it was not produced.
+bool renderPlate(const PlateSpec& spec,
+                 const std::filesystem::path& destination,
+                 const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                 const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine = nullptr);
+
+// Returns the cached plate for spec, rendering it once if missing. Returns an empty
+// string when the plate cannot be produced so callers can use the source directly.
+std::string ensurePlate(const PlateSpec& spec,
+                        const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                        const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine = nullptr);
+
+} // namespace BackgroundPlate
@@ -1,10 +1,13 @@
 #include "background_video_manager.h"
 #include "r2_client.h"
 #include "cache_utils.h"
+#include "tracing.h"
+#include "render_workspace.h"
 #include <iostream>
 #include <chrono>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <algorithm>
 #include <cmath>
 
@@ -16,14 +19,108 @@ namespace fs = std::filesystem;
 
 namespace BackgroundVideo {
 
+namespace {
+
+// trim=end as written into the graph (microseconds), so frame counts use the same cut.
+double trim_seconds(const VideoSegment& segment) {
+    return std::round(segment.trimmedDuration * 1e6) / 1e6;
+}
+
+// Trim one clip at its source rate, then scale and resample it so the concatenated timeline is
+// uniform. Timestamps stay those of the source file, so a seeked input gives the same frames.
+void appendClipChain(std::ostringstream& filter, const AppConfig& config, const VideoSegment& segment) {
+    if (segment.needsTrim) {
+        filter << "trim=end=" << std::fixed << std::setprecision(6) << trim_seconds(segment) << ",";
+        filter.unsetf(std::ios::floatfield);
+    }
+    filter << "scale=" << config.width << ":" << config.height
+           << ",fps=" << config.fps
+           << ",format=" << config.pixelFormat
+           << ",setsar=1";
+}
+
+void appendConcat(std::ostringstream& filter, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        filter << "[v" << i << "]";
+    }
+    filter << "concat=n=" << count << ":v=1:a=0[bg]; ";
+    filter << "[bg]setpts=PTS-STARTPTS";
+}
+
+double source_rate(const VideoSegment& segment, int fps) {
+    return segment.frameRate > 0.0 ? segment.frameRate : static_cast<double>(fps);
+}
+
+} // namespace
+
+std::string buildConcatFilter(const AppConfig& config, const std::vector<VideoSegment>& segments) {
+    std::ostringstream filter;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        filter << "[" << i << ":v]";
+        appendClipChain(filter, config, segments[i]);
+        filter << "[v" << i << "]; ";
+    }
+    appendConcat(filter, segments.size());
+    return filter.str();
+}
+
+long long clipFrameCount(const VideoSegment& segment, int fps) {
+    double rate = source_rate(segment, fps);
+    // Source frames at k/rate; trim=end=D keeps those with k/rate < D.
+    double sourceFrames = segment.needsTrim ? std::ceil(trim_seconds(segment) * rate - 1e-6)
+                                            : std::round(segment.duration * rate);
+    // fps ends the clip at the end of its last source frame, rounded to the output grid.
+    return std::llround(sourceFrames / rate * fps);
+}
+
+std::vector<ClipSlice> clipsInWindow(const std::vector<VideoSegment>& segments, int fps,
+                                     double startSeconds, double endSeconds) {
+    std::vector<ClipSlice> slices;
+    long long windowStart = std::llround(startSeconds * fps);
+    long long windowEnd = std::llround(endSeconds * fps);
+    long long clipStart = 0;
+    for (size_t i = 0; i < segments.size() && clipStart < windowEnd; ++i) {
+        long long clipEnd = clipStart + clipFrameCount(segments[i], fps);
+        if (clipEnd > windowStart) {
+            ClipSlice slice;
+            slice.clip = i;
+            slice.path = segments[i].path;
+            slice.startFrame = std::max(clipStart, windowStart) - clipStart;
+            slice.endFrame = std::min(clipEnd, windowEnd) - clipStart;
+            // fps picks, for each output frame, a source frame up to one source frame (plus half
+            // an output frame) earlier; decode from a little before that.
+            double margin = 1.0 / source_rate(segments[i], fps) + 1.0 / fps;
+            slice.seekSeconds = std::max(0.0, static_cast<double>(slice.startFrame) / fps - margin);
+            slice.durationSeconds = static_cast<double>(slice.endFrame) / fps - slice.seekSeconds + margin;
+            slices.push_back(slice);
+        }
+        clipStart = clipEnd;
+    }
+    return slices;
+}
+
+std::string buildWindowFilter(const AppConfig& config, const std::vector<VideoSegment>& segments,
+                              const std::vector<ClipSlice>& slices) {
+    std::ostringstream filter;
+    for (size_t i = 0; i < slices.size(); ++i) {
+        filter << "[" << i << ":v]";
+        appendClipChain(filter, config, segments[slices[i].clip]);
+        // fps output is in 1/fps units, so the cut is on exact frame indices.
+        filter << ",trim=start_pts=" << slices[i].startFrame << ":end_pts=" << slices[i].endFrame
+               << ",setpts=PTS-STARTPTS[v" << i << "]; ";
+    }
+    appendConcat(filter, slices.size());
+    return filter.str();
+}
+
 Manager::Manager(const AppConfig& config, const CLIOptions& options)
     : config_(config), options_(options) {
     auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
-    tempDir_ = fs::temp_directory_path() / ("qvm_bg_" + std::to_string(timestamp));
-    fs::create_directories(tempDir_);
+    tempDir_ = scratchDirectory("qvm_bg_" + std::to_string(timestamp));
 }
 
-double Manager::getVideoDuration(const std::string& path) {
+double Manager::getVideoDuration(const std::string& path, double& frameRate) {
+    frameRate = 0.0;
     AVFormatContext* formatContext = nullptr;
     if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) != 0) {
         return 0.0;
@@ -33,6 +130,11 @@ double Manager::getVideoDuration(const std::string& path) {
         return 0.0;
     }
     double duration = static_cast<double>(formatContext->duration) / AV_TIME_BASE;
+    int stream = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (stream >= 0) {
+        AVRational rate = formatContext->streams[stream]->avg_frame_rate;
+        if (rate.num > 0 && rate.den > 0) frameRate = av_q2d(rate);
+    }
     avformat_close_input(&formatContext);
     return duration;
 }
@@ -87,6 +189,7 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
     if (!config_.videoSelection.enableDynamicBackgrounds) {
         return "";  // Use default single input
     }
+    Tracing::Span span("buildFilterComplex", "background");
 
     try {
         std::cout << "Selecting dynamic background videos..." << std::endl;
@@ -165,6 +268,7 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
                 if (config_.videoSelection.useLocalDirectory) {
                     themeVideosCache[theme] = listLocalVideos(theme);
                 } else {
+                    Tracing::Span list_span("R2 listVideosInTheme", "background");
                     themeVideosCache[theme] = r2Client->listVideosInTheme(theme);
                 }
                 
@@ -248,6 +352,7 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
                 } else {
                     fs::path tempPath = tempDir_ / fs::path(entry.videoKey).filename();
                     try {
+                        Tracing::Span download_span("R2 downloadVideo", "background");
                         localPath = r2Client->downloadVideo(entry.videoKey, tempPath);
                         cacheVideo(entry.videoKey, localPath);
                         tempFiles_.push_back(tempPath);
@@ -259,7 +364,8 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
             }
             
             // Get video duration
-            double duration = getVideoDuration(localPath);
+            double frameRate = 0.0;
+            double duration = getVideoDuration(localPath, frameRate);
             if (duration <= 0) {
                 std::cerr << " (invalid duration)" << std::endl;
                 continue;
@@ -272,6 +378,7 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
             segment.path = localPath;
             segment.theme = entry.theme;
             segment.duration = duration;
+            segment.frameRate = frameRate;
             segment.isLocal = true;
             segment.needsTrim = false;
             segment.trimmedDuration = duration;
@@ -306,33 +413,10 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
         std::cout << "  Collected " << segments.size() << " segments, total duration: " 
                   << currentTime << " seconds" << std::endl;
         
-        // Build concat filter
-        std::ostringstream filter;
-        
-        // First, scale and trim all inputs
-        for (size_t i = 0; i < segments.size(); ++i) {
-            filter << "[" << i << ":v]";
-            
-            // Trim if needed
-            if (segments[i].needsTrim) {
-                filter << "trim=duration=" << segments[i].trimmedDuration << ",setpts=PTS-STARTPTS,";
-            }
-            
-            // Scale to configured dimensions and normalize parameters
-            filter << "scale=" << config_.width << ":" << config_.height 
-                   << ",fps=" << config_.fps
-                   << ",format=" << config_.pixelFormat
-                   << ",setsar=1[v" << i << "]; ";
-        }
-        
-        // Then concat them
-        for (size_t i = 0; i < segments.size(); ++i) {
-            filter << "[v" << i << "]";
-        }
-        filter << "concat=n=" << segments.size() << ":v=1:a=0[bg]; ";
-        filter << "[bg]setpts=PTS-STARTPTS";
+        std::string filter = buildConcatFilter(config_, segments);
+        segments_ = segments;
         
-        return filter.str();
+        return filter;
         
     } catch (const std::exception& e) {
         std::cerr << "Warning: Dynamic background selection failed: " << e.what() 
@@ -14,8 +14,40 @@ struct VideoSegment {
     double trimmedDuration;
     bool isLocal;
     bool needsTrim;
+    double frameRate = 0.0;  // source frames per second (0 = unknown, assume the output rate)
 };
 
+// Concat graph over the clips opened as inputs 0..n-1: each is trimmed at its source rate, then
+// scaled and resampled to config.fps. Ends unlabelled after "setpts=PTS-STARTPTS" so callers can
+// chain onto it.
+std::string buildConcatFilter(const AppConfig& config, const std::vector<VideoSegment>& segments);
+
+// Output frames a clip contributes to that timeline. trim keeps the source frames that start
+// before trimmedDuration, and fps resamples their span, so this depends on the source rate.
+long long clipFrameCount(const VideoSegment& segment, int fps);
+
+// One clip's share of a window on the concatenated background timeline.
+struct ClipSlice {
+    size_t clip;             // index into the segments
+    std::string path;
+    long long startFrame;    // output frames [startFrame, endFrame) of the clip
+    long long endFrame;
+    double seekSeconds;      // input seek, a few source frames before startFrame (0 = none)
+    double durationSeconds;  // input duration from the seek point, with the same margin
+};
+
+// Clips overlapping [startSeconds, endSeconds) of the timeline buildConcatFilter produces. The
+// window is cut on the output frame grid, with each clip starting at the sum of the earlier
+// clips' clipFrameCount.
+std::vector<ClipSlice> clipsInWindow(const std::vector<VideoSegment>& segments, int fps,
+                                     double startSeconds, double endSeconds);
+
+// Concat graph over slices opened as inputs 0..n-1 (seeked with their timestamps kept, see
+// ClipSlice). Each clip runs through the same chain as buildConcatFilter and is then cut to its
+// output frames, so the window's frames are the single-pass frames. Ends like buildConcatFilter.
+std::string buildWindowFilter(const AppConfig& config, const std::vector<VideoSegment>& segments,
+                              const std::vector<ClipSlice>& slices);
+
 class Manager {
 public:
     explicit Manager(const AppConfig& config, const CLIOptions& options);
@@ -24,6 +56,9 @@ public:
     std::string buildFilterComplex(double totalDurationSeconds, 
                                    std::vector<std::string>& outputInputFiles);
     
+    // Clips selected by the last buildFilterComplex, in timeline order
+    const std::vector<VideoSegment>& segments() const { return segments_; }
+
     // Cleanup temporary files
     void cleanup();
 
@@ -33,10 +68,11 @@ private:
     std::filesystem::path tempDir_;
     std::filesystem::path cacheDir_;
     std::vector<std::filesystem::path> tempFiles_;
+    std::vector<VideoSegment> segments_;
     VideoSelector::SelectionState selectionState_;
     
-    // Get video duration using libav
-    double getVideoDuration(const std::string& path);
+    // Get video duration and the video stream's frame rate (0 when unknown) using libav
+    double getVideoDuration(const std::string& path, double& frameRate);
     
     // Cache management for R2 videos
     std::string getCachedVideoPath(const std::string& remoteKey);
@@ -0,0 +1,122 @@
+#include "batch_runner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using nlohmann::json;
+
+namespace BatchRunner {
+
+std::vector<json> readJobs(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Could not open batch file: " + path);
+
+    std::vector<json> jobs;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        try {
+            jobs.push_back(json::parse(line));
+        } catch (const json::parse_error& e) {
+            throw std::runtime_error("Invalid JSON on line " + std::to_string(lineNumber) + " of " + path + ": " + e.what());
+        }
+    }
+    return jobs;
+}
+
+std::vector<std::string> outputConflicts(const std::vector<json>& jobs, const CLIOptions& defaults) {
+    std::vector<std::string> conflicts(jobs.size());
+    std::map<std::string, size_t> claimed;  // output directory and stem -> job index
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        CLIOptions options;
+        try {
+            options = RenderJob::optionsFromJson(jobs[i], defaults);
+            if (!RenderJob::normalizeOptions(options).empty()) continue;
+        } catch (const std::exception&) {
+            continue;
+        }
+        for (const auto& output : RenderJob::outputPaths(options)) {
+            auto [owner, inserted] = claimed.emplace(RenderJob::outputKey(output), i);
+            if (!inserted && owner->second != i) {
+                conflicts[i] = "Output " + output + " conflicts with batch job " + std::to_string(owner->second + 1);
+                break;
+            }
+        }
+    }
+    return conflicts;
+}
+
+int run(const Options& batchOptions,
+        const CLIOptions& defaults,
+        const ConfigFile& configFile,
+        const std::vector<std::string>& invocationArgs,
+        const RenderJob::Services& services) {
+    std::vector<json> jobs = readJobs(batchOptions.jobsPath);
+    std::string resultsPath = batchOptions.resultsPath.empty()
+        ? batchOptions.jobsPath + ".results.jsonl"
+        : batchOptions.resultsPath;
+    std::ofstream results(resultsPath, std::ios::trunc);
+    if (!results.is_open()) throw std::runtime_error("Could not open batch results file: " + resultsPath);
+
+    std::vector<std::string> conflicts = outputConflicts(jobs, defaults);
+    int workerCount = std::max(1, std::min(batchOptions.workers, static_cast<int>(jobs.size())));
+    std::cout << "Batch: " << jobs.size() << " jobs, " << workerCount << " worker(s), results -> "
+              << resultsPath << std::endl;
+
+    auto batchStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextJob{0};
+    std::atomic<int> failures{0};
+    std::mutex resultsMutex;
+
+    auto worker = [&](int workerIndex) {
+        while (true) {
+            size_t index = nextJob++;
+            if (index >= jobs.size()) return;
+            const json& job = jobs[index];
+            double queuedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+
+            RenderJob::Result result;
+            try {
+                if (!conflicts[index].empty()) throw std::runtime_error(conflicts[index]);
+                CLIOptions options = RenderJob::optionsFromJson(job, defaults);
+                std::vector<std::string> jobArgs = invocationArgs;
+                jobArgs.push_back("--batch-job");
+                jobArgs.push_back(job.dump());
+                result = RenderJob::run(options, configFile, jobArgs, services);
+            } catch (const std::exception& e) {
+                result.error = e.what();
+            }
+            if (!result.success) ++failures;
+
+            json line = RenderJob::resultToJson(result);
+            line["index"] = index;
+            if (job.is_object() && job.contains("id")) line["id"] = job["id"];
+            line["worker"] = workerIndex;
+            line["timings"]["queuedSeconds"] = queuedSeconds;
+
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results << line.dump() << "\n";
+            results.flush();
+            std::cout << "Batch job " << (index + 1) << "/" << jobs.size() << " "
+                      << (result.success ? "succeeded" : "failed: " + result.error) << std::endl;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; ++i) workers.emplace_back(worker, i);
+    for (auto& thread : workers) thread.join();
+
+    std::cout << "Batch complete: " << (jobs.size() - failures) << " succeeded, " << failures << " failed" << std::endl;
+    return failures;
+}
+
+} // namespace BatchRunner
@@ -0,0 +1,32 @@
+#pragma once
+#include "render_job.h"
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace BatchRunner {
+
+struct Options {
+    std::string jobsPath;
+    std::string resultsPath;  // defaults to <jobsPath>.results.jsonl
+    int workers = 1;
+};
+
+// Reads one JSON job per line; blank lines and lines starting with '#' are skipped.
+std::vector<nlohmann::json> readJobs(const std::string& path);
+
+// Per job, an error when its resolved output (or a rendition's) has the same directory and stem
+// as an earlier job's: they would overwrite each other's video, thumbnail and sidecar. Jobs that
+// fail to parse or validate get "" here and report their own error when run.
+std::vector<std::string> outputConflicts(const std::vector<nlohmann::json>& jobs, const CLIOptions& defaults);
+
+// Renders every job on a bounded worker pool, sharing the parsed config and the process-wide
+// caches. Jobs with an output conflict fail without rendering. Writes one result line per job
+// (in completion order) and returns the failure count.
+int run(const Options& batchOptions,
+        const CLIOptions& defaults,
+        const ConfigFile& configFile,
+        const std::vector<std::string>& invocationArgs,
+        const RenderJob::Services& services);
+
+} // namespace BatchRunner
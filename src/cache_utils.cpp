@@ -1,6 +1,8 @@
 #include "cache_utils.h"
 #include "quran_data.h"
 #include <fstream>
+#include <cstdint>
+#include <vector>
 #include <unordered_map>
 #include <mutex>
 #include <cctype>
@@ -10,8 +12,16 @@
 #include <chrono>
 #include <thread>
 #include <iostream>
+#include <sstream>
+#include <atomic>
 #include <cpr/cpr.h>
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
@@ -66,6 +76,27 @@ namespace {
     std::mutex reciterCacheMutex;
     std::unordered_map<int, json> reciterAudioCache;
 
+    constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+    constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+    uint64_t fnv1a(uint64_t hash, const char* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= kFnvPrime;
+        }
+        return hash;
+    }
+
+    std::string to_hex(uint64_t value) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; --i) {
+            out[i] = digits[value & 0xF];
+            value >>= 4;
+        }
+        return out;
+    }
+
     void ensure_parent(const fs::path& path) {
         const auto parent = path.parent_path();
         if (!parent.empty()) {
@@ -141,6 +172,15 @@ std::string CacheUtils::getTranslationText(int translationId, const std::string&
     return "";
 }
 
+void CacheUtils::clearMemoryCaches() {
+    {
+        std::lock_guard<std::mutex> lock(translationCacheMutex);
+        translationCache.clear();
+    }
+    std::lock_guard<std::mutex> lock(reciterCacheMutex);
+    reciterAudioCache.clear();
+}
+
 const json& CacheUtils::getReciterAudioData(int reciterId) {
     std::lock_guard<std::mutex> lock(reciterCacheMutex);
     auto it = reciterAudioCache.find(reciterId);
@@ -172,6 +212,19 @@ bool CacheUtils::fileIsValid(const fs::path& path) {
     return fs::exists(path, ec) && fs::file_size(path, ec) > 0;
 }
 
+fs::path CacheUtils::uniquePartialPath(const fs::path& destination) {
+    static std::atomic<unsigned long> next_partial{0};
+#ifdef _WIN32
+    long pid = static_cast<long>(_getpid());
+#else
+    long pid = static_cast<long>(getpid());
+#endif
+    std::ostringstream name;
+    name << destination.stem().string() << '.' << pid << '-' << next_partial++ << ".partial"
+         << destination.extension().string();
+    return destination.parent_path() / name.str();
+}
+
 std::string CacheUtils::sanitizeLabel(std::string value) {
     for (char& ch : value) {
         if (!std::isalnum(static_cast<unsigned char>(ch))) {
@@ -181,10 +234,34 @@ std::string CacheUtils::sanitizeLabel(std::string value) {
     return value;
 }
 
+std::string CacheUtils::hashString(const std::string& value) {
+    return to_hex(fnv1a(kFnvOffsetBasis, value.data(), value.size()));
+}
+
+std::string CacheUtils::hashFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Unable to open file for hashing: " + path.string());
+    }
+    std::vector<char> buffer(1 << 20);
+    uint64_t hash = kFnvOffsetBasis;
+    while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hash = fnv1a(hash, buffer.data(), static_cast<size_t>(file.gcount()));
+    }
+    return to_hex(hash);
+}
+
 bool CacheUtils::downloadFileWithRetry(const std::string& url, const fs::path& destination, int maxRetries) {
     ensure_parent(destination);
+    // Download next to the destination and rename into place so concurrent jobs fetching
+    // the same file never observe (or clobber) a partial download.
+    std::ostringstream suffix;
+    suffix << ".part-" << std::this_thread::get_id();
+    fs::path partial = destination;
+    partial += suffix.str();
     for (int attempt = 1; attempt <= maxRetries; ++attempt) {
-        std::ofstream out(destination, std::ios::binary | std::ios::trunc);
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
         if (!out.is_open()) {
             throw std::runtime_error("Unable to open destination for download: " + destination.string());
         }
@@ -200,9 +277,13 @@ bool CacheUtils::downloadFileWithRetry(const std::string& url, const fs::path& d
 
         const bool ok = response.error.code == cpr::ErrorCode::OK &&
                         response.status_code >= 200 && response.status_code < 400 &&
-                        fileIsValid(destination);
+                        fileIsValid(partial);
         if (ok) {
-            return true;
+            std::error_code ec;
+            fs::rename(partial, destination, ec);
+            if (!ec) return true;
+            fs::remove(partial, ec);
+            return fileIsValid(destination);
         }
 
         if (attempt == maxRetries) {
@@ -213,7 +294,7 @@ bool CacheUtils::downloadFileWithRetry(const std::string& url, const fs::path& d
         }
 
         std::error_code ec;
-        fs::remove(destination, ec);
+        fs::remove(partial, ec);
         std::this_thread::sleep_for(std::chrono::milliseconds(250 * attempt));
     }
     return false;
@@ -17,8 +17,17 @@ namespace CacheUtils {
     const nlohmann::json& getTranslationData(int translationId);
     const nlohmann::json& getReciterAudioData(int reciterId);
     std::string getTranslationText(int translationId, const std::string& verseKey);
+    // Drops parsed translation/reciter data so the next lookup re-reads the files (benchmarks).
+    // Invalidates references returned by the getters above.
+    void clearMemoryCaches();
     std::filesystem::path buildCachedAudioPath(const std::string& label);
     bool fileIsValid(const std::filesystem::path& path);
+    // Scratch name next to `destination`, unique per process and call, for files written and
+    // then renamed into place by concurrent jobs. Keeps the extension so ffmpeg infers the format.
+    std::filesystem::path uniquePartialPath(const std::filesystem::path& destination);
     std::string sanitizeLabel(std::string value);
+    // Stable 64-bit FNV-1a hashes (16 hex chars) for content-addressed cache keys
+    std::string hashString(const std::string& value);
+    std::string hashFile(const std::filesystem::path& path);
     bool downloadFileWithRetry(const std::string& url, const std::filesystem::path& destination, int maxRetries = 4);
 }
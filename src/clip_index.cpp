@@ -0,0 +1,234 @@
+#include "clip_index.h"
+#include "render/plan_runner.h"
+#include "tracing.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace ClipIndex {
+
+namespace {
+
+constexpr int kIndexVersion = 1;
+
+std::string verse_key(int surah, int verse) {
+    return std::to_string(surah) + ":" + std::to_string(verse);
+}
+
+// (seconds from the first sample, file offset) of every keyframe in the stream's sample table.
+std::vector<std::pair<double, long long>> keyframe_table(AVStream* stream) {
+    std::vector<std::pair<double, long long>> keyframes;
+    double time_base = av_q2d(stream->time_base);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 76, 100)
+    int count = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < count; ++i) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        if (entry && (entry->flags & AVINDEX_KEYFRAME)) keyframes.emplace_back(entry->timestamp * time_base, entry->pos);
+    }
+#else
+    for (int i = 0; i < stream->nb_index_entries; ++i) {
+        const AVIndexEntry& entry = stream->index_entries[i];
+        if (entry.flags & AVINDEX_KEYFRAME) keyframes.emplace_back(entry.timestamp * time_base, entry.pos);
+    }
+#endif
+    if (!keyframes.empty()) {
+        // Decode timestamps start below zero when the encoder delays frames; the first sample is t=0.
+        double origin = keyframes.front().first;
+        for (auto& keyframe : keyframes) keyframe.first -= origin;
+    }
+    return keyframes;
+}
+
+} // namespace
+
+std::vector<Entry> timeline(const AppConfig& config,
+                            const std::vector<VerseData>& verses,
+                            const VerseSegmentation::Manager* segmentManager) {
+    std::vector<Entry> entries;
+    double cumulative = config.introDuration + config.pauseAfterIntroDuration;
+    for (const auto& verse : verses) {
+        double verse_end = cumulative + verse.durationInSeconds;
+        bool segmented = segmentManager && segmentManager->isEnabled() &&
+                         segmentManager->shouldSegmentVerse(verse.verseKey);
+        std::vector<VerseSegmentation::Segment> segments;
+        if (segmented) segments = segmentManager->getSegments(verse.verseKey);
+        if (segments.empty()) {
+            Entry entry;
+            entry.verseKey = verse.verseKey;
+            entry.startSeconds = cumulative;
+            entry.endSeconds = verse_end;
+            entries.push_back(entry);
+        } else {
+            double verse_audio_start = verse.timestampFromMs / 1000.0;
+            for (size_t i = 0; i < segments.size(); ++i) {
+                Entry entry;
+                entry.verseKey = verse.verseKey;
+                entry.segment = static_cast<int>(i);
+                entry.startSeconds = cumulative + (segments[i].startSeconds - verse_audio_start);
+                entry.endSeconds = segments[i].isLast || i + 1 == segments.size()
+                    ? verse_end
+                    : cumulative + (segments[i].endSeconds - verse_audio_start);
+                entries.push_back(entry);
+            }
+        }
+        cumulative = verse_end;
+    }
+    return entries;
+}
+
+std::string forceKeyFrames(const std::vector<Entry>& entries) {
+    std::ostringstream times;
+    times << std::fixed << std::setprecision(3);
+    double previous = 0.0;
+    for (const auto& entry : entries) {
+        if (entry.startSeconds <= previous + 1e-3) continue;
+        if (times.tellp() > 0) times << ",";
+        times << entry.startSeconds;
+        previous = entry.startSeconds;
+    }
+    return times.str();
+}
+
+std::string indexPath(const std::string& mediaPath) {
+    return mediaPath + ".index.json";
+}
+
+bool locateKeyframes(std::vector<Entry>& entries, const std::string& mediaPath, int fps) {
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, mediaPath.c_str(), nullptr, nullptr) != 0) return false;
+    int stream_index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (stream_index < 0) {
+        avformat_close_input(&format);
+        return false;
+    }
+    auto keyframes = keyframe_table(format->streams[stream_index]);
+    avformat_close_input(&format);
+    if (keyframes.empty()) return false;
+
+    // ffmpeg forces the keyframe on the first frame at or after the requested time.
+    double frame = 1.0 / std::max(1, fps);
+    for (auto& entry : entries) {
+        double target = std::ceil(entry.startSeconds / frame - 1e-6) * frame;
+        auto nearest = std::min_element(keyframes.begin(), keyframes.end(), [&](const auto& a, const auto& b) {
+            return std::abs(a.first - target) < std::abs(b.first - target);
+        });
+        if (std::abs(nearest->first - target) <= 1.5 * frame) {
+            entry.keyframeSeconds = target;
+            entry.byteOffset = nearest->second;
+        }
+    }
+    return true;
+}
+
+void write(const Index& index, const std::string& mediaPath) {
+    json entries = json::array();
+    for (const auto& entry : index.entries) {
+        json item = {
+            {"verseKey", entry.verseKey},
+            {"startSeconds", entry.startSeconds},
+            {"endSeconds", entry.endSeconds},
+            {"keyframeSeconds", entry.keyframeSeconds},
+            {"byteOffset", entry.byteOffset}
+        };
+        if (entry.segment >= 0) item["segment"] = entry.segment;
+        entries.push_back(item);
+    }
+    json out = {{"version", kIndexVersion}, {"surah", index.surah}, {"media", index.media}, {"entries", entries}};
+
+    std::string path = indexPath(mediaPath);
+    std::ofstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Cannot write clip index: " + path);
+    file << out.dump(2) << std::endl;
+}
+
+Index read(const std::string& mediaPath) {
+    std::string path = indexPath(mediaPath);
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("No clip index for " + mediaPath + " (expected " + path + ")");
+    json data = json::parse(file, nullptr, false);
+    if (data.is_discarded() || !data.contains("entries")) throw std::runtime_error("Malformed clip index: " + path);
+
+    Index index;
+    index.surah = data.value("surah", 0);
+    index.media = data.value("media", "");
+    for (const auto& item : data["entries"]) {
+        Entry entry;
+        entry.verseKey = item.value("verseKey", "");
+        entry.segment = item.value("segment", -1);
+        entry.startSeconds = item.value("startSeconds", 0.0);
+        entry.endSeconds = item.value("endSeconds", 0.0);
+        entry.keyframeSeconds = item.value("keyframeSeconds", -1.0);
+        entry.byteOffset = item.value("byteOffset", -1LL);
+        index.entries.push_back(entry);
+    }
+    return index;
+}
+
+std::pair<Entry, Entry> verseRange(const Index& index, int fromVerse, int toVerse) {
+    if (fromVerse > toVerse) throw std::invalid_argument("--from must not be after --to");
+    std::string first_key = verse_key(index.surah, fromVerse);
+    std::string last_key = verse_key(index.surah, toVerse);
+    auto first = std::find_if(index.entries.begin(), index.entries.end(),
+                              [&](const Entry& entry) { return entry.verseKey == first_key; });
+    auto last = std::find_if(index.entries.rbegin(), index.entries.rend(),
+                             [&](const Entry& entry) { return entry.verseKey == last_key; });
+    if (first == index.entries.end() || last == index.entries.rend()) {
+        throw std::invalid_argument("Verses " + first_key + "-" + std::to_string(toVerse) + " are not in this render");
+    }
+    return {*first, *last};
+}
+
+std::string extract(const std::string& mediaPath,
+                    int fromVerse,
+                    int toVerse,
+                    const std::string& destination,
+                    const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor) {
+    Tracing::Span span("extractClip");
+    Index index = read(mediaPath);
+    auto [first, last] = verseRange(index, fromVerse, toVerse);
+    if (first.keyframeSeconds < 0.0) {
+        std::cerr << "Warning: No keyframe recorded at " << first.verseKey
+                  << "; the clip will start at the preceding keyframe." << std::endl;
+    }
+    double start = first.keyframeSeconds >= 0.0 ? first.keyframeSeconds : first.startSeconds;
+
+    std::string clip = destination;
+    if (clip.empty()) {
+        fs::path media(mediaPath);
+        clip = (media.parent_path() / (media.stem().string() + "-" + std::to_string(index.surah) + "_" +
+                                       std::to_string(fromVerse) + "-" + std::to_string(toVerse) +
+                                       media.extension().string())).string();
+    }
+
+    // Input seeking with stream copy starts at the keyframe at or before `start`, which the
+    // render placed exactly on the verse start.
+    Render::Plan plan;
+    Render::Input input;
+    input.path = fs::path(mediaPath).generic_string();
+    input.seekSeconds = start;
+    plan.inputs.push_back(input);
+    Render::Output output;
+    output.path = fs::path(clip).generic_string();
+    output.maps = {"0:v", "0:a?"};
+    output.durationSeconds = std::max(0.0, last.endSeconds - start);
+    output.options = {{"c", "copy"}, {"avoid_negative_ts", "make_zero"}, {"movflags", "+faststart"}};
+    plan.outputs.push_back(output);
+    Render::runPlan(plan, processExecutor);
+    return clip;
+}
+
+} // namespace ClipIndex
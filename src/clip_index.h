@@ -0,0 +1,60 @@
+#pragma once
+#include "types.h"
+#include "interfaces/IProcessExecutor.h"
+#include "verse_segmentation.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Verse-aligned keyframes in renders and the sidecar index used to cut clips from them.
+namespace ClipIndex {
+
+struct Entry {
+    std::string verseKey;
+    int segment = -1;               // part of a segmented long verse, -1 for a whole verse
+    double startSeconds = 0.0;      // output timeline
+    double endSeconds = 0.0;
+    double keyframeSeconds = -1.0;  // the IDR frame that opens the entry, -1 when not located
+    long long byteOffset = -1;      // file offset of that frame's sample, -1 when not located
+};
+
+struct Index {
+    int surah = 0;
+    std::string media;              // file name of the indexed render
+    std::vector<Entry> entries;
+};
+
+// Every verse, or every segment of a segmented verse, on the output timeline. Uses the same
+// arithmetic as SubtitleBuilder::buildAssFile, so entries start exactly when their text appears.
+std::vector<Entry> timeline(const AppConfig& config,
+                            const std::vector<VerseData>& verses,
+                            const VerseSegmentation::Manager* segmentManager);
+
+// -force_key_frames value that puts a keyframe at every entry start.
+std::string forceKeyFrames(const std::vector<Entry>& entries);
+
+// Sidecar next to a render: <output>.index.json.
+std::string indexPath(const std::string& mediaPath);
+
+// Fills keyframeSeconds/byteOffset from the keyframe table of a finished MP4 (no packets are
+// read). Returns false when the file cannot be opened or has no video stream.
+bool locateKeyframes(std::vector<Entry>& entries, const std::string& mediaPath, int fps);
+
+// Throws std::runtime_error when the index cannot be written or read.
+void write(const Index& index, const std::string& mediaPath);
+Index read(const std::string& mediaPath);
+
+// First and last entry covering verses fromVerse..toVerse of the indexed surah.
+// Throws std::invalid_argument when the range is not in the render.
+std::pair<Entry, Entry> verseRange(const Index& index, int fromVerse, int toVerse);
+
+// Cuts verses fromVerse..toVerse out of an indexed render by stream copy (no re-encode).
+// An empty destination writes <stem>-<surah>_<from>-<to>.mp4 next to the render.
+// Returns the clip path; throws on failure.
+std::string extract(const std::string& mediaPath,
+                    int fromVerse,
+                    int toVerse,
+                    const std::string& destination,
+                    const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor);
+
+} // namespace ClipIndex
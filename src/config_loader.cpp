@@ -151,7 +151,7 @@ void applyQualityProfile(AppConfig& cfg,
 }
 }
 
-AppConfig loadConfig(const std::string& path, CLIOptions& options) {
+ConfigFile readConfigFile(const std::string& path, CLIOptions& options) {
     fs::path configPath = path;
     
     // Auto-discovery logic
@@ -178,11 +178,25 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
     options.configPath = configPath.string();
 
     // Resolve assets relative to config file location
-    fs::path configDir = configPath.parent_path();
-    CacheUtils::setDataRoot(configDir);
+    CacheUtils::setDataRoot(configPath.parent_path());
 
     std::ifstream f(configPath);
     if (!f.is_open()) throw std::runtime_error("Could not open config file: " + configPath.string());
+
+    ConfigFile file;
+    file.path = configPath.string();
+    file.data = std::make_shared<const json>(json::parse(f));
+    return file;
+}
+
+AppConfig loadConfig(const std::string& path, CLIOptions& options) {
+    return buildConfig(readConfigFile(path, options), options);
+}
+
+AppConfig buildConfig(const ConfigFile& file, CLIOptions& options) {
+    fs::path configPath = file.path;
+    options.configPath = file.path;
+    fs::path configDir = configPath.parent_path();
     auto resolvePath = [&](std::string p) {
         if (p.empty()) return p;
         fs::path fp = p;
@@ -190,7 +204,7 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
         return (configDir / fp).string();
     };
 
-    json data = json::parse(f);
+    const json& data = *file.data;
     AppConfig cfg;
 
     // Video dimensions
@@ -232,9 +246,10 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
 
     std::string bgVideoSetting = data.value("assetBgVideo", QuranData::defaultBackgroundVideo);
     cfg.assetBgVideo = resolveAssetPath(bgVideoSetting);
+    cfg.useBackgroundPlateCache = data.value("backgroundPlateCache", false);
 
     // Font configuration
-    cfg.arabicFont.family = data["arabicFont"].value("family", "KFGQPC HAFS Uthmanic Script");
+    cfg.arabicFont.family = data.at("arabicFont").value("family", "KFGQPC HAFS Uthmanic Script");
     // Logic for font paths: config might just say "fonts/File.ttf".
     // We resolve it against configDir. 
     // Or if it says "File.ttf", we might expect it in assetFolderPath/fonts/
@@ -256,9 +271,9 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
         return resolvePath(fontFile);
     };
 
-    cfg.arabicFont.file = resolveFont(data["arabicFont"].value("file", ""), QuranData::defaultArabicFont);
-    cfg.arabicFont.size = data["arabicFont"].value("size", 100);
-    cfg.arabicFont.color = data["arabicFont"].value("color", "FFFFFF");
+    cfg.arabicFont.file = resolveFont(data.at("arabicFont").value("file", ""), QuranData::defaultArabicFont);
+    cfg.arabicFont.size = data.at("arabicFont").value("size", 100);
+    cfg.arabicFont.color = data.at("arabicFont").value("color", "FFFFFF");
 
     json translationFontConfig = data.contains("translationFont") ? data["translationFont"] : json::object();
     bool translationFontFamilyOverridden =
@@ -298,6 +313,7 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
     cfg.textGrowthThreshold = data.value("textGrowthThreshold", 100);
     cfg.maxGrowthFactor = data.value("maxGrowthFactor", 1.15);
     cfg.growthRateFactor = data.value("growthRateFactor", 0.05);
+    cfg.layoutCache = data.value("layoutCache", true);
     
     // Fade parameters
     cfg.fadeDurationFactor = data.value("fadeDurationFactor", 0.2);
@@ -330,6 +346,24 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
     cfg.videoMaxRate = data.value("videoMaxRate", "");
     cfg.videoBufSize = data.value("videoBufSize", "");
     auto qualityProfiles = loadQualityProfiles(data);
+    if (data.contains("autoQuality") && data["autoQuality"].is_object()) {
+        const auto& aq = data["autoQuality"];
+        cfg.autoQuality.enabled = aq.value("enabled", false);
+        cfg.autoQuality.metric = toLowerCopy(aq.value("metric", cfg.autoQuality.metric));
+        cfg.autoQuality.minScore = aq.value("minScore", cfg.autoQuality.minScore);
+        if (aq.contains("presets") && aq["presets"].is_array() && !aq["presets"].empty()) {
+            cfg.autoQuality.presets = aq["presets"].get<std::vector<std::string>>();
+        }
+        if (aq.contains("crfs") && aq["crfs"].is_array() && !aq["crfs"].empty()) {
+            cfg.autoQuality.crfs = aq["crfs"].get<std::vector<int>>();
+        }
+        cfg.autoQuality.samples = std::max(1, aq.value("samples", cfg.autoQuality.samples));
+        cfg.autoQuality.sampleSeconds = std::max(0.5, aq.value("sampleSeconds", cfg.autoQuality.sampleSeconds));
+    }
+    if (cfg.autoQuality.metric != "ssim" && cfg.autoQuality.metric != "psnr") {
+        std::cerr << "Warning: Unknown autoQuality metric '" << cfg.autoQuality.metric << "'. Using ssim." << std::endl;
+        cfg.autoQuality.metric = "ssim";
+    }
 
     // Video selection configuration
     if (data.contains("videoSelection") && data["videoSelection"].is_object()) {
@@ -405,10 +439,14 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
     }
     
     cfg.enableTextGrowth = options.enableTextGrowth;
+    if (options.noCache) cfg.layoutCache = false;
+    if (options.plateCache) cfg.useBackgroundPlateCache = true;
 
     if (!options.qualityProfile.empty()) cfg.qualityProfile = options.qualityProfile;
     applyQualityProfile(cfg, options, qualityProfiles);
     if (options.customCRF != -1) cfg.crf = options.customCRF;
+    if (options.autoQuality) cfg.autoQuality.enabled = true;
+    if (options.qualityFloor >= 0.0) cfg.autoQuality.minScore = options.qualityFloor;
     if (!options.pixelFormatOverride.empty()) cfg.pixelFormat = options.pixelFormatOverride;
     if (!options.videoBitrateOverride.empty()) cfg.videoBitrate = options.videoBitrateOverride;
     if (!options.videoMaxRateOverride.empty()) cfg.videoMaxRate = options.videoMaxRateOverride;
@@ -1,7 +1,19 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <nlohmann/json.hpp>
 #include "types.h"
 
+// A parsed config.json, shareable across jobs so batch renders only read and parse it once.
+struct ConfigFile {
+    std::string path;  // resolved absolute path
+    std::shared_ptr<const nlohmann::json> data;
+};
+
+// Resolves (with auto-discovery) and parses the config file, and sets the data root.
+ConfigFile readConfigFile(const std::string& path, CLIOptions& options);
+// Builds the effective config for one job from a parsed file plus CLI overrides.
+AppConfig buildConfig(const ConfigFile& file, CLIOptions& options);
 AppConfig loadConfig(const std::string& path, CLIOptions& options);
 void validateAssets(const AppConfig& config);
@@ -0,0 +1,204 @@
+#include "encoder_tuning.h"
+#include "cache_utils.h"
+#include "render/plan_runner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+std::atomic<int> active_jobs{0};
+std::mutex benchmark_mutex;
+
+// x264 frame threads stop paying off once each thread has too few macroblock rows to
+// work ahead on; ~64 rows of pixels per thread is where returns flatten out.
+int frame_thread_limit(int height) {
+    return std::clamp(height / 64, 2, 16);
+}
+
+json read_benchmarks() {
+    std::ifstream file(EncoderTuning::benchmarkPath());
+    if (!file.is_open()) return json::object();
+    try {
+        json data = json::parse(file);
+        return data.is_object() ? data : json::object();
+    } catch (const json::exception&) {
+        return json::object();
+    }
+}
+
+} // namespace
+
+namespace EncoderTuning {
+
+ActiveJob::ActiveJob() { ++active_jobs; }
+ActiveJob::~ActiveJob() { --active_jobs; }
+
+int activeJobs() {
+    return std::max(1, active_jobs.load());
+}
+
+Settings choose(unsigned int cores, int concurrentJobs, int parallelEncodes, int height, int benchmarkThreads) {
+    Settings settings;
+    settings.cores = std::max(1u, cores);
+    settings.concurrentJobs = std::max(1, concurrentJobs);
+    settings.parallelEncodes = std::max(1, parallelEncodes);
+
+    int budget = std::max(1, static_cast<int>(settings.cores) / (settings.concurrentJobs * settings.parallelEncodes));
+    int limit = frame_thread_limit(height);
+    if (benchmarkThreads > 0) {
+        limit = std::min(limit, benchmarkThreads);
+        settings.source = "benchmark";
+    }
+    settings.encoderThreads = std::min(budget, limit);
+    // Same ratio x264 uses by default, made explicit so the metadata records it.
+    settings.lookaheadThreads = std::max(1, settings.encoderThreads / 6);
+    // Scaling and overlay slice-thread well; the ASS renderer does not, so a few threads suffice.
+    settings.filterThreads = std::clamp(budget / 4, 1, 4);
+    return settings;
+}
+
+Settings forJob(const CLIOptions& options, const AppConfig& config, int parallelEncodes) {
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (options.encoderThreads > 0) {
+        Settings settings = choose(cores, activeJobs(), parallelEncodes, config.height);
+        settings.encoderThreads = options.encoderThreads;
+        settings.lookaheadThreads = std::max(1, options.encoderThreads / 6);
+        settings.source = "override";
+        return settings;
+    }
+    int benchmarked = lookupBenchmark(benchmarkKey(config.width, config.height, options.preset));
+    return choose(cores, activeJobs(), parallelEncodes, config.height, benchmarked);
+}
+
+void apply(const Settings& settings, Render::OptionList& codecOptions) {
+    codecOptions.emplace_back("threads", std::to_string(settings.encoderThreads));
+    if (Render::findOption(codecOptions, "c:v") == "libx264") {
+        codecOptions.emplace_back("x264-params", "lookahead-threads=" + std::to_string(settings.lookaheadThreads));
+    }
+}
+
+json toJson(const Settings& settings) {
+    return {
+        {"encoderThreads", settings.encoderThreads},
+        {"lookaheadThreads", settings.lookaheadThreads},
+        {"filterThreads", settings.filterThreads},
+        {"cores", settings.cores},
+        {"concurrentJobs", settings.concurrentJobs},
+        {"parallelEncodes", settings.parallelEncodes},
+        {"source", settings.source}
+    };
+}
+
+std::string benchmarkKey(int width, int height, const std::string& preset) {
+    return std::to_string(width) + "x" + std::to_string(height) + "/" + preset;
+}
+
+fs::path benchmarkPath() {
+    return CacheUtils::getCacheRoot() / "encoder-tuning.json";
+}
+
+int lookupBenchmark(const std::string& key) {
+    std::lock_guard<std::mutex> lock(benchmark_mutex);
+    json data = read_benchmarks();
+    if (!data.contains(key) || !data[key].contains("threads")) return 0;
+    try {
+        return data[key]["threads"].get<int>();
+    } catch (const json::exception&) {
+        return 0;
+    }
+}
+
+void saveBenchmark(const std::string& key, int bestThreads, const std::map<int, double>& secondsByThreads) {
+    std::lock_guard<std::mutex> lock(benchmark_mutex);
+    json data = read_benchmarks();
+    json timings = json::object();
+    for (const auto& [threads, seconds] : secondsByThreads) timings[std::to_string(threads)] = seconds;
+    data[key] = {
+        {"threads", bestThreads},
+        {"cores", std::max(1u, std::thread::hardware_concurrency())},
+        {"secondsByThreads", timings}
+    };
+
+    fs::path path = benchmarkPath();
+    fs::create_directories(path.parent_path());
+    // Concurrent --tune-encoder processes each write their own partial before the rename.
+    fs::path partial = CacheUtils::uniquePartialPath(path);
+    {
+        std::ofstream file(partial);
+        if (!file.is_open()) throw std::runtime_error("Failed to write encoder tuning file: " + path.string());
+        file << data.dump(2) << '\n';
+    }
+    fs::rename(partial, path);
+}
+
+int runBenchmark(const CLIOptions& options,
+                 const AppConfig& config,
+                 const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                 const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    constexpr double kSampleSeconds = 5.0;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> candidates;
+    for (unsigned int threads = 1; threads < cores; threads *= 2) candidates.push_back(static_cast<int>(threads));
+    candidates.push_back(static_cast<int>(cores));
+
+    // Encode the real background when available so motion (and therefore encoder load) is representative.
+    Render::Input input;
+    std::string scale = "scale=" + std::to_string(config.width) + ":" + std::to_string(config.height);
+    if (fs::exists(config.assetBgVideo)) {
+        input.path = config.assetBgVideo;
+        input.streamLoop = -1;
+    } else {
+        input.path = "testsrc2=size=" + std::to_string(config.width) + "x" + std::to_string(config.height) +
+                     ":rate=" + std::to_string(config.fps);
+        input.format = "lavfi";
+    }
+
+    std::string key = benchmarkKey(config.width, config.height, options.preset);
+    std::cout << "Benchmarking encoder threads for " << key << " (" << kSampleSeconds << "s sample)" << std::endl;
+
+    std::map<int, double> secondsByThreads;
+    for (int threads : candidates) {
+        Render::Plan plan;
+        plan.inputs.push_back(input);
+        plan.filterComplex = "[0:v]" + scale + ",fps=" + std::to_string(config.fps) + ",format=" + config.pixelFormat + "[v]";
+        Render::Output output;
+        output.path = "-";
+        output.maps = {"[v]"};
+        output.durationSeconds = kSampleSeconds;
+        output.options = {{"c:v", "libx264"}, {"preset", options.preset}, {"crf", std::to_string(config.crf)},
+                          {"threads", std::to_string(threads)}, {"f", "null"}};
+        plan.outputs.push_back(output);
+
+        auto start = std::chrono::steady_clock::now();
+        Render::runPlan(plan, processExecutor, renderEngine);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        secondsByThreads[threads] = seconds;
+        std::cout << "  " << threads << " thread(s): " << seconds << "s" << std::endl;
+    }
+
+    // Prefer fewer threads unless more are clearly faster, leaving cores for concurrent jobs.
+    double fastest = std::min_element(secondsByThreads.begin(), secondsByThreads.end(),
+        [](const auto& a, const auto& b) { return a.second < b.second; })->second;
+    int best = candidates.back();
+    for (const auto& [threads, seconds] : secondsByThreads) {
+        if (seconds <= fastest * 1.05) {
+            best = threads;
+            break;
+        }
+    }
+
+    saveBenchmark(key, best, secondsByThreads);
+    std::cout << "Best setting for " << key << ": " << best << " encoder threads (saved to "
+              << benchmarkPath().string() << ")" << std::endl;
+    return best;
+}
+
+} // namespace EncoderTuning
@@ -0,0 +1,63 @@
+#pragma once
+#include "types.h"
+#include "render/render_plan.h"
+#include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <nlohmann/json.hpp>
+
+// Picks encoder and filter thread counts from the machine size and the renders running
+// alongside this one, instead of a fixed -threads value.
+namespace EncoderTuning {
+
+struct Settings {
+    int encoderThreads = 1;     // -threads for the video encoder
+    int lookaheadThreads = 1;   // x264 lookahead-threads
+    int filterThreads = 1;      // -filter_complex_threads
+    unsigned int cores = 1;
+    int concurrentJobs = 1;     // renders sharing the machine, including this one
+    int parallelEncodes = 1;    // encodes this job runs at once (chunks)
+    std::string source = "auto";  // "auto", "benchmark" or "override"
+};
+
+// Registers a running render for the lifetime of the object.
+class ActiveJob {
+public:
+    ActiveJob();
+    ~ActiveJob();
+    ActiveJob(const ActiveJob&) = delete;
+    ActiveJob& operator=(const ActiveJob&) = delete;
+};
+
+int activeJobs();
+
+// Splits `cores` between concurrent jobs and the encodes within this job. `height` bounds
+// useful x264 frame threads; `benchmarkThreads` (0 = none) caps them with a measured optimum.
+Settings choose(unsigned int cores, int concurrentJobs, int parallelEncodes, int height, int benchmarkThreads = 0);
+
+// Settings for the current job: --encoder-threads override, else choose() with the
+// benchmarked optimum for this resolution/preset when one has been saved.
+Settings forJob(const CLIOptions& options, const AppConfig& config, int parallelEncodes);
+
+// Appends -threads and, for libx264, lookahead-threads to the video codec options.
+void apply(const Settings& settings, Render::OptionList& codecOptions);
+
+nlohmann::json toJson(const Settings& settings);
+
+// Benchmark results live in <cache>/encoder-tuning.json, keyed by "<width>x<height>/<preset>".
+std::string benchmarkKey(int width, int height, const std::string& preset);
+std::filesystem::path benchmarkPath();
+int lookupBenchmark(const std::string& key);  // 0 when not benchmarked
+void saveBenchmark(const std::string& key, int bestThreads, const std::map<int, double>& secondsByThreads);
+
+// Encodes a short sample at the configured resolution/preset with increasing thread counts
+// and saves the fastest. Returns the chosen thread count.
+int runBenchmark(const CLIOptions& options,
+                 const AppConfig& config,
+                 const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                 const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine = nullptr);
+
+} // namespace EncoderTuning
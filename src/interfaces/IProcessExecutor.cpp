@@ -0,0 +1,46 @@
+#include "interfaces/IProcessExecutor.h"
+
+#include <sstream>
+
+namespace {
+
+bool needs_quoting(const std::string& arg) {
+    if (arg.empty()) return true;
+    for (char ch : arg) {
+        const bool safe = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                          (ch >= '0' && ch <= '9') || ch == '-' || ch == '_' ||
+                          ch == '.' || ch == ':' || ch == '+' || ch == '/' ||
+                          ch == '=' || ch == ',' || ch == '@';
+        if (!safe) return true;
+    }
+    return false;
+}
+
+// Quote an argument for the platform shell (SystemProcessExecutor, logs, test doubles).
+std::string quote_arg(const std::string& arg) {
+    if (!needs_quoting(arg)) return arg;
+    std::string quoted = "\"";
+    for (char ch : arg) {
+#ifdef _WIN32
+        if (ch == '"') quoted.push_back('\\');
+#else
+        if (ch == '"' || ch == '$' || ch == '`' || ch == '\\') quoted.push_back('\\');
+#endif
+        quoted.push_back(ch);
+    }
+    quoted.push_back('"');
+    return quoted;
+}
+
+} // namespace
+
+std::string Interfaces::IProcessExecutor::joinCommand(const std::vector<std::string>& argv) {
+    std::ostringstream cmd;
+    bool first = true;
+    for (const auto& arg : argv) {
+        if (!first) cmd << ' ';
+        first = false;
+        cmd << quote_arg(arg);
+    }
+    return cmd.str();
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 namespace Interfaces {
     class IProcessExecutor {
@@ -7,5 +8,17 @@ namespace Interfaces {
         virtual ~IProcessExecutor() = default;
         virtual int execute(const std::string& command) = 0;
         virtual void executeWithProgress(const std::string& command, double totalDurationSeconds) = 0;
+
+        // Run argv[0] with exactly these arguments. Executors without a shell-free launcher
+        // (and test doubles) get the same invocation as a quoted command line.
+        virtual int executeArgs(const std::vector<std::string>& argv) {
+            return execute(joinCommand(argv));
+        }
+        virtual void executeArgsWithProgress(const std::vector<std::string>& argv, double totalDurationSeconds) {
+            executeWithProgress(joinCommand(argv), totalDurationSeconds);
+        }
+
+        // argv as a command line for the platform shell (also used for logging).
+        static std::string joinCommand(const std::vector<std::string>& argv);
     };
 }
@@ -0,0 +1,12 @@
+#pragma once
+#include "render/render_plan.h"
+
+namespace Interfaces {
+    class IRenderEngine {
+    public:
+        virtual ~IRenderEngine() = default;
+        // Executes the plan; throws Render::UnsupportedPlanError when the plan needs
+        // features the engine does not implement so callers can use the ffmpeg CLI instead.
+        virtual void render(const Render::Plan& plan) = 0;
+    };
+}
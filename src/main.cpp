@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <filesystem>
 #include <vector>
+#include <sstream>
 #include "cxxopts.hpp"
 #include "video_standardizer.h"
 #include "types.h"
@@ -10,10 +11,17 @@
 #include "quran_data.h"
 #include "config_loader.h"
 #include "SystemProcessExecutor.h"
+#include "LibavRenderEngine.h"
 #include <memory>
 #include "metadata_writer.h"
 #include "cache_utils.h"
 #include "verse_segmentation.h"
+#include "render_job.h"
+#include "batch_runner.h"
+#include "render_server.h"
+#include "encoder_tuning.h"
+#include "clip_index.h"
+#include "text/layout_cache.h"
 
 namespace fs = std::filesystem;
 
@@ -37,13 +45,31 @@ int main(int argc, char* argv[]) {
         ("translation-font-size", "Override translation font size", cxxopts::value<int>())
         ("text-padding", "Horizontal padding fraction (0-0.45) for subtitles", cxxopts::value<double>())
         ("e,encoder", "Choose encoder: 'software' (default) or 'hardware'", cxxopts::value<std::string>()->default_value("software"))
+        ("render-engine", "Render backend: 'ffmpeg' (CLI, default) or 'libav' (in-process, falls back to CLI)", cxxopts::value<std::string>()->default_value("ffmpeg"))
+        ("chunks", "Encode the video as N chunks in parallel (0 = auto from CPU cores, 1 = single pass)", cxxopts::value<int>()->default_value("1"))
+        ("encoder-threads", "Encoder threads per encode (0 = auto from CPU cores and concurrent renders)", cxxopts::value<int>()->default_value("0"))
+        ("ffmpeg-stall-timeout", "Kill an encode whose ffmpeg progress has not advanced for this many seconds (0 = never)", cxxopts::value<double>()->default_value("120"))
+        ("ffmpeg-usage", "Print each ffmpeg run's wall time, CPU time and peak RSS to stderr", cxxopts::value<bool>()->default_value("false"))
+        ("tune-encoder", "Benchmark encoder thread counts for the configured resolution/preset and save the best", cxxopts::value<bool>()->default_value("false"))
+        ("prewarm-layout", "Lay out every verse for these translation IDs (comma-separated; default: the configured one) at the configured resolution and each --rendition, into the layout cache", cxxopts::value<std::string>()->implicit_value(""))
         ("p,preset", "Software encoder preset for speed/quality (ultrafast, fast, medium)", cxxopts::value<std::string>()->default_value("fast"))
         ("quality-profile", "Quality profile: speed | balanced | max", cxxopts::value<std::string>())
         ("crf", "Constant Rate Factor (0-51). Lower improves quality.", cxxopts::value<int>())
+        ("auto-quality", "Pick the fastest preset/CRF whose sample encodes reach the autoQuality floor (cached per background/resolution)", cxxopts::value<bool>()->default_value("false"))
+        ("quality-floor", "Minimum SSIM (0-1) or PSNR (dB) for --auto-quality", cxxopts::value<double>())
         ("pix-fmt", "Pixel format (e.g. yuv420p, yuv420p10le)", cxxopts::value<std::string>())
         ("video-bitrate", "Target video bitrate (e.g. 6000k)", cxxopts::value<std::string>())
         ("maxrate", "Maximum encoder bitrate (e.g. 8000k)", cxxopts::value<std::string>())
         ("bufsize", "Encoder buffer size (e.g. 12000k)", cxxopts::value<std::string>())
+        ("plate-cache", "Cache backgrounds pre-scaled with the overlay baked in and reuse them across renders", cxxopts::value<bool>()->default_value("false"))
+        ("static-bg", "Treat the background as a still image (its first frame) and use the still-image fast path", cxxopts::value<bool>()->default_value("false"))
+        ("incremental", "Keep per-segment encodes next to the output and re-encode only segments whose inputs changed", cxxopts::value<bool>()->default_value("false"))
+        ("stream-format", "Write segmented 'hls' or 'dash' output (verse-aligned segments, renditions as a bitrate ladder) instead of an MP4", cxxopts::value<std::string>())
+        ("draft", "Fast preview: reduced resolution, 10 fps, ultrafast, static background, plus a contact sheet with one frame per verse", cxxopts::value<bool>()->default_value("false"))
+        ("tmpfs-workspace", "Keep intermediate files of each render in /dev/shm (tmpfs) instead of the temp directory", cxxopts::value<bool>()->default_value("false"))
+        ("trace", "Write a Chrome trace_event JSON of the render stages to this path (open in chrome://tracing or Perfetto)", cxxopts::value<std::string>())
+        ("rendition", "Also encode a rendition from the same decode pass: name:WIDTHxHEIGHT[:quality-profile] (repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("vfr", "With a still background, emit variable frame rate output that only encodes frames that change", cxxopts::value<bool>()->default_value("false"))
         ("no-cache", "Disable caching", cxxopts::value<bool>()->default_value("false"))
         ("clear-cache", "Clear all cached data", cxxopts::value<bool>()->default_value("false"))
         ("no-growth", "Disable text growth animations", cxxopts::value<bool>()->default_value("false"))
@@ -59,20 +85,32 @@ int main(int argc, char* argv[]) {
         ("r2-access-key", "R2 access key (for private buckets)", cxxopts::value<std::string>())
         ("r2-secret-key", "R2 secret key (for private buckets)", cxxopts::value<std::string>())
         ("r2-bucket", "R2 bucket name", cxxopts::value<std::string>()->default_value("quran-background-videos"))
+        ("extract", "Cut verses --from..--to out of an existing render by stream copy, using its .index.json", cxxopts::value<std::string>())
         ("standardize-local", "Standardize all videos in a local directory", cxxopts::value<std::string>())
         ("standardize-r2", "Standardize videos in R2 bucket (requires credentials)", cxxopts::value<std::string>())
         ("segment-long-verses", "Enable segmentation of long verses into timed parts", cxxopts::value<bool>()->default_value("false"))
         ("segment-data", "Path to reciter-specific segment timing JSON file", cxxopts::value<std::string>())
         ("long-verses", "Path to list of long verses (default: metadata/long-verses.json)", cxxopts::value<std::string>()->default_value("metadata/long-verses.json"))
+        ("batch", "Render every job in a JSONL file (one JSON object per line, CLIOptions field names)", cxxopts::value<std::string>())
+        ("batch-workers", "Number of batch jobs rendered concurrently", cxxopts::value<int>()->default_value("1"))
+        ("batch-results", "Where to write per-job result lines (default: <batch>.results.jsonl)", cxxopts::value<std::string>())
+        ("serve", "Run as a render daemon accepting JSON jobs on this Unix socket path", cxxopts::value<std::string>())
+        ("serve-slots", "Number of jobs the daemon renders concurrently", cxxopts::value<int>()->default_value("1"))
+        ("serve-max-queue", "Queued jobs the daemon accepts before rejecting new ones", cxxopts::value<int>()->default_value("64"))
         ("h,help", "Print usage");
     
     cli_parser.parse_positional({"surah", "from", "to"});
     auto result = cli_parser.parse(argc, argv);
 
+    // Every ffmpeg run in this process, render or maintenance, honours the same watchdog and
+    // usage settings.
+    auto processExecutor = makeProcessExecutor(result["ffmpeg-stall-timeout"].as<double>(),
+                                               result["ffmpeg-usage"].as<bool>());
+
     // Handle standardization
     if (result.count("standardize-local")) {
         try {
-            VideoStandardizer::standardizeDirectory(result["standardize-local"].as<std::string>(), false);
+            VideoStandardizer::standardizeDirectory(result["standardize-local"].as<std::string>(), processExecutor, false);
         } catch (const std::exception& e) {
             std::cerr << "Standardization failed: " << e.what() << std::endl;
             return 1;
@@ -82,7 +120,7 @@ int main(int argc, char* argv[]) {
 
     if (result.count("standardize-r2")) {
         try {
-            VideoStandardizer::standardizeDirectory(result["standardize-r2"].as<std::string>(), true);
+            VideoStandardizer::standardizeDirectory(result["standardize-r2"].as<std::string>(), processExecutor, true);
         } catch (const std::exception& e) {
             std::cerr << "Standardization failed: " << e.what() << std::endl;
             return 1;
@@ -109,7 +147,30 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (result.count("help") || !result.count("surah") || !result.count("from") || !result.count("to")) {
+    if (result.count("extract")) {
+        if (!result.count("from") || !result.count("to")) {
+            std::cerr << "Error: --extract needs --from and --to verse numbers." << std::endl;
+            return 1;
+        }
+        try {
+            std::string clip = ClipIndex::extract(result["extract"].as<std::string>(),
+                                                  result["from"].as<int>(),
+                                                  result["to"].as<int>(),
+                                                  result.count("output") ? result["output"].as<std::string>() : "",
+                                                  processExecutor);
+            std::cout << "✅ Clip saved to: " << clip << std::endl;
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    bool batchMode = result.count("batch") > 0;
+    bool serveMode = result.count("serve") > 0;
+    bool tuneMode = result["tune-encoder"].as<bool>();
+    bool prewarmMode = result.count("prewarm-layout") > 0;
+    if (result.count("help") || (!batchMode && !serveMode && !tuneMode && !prewarmMode && (!result.count("surah") || !result.count("from") || !result.count("to")))) {
         std::cout << cli_parser.help() << std::endl;
         std::cout << "\nRecitation Modes:\n"
                   << "  gapped  - Ayah-by-ayah with pauses between verses (default)\n"
@@ -123,12 +184,10 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    const std::string gaplessDisabledError = "Error: Gapless mode is temporarily disabled because it's too buggy and the gapless data needs to be cleaned first.";
-
     CLIOptions options;
-    options.surah = result["surah"].as<int>();
-    options.from = result["from"].as<int>();
-    options.to = result["to"].as<int>();
+    if (result.count("surah")) options.surah = result["surah"].as<int>();
+    if (result.count("from")) options.from = result["from"].as<int>();
+    if (result.count("to")) options.to = result["to"].as<int>();
     options.configPath = result["config"].as<std::string>();
     options.configPathProvided = result.count("config") > 0;
     if (result.count("reciter")) options.reciterId = result["reciter"].as<int>();
@@ -140,15 +199,28 @@ int main(int argc, char* argv[]) {
     if (result.count("arabic-font-size")) options.arabicFontSize = result["arabic-font-size"].as<int>();
     if (result.count("translation-font-size")) options.translationFontSize = result["translation-font-size"].as<int>();
     options.noCache = result["no-cache"].as<bool>();
+    options.plateCache = result["plate-cache"].as<bool>();
+    options.staticBackground = result["static-bg"].as<bool>();
+    options.variableFrameRate = result["vfr"].as<bool>();
+    options.incremental = result["incremental"].as<bool>();
+    options.tmpfsWorkspace = result["tmpfs-workspace"].as<bool>();
+    options.draft = result["draft"].as<bool>();
+    if (result.count("trace")) options.tracePath = result["trace"].as<std::string>();
+    if (result.count("stream-format")) options.streamFormat = result["stream-format"].as<std::string>();
     options.clearCache = result["clear-cache"].as<bool>();
     options.preset = result["preset"].as<std::string>();
     options.presetProvided = result.count("preset");
     options.encoder = result["encoder"].as<std::string>();
+    options.renderEngine = result["render-engine"].as<std::string>();
+    options.renderChunks = result["chunks"].as<int>();
+    options.encoderThreads = result["encoder-threads"].as<int>();
     options.enableTextGrowth = !result["no-growth"].as<bool>();
     options.emitProgress = result["progress"].as<bool>();
     if (result.count("text-padding")) options.textPaddingOverride = result["text-padding"].as<double>();
     if (result.count("quality-profile")) options.qualityProfile = result["quality-profile"].as<std::string>();
     if (result.count("crf")) options.customCRF = result["crf"].as<int>();
+    options.autoQuality = result["auto-quality"].as<bool>();
+    if (result.count("quality-floor")) options.qualityFloor = result["quality-floor"].as<double>();
     if (result.count("pix-fmt")) options.pixelFormatOverride = result["pix-fmt"].as<std::string>();
     if (result.count("video-bitrate")) options.videoBitrateOverride = result["video-bitrate"].as<std::string>();
     if (result.count("maxrate")) options.videoMaxRateOverride = result["maxrate"].as<std::string>();
@@ -178,47 +250,43 @@ int main(int argc, char* argv[]) {
     }
     options.longVersesPath = result["long-verses"].as<std::string>();
 
-    // Validate segmentation options
-    if (options.segmentLongVerses && options.segmentDataPath.empty()) {
-        std::cerr << "Error: --segment-long-verses requires --segment-data to specify the segment timing file." << std::endl;
-        return 1;
-    }
-
     // Custom recitation options
     if (result.count("custom-audio")) options.customAudioPath = result["custom-audio"].as<std::string>();
     if (result.count("custom-timing")) options.customTimingFile = result["custom-timing"].as<std::string>();
-    
-    // Validate custom recitation usage
-    if (!options.customAudioPath.empty() || !options.customTimingFile.empty()) {
-        if (options.customAudioPath.empty() || options.customTimingFile.empty()) {
-            std::cerr << "Error: Both --custom-audio and --custom-timing must be specified together." << std::endl;
+    if (result.count("bg-theme")) options.backgroundTheme = result["bg-theme"].as<std::string>();
+    if (result.count("output")) options.output = result["output"].as<std::string>();
+    if (result.count("rendition")) {
+        try {
+            for (const auto& spec : result["rendition"].as<std::vector<std::string>>()) {
+                options.renditions.push_back(RenderJob::parseRendition(spec));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
             return 1;
         }
-        // Custom recitations only work in gapless mode
-        if (options.recitationMode.empty()) {
-            options.recitationMode = "gapless";
-        } else if (options.recitationMode != "gapless") {
-            std::cerr << "Error: Custom recitations only work in gapless mode." << std::endl;
+    }
+
+    std::vector<int> prewarmTranslations;
+    if (prewarmMode) {
+        std::stringstream ids(result["prewarm-layout"].as<std::string>());
+        std::string id;
+        try {
+            while (std::getline(ids, id, ',')) {
+                if (!id.empty()) prewarmTranslations.push_back(std::stoi(id));
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: --prewarm-layout expects comma-separated translation IDs, got '" << id << "'." << std::endl;
             return 1;
         }
+        if (prewarmTranslations.empty()) prewarmTranslations.push_back(options.translationId);
     }
 
-    // We want to allow gapless mode for custom audio
-    if (options.recitationMode == "gapless" && options.customAudioPath.empty()) {
-        std::cerr << gaplessDisabledError << std::endl;
-        return 1;
-    }
-    
-    if (result.count("output")) {
-        options.output = result["output"].as<std::string>();
-    } else {
-        fs::path default_output_dir = "out";
-        if (!fs::exists(default_output_dir)) {
-            if (!fs::create_directories(default_output_dir)) {
-                throw std::runtime_error("Failed to create directory: " + default_output_dir.string());
-            }
+    if (!batchMode && !serveMode && !tuneMode && !prewarmMode) {
+        std::string validationError = RenderJob::normalizeOptions(options);
+        if (!validationError.empty()) {
+            std::cerr << "Error: " << validationError << std::endl;
+            return 1;
         }
-        options.output = "out/surah-" + std::to_string(options.surah) + "_" + std::to_string(options.from) + "-" + std::to_string(options.to) + ".mp4";
     }
     
     try {
@@ -228,52 +296,69 @@ int main(int argc, char* argv[]) {
             fs::remove_all(cacheDir);
         }
         
-        AppConfig config = loadConfig(options.configPath, options);
+        ConfigFile configFile = readConfigFile(options.configPath, options);
 
-        // We want to allow gapless mode for custom audio
-        if (config.recitationMode == RecitationMode::GAPLESS && options.customAudioPath.empty()) {
-            std::cerr << gaplessDisabledError << std::endl;
-            return 1;
-        }
-        
-        // Override background theme if specified
-        if (result.count("bg-theme")) {
-            std::string theme = result["bg-theme"].as<std::string>();
-            auto it = QuranData::backgroundThemes.find(theme);
-            if (it != QuranData::backgroundThemes.end()) {
-                fs::path themePath = it->second;
-                if (!themePath.is_absolute()) {
-                    themePath = fs::path(config.assetFolderPath) / themePath;
+        if (prewarmMode) {
+            for (int translationId : prewarmTranslations) {
+                CLIOptions translationOptions = options;
+                translationOptions.translationId = translationId;
+                AppConfig config = buildConfig(configFile, translationOptions);
+                std::vector<AppConfig> targets = {config};
+                for (const auto& rendition : options.renditions) {
+                    CLIOptions renditionOptions = translationOptions;
+                    targets.push_back(RenderJob::renditionConfig(renditionOptions, rendition, config, configFile));
+                }
+                for (const auto& target : targets) {
+                    std::cout << "Prewarming layout for translation " << target.translationId << " at "
+                              << target.width << "x" << target.height << "..." << std::endl;
+                    TextLayout::prewarmLayoutCache(target);
                 }
-                config.assetBgVideo = themePath.string();
-            } else {
-                std::cerr << "Warning: Unknown theme '" << theme << "', using default." << std::endl;
             }
+            std::cout << "✅ Layout cache ready in " << TextLayout::LayoutCache::directory().string() << std::endl;
+            return 0;
         }
-        
-        validateAssets(config);
 
-        std::string modeStr = (config.recitationMode == RecitationMode::GAPLESS) ? "gapless" : "gapped";
-        std::cout << "Rendering Surah " << options.surah << ", verses " << options.from << "-" << options.to << std::endl;
-        std::cout << "Mode: " << modeStr << std::endl;
-        std::cout << "Config: " << config.width << "x" << config.height << " @ " << config.fps << "fps, reciter=" << config.reciterId << ", translation=" << config.translationId << std::endl;
-        std::cout << "Text growth: " << (config.enableTextGrowth ? "enabled" : "disabled") << std::endl;
+        RenderJob::Services services;
+        services.processExecutor = processExecutor;
+        services.apiClient = std::make_shared<LiveApiClient>(processExecutor);
+        if (options.renderEngine == "libav") services.renderEngine = std::make_shared<LibavRenderEngine>();
 
-    auto processExecutor = std::make_shared<SystemProcessExecutor>();
-    auto apiClient = std::make_shared<LiveApiClient>();
-    auto verses = apiClient->fetchQuranData(options, config);
+        if (tuneMode) {
+            AppConfig config = buildConfig(configFile, options);
+            EncoderTuning::runBenchmark(options, config, services.processExecutor, services.renderEngine);
+            return 0;
+        }
 
-    // Create segmentation manager if enabled
-    auto segmentManager = VerseSegmentation::createManager(
-        options.segmentLongVerses,
-        options.longVersesPath,
-        options.segmentDataPath
-    );
+        if (serveMode) {
+            RenderServer::Options serverOptions;
+            serverOptions.socketPath = result["serve"].as<std::string>();
+            serverOptions.slots = result["serve-slots"].as<int>();
+            serverOptions.maxQueue = result["serve-max-queue"].as<int>();
+            if (serverOptions.slots < 1 || serverOptions.maxQueue < 1) {
+                std::cerr << "Error: --serve-slots and --serve-max-queue must be at least 1." << std::endl;
+                return 1;
+            }
+            return RenderServer::serve(serverOptions, options, configFile, invocationArgs, services);
+        }
 
-    MetadataWriter::writeMetadata(options, config, invocationArgs);
-    VideoGenerator::generateVideo(options, config, verses, processExecutor, segmentManager.get());
-    VideoGenerator::generateThumbnail(options, config, processExecutor);
+        if (batchMode) {
+            if (result["batch-workers"].as<int>() < 1) {
+                std::cerr << "Error: --batch-workers must be at least 1." << std::endl;
+                return 1;
+            }
+            BatchRunner::Options batchOptions;
+            batchOptions.jobsPath = result["batch"].as<std::string>();
+            batchOptions.workers = result["batch-workers"].as<int>();
+            if (result.count("batch-results")) batchOptions.resultsPath = result["batch-results"].as<std::string>();
+            int failures = BatchRunner::run(batchOptions, options, configFile, invocationArgs, services);
+            return failures == 0 ? 0 : 1;
+        }
 
+        RenderJob::Result jobResult = RenderJob::run(options, configFile, invocationArgs, services);
+        if (!jobResult.success) {
+            std::cerr << "Fatal Error: " << jobResult.error << std::endl;
+            return 1;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Fatal Error: " << e.what() << std::endl;
         return 1;
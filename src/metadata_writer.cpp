@@ -208,6 +208,12 @@ json buildConfigArtifact(const std::string& configPath) {
     return artifact;
 }
 
+fs::path metadataPathFor(const CLIOptions& options) {
+    fs::path metadataPath = options.output.empty() ? fs::path("out/render.mp4") : fs::path(options.output);
+    metadataPath.replace_extension(".metadata.json");
+    return metadataPath;
+}
+
 json buildArtifactsBlock(const CLIOptions& options) {
     json artifacts;
     artifacts["config"] = buildConfigArtifact(options.configPath);
@@ -221,9 +227,7 @@ namespace MetadataWriter {
 void writeMetadata(const CLIOptions& options,
                    const AppConfig& config,
                    const std::vector<std::string>& rawArgs) {
-    fs::path outputPath = options.output.empty() ? fs::path("out/render.mp4") : fs::path(options.output);
-    fs::path metadataPath = outputPath;
-    metadataPath.replace_extension(".metadata.json");
+    fs::path metadataPath = metadataPathFor(options);
 
     fs::path parentDir = metadataPath.parent_path();
     if (!parentDir.empty() && !fs::exists(parentDir)) {
@@ -243,6 +247,28 @@ void writeMetadata(const CLIOptions& options,
     file << metadata.dump(2) << '\n';
 }
 
+void mergeIntoMetadata(const CLIOptions& options, const std::string& key, const json& value) {
+    fs::path metadataPath = metadataPathFor(options);
+    json metadata;
+    {
+        std::ifstream in(metadataPath);
+        if (!in.is_open()) return;
+        try {
+            metadata = json::parse(in);
+        } catch (const json::parse_error& e) {
+            std::cerr << "Warning: Could not update metadata file " << metadataPath.string() << ": " << e.what() << std::endl;
+            return;
+        }
+    }
+    metadata[key] = value;
+
+    std::ofstream file(metadataPath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to write metadata file: " + metadataPath.string());
+    }
+    file << metadata.dump(2) << '\n';
+}
+
 void generateBackendMetadata(const std::string& outputPath) {
     if (outputPath.empty()) {
         throw std::invalid_argument("Output path is required to generate backend metadata");
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <nlohmann/json.hpp>
 
 #include "types.h"
 
@@ -11,6 +12,10 @@ void writeMetadata(const CLIOptions& options,
                    const AppConfig& config,
                    const std::vector<std::string>& rawArgs);
 
+// Sets `key` in the sidecar written by writeMetadata, for facts only known once rendering
+// starts. Does nothing when the sidecar does not exist.
+void mergeIntoMetadata(const CLIOptions& options, const std::string& key, const nlohmann::json& value);
+
 void generateBackendMetadata(const std::string& outputPath);
 
 } // namespace MetadataWriter
@@ -0,0 +1,143 @@
+#include "progress.h"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+thread_local Progress::Sink current_sink;
+
+std::string escape_json(const std::string& input) {
+    std::string escaped;
+    escaped.reserve(input.size());
+    for (char ch : input) {
+        if (ch == '"' || ch == '\\') escaped.push_back('\\');
+        if (ch == '\n') {
+            escaped += "\\n";
+            continue;
+        }
+        escaped.push_back(ch);
+    }
+    return escaped;
+}
+
+std::string trim(const std::string& input) {
+    size_t start = 0;
+    while (start < input.size() && std::isspace(static_cast<unsigned char>(input[start]))) {
+        ++start;
+    }
+    if (start == input.size()) return "";
+    size_t end = input.size() - 1;
+    while (end > start && std::isspace(static_cast<unsigned char>(input[end]))) {
+        --end;
+    }
+    return input.substr(start, end - start + 1);
+}
+
+double parse_out_time(const std::string& value) {
+    try {
+        return std::stod(value) / 1000000.0;
+    } catch (...) {
+        return 0.0;
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+namespace Progress {
+
+void emit(const std::string& stage,
+          const std::string& status,
+          double percent,
+          double elapsedSeconds,
+          double etaSeconds,
+          const std::string& message) {
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss << std::setprecision(2);
+    oss << "{\"stage\":\"" << stage << "\",\"status\":\"" << status << "\"";
+    if (percent >= 0.0) oss << ",\"percent\":" << percent;
+    if (elapsedSeconds >= 0.0) oss << ",\"elapsedSeconds\":" << elapsedSeconds;
+    if (etaSeconds >= 0.0) oss << ",\"etaSeconds\":" << etaSeconds;
+    if (!message.empty()) oss << ",\"message\":\"" << escape_json(message) << "\"";
+    oss << "}";
+
+    if (current_sink) {
+        current_sink(oss.str());
+    } else {
+        std::cout << "PROGRESS " << oss.str() << std::endl;
+    }
+}
+
+void emitStage(const std::string& stage, const std::string& status, const std::string& message) {
+    emit(stage, status, -1.0, -1.0, -1.0, message);
+}
+
+EncodeTracker::EncodeTracker(double totalDurationSeconds)
+    : totalDurationSeconds_(totalDurationSeconds),
+      start_(std::chrono::steady_clock::now()),
+      lastAdvance_(start_) {
+    emit("encoding", "running", 0.0, 0.0, -1.0, "FFmpeg started");
+}
+
+bool EncodeTracker::consume(const std::string& rawLine) {
+    std::string line = trim(rawLine);
+    auto delimiter = line.find('=');
+    if (line.empty() || delimiter == std::string::npos) return false;
+    std::string key = trim(line.substr(0, delimiter));
+    std::string value = trim(line.substr(delimiter + 1));
+
+    if (key == "out_time_ms") {
+        double seconds = parse_out_time(value);
+        if (seconds > outSeconds_) lastAdvance_ = std::chrono::steady_clock::now();
+        outSeconds_ = std::max(outSeconds_, seconds);
+    } else if (key == "progress") {
+        double elapsed = seconds_since(start_);
+        double percent = (totalDurationSeconds_ > 0.0)
+            ? std::clamp((outSeconds_ / totalDurationSeconds_) * 100.0, 0.0, 100.0)
+            : -1.0;
+        lastPercent_ = percent >= 0.0 ? percent : lastPercent_;
+        double eta = -1.0;
+        if (percent > 0.0 && percent < 100.0) {
+            double ratio = percent / 100.0;
+            eta = elapsed * ((1.0 - ratio) / ratio);
+        } else if (percent >= 100.0) {
+            eta = 0.0;
+        }
+
+        finished_ = (value == "end");
+        emit("encoding",
+             finished_ ? "completed" : "running",
+             percent,
+             elapsed,
+             eta,
+             finished_ ? "Encoding complete" : "Encoding in progress");
+    }
+    return finished_;
+}
+
+void EncodeTracker::finish() {
+    if (!finished_) emit("encoding", "completed", 100.0, seconds_since(start_), 0.0, "Encoding complete");
+    finished_ = true;
+}
+
+void EncodeTracker::fail(const std::string& message) {
+    emit("encoding", "failed", lastPercent_, -1.0, -1.0, message);
+}
+
+ScopedSink::ScopedSink(Sink sink) : previous_(std::move(current_sink)) {
+    current_sink = std::move(sink);
+}
+
+ScopedSink::~ScopedSink() {
+    current_sink = std::move(previous_);
+}
+
+} // namespace Progress
@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+
+// Structured progress events ("PROGRESS {...}" lines on stdout by default).
+namespace Progress {
+
+// Receives the JSON payload of one event (without the "PROGRESS " prefix).
+using Sink = std::function<void(const std::string& payload)>;
+
+// Negative numeric values are omitted from the event.
+void emit(const std::string& stage,
+          const std::string& status,
+          double percent = -1.0,
+          double elapsedSeconds = -1.0,
+          double etaSeconds = -1.0,
+          const std::string& message = "");
+
+void emitStage(const std::string& stage, const std::string& status, const std::string& message);
+
+// Routes events emitted on the current thread to `sink` for the lifetime of the guard,
+// so concurrent jobs (e.g. in --serve) can stream progress to their own clients.
+class ScopedSink {
+public:
+    explicit ScopedSink(Sink sink);
+    ~ScopedSink();
+    ScopedSink(const ScopedSink&) = delete;
+    ScopedSink& operator=(const ScopedSink&) = delete;
+
+private:
+    Sink previous_;
+};
+
+// Turns the key=value lines of ffmpeg's `-progress pipe:1` into "encoding" events.
+class EncodeTracker {
+public:
+    // Emits the "FFmpeg started" event.
+    explicit EncodeTracker(double totalDurationSeconds);
+
+    // Consumes one line; returns true once ffmpeg reports progress=end.
+    bool consume(const std::string& line);
+    // Emits "completed" when ffmpeg exited without reporting progress=end.
+    void finish();
+    void fail(const std::string& message);
+
+    // Output timestamp reached so far, and when it last moved forward (stall detection).
+    double outSeconds() const { return outSeconds_; }
+    std::chrono::steady_clock::time_point lastAdvance() const { return lastAdvance_; }
+
+private:
+    double totalDurationSeconds_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point lastAdvance_;
+    double outSeconds_ = 0.0;
+    double lastPercent_ = 0.0;
+    bool finished_ = false;
+};
+
+} // namespace Progress
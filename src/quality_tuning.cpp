@@ -0,0 +1,348 @@
+#include "quality_tuning.h"
+#include "background_plate_cache.h"
+#include "cache_utils.h"
+#include "render/plan_runner.h"
+#include "render_workspace.h"
+#include "subtitle_builder.h"
+#include "tracing.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+constexpr int kDecisionVersion = 1;
+std::mutex decision_mutex;
+
+// Filter arguments need ':' and '\'' escaped on Windows paths (see video_generator).
+std::string filter_path(const fs::path& path) {
+    std::string s = path.generic_string();
+#ifdef _WIN32
+    std::string out;
+    for (char ch : s) {
+        if (ch == ':' || ch == '\'') out.push_back('\\');
+        out.push_back(ch);
+    }
+    return out;
+#else
+    return s;
+#endif
+}
+
+json read_decisions() {
+    std::ifstream file(QualityTuning::decisionPath());
+    if (!file.is_open()) return json::object();
+    try {
+        json data = json::parse(file);
+        return data.is_object() ? data : json::object();
+    } catch (const json::exception&) {
+        return json::object();
+    }
+}
+
+json measurement_json(const QualityTuning::Measurement& m) {
+    return {{"preset", m.preset}, {"crf", m.crf}, {"score", m.score},
+            {"encodeSeconds", m.encodeSeconds}, {"bytes", m.bytes}};
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+namespace QualityTuning {
+
+double readScore(const fs::path& statsFile, const std::string& metric) {
+    std::ifstream file(statsFile);
+    if (!file.is_open()) return -1.0;
+    const std::string field = metric == "psnr" ? "psnr_avg:" : "All:";
+    double total = 0.0;
+    int frames = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t pos = line.find(field);
+        if (pos == std::string::npos) continue;
+        std::istringstream value(line.substr(pos + field.size()));
+        std::string token;
+        value >> token;
+        // Identical frames report PSNR "inf"; 100 dB is far above any useful floor.
+        double score = token == "inf" ? 100.0 : std::atof(token.c_str());
+        total += std::min(score, 100.0);
+        ++frames;
+    }
+    return frames > 0 ? total / frames : -1.0;
+}
+
+std::optional<Measurement> choose(const std::vector<Measurement>& measurements, double minScore) {
+    std::vector<Measurement> passing;
+    for (const auto& m : measurements) {
+        if (m.score >= minScore) passing.push_back(m);
+    }
+    if (passing.empty()) return std::nullopt;
+    double fastest = std::min_element(passing.begin(), passing.end(), [](const auto& a, const auto& b) {
+        return a.encodeSeconds < b.encodeSeconds;
+    })->encodeSeconds;
+    std::optional<Measurement> best;
+    for (const auto& m : passing) {
+        if (m.encodeSeconds > fastest * 1.05) continue;
+        if (!best || m.bytes < best->bytes) best = m;
+    }
+    return best;
+}
+
+std::string decisionKey(const AppConfig& config,
+                        const std::vector<std::string>& presets,
+                        const std::vector<int>& crfs) {
+    auto spec = BackgroundPlate::specFromConfig(config, true);
+    std::ostringstream key;
+    key << kDecisionVersion << '|' << BackgroundPlate::plateKey(spec) << '|' << config.autoQuality.metric
+        << '>' << config.autoQuality.minScore << '|' << config.autoQuality.samples << 'x'
+        << config.autoQuality.sampleSeconds << '|';
+    for (const auto& preset : presets) key << preset << ',';
+    key << '|';
+    for (int crf : crfs) key << crf << ',';
+    return std::to_string(config.width) + "x" + std::to_string(config.height) + "/" +
+           CacheUtils::hashString(key.str());
+}
+
+fs::path decisionPath() {
+    return CacheUtils::getCacheRoot() / "quality-tuning.json";
+}
+
+std::optional<Decision> lookupDecision(const std::string& key) {
+    std::lock_guard<std::mutex> lock(decision_mutex);
+    json data = read_decisions();
+    if (!data.contains(key)) return std::nullopt;
+    try {
+        const json& entry = data[key];
+        Decision decision;
+        decision.preset = entry.at("preset").get<std::string>();
+        decision.crf = entry.at("crf").get<int>();
+        decision.score = entry.value("score", 0.0);
+        decision.metric = entry.value("metric", "ssim");
+        decision.minScore = entry.value("minScore", 0.0);
+        decision.source = "cache";
+        return decision;
+    } catch (const json::exception&) {
+        return std::nullopt;
+    }
+}
+
+void saveDecision(const std::string& key, const Decision& decision) {
+    std::lock_guard<std::mutex> lock(decision_mutex);
+    json data = read_decisions();
+    json measured = json::array();
+    for (const auto& m : decision.measurements) measured.push_back(measurement_json(m));
+    data[key] = {
+        {"preset", decision.preset},
+        {"crf", decision.crf},
+        {"score", decision.score},
+        {"metric", decision.metric},
+        {"minScore", decision.minScore},
+        {"measurements", measured}
+    };
+
+    fs::path path = decisionPath();
+    fs::create_directories(path.parent_path());
+    // The mutex only covers this process; other qvm processes save through their own partial.
+    fs::path partial = CacheUtils::uniquePartialPath(path);
+    {
+        std::ofstream file(partial);
+        if (!file.is_open()) throw std::runtime_error("Failed to write quality tuning file: " + path.string());
+        file << data.dump(2) << '\n';
+    }
+    fs::rename(partial, path);
+}
+
+std::optional<Decision> forJob(const CLIOptions& options,
+                               const AppConfig& config,
+                               const std::vector<VerseData>& verses,
+                               const VerseSegmentation::Manager* segmentManager,
+                               const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                               const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    const AutoQualityConfig& tuning = config.autoQuality;
+    if (!tuning.enabled || options.draft) return std::nullopt;
+    if (options.encoder == "hardware") {
+        std::cerr << "Warning: Automatic quality selection tunes libx264 only; ignoring it for the hardware encoder." << std::endl;
+        return std::nullopt;
+    }
+    Tracing::Span span("autoQuality");
+
+    std::vector<std::string> presets = options.presetProvided ? std::vector<std::string>{options.preset} : tuning.presets;
+    std::vector<int> crfs = options.customCRF != -1 ? std::vector<int>{config.crf} : tuning.crfs;
+    // Highest CRF first: once a preset reaches the floor, lower CRFs only cost bits and time.
+    std::sort(crfs.begin(), crfs.end(), std::greater<int>());
+
+    std::string key;
+    try {
+        key = decisionKey(config, presets, crfs);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Automatic quality selection skipped: " << e.what() << std::endl;
+        return std::nullopt;
+    }
+    if (!options.noCache) {
+        if (auto cached = lookupDecision(key)) {
+            std::cout << "Auto quality: " << cached->preset << " crf " << cached->crf << " (cached, "
+                      << cached->metric << " " << cached->score << ")" << std::endl;
+            return cached;
+        }
+    }
+
+    // Windows spread over the job, each with the subtitles it would show in the render.
+    double total = config.introDuration + config.pauseAfterIntroDuration;
+    for (const auto& verse : verses) total += verse.durationInSeconds;
+    std::string ass = SubtitleBuilder::buildAssFile(config, options, verses, config.introDuration,
+                                                    config.pauseAfterIntroDuration, segmentManager);
+    std::string fonts = filter_path(fs::absolute(config.assetFolderPath) / "fonts");
+    std::ostringstream base_chain;
+    base_chain << "[0:v]setpts=PTS-STARTPTS,scale=" << config.width << ":" << config.height << ",fps=" << config.fps
+               << ",format=" << config.pixelFormat;
+    if (!config.overlayColor.empty()) {
+        base_chain << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << config.overlayColor << ":t=fill";
+    }
+
+    std::cout << "Auto quality: sampling " << tuning.samples << " x " << tuning.sampleSeconds << "s for "
+              << tuning.metric << " >= " << tuning.minScore << std::endl;
+    std::vector<fs::path> references;
+    for (int i = 0; i < tuning.samples; ++i) {
+        double start = std::max(0.0, total * (i + 0.5) / tuning.samples - tuning.sampleSeconds / 2.0);
+        // The background loops from its start; the subtitle clock is moved to the window.
+        Render::Plan plan;
+        Render::Input input;
+        input.path = fs::path(config.assetBgVideo).generic_string();
+        input.streamLoop = -1;
+        plan.inputs.push_back(input);
+        std::ostringstream chain;
+        chain << base_chain.str() << ",setpts=PTS+" << start << "/TB,ass='" << filter_path(ass)
+              << "':fontsdir='" << fonts << "',setpts=PTS-STARTPTS[v]";
+        plan.filterComplex = chain.str();
+        Render::Output output;
+        output.path = scratchFile("quality-ref-" + std::to_string(i) + ".mkv").generic_string();
+        output.maps = {"[v]"};
+        output.durationSeconds = tuning.sampleSeconds;
+        output.options = {{"c:v", "libx264"}, {"preset", "ultrafast"}, {"qp", "0"}};
+        plan.outputs.push_back(output);
+        Render::runPlan(plan, processExecutor, renderEngine);
+        references.push_back(output.path);
+    }
+
+    auto measure = [&](const std::string& preset, int crf) {
+        Measurement m;
+        m.preset = preset;
+        m.crf = crf;
+        for (size_t i = 0; i < references.size(); ++i) {
+            fs::path encoded = scratchFile("quality-candidate.mp4");
+            Render::Plan encode;
+            Render::Input reference;
+            reference.path = references[i].generic_string();
+            encode.inputs.push_back(reference);
+            Render::Output output;
+            output.path = encoded.generic_string();
+            output.maps = {"0:v"};
+            output.options = {{"c:v", "libx264"}, {"preset", preset}, {"crf", std::to_string(crf)},
+                              {"pix_fmt", config.pixelFormat}};
+            encode.outputs.push_back(output);
+            auto started = std::chrono::steady_clock::now();
+            Render::runPlan(encode, processExecutor, renderEngine);
+            m.encodeSeconds += seconds_since(started);
+            std::error_code ec;
+            auto size = fs::file_size(encoded, ec);
+            if (!ec) m.bytes += size;
+
+            fs::path stats = scratchFile("quality-" + tuning.metric + ".log");
+            fs::remove(stats, ec);
+            Render::Plan compare;
+            Render::Input distorted;
+            distorted.path = encoded.generic_string();
+            compare.inputs = {distorted, reference};
+            compare.filterComplex = "[0:v][1:v]" + tuning.metric + "=stats_file='" + filter_path(stats) + "'[cmp]";
+            Render::Output sink;
+            sink.path = "-";
+            sink.maps = {"[cmp]"};
+            sink.options = {{"f", "null"}};
+            compare.outputs.push_back(sink);
+            Render::runPlan(compare, processExecutor, renderEngine);
+
+            double score = readScore(stats, tuning.metric);
+            if (score < 0.0) {
+                m.score = -1.0;
+                return m;
+            }
+            m.score = i == 0 ? score : std::min(m.score, score);
+        }
+        return m;
+    };
+
+    Decision decision;
+    decision.metric = tuning.metric;
+    decision.minScore = tuning.minScore;
+    for (const auto& preset : presets) {
+        for (int crf : crfs) {
+            Measurement m = measure(preset, crf);
+            if (m.score < 0.0) {
+                std::cerr << "Warning: Could not score " << tuning.metric << " samples; keeping the "
+                          << config.qualityProfile << " profile settings." << std::endl;
+                return std::nullopt;
+            }
+            std::cout << "  " << preset << " crf " << crf << ": " << tuning.metric << " " << m.score << ", "
+                      << m.encodeSeconds << "s, " << m.bytes << " bytes" << std::endl;
+            decision.measurements.push_back(m);
+            if (m.score >= tuning.minScore) break;
+        }
+    }
+
+    auto best = choose(decision.measurements, tuning.minScore);
+    if (!best) {
+        best = *std::max_element(decision.measurements.begin(), decision.measurements.end(),
+                                 [](const auto& a, const auto& b) { return a.score < b.score; });
+        std::cerr << "Warning: No candidate reached " << tuning.metric << " " << tuning.minScore
+                  << "; using the highest quality measured." << std::endl;
+    }
+    decision.preset = best->preset;
+    decision.crf = best->crf;
+    decision.score = best->score;
+    std::cout << "Auto quality: " << decision.preset << " crf " << decision.crf << " (" << decision.metric << " "
+              << decision.score << ")" << std::endl;
+
+    if (!options.noCache) {
+        try {
+            saveDecision(key, decision);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: " << e.what() << std::endl;
+        }
+    }
+    return decision;
+}
+
+void apply(const Decision& decision, CLIOptions& options, AppConfig& config) {
+    options.preset = decision.preset;
+    options.presetProvided = true;
+    config.crf = decision.crf;
+}
+
+json toJson(const Decision& decision) {
+    json out = {
+        {"preset", decision.preset},
+        {"crf", decision.crf},
+        {"metric", decision.metric},
+        {"score", decision.score},
+        {"minScore", decision.minScore},
+        {"source", decision.source}
+    };
+    if (!decision.measurements.empty()) {
+        json measured = json::array();
+        for (const auto& m : decision.measurements) measured.push_back(measurement_json(m));
+        out["measurements"] = measured;
+    }
+    return out;
+}
+
+} // namespace QualityTuning
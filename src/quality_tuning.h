@@ -0,0 +1,69 @@
+#pragma once
+#include "types.h"
+#include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
+#include "verse_segmentation.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Picks the x264 preset and CRF for a job by encoding short windows of its actual frames at
+// several points and scoring them against a lossless reference with ffmpeg's ssim/psnr
+// filters, instead of trusting the static qualityProfiles.
+namespace QualityTuning {
+
+struct Measurement {
+    std::string preset;
+    int crf = 0;
+    double score = -1.0;         // worst window's mean SSIM/PSNR, -1 when it could not be read
+    double encodeSeconds = 0.0;  // all windows
+    std::uintmax_t bytes = 0;    // all windows
+};
+
+struct Decision {
+    std::string preset;
+    int crf = 0;
+    double score = 0.0;
+    std::string metric;
+    double minScore = 0.0;
+    std::string source = "measured";  // "measured" or "cache"
+    std::vector<Measurement> measurements;
+};
+
+// Mean per-frame score of an ssim ("All:") or psnr ("psnr_avg:") stats_file, -1 when it has none.
+double readScore(const std::filesystem::path& statsFile, const std::string& metric);
+
+// Fastest measurement reaching minScore; encodes within 5% of the fastest go to the smaller
+// file. nullopt when nothing reaches the floor.
+std::optional<Measurement> choose(const std::vector<Measurement>& measurements, double minScore);
+
+// Decisions live in <cache>/quality-tuning.json, keyed by the background plate (source file
+// content plus resolution, frame rate, pixel format and overlay), the metric and floor, and
+// the candidate grid.
+std::string decisionKey(const AppConfig& config,
+                        const std::vector<std::string>& presets,
+                        const std::vector<int>& crfs);
+std::filesystem::path decisionPath();
+std::optional<Decision> lookupDecision(const std::string& key);
+void saveDecision(const std::string& key, const Decision& decision);
+
+// Decision for this job when autoQuality is enabled: the cached one for its background and
+// resolution, otherwise measured and cached. An explicit --preset or --crf pins that axis.
+// nullopt when tuning is off or the samples could not be scored (the profile then applies).
+std::optional<Decision> forJob(const CLIOptions& options,
+                               const AppConfig& config,
+                               const std::vector<VerseData>& verses,
+                               const VerseSegmentation::Manager* segmentManager,
+                               const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                               const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine = nullptr);
+
+// Makes the decision the job's preset and CRF (renditions without a profile inherit it).
+void apply(const Decision& decision, CLIOptions& options, AppConfig& config);
+
+nlohmann::json toJson(const Decision& decision);
+
+} // namespace QualityTuning
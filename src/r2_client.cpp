@@ -15,14 +15,29 @@ namespace fs = std::filesystem;
 
 namespace R2 {
 
+namespace {
+
+// The SDK is initialized once per process and shut down at exit, so batch and
+// --serve jobs reuse it instead of paying InitAPI/ShutdownAPI for every client.
+struct SdkLifetime {
+    Aws::SDKOptions options;
+    SdkLifetime() { Aws::InitAPI(options); }
+    ~SdkLifetime() { Aws::ShutdownAPI(options); }
+};
+
+void ensureSdkInitialized() {
+    static SdkLifetime sdk;
+}
+
+} // namespace
+
 class Client::Impl {
 public:
     R2Config config;
-    Aws::SDKOptions sdkOptions;
     std::shared_ptr<Aws::S3::S3Client> s3Client;
 
     explicit Impl(const R2Config& cfg) : config(cfg) {
-        Aws::InitAPI(sdkOptions);
+        ensureSdkInitialized();
         
         Aws::Client::ClientConfiguration clientConfig;
         clientConfig.endpointOverride = extractHost(config.endpoint);
@@ -50,10 +65,6 @@ public:
         }
     }
 
-    ~Impl() {
-        Aws::ShutdownAPI(sdkOptions);
-    }
-
 private:
     std::string extractHost(const std::string& endpoint) {
         size_t start = endpoint.find("://");
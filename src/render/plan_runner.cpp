@@ -0,0 +1,37 @@
+#include "render/plan_runner.h"
+#include "tracing.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace Render {
+
+void runPlan(const Plan& plan,
+             const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+             const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    if (renderEngine) {
+        try {
+            Tracing::Span span("encode (in-process)", "encode");
+            renderEngine->render(plan);
+            return;
+        } catch (const UnsupportedPlanError& e) {
+            std::cerr << "Warning: In-process render unavailable (" << e.what()
+                      << "), falling back to ffmpeg CLI." << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: In-process render failed (" << e.what()
+                      << "), falling back to ffmpeg CLI." << std::endl;
+        }
+    }
+
+    Tracing::Span span("encode (ffmpeg)", "encode");
+    std::vector<std::string> args = buildFfmpegArgs(plan);
+    std::cout << "\nExecuting FFmpeg command:\n" << Interfaces::IProcessExecutor::joinCommand(args) << std::endl << std::endl;
+    if (plan.emitProgress) {
+        processExecutor->executeArgsWithProgress(args, plan.totalDurationSeconds);
+    } else {
+        int exit_code = processExecutor->executeArgs(args);
+        if (exit_code != 0) throw std::runtime_error("FFmpeg execution failed");
+    }
+}
+
+} // namespace Render
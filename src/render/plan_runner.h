@@ -0,0 +1,15 @@
+#pragma once
+#include "render/render_plan.h"
+#include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
+#include <memory>
+
+namespace Render {
+
+// Runs the plan in-process when an engine is available, otherwise (or when the engine
+// cannot handle the plan) through the ffmpeg CLI. Throws on failure.
+void runPlan(const Plan& plan,
+             const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+             const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine = nullptr);
+
+} // namespace Render
@@ -0,0 +1,81 @@
+#include "render/render_plan.h"
+#include "interfaces/IProcessExecutor.h"
+
+#include <sstream>
+
+namespace {
+
+std::string format_number(double value) {
+    std::ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+} // namespace
+
+namespace Render {
+
+std::string findOption(const OptionList& options, const std::string& key) {
+    std::string value;
+    for (const auto& [name, optionValue] : options) {
+        if (name == key) value = optionValue;
+    }
+    return value;
+}
+
+std::vector<std::string> buildFfmpegArgs(const Plan& plan) {
+    std::vector<std::string> args = {"ffmpeg"};
+    if (plan.emitProgress) {
+        args.insert(args.end(), {"-progress", "pipe:1", "-nostats", "-loglevel", "warning"});
+    }
+    args.push_back("-y");
+
+    for (const auto& input : plan.inputs) {
+        if (input.offsetSeconds != 0.0) {
+            args.insert(args.end(), {"-itsoffset", format_number(input.offsetSeconds)});
+        }
+        if (input.streamLoop != 0) {
+            args.insert(args.end(), {"-stream_loop", std::to_string(input.streamLoop)});
+        }
+        if (!input.format.empty()) {
+            args.insert(args.end(), {"-f", input.format});
+        }
+        for (const auto& [key, value] : input.options) {
+            args.insert(args.end(), {"-" + key, value});
+        }
+        if (input.seekSeconds >= 0.0) {
+            args.insert(args.end(), {"-ss", format_number(input.seekSeconds)});
+        }
+        if (input.durationSeconds >= 0.0) {
+            args.insert(args.end(), {"-t", format_number(input.durationSeconds)});
+        }
+        args.insert(args.end(), {"-i", input.path});
+    }
+
+    if (!plan.filterComplex.empty()) {
+        if (plan.filterThreads > 0) {
+            args.insert(args.end(), {"-filter_complex_threads", std::to_string(plan.filterThreads)});
+        }
+        args.insert(args.end(), {"-filter_complex", plan.filterComplex});
+    }
+
+    for (const auto& output : plan.outputs) {
+        for (const auto& map : output.maps) {
+            args.insert(args.end(), {"-map", map});
+        }
+        if (output.durationSeconds >= 0.0) {
+            args.insert(args.end(), {"-t", format_number(output.durationSeconds)});
+        }
+        for (const auto& [key, value] : output.options) {
+            args.insert(args.end(), {"-" + key, value});
+        }
+        args.push_back(output.path);
+    }
+    return args;
+}
+
+std::string buildFfmpegCommand(const Plan& plan) {
+    return Interfaces::IProcessExecutor::joinCommand(buildFfmpegArgs(plan));
+}
+
+} // namespace Render
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Render {
+
+// Ordered list of "-key value" pairs using ffmpeg CLI spelling (e.g. {"c:v", "libx264"}).
+using OptionList = std::vector<std::pair<std::string, std::string>>;
+
+// A single demuxer input, mirroring the per-input flags of the ffmpeg CLI.
+struct Input {
+    std::string path;                // file path, or a source filter description for "lavfi"
+    std::string format;              // -f (e.g. "lavfi", "concat"); empty = probe
+    int streamLoop = 0;              // -stream_loop (-1 loops forever)
+    double seekSeconds = -1.0;       // -ss
+    double durationSeconds = -1.0;   // -t
+    double offsetSeconds = 0.0;      // -itsoffset
+    OptionList options;              // extra demuxer options (e.g. {"safe", "0"})
+};
+
+struct Output {
+    std::string path;
+    std::vector<std::string> maps;   // filter labels ("[v]") or input streams ("1:a")
+    double durationSeconds = -1.0;   // -t
+    OptionList options;              // codec and muxer options, in order
+};
+
+// Everything needed to run one render, independent of how it is executed.
+struct Plan {
+    std::vector<Input> inputs;
+    std::string filterComplex;
+    std::vector<Output> outputs;
+    bool emitProgress = false;
+    double totalDurationSeconds = 0.0;  // used for progress percentages
+    int filterThreads = 0;              // -filter_complex_threads (0 = ffmpeg default)
+};
+
+// Thrown by render engines that cannot execute a plan so callers can fall back.
+class UnsupportedPlanError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Returns the value of the last matching option, or an empty string.
+std::string findOption(const OptionList& options, const std::string& key);
+
+std::vector<std::string> buildFfmpegArgs(const Plan& plan);
+std::string buildFfmpegCommand(const Plan& plan);
+
+} // namespace Render
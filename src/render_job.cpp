@@ -0,0 +1,394 @@
+#include "render_job.h"
+#include "metadata_writer.h"
+#include "quran_data.h"
+#include "verse_segmentation.h"
+#include "video_generator.h"
+#include "tracing.h"
+#include "render_workspace.h"
+#include "quality_tuning.h"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+const char* kGaplessDisabledError = "Gapless mode is temporarily disabled because it's too buggy and the gapless data needs to be cleaned first.";
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename T>
+std::function<void(CLIOptions&, const json&)> field(T CLIOptions::*member) {
+    return [member](CLIOptions& options, const json& value) { options.*member = value.get<T>(); };
+}
+
+template <typename T>
+std::function<void(CLIOptions&, const json&)> selectionField(T VideoSelectionConfig::*member) {
+    return [member](CLIOptions& options, const json& value) {
+        options.videoSelection.*member = value.get<T>();
+    };
+}
+
+const std::map<std::string, std::function<void(CLIOptions&, const json&)>>& jobFields() {
+    static const std::map<std::string, std::function<void(CLIOptions&, const json&)>> fields = {
+        {"surah", field(&CLIOptions::surah)},
+        {"from", field(&CLIOptions::from)},
+        {"to", field(&CLIOptions::to)},
+        {"reciterId", field(&CLIOptions::reciterId)},
+        {"translationId", field(&CLIOptions::translationId)},
+        {"output", field(&CLIOptions::output)},
+        {"width", field(&CLIOptions::width)},
+        {"height", field(&CLIOptions::height)},
+        {"fps", field(&CLIOptions::fps)},
+        {"arabicFontSize", field(&CLIOptions::arabicFontSize)},
+        {"translationFontSize", field(&CLIOptions::translationFontSize)},
+        {"noCache", field(&CLIOptions::noCache)},
+        {"preset", [](CLIOptions& options, const json& value) {
+            options.preset = value.get<std::string>();
+            options.presetProvided = true;
+        }},
+        {"encoder", field(&CLIOptions::encoder)},
+        {"renderEngine", field(&CLIOptions::renderEngine)},
+        {"renderChunks", field(&CLIOptions::renderChunks)},
+        {"encoderThreads", field(&CLIOptions::encoderThreads)},
+        {"plateCache", field(&CLIOptions::plateCache)},
+        {"staticBackground", field(&CLIOptions::staticBackground)},
+        {"variableFrameRate", field(&CLIOptions::variableFrameRate)},
+        {"incremental", field(&CLIOptions::incremental)},
+        {"tracePath", field(&CLIOptions::tracePath)},
+        {"tmpfsWorkspace", field(&CLIOptions::tmpfsWorkspace)},
+        {"draft", field(&CLIOptions::draft)},
+        {"autoQuality", field(&CLIOptions::autoQuality)},
+        {"qualityFloor", field(&CLIOptions::qualityFloor)},
+        {"streamFormat", field(&CLIOptions::streamFormat)},
+        {"renditions", [](CLIOptions& options, const json& value) {
+            options.renditions.clear();
+            for (const auto& item : value) {
+                if (item.is_string()) {
+                    options.renditions.push_back(RenderJob::parseRendition(item.get<std::string>()));
+                    continue;
+                }
+                Rendition rendition;
+                rendition.name = item.at("name").get<std::string>();
+                rendition.width = item.at("width").get<int>();
+                rendition.height = item.at("height").get<int>();
+                rendition.qualityProfile = item.value("qualityProfile", "");
+                rendition.output = item.value("output", "");
+                options.renditions.push_back(rendition);
+            }
+        }},
+        {"recitationMode", field(&CLIOptions::recitationMode)},
+        {"emitProgress", field(&CLIOptions::emitProgress)},
+        {"customAudioPath", field(&CLIOptions::customAudioPath)},
+        {"customTimingFile", field(&CLIOptions::customTimingFile)},
+        {"enableTextGrowth", field(&CLIOptions::enableTextGrowth)},
+        {"textPaddingOverride", field(&CLIOptions::textPaddingOverride)},
+        {"qualityProfile", field(&CLIOptions::qualityProfile)},
+        {"customCRF", field(&CLIOptions::customCRF)},
+        {"pixelFormatOverride", field(&CLIOptions::pixelFormatOverride)},
+        {"videoBitrateOverride", field(&CLIOptions::videoBitrateOverride)},
+        {"videoMaxRateOverride", field(&CLIOptions::videoMaxRateOverride)},
+        {"videoBufSizeOverride", field(&CLIOptions::videoBufSizeOverride)},
+        {"backgroundTheme", field(&CLIOptions::backgroundTheme)},
+        {"segmentLongVerses", field(&CLIOptions::segmentLongVerses)},
+        {"segmentDataPath", field(&CLIOptions::segmentDataPath)},
+        {"longVersesPath", field(&CLIOptions::longVersesPath)},
+        {"seed", selectionField(&VideoSelectionConfig::seed)},
+        {"enableDynamicBackgrounds", selectionField(&VideoSelectionConfig::enableDynamicBackgrounds)},
+        {"localVideoDirectory", selectionField(&VideoSelectionConfig::localVideoDirectory)},
+        {"r2Endpoint", selectionField(&VideoSelectionConfig::r2Endpoint)},
+        {"r2AccessKey", selectionField(&VideoSelectionConfig::r2AccessKey)},
+        {"r2SecretKey", selectionField(&VideoSelectionConfig::r2SecretKey)},
+        {"r2Bucket", selectionField(&VideoSelectionConfig::r2Bucket)},
+    };
+    return fields;
+}
+
+} // namespace
+
+namespace RenderJob {
+
+std::string normalizeOptions(CLIOptions& options) {
+    if (options.segmentLongVerses && options.segmentDataPath.empty()) {
+        return "--segment-long-verses requires --segment-data to specify the segment timing file.";
+    }
+
+    // Custom recitations only work in gapless mode
+    if (!options.customAudioPath.empty() || !options.customTimingFile.empty()) {
+        if (options.customAudioPath.empty() || options.customTimingFile.empty()) {
+            return "Both --custom-audio and --custom-timing must be specified together.";
+        }
+        if (options.recitationMode.empty()) {
+            options.recitationMode = "gapless";
+        } else if (options.recitationMode != "gapless") {
+            return "Custom recitations only work in gapless mode.";
+        }
+    }
+
+    // We want to allow gapless mode for custom audio
+    if (options.recitationMode == "gapless" && options.customAudioPath.empty()) {
+        return kGaplessDisabledError;
+    }
+
+    if (options.renderChunks < 0) {
+        return "--chunks must be 0 (auto) or a positive number.";
+    }
+    if (options.encoderThreads < 0) {
+        return "--encoder-threads must be 0 (auto) or a positive number.";
+    }
+    if (options.renderEngine != "ffmpeg" && options.renderEngine != "libav") {
+        return "--render-engine must be 'ffmpeg' or 'libav'.";
+    }
+    if (!options.streamFormat.empty() && options.streamFormat != "hls" && options.streamFormat != "dash") {
+        return "--stream-format must be 'hls' or 'dash'.";
+    }
+
+    for (const auto& rendition : options.renditions) {
+        if (rendition.name.empty() || rendition.width <= 0 || rendition.height <= 0) {
+            return "Each --rendition needs a name and a positive width and height.";
+        }
+        if (rendition.width % 2 != 0 || rendition.height % 2 != 0) {
+            return "Rendition '" + rendition.name + "' must have an even width and height.";
+        }
+    }
+
+    if (options.output.empty()) {
+        fs::path default_output_dir = "out";
+        if (!fs::exists(default_output_dir)) {
+            if (!fs::create_directories(default_output_dir)) {
+                throw std::runtime_error("Failed to create directory: " + default_output_dir.string());
+            }
+        }
+        // Batch and daemon jobs also name the reciter and translation, so jobs of the same range
+        // do not write to the same file; single CLI runs keep the plain name.
+        bool per_job = options.jobOutputNames;
+        options.output = "out/surah-" + std::to_string(options.surah) + "_" + std::to_string(options.from) + "-" + std::to_string(options.to) +
+                         (per_job && options.reciterId >= 0 ? "-r" + std::to_string(options.reciterId) : "") +
+                         (per_job && options.translationId >= 0 ? "-t" + std::to_string(options.translationId) : "") +
+                         (options.draft ? "-draft" : "") + ".mp4";
+    }
+    fs::path output_path(options.output);
+    for (auto& rendition : options.renditions) {
+        if (!rendition.output.empty()) continue;
+        rendition.output = (output_path.parent_path() /
+                            (output_path.stem().string() + "-" + rendition.name + output_path.extension().string())).string();
+    }
+    return "";
+}
+
+std::string outputKey(const std::string& output) {
+    fs::path path = fs::absolute(output).lexically_normal();
+    return (path.parent_path() / path.stem()).string();
+}
+
+std::vector<std::string> outputPaths(const CLIOptions& options) {
+    std::vector<std::string> outputs = {options.output};
+    for (const auto& rendition : options.renditions) outputs.push_back(rendition.output);
+    return outputs;
+}
+
+Rendition parseRendition(const std::string& spec) {
+    Rendition rendition;
+    size_t first = spec.find(':');
+    if (first == std::string::npos) throw std::invalid_argument("Invalid rendition '" + spec + "', expected name:WIDTHxHEIGHT[:profile]");
+    rendition.name = spec.substr(0, first);
+    size_t second = spec.find(':', first + 1);
+    std::string size = spec.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+    if (second != std::string::npos) rendition.qualityProfile = spec.substr(second + 1);
+    size_t x = size.find('x');
+    try {
+        if (x == std::string::npos) throw std::invalid_argument("missing 'x'");
+        size_t used = 0;
+        rendition.width = std::stoi(size.substr(0, x), &used);
+        if (used != x) throw std::invalid_argument("bad width");
+        std::string heightText = size.substr(x + 1);
+        rendition.height = std::stoi(heightText, &used);
+        if (used != heightText.size()) throw std::invalid_argument("bad height");
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid rendition size '" + size + "' in '" + spec + "', expected WIDTHxHEIGHT");
+    }
+    if (rendition.name.empty()) throw std::invalid_argument("Rendition '" + spec + "' needs a name");
+    return rendition;
+}
+
+AppConfig renditionConfig(CLIOptions& renditionOptions,
+                          const Rendition& rendition,
+                          const AppConfig& config,
+                          const ConfigFile& configFile) {
+    renditionOptions.renditions.clear();
+    renditionOptions.output = rendition.output;
+    renditionOptions.width = rendition.width;
+    renditionOptions.height = rendition.height;
+    if (!rendition.qualityProfile.empty()) renditionOptions.qualityProfile = rendition.qualityProfile;
+    double scale = static_cast<double>(std::min(rendition.width, rendition.height)) /
+                   std::max(1, std::min(config.width, config.height));
+    renditionOptions.arabicFontSize = static_cast<int>(std::lround(config.arabicFont.size * scale));
+    renditionOptions.translationFontSize = static_cast<int>(std::lround(config.translationFont.size * scale));
+    AppConfig renditionConfig = buildConfig(configFile, renditionOptions);
+    renditionConfig.verticalShift = config.verticalShift * scale;
+    return renditionConfig;
+}
+
+static std::vector<VideoGenerator::RenditionOutput> buildRenditions(const CLIOptions& options,
+                                                             const AppConfig& config,
+                                                             const ConfigFile& configFile) {
+    std::vector<VideoGenerator::RenditionOutput> renditions;
+    for (const auto& rendition : options.renditions) {
+        VideoGenerator::RenditionOutput target;
+        target.options = options;
+        target.name = rendition.name;
+        target.config = renditionConfig(target.options, rendition, config, configFile);
+        renditions.push_back(std::move(target));
+    }
+    return renditions;
+}
+
+CLIOptions optionsFromJson(const json& job, const CLIOptions& defaults) {
+    if (!job.is_object()) throw std::invalid_argument("Job must be a JSON object");
+    CLIOptions options = defaults;
+    // Per-job files are never inherited from the CLI.
+    options.output.clear();
+    options.tracePath.clear();
+    options.jobOutputNames = true;
+    const auto& fields = jobFields();
+    for (const auto& [key, value] : job.items()) {
+        if (key == "id" || key == "priority") continue;  // scheduling metadata, not render options
+        auto it = fields.find(key);
+        if (it == fields.end()) throw std::invalid_argument("Unknown job field: " + key);
+        try {
+            it->second(options, value);
+        } catch (const json::exception&) {
+            throw std::invalid_argument("Invalid value for job field: " + key);
+        }
+    }
+    for (const char* required : {"surah", "from", "to"}) {
+        if (!job.contains(required)) throw std::invalid_argument(std::string("Missing job field: ") + required);
+    }
+    return options;
+}
+
+Result run(CLIOptions options,
+           const ConfigFile& configFile,
+           const std::vector<std::string>& invocationArgs,
+           const Services& services) {
+    Result result;
+    auto job_start = std::chrono::steady_clock::now();
+    auto trace = std::make_shared<Tracing::Session>();
+    Tracing::ScopedSession trace_scope(trace);
+    bool metadata_written = false;
+    try {
+        Tracing::Span job_span("renderJob", "job");
+        std::string error = normalizeOptions(options);
+        if (!error.empty()) throw std::invalid_argument(error);
+        result.output = options.output;
+
+        // Every intermediate of the job goes here; removed when the try block is left.
+        auto workspace = std::make_shared<RenderWorkspace>("", options.tmpfsWorkspace);
+        RenderWorkspace::Scope workspace_scope(workspace);
+
+        auto stage_start = std::chrono::steady_clock::now();
+        std::optional<Tracing::Span> stage_span(std::in_place, "buildConfig", "config");
+        AppConfig config = buildConfig(configFile, options);
+
+        // We want to allow gapless mode for custom audio
+        if (config.recitationMode == RecitationMode::GAPLESS && options.customAudioPath.empty()) {
+            throw std::invalid_argument(kGaplessDisabledError);
+        }
+
+        // Override background theme if specified
+        if (!options.backgroundTheme.empty()) {
+            auto it = QuranData::backgroundThemes.find(options.backgroundTheme);
+            if (it != QuranData::backgroundThemes.end()) {
+                fs::path themePath = it->second;
+                if (!themePath.is_absolute()) {
+                    themePath = fs::path(config.assetFolderPath) / themePath;
+                }
+                config.assetBgVideo = themePath.string();
+            } else {
+                std::cerr << "Warning: Unknown theme '" << options.backgroundTheme << "', using default." << std::endl;
+            }
+        }
+
+        validateAssets(config);
+        stage_span.reset();
+        result.configSeconds = seconds_since(stage_start);
+
+        std::string modeStr = (config.recitationMode == RecitationMode::GAPLESS) ? "gapless" : "gapped";
+        std::cout << "Rendering Surah " << options.surah << ", verses " << options.from << "-" << options.to << std::endl;
+        std::cout << "Mode: " << modeStr << std::endl;
+        std::cout << "Config: " << config.width << "x" << config.height << " @ " << config.fps << "fps, reciter=" << config.reciterId << ", translation=" << config.translationId << std::endl;
+        std::cout << "Text growth: " << (config.enableTextGrowth ? "enabled" : "disabled") << std::endl;
+
+        stage_start = std::chrono::steady_clock::now();
+        stage_span.emplace("fetchQuranData", "fetch");
+        auto verses = services.apiClient->fetchQuranData(options, config);
+
+        // Create segmentation manager if enabled
+        stage_span.emplace("createSegmentationManager", "fetch");
+        auto segmentManager = VerseSegmentation::createManager(
+            options.segmentLongVerses,
+            options.longVersesPath,
+            options.segmentDataPath
+        );
+        stage_span.reset();
+        result.fetchSeconds = seconds_since(stage_start);
+
+        stage_start = std::chrono::steady_clock::now();
+        // Measured before the metadata is written so the sidecar records the chosen preset/CRF.
+        auto quality = QualityTuning::forJob(options, config, verses, segmentManager.get(),
+                                             services.processExecutor, services.renderEngine);
+        if (quality) QualityTuning::apply(*quality, options, config);
+        MetadataWriter::writeMetadata(options, config, invocationArgs);
+        metadata_written = true;
+        if (quality) MetadataWriter::mergeIntoMetadata(options, "autoQuality", QualityTuning::toJson(*quality));
+        auto renditions = buildRenditions(options, config, configFile);
+        stage_span.emplace("generateVideo", "render");
+        bool rendered = VideoGenerator::generateVideo(options, config, verses, services.processExecutor,
+                                                      segmentManager.get(), services.renderEngine, renditions);
+        if (!rendered) throw std::runtime_error("Video generation failed");
+        stage_span.reset();
+        result.renderSeconds = seconds_since(stage_start);
+        result.success = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.totalSeconds = seconds_since(job_start);
+
+    result.trace = trace->summary();
+    if (metadata_written) MetadataWriter::mergeIntoMetadata(options, "trace", result.trace);
+    if (!options.tracePath.empty()) {
+        try {
+            trace->writeChromeTrace(options.tracePath);
+            std::cout << "Trace written to: " << options.tracePath << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: " << e.what() << std::endl;
+        }
+    }
+    return result;
+}
+
+json resultToJson(const Result& result) {
+    json out;
+    out["status"] = result.success ? "succeeded" : "failed";
+    out["output"] = result.output;
+    if (!result.error.empty()) out["error"] = result.error;
+    out["timings"] = {
+        {"configSeconds", result.configSeconds},
+        {"fetchSeconds", result.fetchSeconds},
+        {"renderSeconds", result.renderSeconds},
+        {"totalSeconds", result.totalSeconds}
+    };
+    if (!result.trace.is_null()) out["trace"] = result.trace;
+    return out;
+}
+
+} // namespace RenderJob
@@ -0,0 +1,68 @@
+#pragma once
+#include "types.h"
+#include "config_loader.h"
+#include "interfaces/IApiClient.h"
+#include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace RenderJob {
+
+// Collaborators shared by every job rendered in this process.
+struct Services {
+    std::shared_ptr<Interfaces::IProcessExecutor> processExecutor;
+    std::shared_ptr<Interfaces::IApiClient> apiClient;
+    std::shared_ptr<Interfaces::IRenderEngine> renderEngine;  // optional in-process backend
+};
+
+struct Result {
+    bool success = false;
+    std::string output;
+    std::string error;
+    double configSeconds = 0.0;
+    double fetchSeconds = 0.0;
+    double renderSeconds = 0.0;
+    double totalSeconds = 0.0;
+    nlohmann::json trace;  // Tracing::Session::summary() of the job
+};
+
+// Applies the option rules the CLI enforces (custom audio pairing, gapless availability,
+// segmentation data, default output path out/surah-S_F-T[-draft].mp4; jobs with jobOutputNames
+// get out/surah-S_F-T[-rR][-tT][-draft].mp4 with the reciter and translation when they are set).
+// Returns an error message, or "" when valid.
+std::string normalizeOptions(CLIOptions& options);
+
+// Files a job writes next to an output (video, thumbnail, sidecars) share its directory and stem;
+// this is that prefix, absolute and normalized. Two concurrent jobs must never share one.
+std::string outputKey(const std::string& output);
+
+// The output and every rendition output of normalized options.
+std::vector<std::string> outputPaths(const CLIOptions& options);
+
+// Parses a --rendition spec "name:WIDTHxHEIGHT[:qualityProfile]". Throws std::invalid_argument.
+Rendition parseRendition(const std::string& spec);
+
+// Config of one rendition of a job: same job at another size and quality profile, with font
+// sizes and the vertical shift scaled to the shorter side of the frame. `renditionOptions`
+// starts as a copy of the job's options and is updated to match.
+AppConfig renditionConfig(CLIOptions& renditionOptions,
+                          const Rendition& rendition,
+                          const AppConfig& config,
+                          const ConfigFile& configFile);
+
+// Builds job options from a JSON object keyed by CLIOptions field names, on top of defaults.
+// Throws std::invalid_argument for unknown fields or mistyped values.
+CLIOptions optionsFromJson(const nlohmann::json& job, const CLIOptions& defaults);
+
+// Renders one job: config, verse data, metadata, video and thumbnail. Never throws.
+Result run(CLIOptions options,
+           const ConfigFile& configFile,
+           const std::vector<std::string>& invocationArgs,
+           const Services& services);
+
+nlohmann::json resultToJson(const Result& result);
+
+} // namespace RenderJob
@@ -0,0 +1,364 @@
+#include "render_server.h"
+#include "progress.h"
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using nlohmann::json;
+
+namespace RenderServer {
+
+JobQueue::JobQueue(size_t capacity) : capacity_(capacity) {}
+
+bool JobQueue::push(QueuedJob job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || jobs_.size() >= capacity_) return false;
+        jobs_.push(std::move(job));
+    }
+    ready_.notify_one();
+    return true;
+}
+
+bool JobQueue::pop(QueuedJob& job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return closed_ || !jobs_.empty(); });
+    if (jobs_.empty()) return false;
+    job = jobs_.top();
+    jobs_.pop();
+    return true;
+}
+
+void JobQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    ready_.notify_all();
+}
+
+size_t JobQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+std::string OutputClaims::claim(const std::string& jobId, const std::vector<std::string>& outputs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& output : outputs) {
+        auto owner = owners_.find(RenderJob::outputKey(output));
+        if (owner != owners_.end()) {
+            return "Output " + output + " is already being rendered by job " + owner->second;
+        }
+    }
+    for (const auto& output : outputs) owners_.emplace(RenderJob::outputKey(output), jobId);
+    return "";
+}
+
+void OutputClaims::release(const std::vector<std::string>& outputs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& output : outputs) owners_.erase(RenderJob::outputKey(output));
+}
+
+#ifdef _WIN32
+
+int serve(const Options&, const CLIOptions&, const ConfigFile&,
+          const std::vector<std::string>&, const RenderJob::Services&) {
+    throw std::runtime_error("--serve needs Unix domain sockets and is not available on Windows");
+}
+
+#else
+
+namespace {
+
+constexpr size_t kMaxQueuedProgress = 64;   // progress events dropped once this many lines are unsent
+constexpr int kSendTimeoutSeconds = 30;     // a client that reads nothing for this long is dropped
+
+// One client socket; shared by its reader thread and every job it submitted. Events go through
+// a queue drained by a writer thread, so a client that stops reading never stalls a render slot.
+class Connection {
+public:
+    explicit Connection(int fd) : outbox_(std::make_shared<Outbox>()) {
+        outbox_->fd = fd;
+        timeval timeout{kSendTimeoutSeconds, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        std::thread(writeLoop, outbox_).detach();
+    }
+    // The writer flushes what is still queued, then closes the socket.
+    ~Connection() {
+        {
+            std::lock_guard<std::mutex> lock(outbox_->mutex);
+            outbox_->closing = true;
+        }
+        outbox_->ready.notify_one();
+    }
+
+    int fd() const { return outbox_->fd; }
+
+    // Progress events are dropped while the client is behind; every other event is delivered.
+    void send(const json& event) {
+        bool progress = event.value("event", "") == "progress";
+        {
+            std::lock_guard<std::mutex> lock(outbox_->mutex);
+            if (outbox_->broken) return;
+            if (progress && outbox_->lines.size() >= kMaxQueuedProgress) return;
+            outbox_->lines.push_back(event.dump() + "\n");
+        }
+        outbox_->ready.notify_one();
+    }
+
+private:
+    struct Outbox {
+        int fd = -1;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::string> lines;
+        bool closing = false;
+        bool broken = false;
+    };
+
+    static void writeLoop(std::shared_ptr<Outbox> outbox) {
+        std::unique_lock<std::mutex> lock(outbox->mutex);
+        while (true) {
+            outbox->ready.wait(lock, [&] { return outbox->closing || !outbox->lines.empty(); });
+            if (outbox->lines.empty()) break;  // closing and drained
+            std::string line = std::move(outbox->lines.front());
+            outbox->lines.pop_front();
+            lock.unlock();
+            bool written = writeAll(outbox->fd, line);
+            lock.lock();
+            if (!written) {
+                outbox->broken = true;  // client went away or stopped reading; jobs still run to completion
+                outbox->lines.clear();
+            }
+        }
+        ::close(outbox->fd);
+    }
+
+    static bool writeAll(int fd, const std::string& line) {
+        const char* data = line.data();
+        size_t remaining = line.size();
+        while (remaining > 0) {
+            ssize_t written = ::write(fd, data, remaining);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    std::shared_ptr<Outbox> outbox_;
+};
+
+struct ServerState {
+    const CLIOptions& defaults;
+    const ConfigFile& configFile;
+    const std::vector<std::string>& invocationArgs;
+    const RenderJob::Services& services;
+    JobQueue queue;
+    OutputClaims claims;
+    std::atomic<std::uint64_t> nextSequence{0};
+    std::atomic<int> running{0};
+    int slots;
+};
+
+void handleLine(ServerState& state, const std::shared_ptr<Connection>& connection, const std::string& line) {
+    json request;
+    try {
+        request = json::parse(line);
+    } catch (const json::parse_error& e) {
+        connection->send({{"event", "rejected"}, {"error", std::string("Invalid JSON: ") + e.what()}});
+        return;
+    }
+
+    if (request.is_object() && request.contains("command")) {
+        if (request["command"] == "status") {
+            connection->send({{"event", "status"},
+                              {"queued", state.queue.size()},
+                              {"running", state.running.load()},
+                              {"slots", state.slots}});
+        } else {
+            connection->send({{"event", "rejected"}, {"error", "Unknown command"}});
+        }
+        return;
+    }
+
+    QueuedJob job;
+    job.sequence = state.nextSequence++;
+    job.id = "job-" + std::to_string(job.sequence);
+    try {
+        if (request.is_object() && request.contains("id")) {
+            job.id = request["id"].is_string() ? request["id"].get<std::string>() : request["id"].dump();
+        }
+        // Validate up front so malformed jobs never take a queue slot.
+        CLIOptions options = RenderJob::optionsFromJson(request, state.defaults);
+        std::string error = RenderJob::normalizeOptions(options);
+        if (!error.empty()) throw std::invalid_argument(error);
+        job.outputs = RenderJob::outputPaths(options);
+        if (request.contains("priority")) job.priority = request["priority"].get<int>();
+    } catch (const std::exception& e) {
+        connection->send({{"event", "rejected"}, {"id", job.id}, {"error", e.what()}});
+        return;
+    }
+    // Two jobs on one output would overwrite each other's video, thumbnail and sidecars.
+    std::string conflict = state.claims.claim(job.id, job.outputs);
+    if (!conflict.empty()) {
+        connection->send({{"event", "rejected"}, {"id", job.id}, {"error", conflict}});
+        return;
+    }
+
+    job.job = std::move(request);
+    job.enqueuedAt = std::chrono::steady_clock::now();
+    job.reply = [connection](const json& event) { connection->send(event); };
+    std::string id = job.id;
+    std::vector<std::string> outputs = job.outputs;
+    if (!state.queue.push(std::move(job))) {
+        state.claims.release(outputs);
+        connection->send({{"event", "rejected"}, {"id", id}, {"error", "Render queue is full"}});
+        return;
+    }
+    connection->send({{"event", "queued"}, {"id", id}, {"queued", state.queue.size()}});
+}
+
+void readConnection(ServerState& state, std::shared_ptr<Connection> connection) {
+    std::string pending;
+    char buffer[4096];
+    while (true) {
+        ssize_t received = ::read(connection->fd(), buffer, sizeof(buffer));
+        if (received <= 0) break;
+        pending.append(buffer, static_cast<size_t>(received));
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            handleLine(state, connection, line);
+        }
+    }
+}
+
+void renderSlot(ServerState& state) {
+    QueuedJob job;
+    while (state.queue.pop(job)) {
+        ++state.running;
+        double queuedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.enqueuedAt).count();
+        job.reply({{"event", "started"}, {"id", job.id}, {"queuedSeconds", queuedSeconds}});
+
+        RenderJob::Result result;
+        try {
+            CLIOptions options = RenderJob::optionsFromJson(job.job, state.defaults);
+            options.emitProgress = true;
+            std::vector<std::string> jobArgs = state.invocationArgs;
+            jobArgs.push_back("--serve-job");
+            jobArgs.push_back(job.job.dump());
+
+            const auto& reply = job.reply;
+            const std::string& id = job.id;
+            Progress::ScopedSink sink([&reply, &id](const std::string& payload) {
+                reply({{"event", "progress"}, {"id", id}, {"progress", json::parse(payload)}});
+            });
+            result = RenderJob::run(options, state.configFile, jobArgs, state.services);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        state.claims.release(job.outputs);
+
+        json event = RenderJob::resultToJson(result);
+        event["event"] = "result";
+        event["id"] = job.id;
+        event["timings"]["queuedSeconds"] = queuedSeconds;
+        job.reply(event);
+        std::cout << "Job " << job.id << " " << (result.success ? "succeeded" : "failed: " + result.error) << std::endl;
+        job = QueuedJob{};  // release the client connection
+        --state.running;
+    }
+}
+
+} // namespace
+
+int serve(const Options& serverOptions,
+          const CLIOptions& defaults,
+          const ConfigFile& configFile,
+          const std::vector<std::string>& invocationArgs,
+          const RenderJob::Services& services) {
+    sockaddr_un address{};
+    if (serverOptions.socketPath.empty() || serverOptions.socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Invalid --serve socket path: " + serverOptions.socketPath);
+    }
+
+    // A client disconnecting mid-job must not kill the daemon.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw std::runtime_error("Failed to create server socket");
+    address.sun_family = AF_UNIX;
+    serverOptions.socketPath.copy(address.sun_path, serverOptions.socketPath.size());
+    // Only a socket nobody answers on is stale; a live one belongs to a running daemon.
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        int connected = ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        int error = errno;
+        ::close(probe);
+        if (connected == 0) {
+            ::close(listener);
+            throw std::runtime_error("A render daemon is already serving on " + serverOptions.socketPath);
+        }
+        std::error_code ec;
+        if (error == ECONNREFUSED && !std::filesystem::is_socket(serverOptions.socketPath, ec)) {
+            ::close(listener);
+            throw std::runtime_error(serverOptions.socketPath + " exists and is not a socket");
+        }
+        if (error == ECONNREFUSED) {
+            ::unlink(serverOptions.socketPath.c_str());  // stale socket from a previous run
+        } else if (error != ENOENT) {
+            ::close(listener);
+            throw std::runtime_error("Cannot use " + serverOptions.socketPath + ": " + std::strerror(error));
+        }
+    }
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 16) != 0) {
+        ::close(listener);
+        throw std::runtime_error("Failed to listen on " + serverOptions.socketPath);
+    }
+
+    ServerState state{defaults, configFile, invocationArgs, services,
+                      JobQueue(static_cast<size_t>(serverOptions.maxQueue)), {}, {0}, {0}, serverOptions.slots};
+    std::vector<std::thread> slots;
+    for (int i = 0; i < serverOptions.slots; ++i) slots.emplace_back(renderSlot, std::ref(state));
+
+    std::cout << "Serving on " << serverOptions.socketPath << " with " << serverOptions.slots
+              << " render slot(s), queue limit " << serverOptions.maxQueue << std::endl;
+
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::thread(readConnection, std::ref(state), std::make_shared<Connection>(client)).detach();
+    }
+
+    ::close(listener);
+    state.queue.close();
+    for (auto& slot : slots) slot.join();
+    ::unlink(serverOptions.socketPath.c_str());
+    return 0;
+}
+
+#endif
+
+} // namespace RenderServer
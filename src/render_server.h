@@ -0,0 +1,81 @@
+#pragma once
+#include "render_job.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace RenderServer {
+
+struct Options {
+    std::string socketPath;
+    int slots = 1;        // jobs rendered concurrently
+    int maxQueue = 64;    // queued (not yet running) jobs before new ones are rejected
+};
+
+struct QueuedJob {
+    int priority = 0;
+    std::uint64_t sequence = 0;
+    std::string id;
+    nlohmann::json job;
+    std::chrono::steady_clock::time_point enqueuedAt;
+    std::function<void(const nlohmann::json&)> reply;  // writes one event to the submitting client
+    std::vector<std::string> outputs;  // claimed in OutputClaims until the job ends
+};
+
+// Outputs of the queued and running daemon jobs, by directory and stem (RenderJob::outputKey),
+// so two jobs never write the same video, thumbnail or sidecars. Thread safe.
+class OutputClaims {
+public:
+    // Claims every output for jobId, or none of them: returns an error naming the job that
+    // already owns one, or "" when all were claimed.
+    std::string claim(const std::string& jobId, const std::vector<std::string>& outputs);
+    // Frees the outputs of a finished or dropped job.
+    void release(const std::vector<std::string>& outputs);
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::string> owners_;  // output key -> job id
+};
+
+// Bounded priority queue: higher priority first, then submission order.
+class JobQueue {
+public:
+    explicit JobQueue(size_t capacity);
+
+    // Returns false when the queue is full or closed; the job is not queued.
+    bool push(QueuedJob job);
+    // Blocks until a job is available; returns false once the queue is closed and drained.
+    bool pop(QueuedJob& job);
+    void close();
+    size_t size() const;
+
+private:
+    struct Order {
+        bool operator()(const QueuedJob& a, const QueuedJob& b) const {
+            if (a.priority != b.priority) return a.priority < b.priority;
+            return a.sequence > b.sequence;
+        }
+    };
+
+    size_t capacity_;
+    bool closed_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::priority_queue<QueuedJob, std::vector<QueuedJob>, Order> jobs_;
+};
+
+// Listens on a Unix domain socket and renders newline-delimited JSON jobs until killed.
+int serve(const Options& serverOptions,
+          const CLIOptions& defaults,
+          const ConfigFile& configFile,
+          const std::vector<std::string>& invocationArgs,
+          const RenderJob::Services& services);
+
+} // namespace RenderServer
@@ -0,0 +1,176 @@
+#include "render_workspace.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+thread_local std::shared_ptr<RenderWorkspace> current_workspace;
+std::atomic<unsigned long> next_workspace{0};
+
+long process_id() {
+#ifdef _WIN32
+    return static_cast<long>(_getpid());
+#else
+    return static_cast<long>(getpid());
+#endif
+}
+
+// Sweeps each base directory once per process, before its first workspace is created.
+void sweep_once(const fs::path& base) {
+    static std::mutex mutex;
+    static std::set<std::string> swept;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!swept.insert(base.string()).second) return;
+    }
+    int removed = RenderWorkspace::removeStale(base);
+    if (removed > 0) {
+        std::cout << "Removed " << removed << " stale render workspace(s) from " << base.string() << std::endl;
+    }
+}
+
+bool try_create(const fs::path& dir) {
+    std::error_code ec;
+    return fs::create_directories(dir, ec) && !ec;
+}
+
+constexpr const char* kLockFile = ".lock";
+
+// Exclusive lock on <dir>/.lock for as long as the descriptor stays open; -1 when it could not
+// be taken (the workspace is then never swept).
+int lock_workspace(const fs::path& dir) {
+#ifdef _WIN32
+    (void)dir;
+    return -1;
+#else
+    // Locked under another name first: a sweep must never find an unlocked .lock in a live
+    // workspace. The rename keeps the inode, and with it the lock.
+    fs::path pending = dir / ".lock-pending";
+    int fd = open(pending.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    std::error_code ec;
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+        fs::rename(pending, dir / kLockFile, ec);
+        if (!ec) return fd;
+    }
+    close(fd);
+    fs::remove(pending, ec);
+    return -1;
+#endif
+}
+
+} // namespace
+
+RenderWorkspace::RenderWorkspace(const std::string& label, bool inMemory) {
+    std::string name = "qvm-" + std::to_string(process_id()) + "-" + std::to_string(next_workspace++);
+    if (!label.empty()) name += "-" + label;
+
+    const fs::path shm = "/dev/shm";
+    std::error_code ec;
+    if (inMemory && fs::is_directory(shm, ec)) {
+        sweep_once(shm);
+        if (try_create(shm / name)) {
+            root_ = shm / name;
+            inMemory_ = true;
+            lockFd_ = lock_workspace(root_);
+            return;
+        }
+    }
+    if (inMemory) {
+        std::cerr << "Warning: No tmpfs available for the render workspace, using the temp directory." << std::endl;
+    }
+    fs::path base = fs::temp_directory_path();
+    sweep_once(base);
+    if (!try_create(base / name)) {
+        throw std::runtime_error("Failed to create render workspace: " + (base / name).string());
+    }
+    root_ = base / name;
+    lockFd_ = lock_workspace(root_);
+}
+
+RenderWorkspace::~RenderWorkspace() {
+    std::error_code ec;
+    fs::remove_all(root_, ec);
+    if (ec) std::cerr << "Warning: Could not remove render workspace " << root_.string() << ": " << ec.message() << std::endl;
+#ifndef _WIN32
+    // Unlocked only once the directory is gone, so a sweep never races the removal above.
+    if (lockFd_ >= 0) close(lockFd_);
+#endif
+}
+
+fs::path RenderWorkspace::file(const std::string& name) const {
+    return root_ / name;
+}
+
+fs::path RenderWorkspace::directory(const std::string& name) const {
+    fs::path dir = root_ / name;
+    fs::create_directories(dir);
+    return dir;
+}
+
+std::shared_ptr<RenderWorkspace> RenderWorkspace::current() {
+    return current_workspace;
+}
+
+int RenderWorkspace::removeStale(const fs::path& base) {
+#ifdef _WIN32
+    (void)base;
+    return 0;
+#else
+    int removed = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(base, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind("qvm-", 0) != 0) continue;
+        std::error_code type_ec;
+        if (!it->is_directory(type_ec)) continue;
+        // flock conflicts between open file descriptions, so this fails for any live workspace,
+        // including those of this process and of other PID namespaces on the same kernel.
+        int fd = open((it->path() / kLockFile).c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) continue;
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            close(fd);
+            continue;
+        }
+        std::error_code remove_ec;
+        fs::remove_all(it->path(), remove_ec);
+        close(fd);
+        if (!remove_ec) ++removed;
+    }
+    return removed;
+#endif
+}
+
+RenderWorkspace::Scope::Scope(std::shared_ptr<RenderWorkspace> workspace) : previous_(std::move(current_workspace)) {
+    current_workspace = std::move(workspace);
+}
+
+RenderWorkspace::Scope::~Scope() {
+    current_workspace = std::move(previous_);
+}
+
+fs::path scratchFile(const std::string& name) {
+    if (auto workspace = RenderWorkspace::current()) return workspace->file(name);
+    return fs::temp_directory_path() / name;
+}
+
+fs::path scratchDirectory(const std::string& name) {
+    if (auto workspace = RenderWorkspace::current()) return workspace->directory(name);
+    fs::path dir = fs::temp_directory_path() / name;
+    fs::create_directories(dir);
+    return dir;
+}
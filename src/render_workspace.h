@@ -0,0 +1,59 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Private scratch directory of one render job. Intermediates (verse audio, subtitles, concat
+// lists, chunk files, background downloads) are written here so concurrent renders on one host
+// never share a path, and the directory is removed with everything in it when the workspace dies.
+class RenderWorkspace {
+public:
+    // Creates <base>/qvm-<pid>-<n>[-label] and holds an exclusive lock on its .lock file until
+    // destroyed. With inMemory, <base> is /dev/shm when it is available (tmpfs, so intermediates
+    // never touch the disk), otherwise the system temp directory. Throws std::runtime_error when
+    // the directory cannot be created.
+    explicit RenderWorkspace(const std::string& label = "", bool inMemory = false);
+    ~RenderWorkspace();
+    RenderWorkspace(const RenderWorkspace&) = delete;
+    RenderWorkspace& operator=(const RenderWorkspace&) = delete;
+
+    const std::filesystem::path& root() const { return root_; }
+    bool inMemory() const { return inMemory_; }
+    // Path of a file directly in the workspace; the file is not created.
+    std::filesystem::path file(const std::string& name) const;
+    // Creates (if needed) and returns a subdirectory of the workspace.
+    std::filesystem::path directory(const std::string& name) const;
+
+    // Workspace of the job running on this thread, or nullptr.
+    static std::shared_ptr<RenderWorkspace> current();
+
+    // Removes qvm-* workspaces under `base` whose .lock nobody holds, i.e. left behind by a
+    // crashed or killed render. The lock, not the pid in the name, decides: processes in other
+    // PID namespaces (containers sharing /tmp) keep theirs locked too. Workspaces without a
+    // .lock file are left alone. Returns how many were removed. No-op on Windows.
+    static int removeStale(const std::filesystem::path& base);
+
+    // Makes `workspace` current on this thread for the lifetime of the guard. Worker threads
+    // adopt their parent's workspace with Scope(RenderWorkspace::current()).
+    class Scope {
+    public:
+        explicit Scope(std::shared_ptr<RenderWorkspace> workspace);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        std::shared_ptr<RenderWorkspace> previous_;
+    };
+
+private:
+    std::filesystem::path root_;
+    bool inMemory_ = false;
+    int lockFd_ = -1;
+};
+
+// Scratch file `name` in the current workspace, or in the system temp directory when no job
+// workspace is active (tools and tests calling the stages directly).
+std::filesystem::path scratchFile(const std::string& name);
+// Like scratchFile, for a directory; created before returning.
+std::filesystem::path scratchDirectory(const std::string& name);
@@ -7,10 +7,17 @@
 #include <iomanip>
 #include <thread>
 #include <future>
+#include <atomic>
 #include <cctype>
 #include <algorithm>
+#include <optional>
 #include "localization_utils.h"
+#include "cache_utils.h"
 #include "text/text_layout.h"
+#include "text/utf8.h"
+#include "encoder_tuning.h"
+#include "tracing.h"
+#include "render_workspace.h"
 
 namespace fs = std::filesystem;
 
@@ -39,10 +46,6 @@ std::string format_ass_color(const std::string& hex_color) {
     return "&H" + clean_hex + "&";
 }
 
-bool is_basic_latin_ascii(unsigned char c) {
-    return c >= 0x20 && c <= 0x7E;
-}
-
 // Helper struct for segment dialogue generation
 struct SegmentDialogue {
     double startTime;
@@ -56,23 +59,34 @@ struct SegmentDialogue {
     bool growEnabled;
 };
 
+// A verse or segment waiting for layout. Whole verses are laid out from `verse`, segments
+// from their own text.
+struct LayoutTask {
+    const VerseData* verse = nullptr;
+    std::string arabic;
+    std::string translation;
+    double durationSeconds = 0.0;
+    double startTime = 0.0;
+    double endTime = 0.0;
+};
+
+constexpr int kMaxLayoutThreads = 8;
+
 } // namespace
 
 namespace SubtitleBuilder {
 
+int layoutThreadCount() {
+    int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    return std::clamp(cores / EncoderTuning::activeJobs(), 1, kMaxLayoutThreads);
+}
+
 std::string applyLatinFontFallback(const std::string& text,
                                    const std::string& fallbackFont,
                                    const std::string& primaryFont) {
     if (fallbackFont.empty() || fallbackFont == primaryFont) return text;
 
-    bool hasLatin = false;
-    for (unsigned char c : text) {
-        if (is_basic_latin_ascii(c)) {
-            hasLatin = true;
-            break;
-        }
-    }
-    if (!hasLatin) return text;
+    if (!Utf8::containsBasicLatin(text)) return text;
 
     std::string result;
     bool usingFallback = false;
@@ -82,25 +96,22 @@ std::string applyLatinFontFallback(const std::string& text,
     };
 
     for (size_t i = 0; i < text.size();) {
-        unsigned char c = static_cast<unsigned char>(text[i]);
-        size_t len = 1;
-        if ((c & 0xF8) == 0xF0) {
-            len = 4;
-        } else if ((c & 0xF0) == 0xE0) {
-            len = 3;
-        } else if ((c & 0xE0) == 0xC0) {
-            len = 2;
+        size_t latin = Utf8::basicLatinRunLength(text, i);
+        if (latin > 0) {
+            if (!usingFallback) {
+                append_font_tag(fallbackFont);
+                usingFallback = true;
+            }
+            result.append(text, i, latin);
+            i += latin;
+            continue;
         }
 
-        bool isLatin = (len == 1) && is_basic_latin_ascii(c);
-        if (isLatin && !usingFallback) {
-            append_font_tag(fallbackFont);
-            usingFallback = true;
-        } else if (!isLatin && usingFallback) {
+        if (usingFallback) {
             append_font_tag(primaryFont);
             usingFallback = false;
         }
-
+        size_t len = Utf8::sequenceLength(static_cast<unsigned char>(text[i]));
         result.append(text, i, len);
         i += len;
     }
@@ -117,7 +128,9 @@ std::string buildAssFile(const AppConfig& config,
                          double intro_duration,
                          double pause_after_intro_duration,
                          const VerseSegmentation::Manager* segmentManager) {
-    fs::path ass_path = fs::temp_directory_path() / "subtitles.ass";
+    Tracing::Span span("buildAssFile", "subtitles");
+    // Per-output name: renditions of one job share the workspace.
+    fs::path ass_path = scratchFile(CacheUtils::hashString(options.output).substr(0, 8) + "-subtitles.ass");
     std::ofstream ass_file(ass_path);
     if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary subtitle file.");
 
@@ -134,7 +147,9 @@ std::string buildAssFile(const AppConfig& config,
     ass_file << "[Script Info]\nTitle: Quran Video Subtitles\nScriptType: v4.00+\n";
     ass_file << "PlayResX: " << config.width << "\nPlayResY: " << config.height << "\n\n";
 
+    std::optional<Tracing::Span> layout_span(std::in_place, "TextLayout::Engine", "layout");
     TextLayout::Engine layoutEngine(config);
+    layout_span.reset();
     double paddingPixels = layoutEngine.paddingPixels();
     int styleMargin = std::max(10, static_cast<int>(paddingPixels));
 
@@ -170,8 +185,9 @@ std::string buildAssFile(const AppConfig& config,
             << "\\fad(0," << config.introFadeOutMs << ")}"
             << range_text << "\n";
 
-    // Collect all dialogue entries (verses and segments)
-    std::vector<SegmentDialogue> allDialogues;
+    // Timings of all entries (verses and segments) are fixed up front. Layout, the expensive
+    // part, then runs on a bounded pool, and the events are written in order below.
+    std::vector<LayoutTask> tasks;
     
     double cumulative_time = intro_duration + pause_after_intro_duration;
     double verticalPadding = config.height * std::clamp(config.textVerticalPadding, 0.0, 0.3);
@@ -200,18 +216,51 @@ std::string buildAssFile(const AppConfig& config,
                 // verse_audio_start is when this verse starts in the audio
                 // cumulative_time is when this verse starts in the video
                 double segment_offset_from_verse = segment.startSeconds - verse_audio_start;
-                double segment_start_in_video = cumulative_time + segment_offset_from_verse;
-                double segment_end_in_video = cumulative_time + (segment.endSeconds - verse_audio_start);
-                double segment_duration = segment.endSeconds - segment.startSeconds;
                 
-                // Layout the segment text
-                auto layout = layoutEngine.layoutSegment(segment.arabic, 
-                                                          segment.translation, 
-                                                          segment_duration);
+                LayoutTask task;
+                task.arabic = segment.arabic;
+                task.translation = segment.translation;
+                task.durationSeconds = segment.endSeconds - segment.startSeconds;
+                task.startTime = cumulative_time + segment_offset_from_verse;
+                task.endTime = cumulative_time + (segment.endSeconds - verse_audio_start);
+                tasks.push_back(std::move(task));
+            }
+        } else {
+            // Standard verse handling (no segmentation)
+            LayoutTask task;
+            task.verse = &verse;
+            task.startTime = cumulative_time;
+            task.endTime = cumulative_time + verse.durationInSeconds;
+            tasks.push_back(std::move(task));
+        }
+        
+        cumulative_time += verse.durationInSeconds;
+    }
+
+    // The engine's font pool gives every worker thread its own FreeType/HarfBuzz contexts.
+    std::vector<SegmentDialogue> allDialogues(tasks.size());
+    std::atomic<size_t> next_task{0};
+    std::atomic<bool> failed{false};
+    auto trace_session = Tracing::currentSession();
+    auto worker = [&]() {
+        Tracing::ScopedSession trace_scope(trace_session);
+        while (!failed) {
+            size_t index = next_task++;
+            if (index >= tasks.size()) return;
+            const LayoutTask& task = tasks[index];
+            try {
+                TextLayout::LayoutResult layout;
+                if (task.verse) {
+                    Tracing::Span layout_task_span("layoutVerse", "layout");
+                    layout = layoutEngine.layoutVerse(*task.verse);
+                } else {
+                    Tracing::Span layout_task_span("layoutSegment", "layout");
+                    layout = layoutEngine.layoutSegment(task.arabic, task.translation, task.durationSeconds);
+                }
                 
-                SegmentDialogue dialogue;
-                dialogue.startTime = segment_start_in_video;
-                dialogue.endTime = segment_end_in_video;
+                SegmentDialogue& dialogue = allDialogues[index];
+                dialogue.startTime = task.startTime;
+                dialogue.endTime = task.endTime;
                 dialogue.arabicText = layout.wrappedArabic;
                 dialogue.translationText = applyLatinFontFallback(
                     layout.wrappedTranslation, 
@@ -222,32 +271,24 @@ std::string buildAssFile(const AppConfig& config,
                 dialogue.arabicGrowthFactor = layout.arabicGrowthFactor;
                 dialogue.translationGrowthFactor = layout.translationGrowthFactor;
                 dialogue.growEnabled = layout.growArabic;
-                
-                allDialogues.push_back(dialogue);
+            } catch (...) {
+                failed = true;
+                throw;
             }
-        } else {
-            // Standard verse handling (no segmentation)
-            auto layout = layoutEngine.layoutVerse(verse);
-            
-            SegmentDialogue dialogue;
-            dialogue.startTime = cumulative_time;
-            dialogue.endTime = cumulative_time + verse.durationInSeconds;
-            dialogue.arabicText = layout.wrappedArabic;
-            dialogue.translationText = applyLatinFontFallback(
-                layout.wrappedTranslation, 
-                config.translationFallbackFontFamily, 
-                config.translationFont.family);
-            dialogue.arabicSize = layout.baseArabicSize;
-            dialogue.translationSize = layout.baseTranslationSize;
-            dialogue.arabicGrowthFactor = layout.arabicGrowthFactor;
-            dialogue.translationGrowthFactor = layout.translationGrowthFactor;
-            dialogue.growEnabled = layout.growArabic;
-            
-            allDialogues.push_back(dialogue);
         }
-        
-        cumulative_time += verse.durationInSeconds;
+    };
+
+    size_t layout_threads = std::min(tasks.size(), static_cast<size_t>(layoutThreadCount()));
+    if (layout_threads <= 1) {
+        worker();
+    } else {
+        std::vector<std::future<void>> workers;
+        for (size_t i = 0; i < layout_threads; ++i) {
+            workers.push_back(std::async(std::launch::async, worker));
+        }
+        for (auto& future : workers) future.get();
     }
+    layoutEngine.saveLayoutCache();
 
     // Generate dialogue lines for all entries
     for (const auto& dialogue : allDialogues) {
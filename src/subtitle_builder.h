@@ -11,6 +11,10 @@ namespace SubtitleBuilder {
                                        const std::string& fallbackFont,
                                        const std::string& primaryFont);
 
+    // Worker threads used to lay out verses: the cores left to this render by the ones running
+    // alongside it, at most 8.
+    int layoutThreadCount();
+
     std::string buildAssFile(const AppConfig& config,
                              const CLIOptions& options,
                              const std::vector<VerseData>& verses,
@@ -0,0 +1,131 @@
+#include "text/font_pool.h"
+
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include <hb-ft.h>
+#include <hb.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SIZES_H
+
+namespace TextLayout {
+
+struct FontPool::ThreadFonts {
+    struct SizedFont {
+        FT_Face face = nullptr;
+        FT_Size size = nullptr;
+        hb_font_t* font = nullptr;
+    };
+    using PlanKey = std::tuple<hb_face_t*, int, hb_script_t, hb_language_t>;
+
+    FT_Library library = nullptr;
+    std::map<std::string, FT_Face> faces;
+    std::map<std::pair<std::string, int>, SizedFont> fonts;
+    std::map<PlanKey, hb_shape_plan_t*> plans;
+    hb_buffer_t* scratch = nullptr;
+
+    ~ThreadFonts() {
+        for (auto& [key, plan] : plans) hb_shape_plan_destroy(plan);
+        for (auto& [key, sized] : fonts) hb_font_destroy(sized.font);
+        // FT_Done_Face releases the face's sizes as well.
+        for (auto& [file, face] : faces) FT_Done_Face(face);
+        if (library) FT_Done_FreeType(library);
+        if (scratch) hb_buffer_destroy(scratch);
+    }
+};
+
+FontPool::FontPool() = default;
+FontPool::~FontPool() = default;
+
+FontPool::ThreadFonts& FontPool::threadFonts() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& fonts = threads_[std::this_thread::get_id()];
+    if (!fonts) {
+        auto created = std::make_unique<ThreadFonts>();
+        if (FT_Init_FreeType(&created->library)) throw std::runtime_error("Failed to init FreeType");
+        created->scratch = hb_buffer_create();
+        ++libraries_;
+        fonts = std::move(created);
+    }
+    return *fonts;
+}
+
+void FontPool::shape(const std::string& fontFile, int pixelSize, const std::string& text, hb_buffer_t* buffer) {
+    ThreadFonts& thread = threadFonts();
+
+    auto sized = thread.fonts.find({fontFile, pixelSize});
+    if (sized != thread.fonts.end()) {
+        ++fontHits_;
+    } else {
+        ++fontMisses_;
+        FT_Face& face = thread.faces[fontFile];
+        if (!face) {
+            if (FT_New_Face(thread.library, fontFile.c_str(), 0, &face)) {
+                face = nullptr;
+                thread.faces.erase(fontFile);
+                throw std::runtime_error("Failed to load font: " + fontFile);
+            }
+            ++faceLoads_;
+        }
+        ThreadFonts::SizedFont entry;
+        entry.face = face;
+        if (FT_New_Size(face, &entry.size) || FT_Activate_Size(entry.size)) {
+            throw std::runtime_error("Failed to create font size for: " + fontFile);
+        }
+        FT_Set_Char_Size(face, 0, pixelSize * 64, 0, 0);
+        entry.font = hb_ft_font_create(face, nullptr);
+        sized = thread.fonts.emplace(std::make_pair(fontFile, pixelSize), entry).first;
+    }
+    // hb-ft reads advances through the face's active size.
+    FT_Activate_Size(sized->second.size);
+
+    hb_buffer_reset(buffer);
+    hb_buffer_add_utf8(buffer, text.c_str(), -1, 0, -1);
+    hb_buffer_guess_segment_properties(buffer);
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buffer, &props);
+
+    hb_face_t* hb_face = hb_font_get_face(sized->second.font);
+    ThreadFonts::PlanKey key{hb_face, static_cast<int>(props.direction), props.script, props.language};
+    auto plan = thread.plans.find(key);
+    if (plan != thread.plans.end()) {
+        ++shapePlanHits_;
+    } else {
+        ++shapePlanMisses_;
+        plan = thread.plans.emplace(key, hb_shape_plan_create_cached(hb_face, &props, nullptr, 0, nullptr)).first;
+    }
+    hb_shape_plan_execute(plan->second, sized->second.font, buffer, nullptr, 0);
+}
+
+hb_buffer_t* FontPool::shape(const std::string& fontFile, int pixelSize, const std::string& text) {
+    hb_buffer_t* buffer = threadFonts().scratch;
+    shape(fontFile, pixelSize, text, buffer);
+    return buffer;
+}
+
+double FontPool::measure(const std::string& fontFile, int pixelSize, const std::string& text) {
+    hb_buffer_t* buffer = shape(fontFile, pixelSize, text);
+
+    unsigned int glyph_count;
+    hb_glyph_position_t* glyph_pos = hb_buffer_get_glyph_positions(buffer, &glyph_count);
+    double width = 0.0;
+    for (unsigned int i = 0; i < glyph_count; ++i) {
+        width += glyph_pos[i].x_advance / 64.0;
+    }
+    return width;
+}
+
+FontPool::Stats FontPool::stats() const {
+    Stats stats;
+    stats.libraries = libraries_;
+    stats.faceLoads = faceLoads_;
+    stats.fontHits = fontHits_;
+    stats.fontMisses = fontMisses_;
+    stats.shapePlanHits = shapePlanHits_;
+    stats.shapePlanMisses = shapePlanMisses_;
+    return stats;
+}
+
+} // namespace TextLayout
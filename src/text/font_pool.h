@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+typedef struct hb_buffer_t hb_buffer_t;
+
+namespace TextLayout {
+
+// FreeType/HarfBuzz state kept for the lifetime of a layout engine instead of being rebuilt
+// for every measurement. FreeType objects must not be shared between threads, so each thread
+// that shapes text gets its own FT_Library. Within a thread, every font file is parsed once
+// into an FT_Face, each pixel size gets its own FT_Size and hb_font_t, and shape plans are
+// reused per face and segment properties (direction, script, language).
+class FontPool {
+public:
+    struct Stats {
+        uint64_t libraries = 0;        // FT_Library instances, one per thread that shaped text
+        uint64_t faceLoads = 0;        // font files parsed
+        uint64_t fontHits = 0;         // (file, size) lookups served from the pool
+        uint64_t fontMisses = 0;
+        uint64_t shapePlanHits = 0;
+        uint64_t shapePlanMisses = 0;
+    };
+
+    FontPool();
+    ~FontPool();
+    FontPool(const FontPool&) = delete;
+    FontPool& operator=(const FontPool&) = delete;
+
+    // Shapes UTF-8 `text` with `fontFile` at `pixelSize` into `buffer`, which is reset first.
+    // Throws std::runtime_error when the font cannot be loaded.
+    void shape(const std::string& fontFile, int pixelSize, const std::string& text, hb_buffer_t* buffer);
+    // Same, into the calling thread's scratch buffer, which stays valid until that thread's next
+    // shape or measure call.
+    hb_buffer_t* shape(const std::string& fontFile, int pixelSize, const std::string& text);
+    // Total x advance of the shaped text, in pixels.
+    double measure(const std::string& fontFile, int pixelSize, const std::string& text);
+
+    Stats stats() const;
+
+private:
+    struct ThreadFonts;
+    ThreadFonts& threadFonts();
+
+    std::mutex mutex_;
+    std::map<std::thread::id, std::unique_ptr<ThreadFonts>> threads_;
+    std::atomic<uint64_t> libraries_{0};
+    std::atomic<uint64_t> faceLoads_{0};
+    std::atomic<uint64_t> fontHits_{0};
+    std::atomic<uint64_t> fontMisses_{0};
+    std::atomic<uint64_t> shapePlanHits_{0};
+    std::atomic<uint64_t> shapePlanMisses_{0};
+};
+
+} // namespace TextLayout
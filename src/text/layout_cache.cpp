@@ -0,0 +1,276 @@
+#include "text/layout_cache.h"
+
+#include "cache_utils.h"
+#include "text/text_layout.h"
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <hb.h>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+namespace {
+
+// Bump when wrapping changes in a way that alters its output.
+constexpr const char* kLayoutCacheVersion = "1";
+
+// One run of an entry: pixel sizes [minSize, maxSize] all wrap to `wrapped`. Stored as
+// [min, max, wrapped], with null for text that needed no wrapping.
+struct SizeRun {
+    int minSize;
+    int maxSize;
+    json wrapped;
+};
+
+std::vector<SizeRun> read_runs(const json& entry) {
+    std::vector<SizeRun> runs;
+    if (!entry.is_array()) return runs;
+    for (const auto& run : entry) {
+        if (!run.is_array() || run.size() != 3 || !run[0].is_number_integer() || !run[1].is_number_integer()) continue;
+        runs.push_back({run[0].get<int>(), run[1].get<int>(), run[2]});
+    }
+    return runs;
+}
+
+json write_runs(std::vector<SizeRun> runs) {
+    std::sort(runs.begin(), runs.end(), [](const SizeRun& a, const SizeRun& b) { return a.minSize < b.minSize; });
+    json entry = json::array();
+    for (const auto& run : runs) {
+        if (!entry.empty() && entry.back()[1].get<int>() + 1 >= run.minSize && entry.back()[2] == run.wrapped) {
+            entry.back()[1] = std::max(entry.back()[1].get<int>(), run.maxSize);
+        } else {
+            entry.push_back({run.minSize, run.maxSize, run.wrapped});
+        }
+    }
+    return entry;
+}
+
+bool run_covers(const json& entry, int pixelSize) {
+    for (const auto& run : read_runs(entry)) {
+        if (run.minSize <= pixelSize && pixelSize <= run.maxSize) return true;
+    }
+    return false;
+}
+
+json read_bucket_file(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return json::object();
+    try {
+        json data = json::parse(file);
+        if (data.is_object() && data.value("version", "") == kLayoutCacheVersion && data.contains("entries") &&
+            data["entries"].is_object()) {
+            return data["entries"];
+        }
+    } catch (const json::exception&) {
+        std::cerr << "Warning: Ignoring unreadable layout cache " << path.string() << std::endl;
+    }
+    return json::object();
+}
+
+std::string entry_key(const std::string& text) {
+    return CacheUtils::hashString(text);
+}
+
+} // namespace
+
+namespace TextLayout {
+
+LayoutCache& LayoutCache::shared() {
+    static LayoutCache cache;
+    return cache;
+}
+
+fs::path LayoutCache::directory() {
+    return CacheUtils::getCacheRoot() / "layout";
+}
+
+std::string LayoutCache::bucketKey(const std::string& fontFile, double wrapWidth) {
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size(fontFile, ec);
+    if (ec) return "";
+    fs::file_time_type modified = fs::last_write_time(fontFile, ec);
+    if (ec) return "";
+
+    std::string fontHash;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = fontHashes_.find(fontFile);
+        if (it != fontHashes_.end() && it->second.size == size && it->second.modified == modified) {
+            fontHash = it->second.hash;
+        }
+    }
+    if (fontHash.empty()) {
+        try {
+            fontHash = CacheUtils::hashFile(fontFile);
+        } catch (const std::exception&) {
+            return "";
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        fontHashes_[fontFile] = FontHash{size, modified, fontHash};
+    }
+
+    std::ostringstream key;
+    key.setf(std::ios::fixed);
+    key.precision(6);
+    key << kLayoutCacheVersion << '|' << hb_version_string() << '|' << fontHash << '|' << wrapWidth;
+    return CacheUtils::hashString(key.str());
+}
+
+LayoutCache::Bucket& LayoutCache::bucketLocked(const std::string& bucket) {
+    fs::path path = directory() / (bucket + ".json");
+    auto it = buckets_.find(path);
+    if (it == buckets_.end()) {
+        Bucket loaded;
+        loaded.entries = read_bucket_file(path);
+        it = buckets_.emplace(path, std::move(loaded)).first;
+    }
+    return it->second;
+}
+
+std::optional<std::string> LayoutCache::lookup(const std::string& bucket, const std::string& text, int pixelSize) {
+    if (bucket.empty()) return std::nullopt;
+    std::string key = entry_key(text);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Bucket& entries = bucketLocked(bucket);
+    auto entry = entries.entries.find(key);
+    if (entry != entries.entries.end()) {
+        for (const auto& run : read_runs(*entry)) {
+            if (run.minSize <= pixelSize && pixelSize <= run.maxSize) {
+                ++hits_;
+                return run.wrapped.is_string() ? run.wrapped.get<std::string>() : text;
+            }
+        }
+    }
+    ++misses_;
+    return std::nullopt;
+}
+
+void LayoutCache::store(const std::string& bucket, const std::string& text, int pixelSize, const std::string& wrapped) {
+    if (bucket.empty()) return;
+    std::string key = entry_key(text);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Bucket& entries = bucketLocked(bucket);
+    json& entry = entries.entries[key];
+    if (run_covers(entry, pixelSize)) return;
+    auto runs = read_runs(entry);
+    runs.push_back({pixelSize, pixelSize, wrapped == text ? json(nullptr) : json(wrapped)});
+    entry = write_runs(std::move(runs));
+    entries.dirty = true;
+    ++stores_;
+}
+
+void LayoutCache::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [path, bucket] : buckets_) {
+        if (!bucket.dirty) continue;
+        // Another process may have saved entries since this bucket was loaded.
+        json on_disk = read_bucket_file(path);
+        for (auto it = on_disk.begin(); it != on_disk.end(); ++it) {
+            json& entry = bucket.entries[it.key()];
+            auto runs = read_runs(entry);
+            for (auto& run : read_runs(it.value())) runs.push_back(std::move(run));
+            entry = write_runs(std::move(runs));
+        }
+
+        try {
+            fs::create_directories(path.parent_path());
+            // Processes flushing the same bucket each write their own partial; the last rename wins.
+            fs::path partial = CacheUtils::uniquePartialPath(path);
+            {
+                std::ofstream out(partial);
+                if (!out.is_open()) throw std::runtime_error("cannot write " + partial.string());
+                out << json{{"version", kLayoutCacheVersion}, {"entries", bucket.entries}}.dump();
+            }
+            fs::rename(partial, path);
+            bucket.dirty = false;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Failed to save layout cache " << path.string() << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+LayoutCache::Stats LayoutCache::stats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.stores = stores_;
+    return stats;
+}
+
+size_t prewarmLayoutCache(const AppConfig& config) {
+    // Verse text as renders build it: the QPC words of the verse in order, each followed by a space.
+    std::ifstream file(config.quranWordByWordPath);
+    if (!file.is_open()) throw std::runtime_error("Could not open " + config.quranWordByWordPath);
+    json quranData = json::parse(file);
+    std::map<std::string, std::vector<std::pair<int, std::string>>> words;
+    for (auto it = quranData.begin(); it != quranData.end(); ++it) {
+        const std::string& key = it.key();
+        size_t split = key.rfind(':');
+        if (split == std::string::npos || key.find(':') == split || !it.value().is_object()) continue;
+        try {
+            words[key.substr(0, split)].emplace_back(std::stoi(key.substr(split + 1)), it.value().value("text", ""));
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+
+    struct Verse {
+        std::string arabic;
+        std::string translation;
+    };
+    std::vector<Verse> verses;
+    verses.reserve(words.size());
+    for (auto& [verseKey, verseWords] : words) {
+        std::sort(verseWords.begin(), verseWords.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        Verse verse;
+        for (const auto& word : verseWords) verse.arabic += word.second + " ";
+        try {
+            verse.translation = CacheUtils::getTranslationText(config.translationId, verseKey);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Could not load translation for " << verseKey << ": " << e.what() << std::endl;
+        }
+        verses.push_back(std::move(verse));
+    }
+
+    AppConfig cached = config;
+    cached.layoutCache = true;
+    Engine engine(cached);
+    std::atomic<size_t> next_verse{0};
+    std::atomic<size_t> done{0};
+    std::atomic<bool> failed{false};
+    std::mutex log_mutex;
+    auto worker = [&]() {
+        while (!failed) {
+            size_t index = next_verse++;
+            if (index >= verses.size()) return;
+            try {
+                engine.prewarm(verses[index].arabic, verses[index].translation);
+            } catch (...) {
+                failed = true;
+                throw;
+            }
+            size_t finished = ++done;
+            if (finished % 500 == 0 || finished == verses.size()) {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cout << "  Laid out " << finished << "/" << verses.size() << " verses" << std::endl;
+            }
+        }
+    };
+
+    size_t threads = std::min(verses.size(), static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::future<void>> workers;
+    for (size_t i = 0; i < threads; ++i) workers.push_back(std::async(std::launch::async, worker));
+    for (auto& future : workers) future.get();
+
+    engine.saveLayoutCache();
+    return verses.size();
+}
+
+} // namespace TextLayout
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace TextLayout {
+
+// Wrapped text persisted under <cache>/layout, so renders skip shaping for text that was laid
+// out before. Wrapping depends only on the text, the font file, the pixel size and the wrap
+// width. Entries therefore live in one file per font contents and wrap width (a bucket). In a
+// bucket, each text has runs of consecutive pixel sizes that wrap identically, so every size
+// text growth can reach costs a few bytes.
+class LayoutCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+    };
+
+    // Process-wide instance shared by every engine (and by every job of a batch or the daemon).
+    static LayoutCache& shared();
+    static std::filesystem::path directory();  // <cache>/layout
+
+    // Bucket for text wrapped to `wrapWidth` pixels with `fontFile`. The key also covers the
+    // HarfBuzz version and the layout code version. Returns "" (nothing is cached) when the
+    // font cannot be read.
+    std::string bucketKey(const std::string& fontFile, double wrapWidth);
+
+    std::optional<std::string> lookup(const std::string& bucket, const std::string& text, int pixelSize);
+    void store(const std::string& bucket, const std::string& text, int pixelSize, const std::string& wrapped);
+
+    // Writes buckets that gained entries, merged with what other processes saved meanwhile.
+    void save();
+
+    Stats stats() const;
+
+private:
+    struct Bucket {
+        nlohmann::json entries = nlohmann::json::object();
+        bool dirty = false;
+    };
+    struct FontHash {
+        std::uintmax_t size = 0;
+        std::filesystem::file_time_type modified;
+        std::string hash;
+    };
+
+    Bucket& bucketLocked(const std::string& bucket);
+
+    std::mutex mutex_;
+    // Keyed by file path, so a changed cache root gets its own buckets.
+    std::map<std::filesystem::path, Bucket> buckets_;
+    std::map<std::string, FontHash> fontHashes_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stores_{0};
+};
+
+// Lays out every verse of the Quran with `config` (its translation, fonts and resolution) at
+// every font size text growth can reach, then saves the cache. Returns the number of verses.
+size_t prewarmLayoutCache(const AppConfig& config);
+
+} // namespace TextLayout
@@ -1,36 +1,19 @@
 #include "text/text_layout.h"
 
+#include "text/utf8.h"
+
 #include <algorithm>
-#include <filesystem>
 #include <future>
 #include <sstream>
 #include <string>
 #include <vector>
 
-#include <hb-ft.h>
 #include <hb.h>
-#include <ft2build.h>
-#include FT_FREETYPE_H
-
-namespace fs = std::filesystem;
 
 namespace {
 
 int count_words(const std::string& text) {
-    int words = 0;
-    bool inWord = false;
-    for (unsigned char c : text) {
-        if (std::isspace(c)) {
-            if (inWord) {
-                ++words;
-                inWord = false;
-            }
-        } else {
-            inWord = true;
-        }
-    }
-    if (inWord) ++words;
-    return std::max(words, 1);
+    return std::max(static_cast<int>(Utf8::countWords(text)), 1);
 }
 
 int adaptive_font_size_arabic(const std::string& text, int base_size) {
@@ -59,44 +42,83 @@ bool should_grow(int word_count, const AppConfig& config) {
     return config.enableTextGrowth && word_count < config.textGrowthThreshold;
 }
 
-struct FontContext {
-    FT_Library ft;
-    FT_Face face;
-    hb_font_t* hb_font;
+// A font file at one pixel size, measured through the engine's pool.
+struct FontRef {
+    TextLayout::FontPool& pool;
+    const std::string& file;
+    int pixelSize;
 };
 
-FontContext init_font(const fs::path& font_file, int font_size) {
-    FontContext ctx;
-    if (FT_Init_FreeType(&ctx.ft)) throw std::runtime_error("Failed to init FreeType");
-    if (FT_New_Face(ctx.ft, font_file.string().c_str(), 0, &ctx.face)) {
-        FT_Done_FreeType(ctx.ft);
-        throw std::runtime_error("Failed to load font: " + font_file.string());
-    }
-    FT_Set_Char_Size(ctx.face, 0, font_size * 64, 0, 0);
-    ctx.hb_font = hb_ft_font_create(ctx.face, nullptr);
-    return ctx;
+double measure_text_width(const FontRef& font, const std::string& text) {
+    return font.pool.measure(font.file, font.pixelSize, text);
 }
 
-void free_font(FontContext& ctx) {
-    hb_font_destroy(ctx.hb_font);
-    FT_Done_Face(ctx.face);
-    FT_Done_FreeType(ctx.ft);
-}
+// A line shaped once, with the advance accumulated up to every byte offset, so the width of a
+// substring that starts and ends at safe breaks is one subtraction.
+struct ShapedLine {
+    std::vector<double> advanceBefore;  // [b]: advance of the clusters starting before byte b
+    std::vector<bool> safeBreak;        // [b]: shaping both sides of b separately gives the same glyphs
+    hb_script_t script = HB_SCRIPT_INVALID;
 
-double measure_text_width(FontContext& ctx, const std::string& text) {
-    hb_buffer_t* buf = hb_buffer_create();
-    hb_buffer_add_utf8(buf, text.c_str(), -1, 0, -1);
-    hb_buffer_guess_segment_properties(buf);
-    hb_shape(ctx.hb_font, buf, nullptr, 0);
+    double width() const { return advanceBefore.back(); }
+    double width(size_t from, size_t to) const { return advanceBefore[to] - advanceBefore[from]; }
+};
 
+ShapedLine shape_line(const FontRef& font, const std::string& text) {
+    hb_buffer_t* buf = font.pool.shape(font.file, font.pixelSize, text);
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buf, &props);
     unsigned int glyph_count;
+    hb_glyph_info_t* glyph_info = hb_buffer_get_glyph_infos(buf, &glyph_count);
     hb_glyph_position_t* glyph_pos = hb_buffer_get_glyph_positions(buf, &glyph_count);
-    double width = 0.0;
+
+    // Clusters are byte offsets of the text. Contextual forms (Arabic joining, ligatures, kerning)
+    // across a cluster boundary mark its first glyph unsafe to break.
+    enum : char { kNoGlyph, kSafe, kUnsafe };
+    std::vector<double> cluster_advance(text.size() + 1, 0.0);
+    std::vector<char> cluster_break(text.size() + 1, kNoGlyph);
     for (unsigned int i = 0; i < glyph_count; ++i) {
-        width += glyph_pos[i].x_advance / 64.0;
+        size_t cluster = std::min<size_t>(glyph_info[i].cluster, text.size());
+        cluster_advance[cluster] += glyph_pos[i].x_advance / 64.0;
+        if (hb_glyph_info_get_glyph_flags(&glyph_info[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK) {
+            cluster_break[cluster] = kUnsafe;
+        } else if (cluster_break[cluster] == kNoGlyph) {
+            cluster_break[cluster] = kSafe;
+        }
     }
-    hb_buffer_destroy(buf);
-    return width;
+
+    ShapedLine shaped;
+    shaped.script = props.script;
+    shaped.advanceBefore.assign(text.size() + 1, 0.0);
+    shaped.safeBreak.assign(text.size() + 1, false);
+    for (size_t b = 0; b < text.size(); ++b) {
+        shaped.advanceBefore[b + 1] = shaped.advanceBefore[b] + cluster_advance[b];
+        shaped.safeBreak[b] = cluster_break[b] == kSafe;
+    }
+    shaped.safeBreak[0] = true;
+    shaped.safeBreak[text.size()] = true;
+    return shaped;
+}
+
+// The script hb_buffer_guess_segment_properties picks for `text`: that of the first character
+// that is not Common, Inherited or Unknown.
+hb_script_t guess_script(const std::string& text) {
+    hb_unicode_funcs_t* unicode = hb_unicode_funcs_get_default();
+    for (size_t i = 0; i < text.size();) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t length = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        if (i + length > text.size()) break;
+        hb_codepoint_t cp = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t k = 1; k < length; ++k) {
+            cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+        }
+        i += length;
+        hb_script_t script = hb_unicode_script(unicode, cp);
+        if (script != HB_SCRIPT_COMMON && script != HB_SCRIPT_INHERITED && script != HB_SCRIPT_UNKNOWN) {
+            return script;
+        }
+    }
+    return HB_SCRIPT_INVALID;
 }
 
 std::vector<std::string> split_ass_lines(const std::string& text) {
@@ -115,48 +137,71 @@ std::vector<std::string> split_ass_lines(const std::string& text) {
     return lines;
 }
 
-std::string wrap_single_line(const std::string& line, FontContext& ctx, double max_width) {
-    if (line.empty() || measure_text_width(ctx, line) <= max_width) {
-        return line;
-    }
-
+// Greedy word wrap of a line that is wider than max_width. Candidate lines are runs of words
+// joined by single spaces, which are substrings of the whole line joined the same way, so their
+// widths come from one shaping pass instead of reshaping every growing candidate.
+std::string wrap_single_line(const std::string& line, const ShapedLine& shaped_line, const FontRef& font,
+                             double max_width) {
     std::istringstream iss(line);
+    std::vector<std::string> words;
     std::string word;
-    std::string current;
-    std::vector<std::string> wrapped_lines;
-    auto flush_current = [&]() {
-        if (!current.empty()) {
-            wrapped_lines.push_back(current);
-            current.clear();
-        }
-    };
+    while (iss >> word) words.push_back(word);
+    if (words.empty()) return line;
 
-    while (iss >> word) {
-        std::string candidate = current.empty() ? word : current + " " + word;
-        if (measure_text_width(ctx, candidate) <= max_width || current.empty()) {
-            current = candidate;
-        } else {
-            flush_current();
-            current = word;
-        }
+    std::string joined;
+    std::vector<size_t> starts;
+    std::vector<size_t> ends;
+    std::vector<hb_script_t> scripts;
+    for (const auto& w : words) {
+        if (!joined.empty()) joined += ' ';
+        starts.push_back(joined.size());
+        joined += w;
+        ends.push_back(joined.size());
+        scripts.push_back(guess_script(w));
     }
-    flush_current();
+    ShapedLine reshaped;
+    if (joined != line) reshaped = shape_line(font, joined);
+    const ShapedLine& shaped = joined == line ? shaped_line : reshaped;
+
+    // Shaped on its own, a run only matches the slice of the whole line when both of its ends are
+    // safe breaks and it guesses the same script; anything else is measured directly.
+    auto run_width = [&](size_t first, size_t last, hb_script_t script) {
+        size_t from = starts[first];
+        size_t to = ends[last];
+        if (script == shaped.script && shaped.safeBreak[from] && shaped.safeBreak[to]) {
+            return shaped.width(from, to);
+        }
+        return measure_text_width(font, joined.substr(from, to - from));
+    };
 
     std::string rebuilt;
-    for (size_t i = 0; i < wrapped_lines.size(); ++i) {
-        rebuilt += wrapped_lines[i];
-        if (i + 1 < wrapped_lines.size()) rebuilt += "\\N";
+    size_t first = 0;
+    hb_script_t run_script = scripts[0];
+    auto flush_run = [&](size_t last) {
+        if (!rebuilt.empty()) rebuilt += "\\N";
+        rebuilt += joined.substr(starts[first], ends[last] - starts[first]);
+    };
+    for (size_t i = 1; i < words.size(); ++i) {
+        hb_script_t candidate_script = run_script != HB_SCRIPT_INVALID ? run_script : scripts[i];
+        if (run_width(first, i, candidate_script) <= max_width) {
+            run_script = candidate_script;
+            continue;
+        }
+        flush_run(i - 1);
+        first = i;
+        run_script = scripts[i];
     }
-    return rebuilt.empty() ? line : rebuilt;
+    flush_run(words.size() - 1);
+    return rebuilt;
 }
 
-std::string wrap_if_needed(const std::string& text, FontContext& ctx, double max_width) {
+std::string wrap_if_needed(const std::string& text, const FontRef& font, double max_width) {
     auto lines = split_ass_lines(text);
     bool applied = false;
     for (auto& line : lines) {
-        double width = measure_text_width(ctx, line);
-        if (width > max_width) {
-            line = wrap_single_line(line, ctx, max_width);
+        ShapedLine shaped = shape_line(font, line);
+        if (shaped.width() > max_width) {
+            line = wrap_single_line(line, shaped, font, max_width);
             applied = true;
         }
     }
@@ -179,11 +224,52 @@ double clamp_padding(double value) {
 namespace TextLayout {
 
 Engine::Engine(const AppConfig& config)
-    : config_(config) {
+    : config_(config), fonts_(std::make_shared<FontPool>()) {
     paddingPixels_ = config.width * clamp_padding(config.textHorizontalPadding);
     arabicWrapWidth_ = std::max(50.0, (config.width - 2.0 * paddingPixels_) * config.arabicMaxWidthFraction);
     translationWrapWidth_ =
         std::max(50.0, (config.width - 2.0 * paddingPixels_) * config.translationMaxWidthFraction);
+    if (config.layoutCache) {
+        cache_ = &LayoutCache::shared();
+        arabicBucket_ = cache_->bucketKey(config.arabicFont.file, arabicWrapWidth_);
+        translationBucket_ = cache_->bucketKey(config.translationFont.file, translationWrapWidth_);
+    }
+}
+
+std::string Engine::wrap(const std::string& text, const FontConfig& font, int pixelSize, double maxWidth,
+                         const std::string& bucket) const {
+    if (cache_) {
+        if (auto cached = cache_->lookup(bucket, text, pixelSize)) return *cached;
+    }
+    std::string wrapped = wrap_if_needed(text, FontRef{*fonts_, font.file, pixelSize}, maxWidth);
+    if (cache_) cache_->store(bucket, text, pixelSize, wrapped);
+    return wrapped;
+}
+
+void Engine::prewarm(const std::string& arabic, const std::string& translation) const {
+    // Growth scales the base sizes by min(maxGrowthFactor, 1 + duration * growthRateFactor), so
+    // every integer size between the two ends can occur.
+    bool grow = should_grow(count_words(arabic), config_);
+    double lowFactor = grow ? std::min(config_.maxGrowthFactor, 1.0) : 1.0;
+    double highFactor = grow ? std::max(config_.maxGrowthFactor, 1.0) : 1.0;
+    auto sizes = [&](int base) {
+        return std::make_pair(std::max(1, static_cast<int>(base * lowFactor)),
+                              std::max(1, static_cast<int>(base * highFactor)));
+    };
+
+    auto [arabicLow, arabicHigh] = sizes(adaptive_font_size_arabic(arabic, config_.arabicFont.size));
+    for (int size = arabicLow; size <= arabicHigh; ++size) {
+        wrap(arabic, config_.arabicFont, size, arabicWrapWidth_, arabicBucket_);
+    }
+    auto [translationLow, translationHigh] =
+        sizes(adaptive_font_size_translation(translation, config_.translationFont.size));
+    for (int size = translationLow; size <= translationHigh; ++size) {
+        wrap(translation, config_.translationFont, size, translationWrapWidth_, translationBucket_);
+    }
+}
+
+void Engine::saveLayoutCache() const {
+    if (cache_) cache_->save();
 }
 
 LayoutResult Engine::layoutVerse(const VerseData& verse) const {
@@ -196,18 +282,14 @@ LayoutResult Engine::layoutVerse(const VerseData& verse) const {
         : 1.0;
     int maxArabicSize = std::max(1, static_cast<int>(layout.baseArabicSize * layout.arabicGrowthFactor));
 
-    FontContext arabic_ctx = init_font(config_.arabicFont.file, maxArabicSize);
-    layout.wrappedArabic = wrap_if_needed(verse.text, arabic_ctx, arabicWrapWidth_);
-    free_font(arabic_ctx);
+    layout.wrappedArabic = wrap(verse.text, config_.arabicFont, maxArabicSize, arabicWrapWidth_, arabicBucket_);
 
     layout.baseTranslationSize = adaptive_font_size_translation(verse.translation, config_.translationFont.size);
     layout.translationGrowthFactor = layout.growArabic ? layout.arabicGrowthFactor : 1.0;
     int maxTranslationSize =
         std::max(1, static_cast<int>(layout.baseTranslationSize * layout.translationGrowthFactor));
 
-    FontContext translation_ctx = init_font(config_.translationFont.file, maxTranslationSize);
-    layout.wrappedTranslation = wrap_if_needed(verse.translation, translation_ctx, translationWrapWidth_);
-    free_font(translation_ctx);
+    layout.wrappedTranslation = wrap(verse.translation, config_.translationFont, maxTranslationSize, translationWrapWidth_, translationBucket_);
 
     return layout;
 }
@@ -225,18 +307,14 @@ LayoutResult Engine::layoutSegment(const std::string& arabic,
         : 1.0;
     int maxArabicSize = std::max(1, static_cast<int>(layout.baseArabicSize * layout.arabicGrowthFactor));
 
-    FontContext arabic_ctx = init_font(config_.arabicFont.file, maxArabicSize);
-    layout.wrappedArabic = wrap_if_needed(arabic, arabic_ctx, arabicWrapWidth_);
-    free_font(arabic_ctx);
+    layout.wrappedArabic = wrap(arabic, config_.arabicFont, maxArabicSize, arabicWrapWidth_, arabicBucket_);
 
     layout.baseTranslationSize = adaptive_font_size_translation(translation, config_.translationFont.size);
     layout.translationGrowthFactor = layout.growArabic ? layout.arabicGrowthFactor : 1.0;
     int maxTranslationSize =
         std::max(1, static_cast<int>(layout.baseTranslationSize * layout.translationGrowthFactor));
 
-    FontContext translation_ctx = init_font(config_.translationFont.file, maxTranslationSize);
-    layout.wrappedTranslation = wrap_if_needed(translation, translation_ctx, translationWrapWidth_);
-    free_font(translation_ctx);
+    layout.wrappedTranslation = wrap(translation, config_.translationFont, maxTranslationSize, translationWrapWidth_, translationBucket_);
 
     return layout;
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "text/font_pool.h"
+#include "text/layout_cache.h"
 #include "types.h"
+#include <memory>
 #include <string>
 
 namespace TextLayout {
@@ -25,9 +28,24 @@ public:
     double paddingPixels() const { return paddingPixels_; }
     double arabicWrapWidth() const { return arabicWrapWidth_; }
     double translationWrapWidth() const { return translationWrapWidth_; }
+    // Reuse counters of the engine's FreeType/HarfBuzz contexts.
+    FontPool::Stats fontStats() const { return fonts_->stats(); }
+
+    // Wraps `arabic` and `translation` at every font size text growth can reach for them, so
+    // later layouts of this text are served from the layout cache whatever the verse duration.
+    void prewarm(const std::string& arabic, const std::string& translation) const;
+    // Persists text wrapped since the cache was loaded (no-op when config.layoutCache is off).
+    void saveLayoutCache() const;
 
 private:
+    std::string wrap(const std::string& text, const FontConfig& font, int pixelSize, double maxWidth,
+                     const std::string& bucket) const;
+
     const AppConfig& config_;
+    std::shared_ptr<FontPool> fonts_;
+    LayoutCache* cache_ = nullptr;
+    std::string arabicBucket_;
+    std::string translationBucket_;
     double paddingPixels_;
     double arabicWrapWidth_;
     double translationWrapWidth_;
@@ -0,0 +1,387 @@
+#include "text/utf8.h"
+
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QVM_UTF8_SSE2 1
+#include <emmintrin.h>
+// AVX2 kernels are compiled per function (target attribute) and picked at run time.
+#if defined(__GNUC__) || defined(__clang__)
+#define QVM_UTF8_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+using Utf8::Kernel;
+
+enum class ByteClass {
+    NonAscii,         // >= 0x80
+    BasicLatin,       // printable ASCII, 0x20-0x7E
+    Space,            // ' ', \t, \n, \v, \f, \r
+    ArabicLead,       // bytes that can start an Arabic-block sequence (also malformed ones)
+    ArabicDigitLead,  // 0xD9, lead of U+0640-067F (Arabic-Indic digits included)
+};
+
+template <ByteClass C>
+bool in_class(unsigned char c) {
+    switch (C) {
+    case ByteClass::NonAscii: return c >= 0x80;
+    case ByteClass::BasicLatin: return c >= 0x20 && c <= 0x7E;
+    case ByteClass::Space: return c == ' ' || (c >= 0x09 && c <= 0x0D);
+    case ByteClass::ArabicLead: return (c >= 0xD8 && c <= 0xDB) || c == 0xDD || c == 0xE0 || c == 0xF0;
+    case ByteClass::ArabicDigitLead: return c == 0xD9;
+    }
+    return false;
+}
+
+unsigned trailing_zeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+size_t popcount(uint32_t mask) {
+    return std::bitset<32>(mask).count();
+}
+
+// Index of the first byte in [from, size) whose membership in C equals Member, or size.
+template <ByteClass C, bool Member>
+size_t find_scalar(const unsigned char* p, size_t from, size_t size) {
+    for (size_t i = from; i < size; ++i) {
+        if (in_class<C>(p[i]) == Member) return i;
+    }
+    return size;
+}
+
+size_t count_words_scalar(const unsigned char* p, size_t from, size_t size, bool in_word) {
+    size_t words = 0;
+    for (size_t i = from; i < size; ++i) {
+        if (in_class<ByteClass::Space>(p[i])) {
+            in_word = false;
+        } else {
+            if (!in_word) ++words;
+            in_word = true;
+        }
+    }
+    return words;
+}
+
+#ifdef QVM_UTF8_SSE2
+
+inline __m128i splat(unsigned char c) {
+    return _mm_set1_epi8(static_cast<char>(c));
+}
+
+// One bit per byte of `v`, set when the byte is in C. Signed compares are fine for the ASCII
+// classes: bytes >= 0x80 are negative and fall outside every ASCII range.
+template <ByteClass C>
+uint32_t class_mask_sse2(__m128i v) {
+    __m128i m;
+    switch (C) {
+    case ByteClass::NonAscii:
+        return static_cast<uint32_t>(_mm_movemask_epi8(v));
+    case ByteClass::BasicLatin:
+        m = _mm_and_si128(_mm_cmpgt_epi8(v, splat(0x1F)), _mm_cmplt_epi8(v, splat(0x7F)));
+        break;
+    case ByteClass::Space:
+        m = _mm_or_si128(_mm_cmpeq_epi8(v, splat(' ')),
+                         _mm_and_si128(_mm_cmpgt_epi8(v, splat(0x08)), _mm_cmplt_epi8(v, splat(0x0E))));
+        break;
+    case ByteClass::ArabicLead: {
+        __m128i offset = _mm_sub_epi8(v, splat(0xD8));
+        m = _mm_cmpeq_epi8(_mm_min_epu8(offset, splat(3)), offset);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, splat(0xDD)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, splat(0xE0)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, splat(0xF0)));
+        break;
+    }
+    case ByteClass::ArabicDigitLead:
+        m = _mm_cmpeq_epi8(v, splat(0xD9));
+        break;
+    }
+    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+}
+
+template <ByteClass C, bool Member>
+size_t find_sse2(const unsigned char* p, size_t from, size_t size) {
+    size_t i = from;
+    for (; i + 16 <= size; i += 16) {
+        uint32_t mask = class_mask_sse2<C>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        if (!Member) mask = ~mask & 0xFFFFu;
+        if (mask) return i + trailing_zeros(mask);
+    }
+    return find_scalar<C, Member>(p, i, size);
+}
+
+// A word starts at every non-space byte whose predecessor is a space (or the start).
+size_t count_words_sse2(const unsigned char* p, size_t size) {
+    size_t words = 0;
+    uint32_t previous = 0;  // 1 when the byte before the block is part of a word
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint32_t space = class_mask_sse2<ByteClass::Space>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+        uint32_t word = ~space & 0xFFFFu;
+        words += popcount(word & ~((word << 1) | previous));
+        previous = (word >> 15) & 1u;
+    }
+    return words + count_words_scalar(p, i, size, previous != 0);
+}
+
+#endif
+
+#ifdef QVM_UTF8_AVX2
+
+__attribute__((target("avx2"))) inline __m256i splat256(unsigned char c) {
+    return _mm256_set1_epi8(static_cast<char>(c));
+}
+
+template <ByteClass C>
+__attribute__((target("avx2"))) uint32_t class_mask_avx2(__m256i v) {
+    __m256i m;
+    switch (C) {
+    case ByteClass::NonAscii:
+        return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    case ByteClass::BasicLatin:
+        m = _mm256_and_si256(_mm256_cmpgt_epi8(v, splat256(0x1F)), _mm256_cmpgt_epi8(splat256(0x7F), v));
+        break;
+    case ByteClass::Space:
+        m = _mm256_or_si256(_mm256_cmpeq_epi8(v, splat256(' ')),
+                            _mm256_and_si256(_mm256_cmpgt_epi8(v, splat256(0x08)),
+                                             _mm256_cmpgt_epi8(splat256(0x0E), v)));
+        break;
+    case ByteClass::ArabicLead: {
+        __m256i offset = _mm256_sub_epi8(v, splat256(0xD8));
+        m = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, splat256(3)), offset);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, splat256(0xDD)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, splat256(0xE0)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, splat256(0xF0)));
+        break;
+    }
+    case ByteClass::ArabicDigitLead:
+        m = _mm256_cmpeq_epi8(v, splat256(0xD9));
+        break;
+    }
+    return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+template <ByteClass C, bool Member>
+__attribute__((target("avx2"))) size_t find_avx2(const unsigned char* p, size_t from, size_t size) {
+    size_t i = from;
+    for (; i + 32 <= size; i += 32) {
+        uint32_t mask = class_mask_avx2<C>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+        if (!Member) mask = ~mask;
+        if (mask) return i + trailing_zeros(mask);
+    }
+    return find_sse2<C, Member>(p, i, size);
+}
+
+__attribute__((target("avx2"))) size_t count_words_avx2(const unsigned char* p, size_t size) {
+    size_t words = 0;
+    uint32_t previous = 0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint32_t space =
+            class_mask_avx2<ByteClass::Space>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+        uint32_t word = ~space;
+        words += popcount(word & ~((word << 1) | previous));
+        previous = word >> 31;
+    }
+    return words + count_words_scalar(p, i, size, previous != 0);
+}
+
+#endif
+
+Kernel detect_kernel() {
+#ifdef QVM_UTF8_AVX2
+    if (__builtin_cpu_supports("avx2")) return Kernel::Avx2;
+#endif
+#ifdef QVM_UTF8_SSE2
+    return Kernel::Sse2;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const Kernel best_kernel = detect_kernel();
+std::atomic<Kernel> active_kernel{best_kernel};
+
+const unsigned char* bytes(const std::string& text) {
+    return reinterpret_cast<const unsigned char*>(text.data());
+}
+
+template <ByteClass C, bool Member>
+size_t find(const std::string& text, size_t from) {
+    if (from >= text.size()) return text.size();
+    switch (active_kernel.load(std::memory_order_relaxed)) {
+#ifdef QVM_UTF8_AVX2
+    case Kernel::Avx2:
+        return find_avx2<C, Member>(bytes(text), from, text.size());
+#endif
+#ifdef QVM_UTF8_SSE2
+    case Kernel::Sse2:
+        return find_sse2<C, Member>(bytes(text), from, text.size());
+#endif
+    default:
+        return find_scalar<C, Member>(bytes(text), from, text.size());
+    }
+}
+
+// Length of the sequence at `i`, or 1 when it would run past the end of the text.
+size_t unit_length(const std::string& text, size_t i) {
+    size_t length = Utf8::sequenceLength(static_cast<unsigned char>(text[i]));
+    return i + length <= text.size() ? length : 1;
+}
+
+bool is_space(unsigned char c) {
+    return std::isspace(c) != 0;
+}
+
+} // namespace
+
+namespace Utf8 {
+
+Kernel bestKernel() {
+    return best_kernel;
+}
+
+Kernel activeKernel() {
+    return active_kernel.load(std::memory_order_relaxed);
+}
+
+void useKernel(Kernel kernel) {
+    active_kernel = static_cast<int>(kernel) <= static_cast<int>(best_kernel) ? kernel : best_kernel;
+}
+
+const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Sse2: return "sse2";
+    case Kernel::Scalar: return "scalar";
+    }
+    return "scalar";
+}
+
+size_t sequenceLength(unsigned char lead) {
+    if ((lead & 0xF8) == 0xF0) return 4;
+    if ((lead & 0xF0) == 0xE0) return 3;
+    if ((lead & 0xE0) == 0xC0) return 2;
+    return 1;
+}
+
+size_t asciiRunLength(const std::string& text, size_t from) {
+    if (from >= text.size()) return 0;
+    return find<ByteClass::NonAscii, true>(text, from) - from;
+}
+
+size_t basicLatinRunLength(const std::string& text, size_t from) {
+    if (from >= text.size()) return 0;
+    return find<ByteClass::BasicLatin, false>(text, from) - from;
+}
+
+bool containsBasicLatin(const std::string& text) {
+    return find<ByteClass::BasicLatin, true>(text, 0) < text.size();
+}
+
+bool containsArabic(const std::string& text) {
+    // Without a byte that can lead an Arabic-block sequence there is nothing to decode.
+    if (find<ByteClass::ArabicLead, true>(text, 0) == text.size()) return false;
+
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            i += asciiRunLength(text, i);
+            continue;
+        }
+        size_t length = unit_length(text, i);
+        unsigned int codepoint = c;
+        if (length > 1) {
+            codepoint = c & (0x7F >> length);
+            for (size_t k = 1; k < length; ++k) {
+                codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+            }
+        }
+        if ((codepoint >= 0x0600 && codepoint <= 0x06FF) ||
+            (codepoint >= 0x0750 && codepoint <= 0x077F) ||
+            (codepoint >= 0x08A0 && codepoint <= 0x08FF)) {
+            return true;
+        }
+        i += length;
+    }
+    return false;
+}
+
+size_t countWords(const std::string& text) {
+    switch (activeKernel()) {
+#ifdef QVM_UTF8_AVX2
+    case Kernel::Avx2:
+        return count_words_avx2(bytes(text), text.size());
+#endif
+#ifdef QVM_UTF8_SSE2
+    case Kernel::Sse2:
+        return count_words_sse2(bytes(text), text.size());
+#endif
+    default:
+        return count_words_scalar(bytes(text), 0, text.size(), false);
+    }
+}
+
+std::string arabicDigitsToAscii(const std::string& text) {
+    if (find<ByteClass::ArabicDigitLead, true>(text, 0) == text.size()) return text;
+
+    std::string converted;
+    converted.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            size_t run = asciiRunLength(text, i);
+            converted.append(text, i, run);
+            i += run;
+            continue;
+        }
+        size_t length = unit_length(text, i);
+        unsigned char next = length == 2 ? static_cast<unsigned char>(text[i + 1]) : 0;
+        if (c == 0xD9 && next >= 0xA0 && next <= 0xA9) {
+            converted.push_back(static_cast<char>('0' + (next - 0xA0)));
+        } else {
+            converted.append(text, i, length);
+        }
+        i += length;
+    }
+    return converted;
+}
+
+void popBack(std::string& text) {
+    if (text.empty()) return;
+    size_t i = text.size() - 1;
+    while (i > 0 && (text[i] & 0xC0) == 0x80) {
+        --i;
+    }
+    text.erase(i);
+}
+
+void dropLastWord(std::string& text) {
+    while (!text.empty() && is_space(static_cast<unsigned char>(text.back()))) {
+        text.pop_back();
+    }
+    while (!text.empty() && !is_space(static_cast<unsigned char>(text.back()))) {
+        popBack(text);
+    }
+    while (!text.empty() && is_space(static_cast<unsigned char>(text.back()))) {
+        text.pop_back();
+    }
+}
+
+} // namespace Utf8
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// UTF-8 scanning shared by the text paths (subtitles, timing files, layout, verse text). The
+// byte-class scans run 32 bytes at a time with AVX2 or 16 with SSE2 when the CPU has them,
+// and byte by byte otherwise. Every kernel gives the same result; malformed sequences are
+// handled the way the byte loops they replaced handled them.
+namespace Utf8 {
+
+enum class Kernel { Scalar, Sse2, Avx2 };
+
+// Widest kernel this build and CPU support; the one in use unless useKernel() picked another.
+Kernel bestKernel();
+Kernel activeKernel();
+// Switches every scan to `kernel`, capped at bestKernel() (benchmarks and tests).
+void useKernel(Kernel kernel);
+const char* kernelName(Kernel kernel);
+
+// Bytes of a sequence starting with `lead`: 2-4 for multi-byte leads, else 1.
+size_t sequenceLength(unsigned char lead);
+
+// Length of the run of ASCII bytes (< 0x80) starting at `from`.
+size_t asciiRunLength(const std::string& text, size_t from = 0);
+// Length of the run of printable Basic Latin bytes (0x20-0x7E) starting at `from`.
+size_t basicLatinRunLength(const std::string& text, size_t from = 0);
+bool containsBasicLatin(const std::string& text);
+
+// True when `text` has a letter from the Arabic, Arabic Supplement or Arabic Extended-A
+// blocks (U+0600-06FF, U+0750-077F, U+08A0-08FF).
+bool containsArabic(const std::string& text);
+
+// Runs of bytes separated by ASCII whitespace (space, \t, \n, \v, \f, \r).
+size_t countWords(const std::string& text);
+
+// Replaces Arabic-Indic digits (U+0660-0669) with '0'-'9'.
+std::string arabicDigitsToAscii(const std::string& text);
+
+// Removes the last code point.
+void popBack(std::string& text);
+// Removes trailing whitespace, the last word, and the whitespace before it.
+void dropLastWord(std::string& text);
+
+} // namespace Utf8
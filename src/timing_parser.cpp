@@ -1,4 +1,5 @@
 #include "timing_parser.h"
+#include "text/utf8.h"
 #include <fstream>
 #include <sstream>
 #include <regex>
@@ -10,11 +11,6 @@
 #include <map>
 
 namespace {
-const std::map<std::string, char> kArabicDigits = {
-    {"٠", '0'}, {"١", '1'}, {"٢", '2'}, {"٣", '3'}, {"٤", '4'},
-    {"٥", '5'}, {"٦", '6'}, {"٧", '7'}, {"٨", '8'}, {"٩", '9'}
-};
-
 std::string strip_carriage_return(std::string line) {
     if (!line.empty() && line.back() == '\r') {
         line.pop_back();
@@ -22,82 +18,6 @@ std::string strip_carriage_return(std::string line) {
     return line;
 }
 
-bool contains_arabic_letters(const std::string& text) {
-    for (size_t i = 0; i < text.size();) {
-        unsigned char c = static_cast<unsigned char>(text[i]);
-        size_t advance = 1;
-        unsigned int codepoint = c;
-        if ((c & 0x80) == 0) {
-            advance = 1;
-        } else if ((c & 0xE0) == 0xC0 && i + 1 < text.size()) {
-            advance = 2;
-            codepoint = ((c & 0x1F) << 6) | (static_cast<unsigned char>(text[i+1]) & 0x3F);
-        } else if ((c & 0xF0) == 0xE0 && i + 2 < text.size()) {
-            advance = 3;
-            codepoint = ((c & 0x0F) << 12) |
-                        ((static_cast<unsigned char>(text[i+1]) & 0x3F) << 6) |
-                        (static_cast<unsigned char>(text[i+2]) & 0x3F);
-        } else if ((c & 0xF8) == 0xF0 && i + 3 < text.size()) {
-            advance = 4;
-            codepoint = ((c & 0x07) << 18) |
-                        ((static_cast<unsigned char>(text[i+1]) & 0x3F) << 12) |
-                        ((static_cast<unsigned char>(text[i+2]) & 0x3F) << 6) |
-                        (static_cast<unsigned char>(text[i+3]) & 0x3F);
-        }
-
-        if ((codepoint >= 0x0600 && codepoint <= 0x06FF) ||
-            (codepoint >= 0x0750 && codepoint <= 0x077F) ||
-            (codepoint >= 0x08A0 && codepoint <= 0x08FF)) {
-            return true;
-        }
-        i += advance;
-    }
-    return false;
-}
-
-std::string convert_arabic_digits_to_ascii(const std::string& text) {
-    std::string converted;
-    converted.reserve(text.size());
-    for (size_t i = 0; i < text.size();) {
-        unsigned char c = static_cast<unsigned char>(text[i]);
-        size_t advance = 1;
-        if ((c & 0x80) == 0) {
-            converted.push_back(static_cast<char>(c));
-        } else if ((c & 0xE0) == 0xC0 && i + 1 < text.size()) {
-            advance = 2;
-            std::string utf8_char = text.substr(i, advance);
-            auto it = kArabicDigits.find(utf8_char);
-            if (it != kArabicDigits.end()) {
-                converted.push_back(it->second);
-            } else {
-                converted.append(utf8_char);
-            }
-        } else if ((c & 0xF0) == 0xE0 && i + 2 < text.size()) {
-            advance = 3;
-            std::string utf8_char = text.substr(i, advance);
-            auto it = kArabicDigits.find(utf8_char);
-            if (it != kArabicDigits.end()) {
-                converted.push_back(it->second);
-            } else {
-                converted.append(utf8_char);
-            }
-        } else if ((c & 0xF8) == 0xF0 && i + 3 < text.size()) {
-            advance = 4;
-            std::string utf8_char = text.substr(i, advance);
-            auto it = kArabicDigits.find(utf8_char);
-            if (it != kArabicDigits.end()) {
-                converted.push_back(it->second);
-            } else {
-                converted.append(utf8_char);
-            }
-        } else {
-            converted.push_back(static_cast<char>(c));
-        }
-        i += advance;
-    }
-    return converted;
-}
-
 bool contains_bismillah_phrase(const std::string& text) {
     if (text.empty()) return false;
     static const std::vector<std::string> markers = {
@@ -121,7 +41,7 @@ bool contains_bismillah_phrase(const std::string& text) {
 }
 
 std::optional<std::string> extract_explicit_verse_key(const std::string& line) {
-    std::string converted = convert_arabic_digits_to_ascii(line);
+    std::string converted = Utf8::arabicDigitsToAscii(line);
     static const std::regex ref_regex(R"((\d+)\s*[:：]\s*(\d+))");
     std::smatch match;
     if (std::regex_search(converted, match, ref_regex)) {
@@ -131,7 +51,7 @@ std::optional<std::string> extract_explicit_verse_key(const std::string& line) {
 }
 
 std::optional<int> extract_verse_number(const std::string& line) {
-    std::string converted = convert_arabic_digits_to_ascii(line);
+    std::string converted = Utf8::arabicDigitsToAscii(line);
     static const std::regex number_regex(R"((\d+))");
     std::smatch match;
     if (std::regex_search(converted, match, number_regex)) {
@@ -231,7 +151,7 @@ TimingParseResult parseTimingFile(const std::string& filepath) {
                     verseNumber = extract_verse_number(payloadLine);
                 }
 
-                if (arabicText.empty() && contains_arabic_letters(payloadLine)) {
+                if (arabicText.empty() && Utf8::containsArabic(payloadLine)) {
                     arabicText = payloadLine;
                 } else if (arabicText.empty()) {
                     arabicText = payloadLine;
@@ -0,0 +1,130 @@
+#include "tracing.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+thread_local std::shared_ptr<Tracing::Session> current_session;
+thread_local int current_depth = 0;
+
+// Shared by every session so traces of concurrent jobs line up on one timeline.
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+long long micros_since_epoch(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - trace_epoch).count();
+}
+
+} // namespace
+
+namespace Tracing {
+
+void Session::record(Event event, std::thread::id thread) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = threadIds_.find(thread);
+    if (it == threadIds_.end()) it = threadIds_.emplace(thread, static_cast<int>(threadIds_.size()) + 1).first;
+    event.threadId = it->second;
+    events_.push_back(std::move(event));
+}
+
+std::vector<Event> Session::events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+}
+
+nlohmann::json Session::toChromeTrace() const {
+    nlohmann::json trace_events = nlohmann::json::array();
+    for (const auto& event : events()) {
+        trace_events.push_back({
+            {"name", event.name},
+            {"cat", event.category},
+            {"ph", "X"},
+            {"ts", event.startMicros},
+            {"dur", event.durationMicros},
+            {"pid", 1},
+            {"tid", event.threadId},
+            {"args", {{"depth", event.depth}, {"cpuSeconds", event.cpuSeconds}}}
+        });
+    }
+    return {{"traceEvents", trace_events}, {"displayTimeUnit", "ms"}};
+}
+
+nlohmann::json Session::summary() const {
+    nlohmann::json spans = nlohmann::json::object();
+    long long first = -1;
+    long long last = 0;
+    for (const auto& event : events()) {
+        auto& entry = spans[event.name];
+        if (entry.is_null()) {
+            entry = {{"category", event.category}, {"count", 0}, {"totalSeconds", 0.0}, {"cpuSeconds", 0.0}};
+        }
+        entry["count"] = entry["count"].get<int>() + 1;
+        entry["totalSeconds"] = entry["totalSeconds"].get<double>() + event.durationMicros / 1e6;
+        if (event.cpuSeconds >= 0.0) entry["cpuSeconds"] = entry["cpuSeconds"].get<double>() + event.cpuSeconds;
+        if (first < 0 || event.startMicros < first) first = event.startMicros;
+        last = std::max(last, event.startMicros + event.durationMicros);
+    }
+    return {{"wallSeconds", first < 0 ? 0.0 : (last - first) / 1e6}, {"spans", spans}};
+}
+
+void Session::writeChromeTrace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) throw std::runtime_error("Failed to write trace file: " + path);
+    out << toChromeTrace().dump() << std::endl;
+}
+
+std::shared_ptr<Session> currentSession() {
+    return current_session;
+}
+
+double processCpuSeconds() {
+#ifndef _WIN32
+    double seconds = 0.0;
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN}) {
+        rusage usage{};
+        if (getrusage(who, &usage) != 0) return -1.0;
+        seconds += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                   usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    }
+    return seconds;
+#else
+    return -1.0;
+#endif
+}
+
+ScopedSession::ScopedSession(std::shared_ptr<Session> session) : previous_(std::move(current_session)) {
+    current_session = std::move(session);
+}
+
+ScopedSession::~ScopedSession() {
+    current_session = std::move(previous_);
+}
+
+Span::Span(std::string name, const char* category)
+    : session_(current_session), name_(std::move(name)), category_(category) {
+    if (!session_) return;
+    depth_ = current_depth++;
+    cpuStart_ = processCpuSeconds();
+    start_ = std::chrono::steady_clock::now();
+}
+
+Span::~Span() {
+    if (!session_) return;
+    auto end = std::chrono::steady_clock::now();
+    --current_depth;
+    Event event;
+    event.name = std::move(name_);
+    event.category = category_;
+    event.startMicros = micros_since_epoch(start_);
+    event.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - start_).count();
+    event.depth = depth_;
+    double cpu_end = processCpuSeconds();
+    if (cpuStart_ >= 0.0 && cpu_end >= 0.0) event.cpuSeconds = cpu_end - cpuStart_;
+    session_->record(std::move(event), std::this_thread::get_id());
+}
+
+} // namespace Tracing
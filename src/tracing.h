@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Scoped timing spans for finding where a render spends its time.
+namespace Tracing {
+
+struct Event {
+    std::string name;
+    std::string category;
+    long long startMicros = 0;     // since the process-wide trace epoch
+    long long durationMicros = 0;
+    int threadId = 0;              // per-session id in order of first use (1 = first thread)
+    int depth = 0;                 // nesting level of the span on its thread
+    // CPU time of the whole process plus reaped child processes (ffmpeg) during the span;
+    // concurrent work is included. -1 when the platform does not report it.
+    double cpuSeconds = -1.0;
+};
+
+// The spans of one render job. Thread safe.
+class Session {
+public:
+    void record(Event event, std::thread::id thread);
+    std::vector<Event> events() const;
+
+    // Chrome trace_event format (complete "X" events), for chrome://tracing or Perfetto.
+    nlohmann::json toChromeTrace() const;
+    // Total seconds, CPU seconds and count per span name, for the metadata sidecar.
+    nlohmann::json summary() const;
+    // Throws std::runtime_error when the file cannot be written.
+    void writeChromeTrace(const std::string& path) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    std::map<std::thread::id, int> threadIds_;
+};
+
+std::shared_ptr<Session> currentSession();
+
+// User + system CPU seconds of this process and its reaped children; -1 when unavailable.
+double processCpuSeconds();
+
+// Records spans opened on the current thread into `session` for the lifetime of the guard.
+// Worker threads adopt their parent's session with ScopedSession(Tracing::currentSession()).
+class ScopedSession {
+public:
+    explicit ScopedSession(std::shared_ptr<Session> session);
+    ~ScopedSession();
+    ScopedSession(const ScopedSession&) = delete;
+    ScopedSession& operator=(const ScopedSession&) = delete;
+
+private:
+    std::shared_ptr<Session> previous_;
+};
+
+// Times its own lifetime as one event of the current session; does nothing without a session.
+class Span {
+public:
+    explicit Span(std::string name, const char* category = "render");
+    ~Span();
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    std::shared_ptr<Session> session_;
+    std::string name_;
+    const char* category_;
+    std::chrono::steady_clock::time_point start_;
+    double cpuStart_ = -1.0;
+    int depth_ = 0;
+};
+
+} // namespace Tracing
@@ -27,6 +27,17 @@ struct VideoSelectionConfig {
     std::string localVideoDirectory = "";  // Path to local video directory
 };
 
+// Measured preset/CRF selection (autoQuality in config.json, --auto-quality).
+struct AutoQualityConfig {
+    bool enabled = false;
+    std::string metric = "ssim";     // "ssim" (0-1) or "psnr" (dB)
+    double minScore = 0.985;         // quality floor every sample window must reach
+    std::vector<std::string> presets = {"ultrafast", "superfast", "veryfast", "faster", "fast", "medium"};
+    std::vector<int> crfs = {28, 25, 22, 19};
+    int samples = 3;                 // windows spread over the job
+    double sampleSeconds = 2.0;
+};
+
 struct AppConfig {
     // Video dimensions
     int width;
@@ -48,6 +59,7 @@ struct AppConfig {
     std::string overlayColor;
     std::string assetFolderPath;
     std::string assetBgVideo;
+    bool useBackgroundPlateCache = false;  // reuse pre-scaled, pre-overlaid backgrounds
     
     // Data paths
     std::string quranWordByWordPath;
@@ -62,6 +74,9 @@ struct AppConfig {
     int textGrowthThreshold;        // word count threshold for growth
     double maxGrowthFactor;         // maximum text growth multiplier
     double growthRateFactor;        // growth rate per second
+
+    // Text layout
+    bool layoutCache = true;        // reuse wrapped text from <cache>/layout (off with --no-cache)
     
     // Fade parameters
     double fadeDurationFactor;      // fraction of verse duration
@@ -89,6 +104,7 @@ struct AppConfig {
     std::string videoBitrate;
     std::string videoMaxRate;
     std::string videoBufSize;
+    AutoQualityConfig autoQuality;
 
     // R2 dynamic video selection configuration
     VideoSelectionConfig videoSelection;
@@ -121,6 +137,15 @@ struct VerseData {
     std::string sourceAudioPath;
 };
 
+// An extra output encoded from the same decode pass as the main video.
+struct Rendition {
+    std::string name;             // suffix for the default output path ("720p", "vertical")
+    int width = 0;
+    int height = 0;
+    std::string qualityProfile;   // entry in qualityProfiles; empty = same as the main output
+    std::string output;           // empty = <output stem>-<name><ext>
+};
+
 struct CLIOptions {
     int surah;
     int from;
@@ -139,6 +164,22 @@ struct CLIOptions {
     bool clearCache = false;
     std::string preset = "fast";
     std::string encoder = "software";
+    std::string renderEngine = "ffmpeg";  // "ffmpeg" (CLI) or "libav" (in-process)
+    int renderChunks = 1;                 // parallel encode chunks (0 = auto, 1 = single pass)
+    int encoderThreads = 0;               // encoder threads per encode (0 = auto from cores and load)
+    bool plateCache = false;              // force the background plate cache on
+    bool staticBackground = false;        // treat the background as a still (first frame only)
+    bool variableFrameRate = false;       // with a still background, encode only frames that change
+    bool incremental = false;             // keep content-keyed segments and re-encode only changed ones
+    std::vector<Rendition> renditions;    // extra outputs sharing the decode pass (--rendition)
+    std::string streamFormat = "";        // "hls" or "dash" segmented output; empty = MP4
+    std::string tracePath = "";           // Chrome trace_event JSON written after the render (--trace)
+    bool draft = false;                   // low-res, low-fps preview plus a per-verse contact sheet
+    bool tmpfsWorkspace = false;          // keep the job's intermediates in /dev/shm when available
+    bool jobOutputNames = false;          // batch/daemon job: per-job default output and thumbnail names
+    bool autoQuality = false;             // pick preset/CRF by measuring sample encodes (--auto-quality)
+    double qualityFloor = -1.0;           // overrides autoQuality.minScore when >= 0
+    std::string backgroundTheme = "";     // --bg-theme override (space, nature, ...)
     std::string recitationMode = "";  // "gapped" or "gapless"
     bool presetProvided = false;
     bool emitProgress = false;
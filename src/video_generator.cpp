@@ -4,6 +4,17 @@
 #include "quran_data.h"
 #include "audio/custom_audio_processor.h"
 #include "interfaces/IProcessExecutor.h"
+#include "render/render_plan.h"
+#include "render/plan_runner.h"
+#include "cache_utils.h"
+#include "background_plate_cache.h"
+#include "progress.h"
+#include "encoder_tuning.h"
+#include "metadata_writer.h"
+#include "audio_track_cache.h"
+#include "tracing.h"
+#include "render_workspace.h"
+#include "clip_index.h"
 #include <chrono>
 #include <cstdio>
 #include <iostream>
@@ -15,8 +26,14 @@
 #include <fstream>
 #include <iomanip>
 #include <limits>
+#include <map>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
 #include "subtitle_builder.h"
 #include "localization_utils.h"
 
@@ -26,32 +43,6 @@ extern "C" {
 
 namespace fs = std::filesystem;
 
-namespace {
-    void emitProgressEvent(const std::string& stage,
-                       const std::string& status,
-                       double percent = -1.0,
-                       double elapsedSeconds = -1.0,
-                       double etaSeconds = -1.0,
-                       const std::string& message = "") {
-    std::ostringstream oss;
-    oss.setf(std::ios::fixed);
-    oss << std::setprecision(2);
-    oss << "PROGRESS {\"stage\":\"" << stage << "\",\"status\":\"" << status << "\"";
-    if (percent >= 0.0) oss << ",\"percent\":" << percent;
-    if (elapsedSeconds >= 0.0) oss << ",\"elapsedSeconds\":" << elapsedSeconds;
-    if (etaSeconds >= 0.0) oss << ",\"etaSeconds\":" << etaSeconds;
-    if (!message.empty()) oss << ",\"message\":\"" << message << "\"";
-    oss << "}";
-    std::cout << oss.str() << std::endl;
-}
-
-void emitStageMessage(const std::string& stage,
-                      const std::string& status,
-                      const std::string& message) {
-    emitProgressEvent(stage, status, -1.0, -1.0, -1.0, message);
-}
-}
-
 // Normalize paths for ffmpeg arguments.
 static std::string to_ffmpeg_path(const fs::path& p) {
     return p.generic_string(); // forward slashes are accepted on all platforms
@@ -78,12 +69,849 @@ static std::string to_ffmpeg_filter_path(const fs::path& p) {
 #endif
 }
 
-void VideoGenerator::generateVideo(const CLIOptions& options, 
+// Per-output scratch file in the job's workspace (renditions of one job share it).
+static fs::path job_temp_path(const CLIOptions& options, const std::string& name) {
+    return scratchFile(CacheUtils::hashString(options.output).substr(0, 8) + "-" + name);
+}
+
+// Encoder options shared by every render of the main video.
+static Render::OptionList build_video_codec_options(const CLIOptions& options, const AppConfig& config) {
+    Render::OptionList codec;
+    auto add_rate_control = [&]() {
+        if (!config.videoMaxRate.empty()) codec.emplace_back("maxrate", config.videoMaxRate);
+        if (!config.videoBufSize.empty()) codec.emplace_back("bufsize", config.videoBufSize);
+    };
+    auto add_libx264 = [&]() {
+        codec.emplace_back("c:v", "libx264");
+        codec.emplace_back("preset", options.preset);
+        codec.emplace_back("crf", std::to_string(config.crf));
+        if (!config.videoBitrate.empty()) codec.emplace_back("b:v", config.videoBitrate);
+        add_rate_control();
+    };
+
+    if (options.encoder == "hardware") {
+        #if defined(__APPLE__)
+            codec.emplace_back("c:v", "h264_videotoolbox");
+            codec.emplace_back("b:v", !config.videoBitrate.empty() ? config.videoBitrate : "3500k");
+            add_rate_control();
+            codec.emplace_back("allow_sw", "1");
+            std::cout << "Using hardware encoder: h264_videotoolbox" << std::endl;
+        #else
+            add_libx264();
+        #endif
+    } else {
+        add_libx264();
+        std::cout << "Using software encoder: libx264 ('" << options.preset << "')" << std::endl;
+    }
+    return codec;
+}
+
+// x264 tuning for a background that never moves, plus passing dropped-frame timestamps through.
+static void add_still_background_options(Render::OptionList& codec, bool stillBackground, bool variableFrameRate) {
+    if (stillBackground && Render::findOption(codec, "c:v") == "libx264") codec.emplace_back("tune", "stillimage");
+    if (variableFrameRate) codec.emplace_back("fps_mode", "vfr");
+}
+
+// --draft: frames at most this many pixels on the short side, at a low frame rate and fast
+// settings. Subtitles keep the full-size PlayRes, so libass scales the final layout down.
+constexpr int kDraftShortSide = 360;
+constexpr int kDraftFps = 10;
+constexpr int kDraftCrf = 32;
+constexpr int kContactSheetTileWidth = 320;
+
+// Draft frame size: the configured aspect ratio, even dimensions, never upscaled.
+static std::pair<int, int> draft_size(const AppConfig& config) {
+    double scale = std::min(1.0, static_cast<double>(kDraftShortSide) / std::max(1, std::min(config.width, config.height)));
+    auto even = [](double value) { return std::max(2, static_cast<int>(std::lround(value / 2.0)) * 2); };
+    return {even(config.width * scale), even(config.height * scale)};
+}
+
+// Selects the frame nearest each time and tiles them into one image, in timeline order.
+static std::string contact_sheet_filter(const std::vector<double>& times, int fps) {
+    std::vector<long long> frames;
+    for (double time : times) frames.push_back(std::llround(time * fps));
+    std::sort(frames.begin(), frames.end());
+    frames.erase(std::unique(frames.begin(), frames.end()), frames.end());
+    if (frames.empty()) frames.push_back(0);
+
+    size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(frames.size()))));
+    size_t rows = (frames.size() + columns - 1) / columns;
+    std::ostringstream filter;
+    filter << "select='";
+    for (size_t i = 0; i < frames.size(); ++i) filter << (i ? "+" : "") << "eq(n," << frames[i] << ")";
+    filter << "',scale=" << kContactSheetTileWidth << ":-2,tile=" << columns << "x" << rows << ":padding=4:margin=4";
+    return filter.str();
+}
+
+// IDR frames at every verse/segment start so clips can be cut by stream copy (see ClipIndex).
+static void add_verse_keyframes(Render::OptionList& codec, const std::vector<ClipIndex::Entry>& entries) {
+    std::string times = ClipIndex::forceKeyFrames(entries);
+    if (times.empty()) return;
+    codec.emplace_back("force_key_frames", times);
+    if (Render::findOption(codec, "c:v") == "libx264") codec.emplace_back("forced-idr", "1");
+}
+
+// Longest segment written for --stream-format; verses longer than this get extra cuts.
+constexpr double kStreamSegmentSeconds = 6.0;
+
+// Adds a stream specifier (":v:N") to every video option so each ladder rung keeps its own
+// encoder settings inside the single segmenting muxer.
+static Render::OptionList for_video_stream(const Render::OptionList& options, size_t index) {
+    Render::OptionList specified;
+    for (const auto& [key, value] : options) {
+        bool typed = key.size() > 2 && key.compare(key.size() - 2, 2, ":v") == 0;
+        specified.emplace_back(key + (typed ? ":" : ":v:") + std::to_string(index), value);
+    }
+    return specified;
+}
+
+// One HLS or DASH output carrying the main video, every rendition and a single audio track.
+// Keyframes are forced at verse starts and the muxer cuts a segment at each of them.
+static Render::Output build_stream_output(const CLIOptions& options,
+                                          const std::vector<VideoGenerator::RenditionOutput>& renditions,
+                                          const std::vector<Render::OptionList>& videoOptions,
+                                          const std::string& audioMap,
+                                          const Render::OptionList& audioOptions,
+                                          const std::vector<double>& verseStarts,
+                                          double totalDuration,
+                                          int fps) {
+    fs::path manifest(VideoGenerator::streamManifestPath(options));
+    fs::path directory = manifest.parent_path();
+    fs::create_directories(directory);
+
+    Render::Output output;
+    output.durationSeconds = totalDuration;
+    for (size_t i = 0; i < videoOptions.size(); ++i) {
+        output.maps.push_back(i == 0 ? "[v]" : "[v" + std::to_string(i) + "]");
+        Render::OptionList specified = videoOptions.size() == 1 ? videoOptions[i] : for_video_stream(videoOptions[i], i);
+        output.options.insert(output.options.end(), specified.begin(), specified.end());
+    }
+    output.maps.push_back(audioMap);
+
+    std::ostringstream keyframes;
+    keyframes << std::fixed << std::setprecision(3);
+    for (double time : VideoGenerator::planStreamKeyframes(verseStarts, totalDuration, kStreamSegmentSeconds)) {
+        if (keyframes.tellp() > 0) keyframes << ",";
+        keyframes << time;
+    }
+    output.options.insert(output.options.end(), {
+        {"force_key_frames", keyframes.str()},
+        // No scene-cut or GOP keyframes in between, which would cut extra segments.
+        {"sc_threshold", "0"},
+        {"g", std::to_string(static_cast<int>(kStreamSegmentSeconds * fps) * 2)}
+    });
+    output.options.insert(output.options.end(), audioOptions.begin(), audioOptions.end());
+
+    if (options.streamFormat == "dash") {
+        output.path = manifest.string();
+        output.options.insert(output.options.end(), {
+            {"f", "dash"},
+            {"seg_duration", "1"},
+            {"use_template", "1"},
+            {"use_timeline", "1"},
+            {"adaptation_sets", "id=0,streams=v id=1,streams=a"},
+            {"init_seg_name", "init-$RepresentationID$.m4s"},
+            {"media_seg_name", "chunk-$RepresentationID$-$Number%05d$.m4s"}
+        });
+        return output;
+    }
+
+    // Variant playlists and segments go in one sub-directory per rung, named after it.
+    std::string var_stream_map = "a:0,agroup:audio,name:audio v:0,agroup:audio,name:main";
+    for (size_t i = 0; i < renditions.size(); ++i) {
+        var_stream_map += " v:" + std::to_string(i + 1) + ",agroup:audio,name:" + renditions[i].name;
+    }
+    output.path = (directory / "%v" / "index.m3u8").string();
+    output.options.insert(output.options.end(), {
+        {"f", "hls"},
+        {"hls_time", "1"},
+        {"hls_playlist_type", "event"},
+        {"hls_segment_type", "fmp4"},
+        {"hls_fmp4_init_filename", "init_%v.mp4"},
+        {"hls_segment_filename", (directory / "%v" / "segment_%05d.m4s").string()},
+        {"master_pl_name", manifest.filename().string()},
+        {"var_stream_map", var_stream_map}
+    });
+    return output;
+}
+
+// Appends the recitation inputs to the plan. Returns the stream to map for audio and sets
+// audioFilter to any filter graph fragment the audio needs (empty when mapped directly).
+static std::string append_audio_inputs(Render::Plan& plan,
+                                       const CLIOptions& options,
+                                       const AppConfig& config,
+                                       const std::vector<VerseData>& verses,
+                                       double minTimestampSec,
+                                       double maxTimestampSec,
+                                       double& total_duration,
+                                       std::string& audioFilter) {
+    double intro_duration = config.introDuration;
+    double pause_after_intro_duration = config.pauseAfterIntroDuration;
+    double verses_duration = 0.0;
+    for (const auto& verse : verses) verses_duration += verse.durationInSeconds;
+    int audioInputIndex = static_cast<int>(plan.inputs.size());
+    audioFilter.clear();
+
+    // Handle audio differently for gapped vs gapless
+    if (config.recitationMode == RecitationMode::GAPLESS) {
+        // For gapless: use single surah audio file with precise trimming
+        if (verses.empty()) throw std::runtime_error("No verses to render");
+        
+        std::string audioPath;
+        for (const auto& verse : verses) {
+            if (verse.localAudioPath.empty()) continue;
+            audioPath = verse.localAudioPath;
+            if (verse.fromCustomAudio) break;
+        }
+        if (audioPath.empty()) throw std::runtime_error("No audio path found for gapless render");
+        bool customClip = !verses.empty() && verses[0].fromCustomAudio;
+        double startTime = customClip ? 0.0 : minTimestampSec;
+        double endTime = customClip ? verses_duration : maxTimestampSec;
+        double trimmedDuration = std::max(0.0, endTime - startTime);
+        double measuredAudioDuration = customClip
+            ? Audio::CustomAudioProcessor::probeDuration(audioPath)
+            : trimmedDuration;
+        double audioDuration = customClip
+            ? std::max(measuredAudioDuration, verses_duration)
+            : measuredAudioDuration;
+        total_duration = intro_duration + pause_after_intro_duration + audioDuration;
+        
+        Render::Input silence;
+        silence.format = "lavfi";
+        silence.durationSeconds = intro_duration + pause_after_intro_duration;
+        silence.path = "anullsrc=r=44100:cl=stereo";
+        plan.inputs.push_back(silence);
+
+        Render::Input recitation;
+        recitation.path = to_ffmpeg_path(audioPath);
+        if (!customClip) {
+            recitation.seekSeconds = startTime;
+            recitation.durationSeconds = trimmedDuration;
+        }
+        plan.inputs.push_back(recitation);
+
+        // Handle audio concatenation
+        audioFilter = "[" + std::to_string(audioInputIndex) + ":a][" +
+                      std::to_string(audioInputIndex + 1) + ":a]concat=n=2:v=0:a=1[a]";
+        return "[a]";
+    }
+
+    // For gapped: concatenate individual ayah audio files
+    std::string concat_file_path = job_temp_path(options, "audiolist.txt").string();
+    {
+        std::ofstream concat_file(concat_file_path);
+        if (!concat_file.is_open()) throw std::runtime_error("Failed to create audio list file.");
+        for (const auto& verse : verses) {
+            concat_file << "file '" << to_ffmpeg_path(fs::absolute(verse.localAudioPath)) << "'\n";
+        }
+    }
+    total_duration = intro_duration + pause_after_intro_duration + verses_duration;
+    
+    Render::Input recitation;
+    recitation.offsetSeconds = intro_duration + pause_after_intro_duration;
+    recitation.format = "concat";
+    recitation.options.emplace_back("safe", "0");
+    recitation.path = to_ffmpeg_path(concat_file_path);
+    plan.inputs.push_back(recitation);
+    return std::to_string(audioInputIndex) + ":a";
+}
+
+std::vector<double> VideoGenerator::planStreamKeyframes(const std::vector<double>& verseStarts,
+                                                        double totalDurationSeconds,
+                                                        double maxSegmentSeconds) {
+    std::vector<double> cuts = {0.0};
+    for (double start : verseStarts) {
+        if (start > cuts.back() + 1e-3 && start < totalDurationSeconds - 1e-3) cuts.push_back(start);
+    }
+    cuts.push_back(totalDurationSeconds);
+
+    std::vector<double> keyframes;
+    for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+        double length = cuts[i + 1] - cuts[i];
+        int pieces = std::max(1, static_cast<int>(std::ceil(length / maxSegmentSeconds - 1e-9)));
+        for (int piece = 0; piece < pieces; ++piece) keyframes.push_back(cuts[i] + length * piece / pieces);
+    }
+    return keyframes;
+}
+
+std::string VideoGenerator::streamManifestPath(const CLIOptions& options) {
+    if (options.streamFormat.empty()) return "";
+    fs::path output(options.output);
+    fs::path directory = output.parent_path() / output.stem();
+    return (directory / (options.streamFormat == "dash" ? "manifest.mpd" : "master.m3u8")).string();
+}
+
+std::vector<double> VideoGenerator::contactSheetTimes(const AppConfig& config,
+                                                      const std::vector<VerseData>& verses,
+                                                      const VerseSegmentation::Manager* segmentManager) {
+    std::vector<double> times;
+    for (const auto& entry : ClipIndex::timeline(config, verses, segmentManager)) {
+        times.push_back((entry.startSeconds + entry.endSeconds) / 2.0);
+    }
+    return times;
+}
+
+std::string VideoGenerator::contactSheetPath(const CLIOptions& options) {
+    fs::path output(options.output);
+    return (output.parent_path() / (output.stem().string() + "-contact.jpg")).string();
+}
+
+std::string VideoGenerator::thumbnailPath(const CLIOptions& options) {
+    fs::path output(options.output);
+    if (!options.jobOutputNames) return (output.parent_path() / "thumbnail.jpeg").string();
+    return (output.parent_path() / (output.stem().string() + "-thumbnail.jpeg")).string();
+}
+
+std::vector<double> VideoGenerator::computeVerseBoundaries(const AppConfig& config,
+                                                           const std::vector<VerseData>& verses) {
+    std::vector<double> boundaries;
+    boundaries.reserve(verses.size());
+    double cumulative = config.introDuration + config.pauseAfterIntroDuration;
+    for (const auto& verse : verses) {
+        boundaries.push_back(cumulative);
+        cumulative += verse.durationInSeconds;
+    }
+    return boundaries;
+}
+
+int VideoGenerator::resolveChunkCount(int requested, double totalDurationSeconds) {
+    constexpr double kMinChunkSeconds = 30.0;
+    int chunks = requested;
+    if (chunks == 0) {
+        // x264 scales well up to ~4 threads per encode; spend remaining cores on more chunks.
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        chunks = static_cast<int>(std::clamp(cores / 4u, 1u, 16u));
+    }
+    int maxByDuration = static_cast<int>(totalDurationSeconds / kMinChunkSeconds);
+    return std::max(1, std::min(chunks, maxByDuration));
+}
+
+std::vector<VideoGenerator::ChunkRange> VideoGenerator::planChunks(const std::vector<double>& cutCandidates,
+                                                                   double totalDurationSeconds,
+                                                                   int fps,
+                                                                   int chunkCount) {
+    std::vector<ChunkRange> chunks;
+    if (chunkCount <= 1 || fps <= 0 || totalDurationSeconds <= 0.0) {
+        chunks.push_back({0.0, totalDurationSeconds});
+        return chunks;
+    }
+
+    // Cuts land on frame boundaries so each chunk covers a whole number of frames.
+    auto snap = [fps](double seconds) { return std::round(seconds * fps) / fps; };
+    double previous = 0.0;
+    for (int k = 1; k < chunkCount; ++k) {
+        double ideal = totalDurationSeconds * k / chunkCount;
+        double best = -1.0;
+        for (double candidate : cutCandidates) {
+            double cut = snap(candidate);
+            if (cut <= previous || cut >= snap(totalDurationSeconds)) continue;
+            if (best < 0.0 || std::abs(cut - ideal) < std::abs(best - ideal)) best = cut;
+        }
+        if (best < 0.0) continue;
+        chunks.push_back({previous, best});
+        previous = best;
+    }
+    chunks.push_back({previous, totalDurationSeconds});
+    return chunks;
+}
+
+namespace {
+
+double parse_ass_time(const std::string& value) {
+    int hours = 0, minutes = 0;
+    double seconds = 0.0;
+    if (std::sscanf(value.c_str(), "%d:%d:%lf", &hours, &minutes, &seconds) != 3) return 0.0;
+    return hours * 3600.0 + minutes * 60.0 + seconds;
+}
+
+} // namespace
+
+std::string VideoGenerator::subtitleEventsInWindow(const std::string& assContent, double startSeconds, double endSeconds) {
+    std::istringstream in(assContent);
+    std::string line;
+    std::string window;
+    bool inEvents = false;
+    while (std::getline(in, line)) {
+        if (!inEvents) {
+            window += line + "\n";
+            if (line.rfind("[Events]", 0) == 0) inEvents = true;
+            continue;
+        }
+        if (line.rfind("Dialogue:", 0) != 0) {
+            if (line.rfind("Format:", 0) == 0) window += line + "\n";
+            continue;
+        }
+        // Dialogue: Layer,Start,End,...
+        size_t first = line.find(',');
+        size_t second = first == std::string::npos ? first : line.find(',', first + 1);
+        size_t third = second == std::string::npos ? second : line.find(',', second + 1);
+        if (third == std::string::npos) continue;
+        double eventStart = parse_ass_time(line.substr(first + 1, second - first - 1));
+        double eventEnd = parse_ass_time(line.substr(second + 1, third - second - 1));
+        if (eventStart < endSeconds && eventEnd > startSeconds) window += line + "\n";
+    }
+    return window;
+}
+
+namespace {
+
+// Bump when the segment recipe changes so stale segments are not reused.
+constexpr const char* kSegmentVersion = "segment-v1";
+// Incremental segments are cut near this length so their boundaries stay stable across edits.
+constexpr double kIncrementalSegmentSeconds = 20.0;
+
+void replace_all(std::string& text, const std::string& from, const std::string& to) {
+    if (from.empty()) return;
+    size_t pos = 0;
+    while ((pos = text.find(from, pos)) != std::string::npos) {
+        text.replace(pos, from.size(), to);
+        pos += to.size();
+    }
+}
+
+const std::string& hash_file_cached(const std::string& path, std::map<std::string, std::string>& fileHashes) {
+    auto it = fileHashes.find(path);
+    if (it == fileHashes.end()) it = fileHashes.emplace(path, CacheUtils::hashFile(path)).first;
+    return it->second;
+}
+
+// Hash of the files a concat list names, in order. The list itself holds absolute paths that
+// may point into the job's workspace, so its own bytes are not stable across runs.
+std::string hash_concat_list(const std::string& listPath, std::map<std::string, std::string>& fileHashes) {
+    std::ifstream list(listPath);
+    std::string line;
+    std::string combined;
+    while (std::getline(list, line)) {
+        const std::string prefix = "file '";
+        if (line.rfind(prefix, 0) != 0 || line.size() <= prefix.size() || line.back() != '\'') continue;
+        std::string path = line.substr(prefix.size(), line.size() - prefix.size() - 1);
+        std::error_code ec;
+        combined += (fs::is_regular_file(path, ec) ? hash_file_cached(path, fileHashes) : path) + "\n";
+    }
+    return CacheUtils::hashString(combined);
+}
+
+// Content key for one segment: the render plan (minus per-run tuning and every path that
+// names this run's workspace or output), the subtitle events it shows and the contents of
+// every input file it reads. Input files are keyed by position and content, so the same
+// sources staged in a new workspace give the same key.
+std::string segment_key(const Render::Plan& plan,
+                        const std::string& subtitleWindow,
+                        std::map<std::string, std::string>& fileHashes) {
+    Render::Plan keyed = plan;
+    keyed.emitProgress = false;
+    keyed.filterThreads = 0;
+    for (auto& output : keyed.outputs) {
+        output.path.clear();
+        Render::OptionList options;
+        for (const auto& option : output.options) {
+            if (option.first != "threads" && option.first != "x264-params") options.push_back(option);
+        }
+        output.options = options;
+    }
+    std::string contents;
+    for (size_t i = 0; i < keyed.inputs.size(); ++i) {
+        auto& input = keyed.inputs[i];
+        std::error_code ec;
+        if (!fs::is_regular_file(input.path, ec)) continue;  // lavfi sources stay as written
+        contents += "\n" + (input.format == "concat" ? hash_concat_list(input.path, fileHashes)
+                                                     : hash_file_cached(input.path, fileHashes));
+        input.path = "input-" + std::to_string(i);
+    }
+    // The subtitle script lives in the workspace; its events are keyed through subtitleWindow.
+    if (auto workspace = RenderWorkspace::current()) {
+        replace_all(keyed.filterComplex, to_ffmpeg_filter_path(workspace->root()), "<workspace>");
+        replace_all(keyed.filterComplex, to_ffmpeg_path(workspace->root()), "<workspace>");
+    }
+    std::string key = std::string(kSegmentVersion) + "\n" + Render::buildFfmpegCommand(keyed) + "\n" + subtitleWindow;
+    return CacheUtils::hashString(key + contents);
+}
+
+struct ChunkedRenderInputs {
+    std::vector<std::string> bgInputFiles;
+    std::string bgFilterComplex;
+    std::vector<BackgroundVideo::VideoSegment> bgClips;  // timeline of bgFilterComplex, for per-chunk windows
+    std::string overlayFilter;   // ",drawbox=..." or empty
+    std::string staticBackgroundPath;
+    std::string staticBackgroundFilter;  // normalization applied after setpts (empty for plates)
+    bool stillBackground = false;        // staticBackgroundPath is a single frame looped by the filter
+    bool variableFrameRate = false;      // subtitleFilter drops unchanged frames
+    int parallelEncodes = 1;             // chunks encoded at once
+    std::string segmentDir;              // persistent directory for incremental segments (empty = temp)
+    std::string assPath;                 // subtitle script, for keying incremental segments
+    std::string audioTrackPath;          // cached audio track to reuse or fill (empty = no cache)
+    std::string subtitleFilter;  // "ass=..."
+    std::vector<ClipIndex::Entry> clipEntries;  // verse/segment starts that get a keyframe
+};
+
+// Encodes the video in parallel slices cut at verse boundaries plus one audio job, then joins
+// the slices with the concat demuxer (stream copy) and muxes the audio track in.
+void render_chunked(const CLIOptions& options,
+                    const AppConfig& config,
+                    const std::vector<VerseData>& verses,
+                    const std::vector<VideoGenerator::ChunkRange>& chunks,
+                    const ChunkedRenderInputs& inputs,
+                    const EncoderTuning::Settings& tuning,
+                    double minTimestampSec,
+                    double maxTimestampSec,
+                    double total_duration,
+                    const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                    const std::shared_ptr<Interfaces::IRenderEngine>& renderEngine) {
+    const bool incremental = !inputs.segmentDir.empty();
+    fs::path chunk_dir = incremental
+        ? fs::path(inputs.segmentDir)
+        : scratchFile("qvm-chunks-" + fs::path(options.output).stem().string());
+    std::error_code ec;
+    if (!incremental) fs::remove_all(chunk_dir, ec);
+    fs::create_directories(chunk_dir);
+
+    Render::OptionList video_codec = build_video_codec_options(options, config);
+    add_still_background_options(video_codec, inputs.stillBackground, inputs.variableFrameRate);
+    EncoderTuning::apply(tuning, video_codec);
+
+    double static_bg_duration = 0.0;
+    if (inputs.bgInputFiles.empty() && !inputs.stillBackground) {
+        static_bg_duration = Audio::CustomAudioProcessor::probeDuration(inputs.staticBackgroundPath);
+    }
+
+    std::vector<Render::Plan> plans;
+    std::vector<double> plan_seconds;
+    std::vector<fs::path> plan_outputs;
+
+    // Audio is encoded once for the whole timeline; per-chunk AAC would add priming gaps at every join.
+    fs::path audio_path = chunk_dir / "audio.m4a";
+    {
+        Render::Plan plan;
+        std::string audioFilter;
+        double audio_duration = total_duration;
+        std::string audioMap = append_audio_inputs(plan, options, config, verses, minTimestampSec, maxTimestampSec,
+                                                   audio_duration, audioFilter);
+        plan.filterComplex = audioFilter;
+        Render::Output output;
+        output.path = to_ffmpeg_path(audio_path);
+        output.maps.push_back(audioMap);
+        output.durationSeconds = total_duration;
+        output.options = AudioTrack::encodeOptions();
+        plan.outputs.push_back(output);
+        plans.push_back(plan);
+        plan_seconds.push_back(0.0);
+        plan_outputs.push_back(audio_path);
+    }
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const auto& chunk = chunks[i];
+        double chunk_duration = chunk.endSeconds - chunk.startSeconds;
+        Render::Plan plan;
+        std::ostringstream chain;
+        auto slices = BackgroundVideo::clipsInWindow(inputs.bgClips, config.fps, chunk.startSeconds, chunk.endSeconds);
+        if (!slices.empty()) {
+            // Open only the clips this chunk shows, seeked to just before its first frame. The
+            // matching -itsoffset keeps the clip's own timestamps, so fps picks the same frames.
+            for (const auto& slice : slices) {
+                Render::Input input;
+                input.path = to_ffmpeg_path(slice.path);
+                if (slice.seekSeconds > 0.0) {
+                    input.seekSeconds = slice.seekSeconds;
+                    input.offsetSeconds = slice.seekSeconds;
+                }
+                input.durationSeconds = slice.durationSeconds;
+                plan.inputs.push_back(input);
+            }
+            chain << BackgroundVideo::buildWindowFilter(config, inputs.bgClips, slices)
+                  << ",trim=duration=" << chunk_duration
+                  << ",setpts=PTS-STARTPTS";
+        } else if (!inputs.bgInputFiles.empty()) {
+            for (const auto& bgFile : inputs.bgInputFiles) {
+                Render::Input input;
+                input.path = to_ffmpeg_path(bgFile);
+                plan.inputs.push_back(input);
+            }
+            chain << inputs.bgFilterComplex
+                  << ",trim=start=" << chunk.startSeconds << ":end=" << chunk.endSeconds
+                  << ",setpts=PTS-STARTPTS";
+        } else {
+            // Seek into the looped background to where the single-pass render would be.
+            Render::Input input;
+            input.path = to_ffmpeg_path(inputs.staticBackgroundPath);
+            input.streamLoop = inputs.stillBackground ? 0 : -1;
+            if (chunk.startSeconds > 0.0 && static_bg_duration > 0.0) {
+                input.seekSeconds = std::fmod(chunk.startSeconds, static_bg_duration);
+            }
+            plan.inputs.push_back(input);
+            chain << "[0:v]setpts=PTS-STARTPTS" << inputs.staticBackgroundFilter;
+        }
+        // Shift into timeline time for the subtitles, then back to a zero-based chunk.
+        chain << inputs.overlayFilter
+              << ",setpts=PTS+" << chunk.startSeconds << "/TB,"
+              << inputs.subtitleFilter
+              << ",setpts=PTS-STARTPTS[v]";
+        plan.filterComplex = chain.str();
+
+        fs::path chunk_path = chunk_dir / ("chunk_" + std::to_string(i) + ".mp4");
+        Render::Output output;
+        output.path = to_ffmpeg_path(chunk_path);
+        output.maps.push_back("[v]");
+        output.durationSeconds = chunk_duration;
+        output.options = video_codec;
+        std::vector<ClipIndex::Entry> chunk_entries;
+        for (auto entry : inputs.clipEntries) {
+            if (entry.startSeconds <= chunk.startSeconds || entry.startSeconds >= chunk.endSeconds) continue;
+            entry.startSeconds -= chunk.startSeconds;
+            chunk_entries.push_back(entry);
+        }
+        add_verse_keyframes(output.options, chunk_entries);
+        output.options.emplace_back("pix_fmt", config.pixelFormat);
+        plan.outputs.push_back(output);
+        plan.filterThreads = tuning.filterThreads;
+        plans.push_back(plan);
+        plan_seconds.push_back(chunk_duration);
+        plan_outputs.push_back(chunk_path);
+    }
+
+    // Incremental segments are named by content key and written via a partial file, so a
+    // segment whose inputs did not change since the last render is reused as-is.
+    std::vector<fs::path> plan_partials = plan_outputs;
+    std::vector<bool> reused(plans.size(), false);
+    nlohmann::json segment_manifest;
+    if (incremental) {
+        std::string ass_content;
+        {
+            std::ifstream ass(inputs.assPath, std::ios::binary);
+            ass_content.assign(std::istreambuf_iterator<char>(ass), std::istreambuf_iterator<char>());
+        }
+        std::map<std::string, std::string> file_hashes;
+        nlohmann::json video_segments = nlohmann::json::array();
+        for (size_t i = 0; i < plans.size(); ++i) {
+            bool is_audio = (i == 0);
+            std::string window = is_audio ? ""
+                : VideoGenerator::subtitleEventsInWindow(ass_content, chunks[i - 1].startSeconds, chunks[i - 1].endSeconds);
+            std::string key = segment_key(plans[i], window, file_hashes);
+            std::string extension = plan_outputs[i].extension().string();
+            plan_outputs[i] = chunk_dir / ((is_audio ? "audio-" : "video-") + key + extension);
+            plan_partials[i] = chunk_dir / ((is_audio ? "audio-" : "video-") + key + ".partial" + extension);
+            plans[i].outputs[0].path = to_ffmpeg_path(plan_partials[i]);
+            reused[i] = CacheUtils::fileIsValid(plan_outputs[i]);
+
+            nlohmann::json entry = {{"hash", key}, {"file", plan_outputs[i].filename().string()}, {"reused", bool(reused[i])}};
+            if (is_audio) {
+                segment_manifest["audio"] = entry;
+            } else {
+                entry["startSeconds"] = chunks[i - 1].startSeconds;
+                entry["endSeconds"] = chunks[i - 1].endSeconds;
+                video_segments.push_back(entry);
+            }
+        }
+        segment_manifest["directory"] = chunk_dir.string();
+        segment_manifest["video"] = video_segments;
+        size_t reused_count = static_cast<size_t>(std::count(reused.begin(), reused.end(), true));
+        std::cout << "Incremental render: reusing " << reused_count << " of " << plans.size()
+                  << " segments (including audio)" << std::endl;
+    }
+    if (!incremental && !inputs.audioTrackPath.empty()) {
+        plan_outputs[0] = inputs.audioTrackPath;
+        plan_partials[0] = CacheUtils::uniquePartialPath(plan_outputs[0]);
+        plans[0].outputs[0].path = to_ffmpeg_path(plan_partials[0]);
+        reused[0] = CacheUtils::fileIsValid(plan_outputs[0]);
+        if (reused[0]) std::cout << "Using cached audio track: " << plan_outputs[0].string() << std::endl;
+    }
+    audio_path = plan_outputs[0];
+    std::vector<fs::path> chunk_paths(plan_outputs.begin() + 1, plan_outputs.end());
+
+    std::cout << "Rendering " << chunks.size() << " chunks, " << inputs.parallelEncodes << " in parallel ("
+              << tuning.encoderThreads << " encoder threads each)" << std::endl;
+
+    std::atomic<size_t> next_plan{0};
+    std::atomic<bool> failed{false};
+    std::mutex progress_mutex;
+    double completed_seconds = 0.0;
+    auto trace_session = Tracing::currentSession();
+    auto worker = [&]() {
+        Tracing::ScopedSession trace_scope(trace_session);
+        while (!failed) {
+            size_t index = next_plan++;
+            if (index >= plans.size()) return;
+            try {
+                if (!reused[index]) {
+                    Render::runPlan(plans[index], processExecutor, renderEngine);
+                    if (plan_partials[index] != plan_outputs[index]) {
+                        fs::rename(plan_partials[index], plan_outputs[index]);
+                    }
+                }
+            } catch (...) {
+                failed = true;
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            completed_seconds += plan_seconds[index];
+        }
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> workers;
+    for (size_t i = 0; i < std::min(plans.size(), static_cast<size_t>(std::max(1, inputs.parallelEncodes))); ++i) {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+    double reported_seconds = -1.0;
+    for (auto& future : workers) {
+        while (future.wait_for(std::chrono::milliseconds(500)) != std::future_status::ready) {
+            if (!options.emitProgress) continue;
+            double done;
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                done = completed_seconds;
+            }
+            if (done == reported_seconds) continue;
+            reported_seconds = done;
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            double ratio = total_duration > 0.0 ? std::clamp(done / total_duration, 0.0, 1.0) : 0.0;
+            double eta = ratio > 0.0 ? elapsed * (1.0 - ratio) / ratio : -1.0;
+            Progress::emit("encoding", "running", ratio * 100.0, elapsed, eta, "Encoding chunks");
+        }
+    }
+    for (auto& future : workers) future.get();
+
+    fs::path chunk_list = chunk_dir / "chunks.txt";
+    {
+        std::ofstream list(chunk_list);
+        if (!list.is_open()) throw std::runtime_error("Failed to create chunk list file.");
+        for (const auto& chunk_path : chunk_paths) {
+            list << "file '" << to_ffmpeg_path(fs::absolute(chunk_path)) << "'\n";
+        }
+    }
+
+    Render::Plan join;
+    join.emitProgress = options.emitProgress;
+    join.totalDurationSeconds = total_duration;
+    Render::Input joined_video;
+    joined_video.format = "concat";
+    joined_video.options.emplace_back("safe", "0");
+    joined_video.path = to_ffmpeg_path(chunk_list);
+    join.inputs.push_back(joined_video);
+    Render::Input audio;
+    audio.path = to_ffmpeg_path(audio_path);
+    join.inputs.push_back(audio);
+    Render::Output output;
+    output.path = options.output;
+    output.maps = {"0:v", "1:a"};
+    output.durationSeconds = total_duration;
+    output.options = {{"c", "copy"}, {"movflags", "+faststart"}};
+    join.outputs.push_back(output);
+    Render::runPlan(join, processExecutor, renderEngine);
+
+    if (!incremental) {
+        fs::remove_all(chunk_dir, ec);
+        return;
+    }
+
+    // Keep only the segments of this render for the next incremental pass.
+    for (const auto& entry : fs::directory_iterator(chunk_dir, ec)) {
+        if (std::find(plan_outputs.begin(), plan_outputs.end(), entry.path()) == plan_outputs.end()) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    MetadataWriter::mergeIntoMetadata(options, "segments", segment_manifest);
+}
+
+} // namespace
+
+// Thumbnail overlay: surah label, name, reciter and number over the first background frame.
+static fs::path write_thumbnail_ass(const CLIOptions& options, const AppConfig& config) {
+    std::string language_code = LocalizationUtils::getLanguageCode(config);
+    std::string localized_surah_label = LocalizationUtils::getLocalizedSurahLabel(language_code);
+    std::string localized_surah_name = LocalizationUtils::getLocalizedSurahName(options.surah, language_code);
+    std::string localized_reciter_name = LocalizationUtils::getLocalizedReciterName(config.reciterId, language_code);
+    std::string localized_surah_number = LocalizationUtils::getLocalizedNumber(options.surah, language_code);
+
+    auto with_fallback = [&](const std::string& text) {
+        return SubtitleBuilder::applyLatinFontFallback(
+            text,
+            config.translationFallbackFontFamily,
+            config.translationFont.family);
+    };
+    std::string rendered_label = with_fallback(localized_surah_label);
+    std::string rendered_surah_name = with_fallback(localized_surah_name);
+    std::string rendered_reciter_name = with_fallback(localized_reciter_name);
+    std::string rendered_surah_number = with_fallback(localized_surah_number);
+
+    std::vector<std::string> colors = config.thumbnailColors;
+    if (colors.empty()) {
+        colors = {
+            "&HFFFFFF&", // White
+            "&HC0C0C0&", // Silver
+            "&H00D7FF&"  // Gold
+        };
+    }
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(0, colors.size() - 1);
+
+    auto pick_color = [&]() { return colors[dis(gen)]; };
+
+    int base_font_size = config.translationFont.size;
+    int scaled_font_size = static_cast<int>(base_font_size * (config.width * 0.7 / (base_font_size * 3.0)));
+    if (scaled_font_size < base_font_size) scaled_font_size = base_font_size;
+    int label_size = scaled_font_size / 3;
+    int reciter_size = scaled_font_size / 3;
+
+    std::uniform_int_distribution<> side_dis(0, 1);
+    int padding = config.thumbnailNumberPadding;
+    bool right_side = side_dis(gen) == 1;
+    int number_x = right_side ? (config.width - padding) : padding;
+    std::string align = right_side ? "9" : "7";
+
+    std::string number_color = pick_color();
+    int number_size = scaled_font_size * 0.5;
+
+    fs::path ass_path = job_temp_path(options, "thumbnail.ass");
+    std::ofstream ass_file(ass_path);
+    if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary ASS file.");
+
+    ass_file << "[Script Info]\nTitle: Thumbnail\nScriptType: v4.00+\n";
+    ass_file << "PlayResX: " << config.width << "\nPlayResY: " << config.height << "\n\n";
+
+    ass_file << "[V4+ Styles]\n";
+    ass_file << "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n";
+    ass_file << "Style: Label," << config.translationFont.family << "," << label_size 
+            << "," << pick_color() << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,3,1,3,10,10,10,-1\n";
+    ass_file << "Style: Main," << config.translationFont.family << "," << scaled_font_size 
+            << "," << pick_color() << ",&H000000FF&, &H000000&, &H00000000&,1,0,0,0,100,100,0,0,1,5,3,5,10,10,10,-1\n";
+    ass_file << "Style: Reciter," << config.translationFont.family << "," << reciter_size 
+            << "," << pick_color() << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,3,1,3,10,10,10,-1\n";
+    ass_file << "Style: Number," << config.translationFont.family << "," << number_size 
+            << "," << number_color << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,5,3,5,10,10,10,-1\n\n";
+
+    ass_file << "[Events]\n";
+    ass_file << "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+    ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Label,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2 - scaled_font_size*0.6) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_label << "\n";
+    ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Main,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_surah_name << "\n";
+    ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Reciter,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2 + scaled_font_size*0.6) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_reciter_name << "\n";
+    ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Number,,0,0,0,,{\\an" << align << "\\pos(" << number_x << ",50)\\fad(0," << config.introFadeOutMs << ")}" << rendered_surah_number << "\n";
+            
+    ass_file.close();
+    return ass_path;
+}
+
+bool VideoGenerator::generateVideo(const CLIOptions& options, 
                                    const AppConfig& config, 
                                    const std::vector<VerseData>& verses, 
                                    std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
-                                   const VerseSegmentation::Manager* segmentManager) {
+                                   const VerseSegmentation::Manager* segmentManager,
+                                   std::shared_ptr<Interfaces::IRenderEngine> renderEngine,
+                                   const std::vector<RenditionOutput>& renditions) {
+    if (options.draft && (!renditions.empty() || !options.streamFormat.empty() || options.renderChunks != 1 ||
+                          options.incremental || options.variableFrameRate)) {
+        std::cerr << "Warning: Draft renders are a single MP4 pass; ignoring renditions, segmented output, "
+                     "chunked/incremental rendering and --vfr." << std::endl;
+        CLIOptions draft = options;
+        draft.streamFormat.clear();
+        draft.renderChunks = 1;
+        draft.incremental = false;
+        draft.variableFrameRate = false;
+        return generateVideo(draft, config, verses, processExecutor, segmentManager, renderEngine);
+    }
     try {
+        EncoderTuning::ActiveJob active_job;
         std::cout << "\n=== Starting Video Rendering ===" << std::endl;
         
         double intro_duration = config.introDuration;
@@ -108,23 +936,25 @@ void VideoGenerator::generateVideo(const CLIOptions& options,
         std::vector<std::string> bgInputFiles;
         std::string bgFilterComplex;
         
-        if (config.videoSelection.enableDynamicBackgrounds) {
+        if (config.videoSelection.enableDynamicBackgrounds && options.draft) {
+            std::cout << "Draft: using the static background instead of downloading background clips" << std::endl;
+        } else if (config.videoSelection.enableDynamicBackgrounds) {
             if (options.emitProgress) {
-                emitStageMessage("background", "running", "Selecting background videos");
+                Progress::emitStage("background", "running", "Selecting background videos");
             }
             bgFilterComplex = bgManager.buildFilterComplex(total_duration, bgInputFiles);
             if (options.emitProgress) {
-                emitStageMessage("background", "completed", 
+                Progress::emitStage("background", "completed", 
                             "Selected " + std::to_string(bgInputFiles.size()) + " background videos");
             }
         }
 
         std::cout << "Generating subtitles..." << std::endl;
-        if (options.emitProgress) emitStageMessage("subtitles", "running", "Generating subtitles");
+        if (options.emitProgress) Progress::emitStage("subtitles", "running", "Generating subtitles");
         std::string ass_filename = SubtitleBuilder::buildAssFile(config, options, verses, intro_duration, pause_after_intro_duration, segmentManager);
         std::string ass_ffmpeg_path = to_ffmpeg_filter_path(fs::path(ass_filename));
         std::string fonts_ffmpeg_path = to_ffmpeg_filter_path(fs::absolute(config.assetFolderPath) / "fonts");
-        if (options.emitProgress) emitStageMessage("subtitles", "completed", "Subtitles generated");
+        if (options.emitProgress) Progress::emitStage("subtitles", "completed", "Subtitles generated");
 
         size_t at_pos = config.overlayColor.find('@');
         bool apply_overlay = true;
@@ -134,277 +964,410 @@ void VideoGenerator::generateVideo(const CLIOptions& options,
                 if (alpha <= 0.0) apply_overlay = false;
             } catch(...) {}
         }
+        std::string overlay_filter = apply_overlay
+            ? ",drawbox=x=0:y=0:w=iw:h=ih:color=" + config.overlayColor + ":t=fill"
+            : "";
 
-        std::ostringstream video_codec;
-        if (options.encoder == "hardware") {
-            #if defined(__APPLE__)
-                video_codec << "-c:v h264_videotoolbox ";
-                const std::string hardwareBitrate = !config.videoBitrate.empty() ? config.videoBitrate : "3500k";
-                video_codec << "-b:v " << hardwareBitrate << " ";
-                if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-                if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-                video_codec << "-allow_sw 1";
-                std::cout << "Using hardware encoder: h264_videotoolbox" << std::endl;
-            #else
-                video_codec << "-c:v libx264 -preset " << options.preset << " -crf " << config.crf << " ";
-                if (!config.videoBitrate.empty()) video_codec << "-b:v " << config.videoBitrate << " ";
-                if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-                if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-            #endif
-        } else {
-            video_codec << "-c:v libx264 -preset " << options.preset << " -crf " << config.crf << " ";
-            if (!config.videoBitrate.empty()) video_codec << "-b:v " << config.videoBitrate << " ";
-            if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-            if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-            std::cout << "Using software encoder: libx264 ('" << options.preset << "')" << std::endl;
+        // Static backgrounds can come from the plate cache, already scaled and overlaid.
+        std::string static_bg_path = config.assetBgVideo;
+        // The same normalization feeds single-pass and chunked renders, so both produce the same
+        // frames whatever the source's native rate.
+        std::string static_bg_filter = ",scale=" + std::to_string(config.width) + ":" + std::to_string(config.height) +
+                                       ",fps=" + std::to_string(config.fps);
+        int frame_rate = config.fps;
+        std::string draft_scale;
+        if (options.draft) {
+            auto [draft_width, draft_height] = draft_size(config);
+            frame_rate = kDraftFps;
+            draft_scale = ",scale=" + std::to_string(draft_width) + ":" + std::to_string(draft_height);
+            static_bg_filter = ",fps=" + std::to_string(frame_rate) + draft_scale;
+            MetadataWriter::mergeIntoMetadata(options, "draft", {
+                {"width", draft_width},
+                {"height", draft_height},
+                {"fps", frame_rate},
+                {"contactSheet", contactSheetPath(options)}
+            });
+            std::cout << "Draft render: " << draft_width << "x" << draft_height << " @ " << frame_rate
+                      << "fps, subtitles laid out at " << config.width << "x" << config.height << std::endl;
         }
 
-        // Build ffmpeg command with all inputs
-        std::stringstream final_cmd;
-        final_cmd << "ffmpeg ";
-        if (options.emitProgress) {
-            final_cmd << "-progress pipe:1 -nostats -loglevel warning ";
+        // Still backgrounds are decoded once and the frame is repeated by the filter graph.
+        bool still_background = false;
+        if (bgInputFiles.empty() && (options.staticBackground || BackgroundPlate::isStillImage(config.assetBgVideo))) {
+            auto spec = BackgroundPlate::specFromConfig(config, apply_overlay);
+            spec.still = true;
+            std::string still;
+            if (options.noCache) {
+                fs::path destination = job_temp_path(options, "background.png");
+                if (BackgroundPlate::renderPlate(spec, destination, processExecutor, renderEngine)) {
+                    still = destination.string();
+                }
+            } else {
+                still = BackgroundPlate::ensurePlate(spec, processExecutor, renderEngine);
+            }
+            if (!still.empty()) {
+                still_background = true;
+                static_bg_path = still;
+                static_bg_filter = ",format=" + config.pixelFormat + ",loop=loop=-1:size=1,setpts=N/(" +
+                                   std::to_string(frame_rate) + "*TB)" + draft_scale;
+                overlay_filter.clear();
+                std::cout << "Using still background fast path" << std::endl;
+            } else {
+                std::cerr << "Warning: Could not extract a still background, rendering it as video." << std::endl;
+            }
         }
-        final_cmd << "-y ";
+
+        // Only frames that change (subtitle events, fades) are encoded; the rest are dropped.
+        bool variable_frame_rate = options.variableFrameRate && still_background;
+        if (options.variableFrameRate && !still_background) {
+            std::cerr << "Warning: --vfr needs a still background; encoding at a constant frame rate." << std::endl;
+        }
+
+        if (bgInputFiles.empty() && !still_background && config.useBackgroundPlateCache && !options.noCache &&
+            !options.draft) {
+            if (options.emitProgress) Progress::emitStage("background", "running", "Preparing background plate");
+            std::string plate = BackgroundPlate::ensurePlate(
+                BackgroundPlate::specFromConfig(config, apply_overlay), processExecutor, renderEngine);
+            if (!plate.empty()) {
+                static_bg_path = plate;
+                static_bg_filter.clear();
+                overlay_filter.clear();
+            }
+            if (options.emitProgress) Progress::emitStage("background", "completed", "Background plate ready");
+        }
+        std::string subtitle_filter = "ass='" + ass_ffmpeg_path + "':fontsdir='" + fonts_ffmpeg_path + "'";
+        if (variable_frame_rate) subtitle_filter += ",mpdecimate=hi=64:lo=64:frac=0";
+
+        Render::Plan plan;
+        plan.emitProgress = options.emitProgress;
         
         // Add background video inputs
         if (!bgInputFiles.empty()) {
             // Dynamic backgrounds - add all video files as inputs
             for (const auto& bgFile : bgInputFiles) {
-                final_cmd << "-i \"" << to_ffmpeg_path(bgFile) << "\" ";
+                Render::Input input;
+                input.path = to_ffmpeg_path(bgFile);
+                plan.inputs.push_back(input);
             }
         } else {
             // Static background with loop
-            final_cmd << "-stream_loop -1 -i \"" << to_ffmpeg_path(config.assetBgVideo) << "\" ";
+            Render::Input input;
+            input.path = to_ffmpeg_path(static_bg_path);
+            input.streamLoop = still_background ? 0 : -1;
+            plan.inputs.push_back(input);
         }
-        
-        // Handle audio differently for gapped vs gapless
-        if (config.recitationMode == RecitationMode::GAPLESS) {
-            // For gapless: use single surah audio file with precise trimming
-            if (verses.empty()) throw std::runtime_error("No verses to render");
-            
-            std::string audioPath;
-            for (const auto& verse : verses) {
-                if (verse.localAudioPath.empty()) continue;
-                audioPath = verse.localAudioPath;
-                if (verse.fromCustomAudio) break;
+
+        // Video chain: background, optional overlay, then subtitles
+        std::ostringstream video_chain;
+        if (!bgInputFiles.empty()) {
+            // Dynamic backgrounds - use the pre-built filter complex
+            video_chain << bgFilterComplex;
+        } else {
+            // Static background
+            video_chain << "[0:v]setpts=PTS-STARTPTS" << static_bg_filter;
+        }
+        video_chain << overlay_filter;
+        if (options.draft) {
+            // The contact sheet samples the subtitled frames the reviewer will see in the draft.
+            video_chain << "," << subtitle_filter << ",split=2[v][sheet];[sheet]"
+                        << contact_sheet_filter(contactSheetTimes(config, verses, segmentManager), frame_rate)
+                        << "[contact]";
+        } else {
+            // Decode and composite the background once, then scale a copy per rendition. The last
+            // copy keeps only its first frame, which becomes the thumbnail.
+            fs::path thumbnail_ass = write_thumbnail_ass(options, config);
+            size_t thumbnail_branch = renditions.size() + 1;
+            video_chain << ",split=" << thumbnail_branch + 1 << "[bg0]";
+            for (size_t i = 1; i <= thumbnail_branch; ++i) video_chain << "[bg" << i << "]";
+            video_chain << ";[bg0]" << subtitle_filter << "[v]";
+            for (size_t i = 0; i < renditions.size(); ++i) {
+                const auto& target = renditions[i];
+                std::string ass = SubtitleBuilder::buildAssFile(target.config, target.options, verses, intro_duration,
+                                                                pause_after_intro_duration, segmentManager);
+                std::string size = std::to_string(target.config.width) + ":" + std::to_string(target.config.height);
+                video_chain << ";[bg" << i + 1 << "]scale=" << size << ":force_original_aspect_ratio=increase,crop="
+                            << size << ",ass='" << to_ffmpeg_filter_path(fs::path(ass)) << "':fontsdir='"
+                            << fonts_ffmpeg_path << "'";
+                if (variable_frame_rate) video_chain << ",mpdecimate=hi=64:lo=64:frac=0";
+                video_chain << "[v" << i + 1 << "]";
             }
-            if (audioPath.empty()) throw std::runtime_error("No audio path found for gapless render");
-            bool customClip = !verses.empty() && verses[0].fromCustomAudio;
-            double startTime = customClip ? 0.0 : minTimestampSec;
-            double endTime = customClip ? verses_duration : maxTimestampSec;
-            double trimmedDuration = std::max(0.0, endTime - startTime);
-            double measuredAudioDuration = customClip
-                ? Audio::CustomAudioProcessor::probeDuration(audioPath)
-                : trimmedDuration;
-            double audioDuration = customClip
-                ? std::max(measuredAudioDuration, verses_duration)
-                : measuredAudioDuration;
-            total_duration = intro_duration + pause_after_intro_duration + audioDuration;
-            
-            final_cmd << "-f lavfi -t " << (intro_duration + pause_after_intro_duration) << " -i anullsrc=r=44100:cl=stereo ";
-            if (!customClip) {
-                final_cmd << "-ss " << startTime << " -t " << trimmedDuration << " ";
+            video_chain << ";[bg" << thumbnail_branch << "]trim=end_frame=1,ass='" << to_ffmpeg_filter_path(thumbnail_ass)
+                        << "':fontsdir='" << fonts_ffmpeg_path << "'[thumb]";
+        }
+
+        std::string audioFilter;
+        size_t audio_input_start = plan.inputs.size();
+        std::string audioMap = append_audio_inputs(plan, options, config, verses, minTimestampSec, maxTimestampSec,
+                                                   total_duration, audioFilter);
+
+        // The mixed AAC track is cached per reciter/range/padding and stream-copied on reuse.
+        // In-process renders cannot stream-copy, so they keep encoding audio.
+        fs::path audio_track;
+        bool audio_track_cached = false;
+        if (!options.noCache && options.renderEngine != "libav" && !verses.empty()) {
+            audio_track = AudioTrack::trackPath(AudioTrack::trackKey(config, options, verses));
+            audio_track_cached = CacheUtils::fileIsValid(audio_track);
+        }
+        Render::OptionList audio_options = AudioTrack::encodeOptions();
+        if (audio_track_cached) {
+            std::cout << "Using cached audio track: " << audio_track.string() << std::endl;
+            plan.inputs.resize(audio_input_start);
+            Render::Input track;
+            track.path = to_ffmpeg_path(audio_track);
+            plan.inputs.push_back(track);
+            audioFilter.clear();
+            audioMap = std::to_string(audio_input_start) + ":a";
+            audio_options = {{"c:a", "copy"}};
+        }
+        if (!audio_track.empty()) {
+            MetadataWriter::mergeIntoMetadata(options, "audioTrack",
+                                              {{"file", audio_track.string()}, {"reused", audio_track_cached}});
+        }
+
+        bool streaming = !options.streamFormat.empty();
+        std::vector<ClipIndex::Entry> clip_entries = ClipIndex::timeline(config, verses, segmentManager);
+        bool single_pass = streaming || !renditions.empty();
+        // A filter output can only be mapped once, so split the mixed audio per consumer.
+        std::vector<std::string> rendition_audio_maps(renditions.size(), audioMap);
+        std::string audio_cache_map = audioMap;
+        bool write_audio_track = !audio_track.empty() && !audio_track_cached;
+        size_t audio_copies = 1 + (streaming ? 0 : renditions.size()) + (write_audio_track ? 1 : 0);
+        if (audio_copies > 1 && audioMap.front() == '[') {
+            std::ostringstream audio_split;
+            audio_split << audioMap << "asplit=" << audio_copies << "[am]";
+            size_t next = 1;
+            for (size_t i = 0; i < renditions.size() && !streaming; ++i) {
+                rendition_audio_maps[i] = "[a" + std::to_string(next++) + "]";
+                audio_split << rendition_audio_maps[i];
             }
-            final_cmd << "-i \"" << to_ffmpeg_path(audioPath) << "\" ";
-            
-            // Build filter complex
-            final_cmd << "-filter_complex \"";
-            
-            // Handle video part
-            if (!bgInputFiles.empty()) {
-                // Dynamic backgrounds - use the pre-built filter complex
-                final_cmd << bgFilterComplex;
-            } else {
-                // Static background
-                final_cmd << "[0:v]setpts=PTS-STARTPTS,scale=" << config.width << ":" << config.height;
+            if (write_audio_track) {
+                audio_cache_map = "[a" + std::to_string(next) + "]";
+                audio_split << audio_cache_map;
             }
-            
-            // Add overlay if needed
-            if (apply_overlay) {
-                final_cmd << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << config.overlayColor << ":t=fill";
+            audioFilter += ";" + audio_split.str();
+            audioMap = "[am]";
+        }
+        plan.filterComplex = video_chain.str();
+        if (!audioFilter.empty()) plan.filterComplex += ";" + audioFilter;
+        plan.totalDurationSeconds = total_duration;
+
+        if (single_pass && (options.renderChunks > 1 || options.incremental)) {
+            std::cerr << "Warning: " << (streaming ? "Segmented output" : "Renditions")
+                      << " render in a single pass; ignoring chunked and incremental rendering." << std::endl;
+        }
+        int chunk_count = single_pass ? 1 : resolveChunkCount(options.renderChunks, total_duration);
+        int parallel_encodes = chunk_count;
+        std::vector<ChunkRange> chunks;
+        if (options.incremental && !single_pass) {
+            // Segment boundaries depend only on the timeline so edits to styling or text keep them.
+            int segment_count = std::max(1, static_cast<int>(std::lround(total_duration / kIncrementalSegmentSeconds)));
+            chunks = planChunks(computeVerseBoundaries(config, verses), total_duration, config.fps, segment_count);
+            parallel_encodes = std::min(static_cast<int>(chunks.size()),
+                                        resolveChunkCount(options.renderChunks == 1 ? 0 : options.renderChunks, total_duration));
+        } else if (chunk_count > 1) {
+            chunks = planChunks(computeVerseBoundaries(config, verses), total_duration, config.fps, chunk_count);
+            parallel_encodes = static_cast<int>(chunks.size());
+        }
+
+        if (!renditions.empty()) parallel_encodes = static_cast<int>(renditions.size()) + 1;
+        EncoderTuning::Settings tuning = EncoderTuning::forJob(options, config, std::max(1, parallel_encodes));
+        std::cout << "Encoder threads: " << tuning.encoderThreads << " (" << tuning.source << ", "
+                  << tuning.cores << " cores, " << tuning.concurrentJobs << " active render(s)), filter threads: "
+                  << tuning.filterThreads << std::endl;
+        MetadataWriter::mergeIntoMetadata(options, "encoderTuning", EncoderTuning::toJson(tuning));
+
+        if (chunks.size() > 1 || (options.incremental && !single_pass)) {
+            ChunkedRenderInputs chunk_inputs;
+            chunk_inputs.bgInputFiles = bgInputFiles;
+            chunk_inputs.bgFilterComplex = bgFilterComplex;
+            chunk_inputs.bgClips = bgManager.segments();
+            chunk_inputs.overlayFilter = overlay_filter;
+            chunk_inputs.staticBackgroundPath = static_bg_path;
+            chunk_inputs.staticBackgroundFilter = static_bg_filter;
+            chunk_inputs.stillBackground = still_background;
+            chunk_inputs.variableFrameRate = variable_frame_rate;
+            chunk_inputs.parallelEncodes = std::max(1, parallel_encodes);
+            if (options.incremental) {
+                fs::path output_path(options.output);
+                chunk_inputs.segmentDir = (output_path.parent_path() / (output_path.stem().string() + ".segments")).string();
+                chunk_inputs.assPath = ass_filename;
             }
-            
-            // Add subtitles
-            final_cmd << ",ass='" << ass_ffmpeg_path << "':fontsdir='" 
-                      << fonts_ffmpeg_path << "'[v];";
-            
-            // Handle audio concatenation
-            int audioInputIndex = bgInputFiles.empty() ? 1 : bgInputFiles.size();
-            final_cmd << "[" << audioInputIndex << ":a][" << (audioInputIndex + 1) << ":a]concat=n=2:v=0:a=1[a]\" ";
-            
-            // Map outputs
-            final_cmd << "-map \"[v]\" -map \"[a]\" "
-                      << "-t " << total_duration << " ";
-                      
+            chunk_inputs.subtitleFilter = subtitle_filter;
+            chunk_inputs.clipEntries = clip_entries;
+            chunk_inputs.audioTrackPath = audio_track.string();
+            render_chunked(options, config, verses, chunks, chunk_inputs, tuning, minTimestampSec, maxTimestampSec,
+                           total_duration, processExecutor, renderEngine);
+            // Chunk plans do not carry the thumbnail branch; cut it from the first background frame
+            // through the same scaling and overlay the chunks apply.
+            std::string thumbnail_filter = bgInputFiles.empty()
+                ? static_bg_filter
+                : ",scale=" + std::to_string(config.width) + ":" + std::to_string(config.height) +
+                      ",format=" + config.pixelFormat + ",setsar=1";
+            generateThumbnail(options, config, processExecutor,
+                              bgInputFiles.empty() ? static_bg_path : bgInputFiles.front(),
+                              thumbnail_filter + overlay_filter, renderEngine);
         } else {
-            // For gapped: concatenate individual ayah audio files
-            std::string concat_file_path = (fs::temp_directory_path() / "audiolist.txt").string();
-            {
-                std::ofstream concat_file(concat_file_path);
-                if (!concat_file.is_open()) throw std::runtime_error("Failed to create audio list file.");
-                for (const auto& verse : verses) {
-                    concat_file << "file '" << to_ffmpeg_path(fs::absolute(verse.localAudioPath)) << "'\n";
-                }
+            // Video encoder options per output stream: the main video, then each rendition.
+            std::vector<Render::OptionList> video_options;
+            auto add_video_options = [&](const CLIOptions& streamOptions, const AppConfig& streamConfig) {
+                Render::OptionList codec = build_video_codec_options(streamOptions, streamConfig);
+                add_still_background_options(codec, still_background, variable_frame_rate);
+                EncoderTuning::apply(tuning, codec);
+                codec.emplace_back("pix_fmt", streamConfig.pixelFormat);
+                video_options.push_back(codec);
+            };
+            if (options.draft) {
+                CLIOptions draft_options = options;
+                draft_options.encoder = "software";
+                draft_options.preset = "ultrafast";
+                AppConfig draft_config = config;
+                draft_config.crf = kDraftCrf;
+                draft_config.videoBitrate.clear();
+                draft_config.videoMaxRate.clear();
+                draft_config.videoBufSize.clear();
+                add_video_options(draft_options, draft_config);
+            } else {
+                add_video_options(options, config);
             }
-            
-            double totalVideoDuration = intro_duration + pause_after_intro_duration;
-            for(const auto& verse : verses) totalVideoDuration += verse.durationInSeconds;
-            total_duration = totalVideoDuration;
-            
-            int audioInputIndex = bgInputFiles.empty() ? 1 : bgInputFiles.size();
-            final_cmd << "-itsoffset " << (intro_duration + pause_after_intro_duration) << " "
-                      << "-f concat -safe 0 -i \"" << to_ffmpeg_path(concat_file_path) << "\" ";
-            
-            // Build filter complex
-            final_cmd << "-filter_complex \"";
-            
-            // Handle video part
-            if (!bgInputFiles.empty()) {
-                // Dynamic backgrounds - use the pre-built filter complex
-                final_cmd << bgFilterComplex;
+            for (const auto& target : renditions) add_video_options(target.options, target.config);
+
+            std::string manifest_path;
+            if (streaming) {
+                manifest_path = streamManifestPath(options);
+                plan.outputs.push_back(build_stream_output(options, renditions, video_options, audioMap, audio_options,
+                                                           computeVerseBoundaries(config, verses), total_duration,
+                                                           config.fps));
             } else {
-                // Static background
-                final_cmd << "[0:v]setpts=PTS-STARTPTS,scale=" << config.width << ":" << config.height;
+                for (size_t i = 0; i < video_options.size(); ++i) {
+                    Render::Output output;
+                    output.path = i == 0 ? options.output : renditions[i - 1].options.output;
+                    output.maps = {i == 0 ? "[v]" : "[v" + std::to_string(i) + "]",
+                                   i == 0 ? audioMap : rendition_audio_maps[i - 1]};
+                    output.durationSeconds = total_duration;
+                    output.options = video_options[i];
+                    add_verse_keyframes(output.options, clip_entries);
+                    output.options.insert(output.options.end(), audio_options.begin(), audio_options.end());
+                    output.options.emplace_back("movflags", "+faststart");
+                    plan.outputs.push_back(output);
+                }
             }
-            
-            // Add overlay if needed
-            if (apply_overlay) {
-                final_cmd << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << config.overlayColor << ":t=fill";
+
+            // Drafts write the contact sheet and leave the real thumbnail alone.
+            Render::Output still;
+            still.path = to_ffmpeg_path(options.draft ? contactSheetPath(options) : thumbnailPath(options));
+            still.maps = {options.draft ? "[contact]" : "[thumb]"};
+            still.options = {{"frames:v", "1"}, {"q:v", "2"}};
+            plan.outputs.push_back(still);
+
+            // On a miss the same run also writes the audio track to the cache.
+            fs::path audio_partial;
+            if (write_audio_track) {
+                audio_partial = CacheUtils::uniquePartialPath(audio_track);
+                Render::Output track;
+                track.path = to_ffmpeg_path(audio_partial);
+                track.maps = {audio_cache_map};
+                track.durationSeconds = total_duration;
+                track.options = AudioTrack::encodeOptions();
+                plan.outputs.push_back(track);
             }
-            
-            // Add subtitles
-            final_cmd << ",ass='" << ass_ffmpeg_path << "':fontsdir='" 
-                      << fonts_ffmpeg_path << "'[v]\" ";
-            
-            // Map outputs
-            final_cmd << "-map \"[v]\" -map " << audioInputIndex << ":a "
-                      << "-t " << totalVideoDuration << " ";
-        }
 
-        // Add encoding options
-        final_cmd << video_codec.str() << " "
-                  << "-c:a aac -b:a 128k "
-                  << "-pix_fmt " << config.pixelFormat << " "
-                  << "-movflags +faststart "
-                  << "-threads 8 "
-                  << "\"" << options.output << "\"";
+            nlohmann::json rendition_metadata = nlohmann::json::array();
+            for (const auto& target : renditions) {
+                std::string rendition_output = target.options.output;
+                if (streaming) {
+                    rendition_output = options.streamFormat == "hls"
+                        ? (fs::path(manifest_path).parent_path() / target.name / "index.m3u8").string()
+                        : manifest_path;
+                }
+                rendition_metadata.push_back({
+                    {"name", target.name},
+                    {"output", rendition_output},
+                    {"width", target.config.width},
+                    {"height", target.config.height},
+                    {"qualityProfile", target.options.qualityProfile}
+                });
+            }
+            if (!renditions.empty()) {
+                MetadataWriter::mergeIntoMetadata(options, "renditions", rendition_metadata);
+            }
+            if (streaming) {
+                MetadataWriter::mergeIntoMetadata(options, "stream",
+                                                  {{"format", options.streamFormat}, {"manifest", manifest_path}});
+            }
+            plan.filterThreads = tuning.filterThreads;
+
+            Render::runPlan(plan, processExecutor, renderEngine);
+            if (!audio_partial.empty()) AudioTrack::store(audio_partial, audio_track);
+        }
 
-        std::cout << "\nExecuting FFmpeg command:\n" << final_cmd.str() << std::endl << std::endl;
-        
-        if (options.emitProgress) {
-            processExecutor->executeWithProgress(final_cmd.str(), total_duration);
-        } else {
-            int exit_code = processExecutor->execute(final_cmd.str());
-            if (exit_code != 0) throw std::runtime_error("FFmpeg execution failed");
+        // Verse index for `--extract`; keyframe positions come from the finished files.
+        if (!streaming) {
+            std::vector<std::string> indexed = {options.output};
+            for (const auto& target : renditions) indexed.push_back(target.options.output);
+            for (const auto& media : indexed) {
+                ClipIndex::Index index;
+                index.surah = options.surah;
+                index.media = fs::path(media).filename().string();
+                index.entries = clip_entries;
+                if (!ClipIndex::locateKeyframes(index.entries, media, frame_rate)) {
+                    std::cerr << "Warning: Could not read keyframes of " << media
+                              << "; the clip index records verse times only." << std::endl;
+                }
+                try {
+                    ClipIndex::write(index, media);
+                } catch (const std::exception& e) {
+                    std::cerr << "Warning: " << e.what() << std::endl;
+                }
+            }
         }
 
         // Cleanup temporary background video files
         bgManager.cleanup();
 
-        std::cout << "\n✅ Render complete! Video saved to: " << options.output << std::endl;
+        std::cout << "\n✅ Render complete! Video saved to: "
+                  << (options.streamFormat.empty() ? options.output : streamManifestPath(options)) << std::endl;
+        if (options.draft) std::cout << "Contact sheet saved to: " << contactSheetPath(options) << std::endl;
+        return true;
 
     } catch(const std::exception& e) {
         std::cerr << "❌ An error occurred during video generation: " << e.what() << std::endl;
+        return false;
     }
 }
 
-void VideoGenerator::generateThumbnail(const CLIOptions& options, const AppConfig& config, std::shared_ptr<Interfaces::IProcessExecutor> processExecutor) {
+bool VideoGenerator::generateThumbnail(const CLIOptions& options,
+                                       const AppConfig& config,
+                                       std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
+                                       const std::string& backgroundPath,
+                                       const std::string& backgroundFilter,
+                                       std::shared_ptr<Interfaces::IRenderEngine> renderEngine) {
     try {
-        std::string output_dir = fs::path(options.output).parent_path().string();
-        std::string thumbnail_path = (fs::path(output_dir) / "thumbnail.jpeg").string();
-
-        std::string language_code = LocalizationUtils::getLanguageCode(config);
-        std::string localized_surah_label = LocalizationUtils::getLocalizedSurahLabel(language_code);
-        std::string localized_surah_name = LocalizationUtils::getLocalizedSurahName(options.surah, language_code);
-        std::string localized_reciter_name = LocalizationUtils::getLocalizedReciterName(config.reciterId, language_code);
-        std::string localized_surah_number = LocalizationUtils::getLocalizedNumber(options.surah, language_code);
-
-        auto with_fallback = [&](const std::string& text) {
-            return SubtitleBuilder::applyLatinFontFallback(
-                text,
-                config.translationFallbackFontFamily,
-                config.translationFont.family);
-        };
-        std::string rendered_label = with_fallback(localized_surah_label);
-        std::string rendered_surah_name = with_fallback(localized_surah_name);
-        std::string rendered_reciter_name = with_fallback(localized_reciter_name);
-        std::string rendered_surah_number = with_fallback(localized_surah_number);
-
-        std::vector<std::string> colors = config.thumbnailColors;
-        if (colors.empty()) {
-            colors = {
-                "&HFFFFFF&", // White
-                "&HC0C0C0&", // Silver
-                "&H00D7FF&"  // Gold
-            };
-        }
-
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, colors.size() - 1);
-
-        auto pick_color = [&]() { return colors[dis(gen)]; };
-
-        int base_font_size = config.translationFont.size;
-        int scaled_font_size = static_cast<int>(base_font_size * (config.width * 0.7 / (base_font_size * 3.0)));
-        if (scaled_font_size < base_font_size) scaled_font_size = base_font_size;
-        int label_size = scaled_font_size / 3;
-        int reciter_size = scaled_font_size / 3;
-
-        std::uniform_int_distribution<> side_dis(0, 1);
-        int padding = config.thumbnailNumberPadding;
-        bool right_side = side_dis(gen) == 1;
-        int number_x = right_side ? (config.width - padding) : padding;
-        std::string align = right_side ? "9" : "7";
-
-        std::string number_color = pick_color();
-        int number_size = scaled_font_size * 0.5;
-
-        fs::path ass_path = fs::temp_directory_path() / "thumbnail.ass";
-        std::ofstream ass_file(ass_path);
-        if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary ASS file.");
-
-        ass_file << "[Script Info]\nTitle: Thumbnail\nScriptType: v4.00+\n";
-        ass_file << "PlayResX: " << config.width << "\nPlayResY: " << config.height << "\n\n";
-
-        ass_file << "[V4+ Styles]\n";
-        ass_file << "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n";
-        ass_file << "Style: Label," << config.translationFont.family << "," << label_size 
-                << "," << pick_color() << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,3,1,3,10,10,10,-1\n";
-        ass_file << "Style: Main," << config.translationFont.family << "," << scaled_font_size 
-                << "," << pick_color() << ",&H000000FF&, &H000000&, &H00000000&,1,0,0,0,100,100,0,0,1,5,3,5,10,10,10,-1\n";
-        ass_file << "Style: Reciter," << config.translationFont.family << "," << reciter_size 
-                << "," << pick_color() << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,3,1,3,10,10,10,-1\n";
-        ass_file << "Style: Number," << config.translationFont.family << "," << number_size 
-                << "," << number_color << ",&H000000FF&, &H003333&, &H00000000&,1,0,0,0,100,100,0,0,1,5,3,5,10,10,10,-1\n\n";
-
-        ass_file << "[Events]\n";
-        ass_file << "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
-        ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Label,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2 - scaled_font_size*0.6) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_label << "\n";
-        ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Main,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_surah_name << "\n";
-        ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Reciter,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << (config.height/2 + scaled_font_size*0.6) << ")\\fad(0," << config.introFadeOutMs << ")}" << rendered_reciter_name << "\n";
-        ass_file << "Dialogue: 0,0:00:00.00,0:00:05.00,Number,,0,0,0,,{\\an" << align << "\\pos(" << number_x << ",50)\\fad(0," << config.introFadeOutMs << ")}" << rendered_surah_number << "\n";
-                
-        ass_file.close();
-
+        Tracing::Span span("generateThumbnail");
+        std::string thumbnail = thumbnailPath(options);
+        fs::path ass_path = write_thumbnail_ass(options, config);
         std::string fonts_dir = to_ffmpeg_filter_path(fs::absolute(config.assetFolderPath) / "fonts");
+        std::string background = backgroundPath.empty() ? config.assetBgVideo : backgroundPath;
+        std::string filter = backgroundFilter + ",ass='" + to_ffmpeg_filter_path(ass_path) +
+                             "':fontsdir='" + fonts_dir + "'";
 
-        std::stringstream cmd;
-        cmd << "ffmpeg -y "
-            << "-ss 0 "
-            << "-i \"" << to_ffmpeg_path(config.assetBgVideo) << "\" "
-            << "-vf \"ass='" << to_ffmpeg_filter_path(ass_path) << "':fontsdir='" << fonts_dir << "'\" "
-            << "-frames:v 1 "
-            << "-q:v 2 "
-            << "\"" << thumbnail_path << "\"";
-
-        int exit_code = processExecutor->execute(cmd.str());
-        if (exit_code != 0) throw std::runtime_error("FFmpeg thumbnail generation failed");
+        Render::Plan plan;
+        Render::Input input;
+        input.path = to_ffmpeg_path(background);
+        input.seekSeconds = 0.0;
+        plan.inputs.push_back(input);
+        plan.filterComplex = "[0:v]" + filter.substr(1) + "[thumb]";
+        Render::Output still;
+        still.path = to_ffmpeg_path(thumbnail);
+        still.maps = {"[thumb]"};
+        still.options = {{"frames:v", "1"}, {"q:v", "2"}};
+        plan.outputs.push_back(still);
+        Render::runPlan(plan, processExecutor, renderEngine);
 
-        std::cout << "✅ Thumbnail saved to: " << thumbnail_path << std::endl;
+        std::cout << "✅ Thumbnail saved to: " << thumbnail << std::endl;
+        return true;
 
     } catch(const std::exception& e) {
         std::cerr << "❌ An error occurred during thumbnail generation: " << e.what() << std::endl;
+        return false;
     }
 }
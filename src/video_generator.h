@@ -1,17 +1,83 @@
 #pragma once
 #include "types.h"
 #include "interfaces/IProcessExecutor.h"
+#include "interfaces/IRenderEngine.h"
 #include "verse_segmentation.h"
-#include <vector>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace VideoGenerator {
-    void generateVideo(const CLIOptions& options, 
+    // Half-open [startSeconds, endSeconds) slice of the output timeline.
+    struct ChunkRange {
+        double startSeconds;
+        double endSeconds;
+    };
+
+    // Start time of each verse on the output timeline (after intro and pause).
+    std::vector<double> computeVerseBoundaries(const AppConfig& config, const std::vector<VerseData>& verses);
+
+    // Resolves --chunks (0 = auto from core count), capped so chunks stay reasonably long.
+    int resolveChunkCount(int requested, double totalDurationSeconds);
+
+    // Splits the timeline into up to chunkCount ranges, cutting at the candidate times
+    // (snapped to the frame grid) closest to an even split.
+    std::vector<ChunkRange> planChunks(const std::vector<double>& cutCandidates,
+                                       double totalDurationSeconds,
+                                       int fps,
+                                       int chunkCount);
+
+    // ASS script header plus the Dialogue lines visible in [startSeconds, endSeconds): everything
+    // that decides the subtitle pixels of that window. Used to key incremental segments.
+    std::string subtitleEventsInWindow(const std::string& assContent, double startSeconds, double endSeconds);
+
+    // Keyframe times for --stream-format output: 0, every verse start, and evenly spaced extra
+    // cuts so that no segment is longer than maxSegmentSeconds.
+    std::vector<double> planStreamKeyframes(const std::vector<double>& verseStarts,
+                                            double totalDurationSeconds,
+                                            double maxSegmentSeconds);
+
+    // Master playlist (HLS) or manifest (DASH) written for --stream-format, inside a directory
+    // named after the output stem; empty when streaming output is off.
+    std::string streamManifestPath(const CLIOptions& options);
+
+    // Midpoint of every verse, or of every segment of a segmented verse, on the output timeline:
+    // the frames of the --draft contact sheet.
+    std::vector<double> contactSheetTimes(const AppConfig& config,
+                                          const std::vector<VerseData>& verses,
+                                          const VerseSegmentation::Manager* segmentManager);
+
+    // Contact sheet written by --draft renders: <output stem>-contact.jpg next to the output.
+    std::string contactSheetPath(const CLIOptions& options);
+
+    // Thumbnail of a render: thumbnail.jpeg next to the output, or <output stem>-thumbnail.jpeg for
+    // batch and daemon jobs (jobOutputNames), so jobs writing to one directory keep their own.
+    std::string thumbnailPath(const CLIOptions& options);
+
+    // An additional output with its own size, quality settings and subtitle layout.
+    struct RenditionOutput {
+        std::string name;
+        CLIOptions options;
+        AppConfig config;
+    };
+
+    // Renders the video (plus any renditions, from the same decode pass) and its thumbnail (see
+    // thumbnailPath), cut from the first composited background frame; returns false (after
+    // logging) if rendering failed.
+    bool generateVideo(const CLIOptions& options, 
                        const AppConfig& config, 
                        const std::vector<VerseData>& verses, 
                        std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
-                       const VerseSegmentation::Manager* segmentManager = nullptr);
-    void generateThumbnail(const CLIOptions& options, 
+                       const VerseSegmentation::Manager* segmentManager = nullptr,
+                       std::shared_ptr<Interfaces::IRenderEngine> renderEngine = nullptr,
+                       const std::vector<RenditionOutput>& renditions = {});
+    // Standalone thumbnail from the first frame of backgroundPath (default: config.assetBgVideo),
+    // for renders whose encode cannot carry the thumbnail output. backgroundFilter is a
+    // comma-led chain (",scale=...,drawbox=...") that composites the frame before the text.
+    bool generateThumbnail(const CLIOptions& options, 
                            const AppConfig& config, 
-                           std::shared_ptr<Interfaces::IProcessExecutor> processExecutor);
+                           std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
+                           const std::string& backgroundPath = "",
+                           const std::string& backgroundFilter = "",
+                           std::shared_ptr<Interfaces::IRenderEngine> renderEngine = nullptr);
 }
\ No newline at end of file
@@ -16,6 +16,22 @@ extern "C" {
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
+namespace {
+
+// Re-encodes a clip to the 720p30 H.264 format background videos are stored in (no audio).
+// ffmpeg's stderr stays out of the log unless the encode fails.
+bool standardize_file(Interfaces::IProcessExecutor& executor, const fs::path& input, const fs::path& output) {
+    return executor.executeArgs({"ffmpeg", "-y", "-i", input.string(),
+                                 "-c:v", "libx264", "-preset", "fast", "-crf", "23",
+                                 "-s", "1280x720", "-r", "30",
+                                 "-pix_fmt", "yuv420p",
+                                 "-an",
+                                 "-movflags", "+faststart",
+                                 output.string()}) == 0;
+}
+
+} // namespace
+
 namespace VideoStandardizer {
 
 std::string getCurrentTimestamp() {
@@ -33,9 +49,11 @@ std::string getCurrentTimestamp() {
 }
 
 // clean me  up by removing boolean flag and splitting into two functions
-void standardizeDirectory(const std::string& path, bool isR2Bucket) {
+void standardizeDirectory(const std::string& path,
+                          const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                          bool isR2Bucket) {
     if (isR2Bucket) {
-        standardizeR2Bucket(path);
+        standardizeR2Bucket(path, processExecutor);
         return;
     }
     
@@ -80,20 +98,10 @@ void standardizeDirectory(const std::string& path, bool isR2Bucket) {
             fs::path outputPath = videoEntry.path().parent_path() / 
                                   (videoEntry.path().stem().string() + "_std.mp4");
             
-            std::ostringstream cmd;
-            cmd << "ffmpeg -y -i \"" << videoEntry.path().string() << "\" "
-                << "-c:v libx264 -preset fast -crf 23 "
-                << "-s 1280x720 -r 30 "
-                << "-pix_fmt yuv420p "
-                << "-an "  // Remove audio
-                << "-movflags +faststart "
-                << "\"" << outputPath.string() << "\" 2>/dev/null";
-            
             std::cout << "  Standardizing: " << videoEntry.path().filename() << " -> " 
                       << outputPath.filename() << std::endl;
             
-            int result = std::system(cmd.str().c_str());
-            if (result == 0 && fs::exists(outputPath)) {
+            if (standardize_file(*processExecutor, videoEntry.path(), outputPath) && fs::exists(outputPath)) {
                 // Get duration
                 AVFormatContext* ctx = nullptr;
                 double duration = 0.0;
@@ -136,7 +144,8 @@ void standardizeDirectory(const std::string& path, bool isR2Bucket) {
     std::cout << "Metadata saved to: " << metadataPath << std::endl;
 }
 
-void standardizeR2Bucket(const std::string& bucketName) {
+void standardizeR2Bucket(const std::string& bucketName,
+                         const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor) {
     std::cout << "Standardizing R2 bucket: " << bucketName << std::endl;
     
     // Get R2 config from environment
@@ -199,19 +208,9 @@ void standardizeR2Bucket(const std::string& bucketName) {
                 std::string stdFilename = fs::path(filename).stem().string() + "_std.mp4";
                 fs::path stdPath = tempDir / stdFilename;
                 
-                std::ostringstream cmd;
-                cmd << "ffmpeg -y -i \"" << localPath.string() << "\" "
-                    << "-c:v libx264 -preset fast -crf 23 "
-                    << "-s 1280x720 -r 30 "
-                    << "-pix_fmt yuv420p "
-                    << "-an "  // Remove audio
-                    << "-movflags +faststart "
-                    << "\"" << stdPath.string() << "\" 2>/dev/null";
-                
                 std::cout << "  Standardizing: " << filename << " -> " << stdFilename << std::endl;
                 
-                int result = std::system(cmd.str().c_str());
-                if (result == 0 && fs::exists(stdPath)) {
+                if (standardize_file(*processExecutor, localPath, stdPath) && fs::exists(stdPath)) {
                     // Get duration
                     AVFormatContext* ctx = nullptr;
                     double duration = 0.0;
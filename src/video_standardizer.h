@@ -1,8 +1,14 @@
 #pragma once
+#include "interfaces/IProcessExecutor.h"
+#include <memory>
 #include <string>
 
 namespace VideoStandardizer {
-    void standardizeDirectory(const std::string& path, bool isR2Bucket = false);
-    void standardizeR2Bucket(const std::string& bucketName);
+    // Re-encodes each clip through processExecutor.
+    void standardizeDirectory(const std::string& path,
+                              const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor,
+                              bool isR2Bucket = false);
+    void standardizeR2Bucket(const std::string& bucketName,
+                             const std::shared_ptr<Interfaces::IProcessExecutor>& processExecutor);
     std::string getCurrentTimestamp();
 }
\ No newline at end of file
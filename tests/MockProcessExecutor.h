@@ -1,17 +1,24 @@
 #pragma once
 #include "interfaces/IProcessExecutor.h"
+#include <fstream>
 #include <vector>
 #include <string>
 
 class MockProcessExecutor : public Interfaces::IProcessExecutor {
 public:
+    // With writeOutputs, each command "produces" its last argument (the output file) so code
+    // that renames or reuses outputs can be exercised.
+    explicit MockProcessExecutor(bool writeOutputs = false) : writeOutputs_(writeOutputs) {}
+
     int execute(const std::string& command) override {
         commands.push_back(command);
+        writeOutput(command);
         return 0;
     }
 
     void executeWithProgress(const std::string& command, double totalDurationSeconds) override {
         commands.push_back(command);
+        writeOutput(command);
     }
 
     const std::vector<std::string>& getCommands() const {
@@ -19,5 +26,31 @@ public:
     }
 
 private:
+    // Last argument of a command line built by joinCommand/buildFfmpegCommand.
+    static std::string lastArgument(const std::string& command) {
+        if (command.empty()) return "";
+        if (command.back() != '"') return command.substr(command.find_last_of(' ') + 1);
+        size_t open = command.size() - 1;
+        while (open > 0) {
+            --open;
+            if (command[open] != '"') continue;
+            size_t backslashes = 0;
+            while (open > backslashes && command[open - 1 - backslashes] == '\\') ++backslashes;
+            if (backslashes % 2 == 0) break;
+        }
+        std::string argument;
+        for (size_t i = open + 1; i + 1 < command.size(); ++i) {
+            if (command[i] == '\\' && i + 2 < command.size()) ++i;
+            argument.push_back(command[i]);
+        }
+        return argument;
+    }
+
+    void writeOutput(const std::string& command) {
+        if (!writeOutputs_) return;
+        std::ofstream(lastArgument(command), std::ios::binary) << "mock output";
+    }
+
+    bool writeOutputs_ = false;
     std::vector<std::string> commands;
 };
@@ -1,7 +1,12 @@
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include "types.h"
 #include "config_loader.h"
 #include "cache_utils.h"
@@ -10,14 +15,36 @@
 #include "subtitle_builder.h"
 #include "timing_parser.h"
 #include "text/text_layout.h"
+#include "text/layout_cache.h"
+#include "text/utf8.h"
 #include "audio/custom_audio_processor.h"
 #include "video_generator.h"
 #include "metadata_writer.h"
+#include "background_plate_cache.h"
+#include "background_video_manager.h"
+#include "audio_track_cache.h"
+#include "render_job.h"
+#include "batch_runner.h"
+#include "render_server.h"
+#include "progress.h"
+#include "tracing.h"
+#include "render_workspace.h"
+#include "clip_index.h"
+#include "quality_tuning.h"
+#include "encoder_tuning.h"
+#include "render/render_plan.h"
+#include "PosixSpawnProcessExecutor.h"
 #include "MockApiClient.h"
 #include "MockProcessExecutor.h"
 #include <memory>
 #include <nlohmann/json.hpp>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
 namespace fs = std::filesystem;
 using nlohmann::json;
 
@@ -51,6 +78,9 @@ void testCacheUtils() {
     assert(sanitized.find(':') == std::string::npos);
     std::string translation = CacheUtils::getTranslationText(1, "1:1");
     assert(!translation.empty());
+    assert(CacheUtils::hashString("abc") == CacheUtils::hashString("abc"));
+    assert(CacheUtils::hashString("abc") != CacheUtils::hashString("abd"));
+    assert(CacheUtils::hashString("").size() == 16);
 }
 
 void testLocalization() {
@@ -107,11 +137,50 @@ void testSubtitleBuilder() {
     opts.from = 1;
     opts.to = 1;
     AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.layoutCache = false;
     std::vector<VerseData> verses = {makeSampleVerse()};
     std::string assPath = SubtitleBuilder::buildAssFile(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration);
     assert(fs::exists(assPath));
 }
 
+void testParallelSubtitleLayout() {
+    CLIOptions opts;
+    opts.surah = 2;
+    opts.from = 1;
+    opts.to = 60;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.layoutCache = false;
+    assert(SubtitleBuilder::layoutThreadCount() >= 1 && SubtitleBuilder::layoutThreadCount() <= 8);
+
+    std::vector<VerseData> verses;
+    for (int i = 1; i <= 60; ++i) {
+        VerseData verse = makeSampleVerse();
+        verse.verseKey = "2:" + std::to_string(i);
+        verse.translation = "Verse " + std::to_string(i) + " " + std::string(static_cast<size_t>(i % 7) * 30, 'x');
+        verse.durationInSeconds = 2.0;
+        verses.push_back(verse);
+    }
+    std::string assPath = SubtitleBuilder::buildAssFile(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration);
+
+    // Laid out on several threads, the events still come out in verse order.
+    std::ifstream ass(assPath);
+    std::string line;
+    std::vector<std::string> events;
+    while (std::getline(ass, line)) {
+        if (line.rfind("Dialogue:", 0) == 0) events.push_back(line);
+    }
+    assert(events.size() == verses.size() + 2);  // two intro lines
+    TextLayout::Engine engine(cfg);
+    for (size_t i = 0; i < verses.size(); ++i) {
+        const std::string& event = events[i + 2];
+        std::string label = "Verse " + std::to_string(i + 1);
+        size_t at = event.find(label);
+        assert(at != std::string::npos && !std::isdigit(static_cast<unsigned char>(event[at + label.size()])));
+        assert(event.find(engine.layoutVerse(verses[i]).wrappedArabic) != std::string::npos);
+    }
+    fs::remove(assPath);
+}
+
 void testTextLayoutEngine() {
     CLIOptions opts;
     opts.surah = 2;
@@ -130,6 +199,200 @@ void testTextLayoutEngine() {
     assert(layout.wrappedTranslation.find("\\N") != std::string::npos);
 }
 
+void testFontPool() {
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 1;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.layoutCache = false;
+    TextLayout::Engine engine(cfg);
+    VerseData verse = makeSampleVerse();
+    verse.durationInSeconds = 3.0;
+
+    auto first = engine.layoutVerse(verse);
+    auto afterFirst = engine.fontStats();
+    assert(afterFirst.libraries == 1);
+    assert(afterFirst.faceLoads >= 1 && afterFirst.faceLoads <= 2);
+    assert(afterFirst.fontMisses >= 1);
+
+    // Same verse again: every font and shape plan comes from the pool.
+    auto second = engine.layoutVerse(verse);
+    auto afterSecond = engine.fontStats();
+    assert(second.wrappedArabic == first.wrappedArabic);
+    assert(second.wrappedTranslation == first.wrappedTranslation);
+    assert(afterSecond.libraries == 1);
+    assert(afterSecond.faceLoads == afterFirst.faceLoads);
+    assert(afterSecond.fontMisses == afterFirst.fontMisses);
+    assert(afterSecond.fontHits > afterFirst.fontHits);
+    assert(afterSecond.shapePlanMisses == afterFirst.shapePlanMisses);
+    assert(afterSecond.shapePlanHits > afterFirst.shapePlanHits);
+
+    // A second thread gets its own FreeType library.
+    std::thread worker([&]() { engine.layoutVerse(verse); });
+    worker.join();
+    assert(engine.fontStats().libraries == 2);
+}
+
+// Reference for the wrapping rule: greedy, reshaping each growing candidate.
+std::string wrapByReshaping(TextLayout::FontPool& pool, const std::string& file, int size,
+                            const std::string& line, double maxWidth) {
+    if (pool.measure(file, size, line) <= maxWidth) return line;
+    std::istringstream iss(line);
+    std::string word;
+    std::string current;
+    std::string rebuilt;
+    while (iss >> word) {
+        std::string candidate = current.empty() ? word : current + " " + word;
+        if (pool.measure(file, size, candidate) <= maxWidth || current.empty()) {
+            current = candidate;
+        } else {
+            rebuilt += (rebuilt.empty() ? "" : "\\N") + current;
+            current = word;
+        }
+    }
+    if (!current.empty()) rebuilt += (rebuilt.empty() ? "" : "\\N") + current;
+    return rebuilt;
+}
+
+void testLayoutCache() {
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    fs::path tempCache = fs::temp_directory_path() / "qvm_layout_cache_test";
+    fs::remove_all(tempCache);
+    CacheUtils::setCacheRoot(tempCache);
+
+    CLIOptions opts;
+    opts.surah = 2;
+    opts.from = 282;
+    opts.to = 282;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.layoutCache = true;
+    VerseData verse = makeSampleVerse();
+    verse.durationInSeconds = 1.0;
+    for (int i = 0; i < 12; ++i) verse.translation += " and let a scribe write it between you in justice";
+
+    TextLayout::Engine first(cfg);
+    auto before = TextLayout::LayoutCache::shared().stats();
+    auto layout = first.layoutVerse(verse);
+    auto afterFirst = TextLayout::LayoutCache::shared().stats();
+    assert(afterFirst.misses >= before.misses + 2);
+    assert(afterFirst.stores >= before.stores + 2);
+    first.saveLayoutCache();
+    assert(fs::exists(TextLayout::LayoutCache::directory()));
+    assert(!fs::is_empty(TextLayout::LayoutCache::directory()));
+    for (const auto& entry : fs::recursive_directory_iterator(TextLayout::LayoutCache::directory())) {
+        assert(entry.path().filename().string().find(".partial") == std::string::npos);
+    }
+
+    // Known text at a known size: no FreeType or HarfBuzz work at all.
+    TextLayout::Engine second(cfg);
+    auto cached = second.layoutVerse(verse);
+    assert(cached.wrappedArabic == layout.wrappedArabic);
+    assert(cached.wrappedTranslation == layout.wrappedTranslation);
+    assert(second.fontStats().libraries == 0);
+    assert(TextLayout::LayoutCache::shared().stats().hits >= afterFirst.hits + 2);
+
+    // After prewarming, any duration (and so any growth size) is served from the cache, and
+    // matches a layout done without it.
+    TextLayout::Engine warm(cfg);
+    warm.prewarm(verse.text, verse.translation);
+    verse.durationInSeconds = 2.4;
+    TextLayout::Engine third(cfg);
+    auto grown = third.layoutVerse(verse);
+    assert(third.fontStats().libraries == 0);
+    AppConfig uncachedCfg = cfg;
+    uncachedCfg.layoutCache = false;
+    TextLayout::Engine uncached(uncachedCfg);
+    auto reference = uncached.layoutVerse(verse);
+    assert(grown.wrappedArabic == reference.wrappedArabic);
+    assert(grown.wrappedTranslation == reference.wrappedTranslation);
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testUtf8() {
+    assert(Utf8::arabicDigitsToAscii("آية ١٢٣ - 4٥") == "آية 123 - 45");
+    assert(Utf8::containsArabic("Verse: بِسْمِ"));
+    assert(!Utf8::containsArabic("Plain text \xE2\x80\x94 no Arabic"));
+    assert(Utf8::countWords("") == 0);
+    assert(Utf8::countWords("  one\ttwo\n three  ") == 3);
+    assert(Utf8::sequenceLength(0xD8) == 2 && Utf8::sequenceLength(0xF0) == 4 && Utf8::sequenceLength('a') == 1);
+    std::string partial = "kept words  وَلْيَكْتُب  ";
+    Utf8::dropLastWord(partial);
+    assert(partial == "kept words");
+    Utf8::popBack(partial);
+    assert(partial == "kept word");
+
+    // Every kernel agrees with the byte loop, at lengths on both sides of the 16- and 32-byte
+    // blocks and with truncated or stray continuation bytes.
+    std::vector<std::string> inputs = {"", "a", "\xD9", "\xD9\xA3", "\x80\x80 \xD8", "tail \xE0\xA2"};
+    std::string mixed = "The Most Merciful, ٱلرَّحْمَٰنِ ١٢ \t\n(1) ";
+    for (size_t length = 1; length <= 3 * mixed.size(); length += 7) {
+        std::string text;
+        while (text.size() < length) text += mixed;
+        text.resize(length);
+        inputs.push_back(text);
+        inputs.push_back(std::string(length, ' ') + "x");
+        inputs.push_back(std::string(length, 'x') + "\xD9\xA9");
+    }
+
+    const Utf8::Kernel original = Utf8::activeKernel();
+    for (Utf8::Kernel kernel : {Utf8::Kernel::Sse2, Utf8::Kernel::Avx2}) {
+        for (const auto& text : inputs) {
+            Utf8::useKernel(Utf8::Kernel::Scalar);
+            size_t ascii = Utf8::asciiRunLength(text, 1);
+            size_t latin = Utf8::basicLatinRunLength(text);
+            bool hasLatin = Utf8::containsBasicLatin(text);
+            bool arabic = Utf8::containsArabic(text);
+            size_t words = Utf8::countWords(text);
+            std::string digits = Utf8::arabicDigitsToAscii(text);
+            std::string fallback = SubtitleBuilder::applyLatinFontFallback(text, "Latin", "Arabic");
+
+            Utf8::useKernel(kernel);
+            assert(Utf8::asciiRunLength(text, 1) == ascii);
+            assert(Utf8::basicLatinRunLength(text) == latin);
+            assert(Utf8::containsBasicLatin(text) == hasLatin);
+            assert(Utf8::containsArabic(text) == arabic);
+            assert(Utf8::countWords(text) == words);
+            assert(Utf8::arabicDigitsToAscii(text) == digits);
+            assert(SubtitleBuilder::applyLatinFontFallback(text, "Latin", "Arabic") == fallback);
+        }
+    }
+    Utf8::useKernel(original);
+    assert(Utf8::activeKernel() == Utf8::bestKernel());
+}
+
+void testWordAdvanceWrapping() {
+    CLIOptions opts;
+    opts.surah = 2;
+    opts.from = 282;
+    opts.to = 282;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.layoutCache = false;
+    TextLayout::Engine engine(cfg);
+    TextLayout::FontPool pool;
+
+    VerseData verse = makeSampleVerse();
+    verse.durationInSeconds = 4.0;
+    verse.text.clear();
+    verse.translation.clear();
+    for (int i = 0; i < 40; ++i) {
+        verse.text += (i ? " " : "") + std::string("وَلْيَكْتُب بَّيْنَكُمْ كَاتِبٌ بِالْعَدْلِ");
+        verse.translation += (i ? " " : "") + std::string("and let a scribe write it between you in justice, 42 times");
+    }
+    verse.translation += "  with   extra\tspaces";
+
+    auto layout = engine.layoutVerse(verse);
+    int arabicSize = std::max(1, static_cast<int>(layout.baseArabicSize * layout.arabicGrowthFactor));
+    int translationSize = std::max(1, static_cast<int>(layout.baseTranslationSize * layout.translationGrowthFactor));
+    assert(layout.wrappedArabic.find("\\N") != std::string::npos);
+    assert(layout.wrappedArabic ==
+           wrapByReshaping(pool, cfg.arabicFont.file, arabicSize, verse.text, engine.arabicWrapWidth()));
+    assert(layout.wrappedTranslation == wrapByReshaping(pool, cfg.translationFont.file, translationSize,
+                                                        verse.translation, engine.translationWrapWidth()));
+}
+
 void testCustomAudioPlan() {
     CLIOptions opts;
     opts.customAudioPath = "custom.mp3";
@@ -229,14 +492,1081 @@ void testVideoGenerator() {
     assert(commands.size() == 2);
     assert(commands[0].find("ffmpeg") != std::string::npos);
     assert(commands[0].find(opts.output) != std::string::npos);
+    // Single-pass renders normalize the background exactly like chunked ones.
+    assert(commands[0].find(",scale=" + std::to_string(cfg.width) + ":" + std::to_string(cfg.height) +
+                            ",fps=" + std::to_string(cfg.fps)) != std::string::npos);
     assert(commands[1].find("ffmpeg") != std::string::npos);
-    std::string thumbPath = (fs::path(opts.output).parent_path() / "thumbnail.jpeg").string();
+    std::string thumbPath = VideoGenerator::thumbnailPath(opts);
+    assert(thumbPath == (fs::path(opts.output).parent_path() / "thumbnail.jpeg").string());
+    // The standalone extract is a plan too: one frame of the composited background.
+    assert(commands[1].find("-map \"[thumb]\" -frames:v 1 -q:v 2 " + thumbPath) != std::string::npos);
+    CLIOptions jobOpts = opts;
+    jobOpts.jobOutputNames = true;
+    assert(VideoGenerator::thumbnailPath(jobOpts) ==
+           (fs::path(opts.output).parent_path() / (fs::path(opts.output).stem().string() + "-thumbnail.jpeg")).string());
+    // The render itself cuts the thumbnail from its first composited frame.
+    assert(commands[0].find("trim=end_frame=1,ass=") != std::string::npos);
+    assert(commands[0].find("-map \"[thumb]\" -frames:v 1 -q:v 2 " + thumbPath) != std::string::npos);
     assert(commands[1].find(thumbPath) != std::string::npos);
 
     fs::remove(opts.output);
     fs::remove(dummyAudioPath);
 }
 
+class UnsupportedRenderEngine : public Interfaces::IRenderEngine {
+public:
+    int calls = 0;
+    void render(const Render::Plan&) override {
+        ++calls;
+        throw Render::UnsupportedPlanError("not supported in tests");
+    }
+};
+
+void testRenderPlan() {
+    Render::Plan plan;
+    Render::Input background;
+    background.path = "bg video.mp4";
+    background.streamLoop = -1;
+    plan.inputs.push_back(background);
+    Render::Input silence;
+    silence.format = "lavfi";
+    silence.durationSeconds = 2.5;
+    silence.path = "anullsrc=r=44100:cl=stereo";
+    plan.inputs.push_back(silence);
+    plan.filterComplex = "[0:v]scale=1280:720,ass='subs.ass'[v]";
+
+    Render::Output output;
+    output.path = "out.mp4";
+    output.maps = {"[v]", "1:a"};
+    output.durationSeconds = 10;
+    output.options = {{"c:v", "libx264"}, {"crf", "23"}, {"crf", "18"}};
+    plan.outputs.push_back(output);
+
+    auto args = Render::buildFfmpegArgs(plan);
+    assert(args.front() == "ffmpeg");
+    assert(args.back() == "out.mp4");
+    assert(Render::findOption(output.options, "crf") == "18");
+    assert(Render::findOption(output.options, "b:v").empty());
+
+    std::string cmd = Render::buildFfmpegCommand(plan);
+    assert(cmd.find("-stream_loop -1 -i \"bg video.mp4\"") != std::string::npos);
+    assert(cmd.find("-f lavfi -t 2.5 -i anullsrc=r=44100:cl=stereo") != std::string::npos);
+    assert(cmd.find("-filter_complex \"[0:v]scale=1280:720,ass='subs.ass'[v]\"") != std::string::npos);
+    assert(cmd.find("-map \"[v]\" -map 1:a -t 10") != std::string::npos);
+#ifndef _WIN32
+    // Inside double quotes /bin/sh still interprets backslashes.
+    Render::Plan escaped;
+    Render::Output trailing;
+    trailing.path = "dir\\out \\";
+    escaped.outputs.push_back(trailing);
+    assert(Render::buildFfmpegCommand(escaped).find("\"dir\\\\out \\\\\"") != std::string::npos);
+#endif
+
+    // Plans the engine rejects must still render through the CLI executor.
+    CLIOptions opts;
+    opts.output = (fs::temp_directory_path() / "test_render_engine.mp4").string();
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    std::vector<VerseData> verses = {makeSampleVerse()};
+    verses[0].localAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
+    auto mockProcessExecutor = std::make_shared<MockProcessExecutor>();
+    auto engine = std::make_shared<UnsupportedRenderEngine>();
+    VideoGenerator::generateVideo(opts, cfg, verses, mockProcessExecutor, nullptr, engine);
+    assert(engine->calls == 1);
+    assert(mockProcessExecutor->getCommands().size() == 1);
+    assert(mockProcessExecutor->getCommands()[0].find(opts.output) != std::string::npos);
+}
+
+void testChunkPlanning() {
+    CLIOptions opts;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    std::vector<VerseData> verses = {makeSampleVerse(), makeSampleVerse()};
+    auto boundaries = VideoGenerator::computeVerseBoundaries(cfg, verses);
+    assert(boundaries.size() == 2);
+    assert(boundaries[0] == cfg.introDuration + cfg.pauseAfterIntroDuration);
+    assert(boundaries[1] == boundaries[0] + verses[0].durationInSeconds);
+
+    assert(VideoGenerator::resolveChunkCount(1, 3600.0) == 1);
+    assert(VideoGenerator::resolveChunkCount(4, 3600.0) == 4);
+    assert(VideoGenerator::resolveChunkCount(4, 65.0) == 2);
+    assert(VideoGenerator::resolveChunkCount(0, 3600.0) >= 1);
+
+    auto single = VideoGenerator::planChunks({10.0, 20.0}, 80.0, 30, 1);
+    assert(single.size() == 1 && single[0].startSeconds == 0.0 && single[0].endSeconds == 80.0);
+
+    auto chunks = VideoGenerator::planChunks({5.0, 12.34, 30.0, 47.0, 61.0}, 80.0, 30, 3);
+    assert(chunks.size() == 3);
+    assert(chunks.front().startSeconds == 0.0);
+    assert(chunks.back().endSeconds == 80.0);
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        assert(chunks[i].startSeconds == chunks[i - 1].endSeconds);
+        double frames = chunks[i].startSeconds * 30;
+        assert(std::abs(frames - std::round(frames)) < 1e-6);
+    }
+    assert(chunks[0].endSeconds == 30.0);
+    assert(chunks[1].endSeconds == 47.0);
+
+    // Dynamic backgrounds: a clip's length on the timeline comes from its source frames. 5.01s of
+    // a 30 fps clip keeps 151 frames, which fps=25 turns into 126 frames, not round(5.01 * 25).
+    std::vector<BackgroundVideo::VideoSegment> clips = {
+        {"a.mp4", "t", 20.0, 20.0, true, false, 30.0},
+        {"b.mp4", "t", 30.0, 5.01, true, true, 30.0},
+        {"c.mp4", "t", 40.0, 7.3, true, true, 24.0},
+    };
+    assert(BackgroundVideo::clipFrameCount(clips[0], 25) == 500);
+    assert(BackgroundVideo::clipFrameCount(clips[1], 25) == 126);
+    assert(BackgroundVideo::clipFrameCount(clips[2], 25) == 183);
+    std::vector<long long> clipStarts = {0, 500, 626};
+    long long timelineFrames = 809;
+
+    // A chunk opens only the clips it shows; together the chunks cover the single-pass timeline
+    // frame for frame, each clip continuing where the previous chunk left it.
+    auto dynamicChunks = VideoGenerator::planChunks({10.0, 20.0, 25.0}, timelineFrames / 25.0, 25, 3);
+    long long nextFrame = 0;
+    for (const auto& chunk : dynamicChunks) {
+        auto window = BackgroundVideo::clipsInWindow(clips, 25, chunk.startSeconds, chunk.endSeconds);
+        assert(!window.empty());
+        assert(nextFrame == std::llround(chunk.startSeconds * 25));
+        for (const auto& slice : window) {
+            assert(clipStarts[slice.clip] + slice.startFrame == nextFrame);
+            assert(slice.endFrame > slice.startFrame);
+            assert(slice.seekSeconds <= slice.startFrame / 25.0);
+            assert(slice.seekSeconds + slice.durationSeconds >= slice.endFrame / 25.0);
+            nextFrame += slice.endFrame - slice.startFrame;
+        }
+        assert(nextFrame == std::llround(chunk.endSeconds * 25));
+    }
+    assert(nextFrame == timelineFrames);
+
+    auto window = BackgroundVideo::clipsInWindow(clips, 25, 25.0, timelineFrames / 25.0);
+    assert(window.size() == 2);
+    assert(window[0].path == "b.mp4" && window[0].startFrame == 125 && window[0].endFrame == 126);
+    assert(std::abs(window[0].seekSeconds - (5.0 - 1.0 / 30 - 1.0 / 25)) < 1e-9);
+    assert(window[1].path == "c.mp4" && window[1].startFrame == 0 && window[1].endFrame == 183);
+    assert(window[1].seekSeconds == 0.0);
+    assert(BackgroundVideo::clipsInWindow(clips, 25, 40.0, 45.0).empty());
+
+    // Each clip in a window runs through the single-pass chain, then is cut on exact frame indices.
+    cfg.fps = 25;
+    std::string concatFilter = BackgroundVideo::buildConcatFilter(cfg, clips);
+    assert(concatFilter.find("[1:v]trim=end=5.010000,scale=") != std::string::npos);
+    assert(concatFilter.find("[v0][v1][v2]concat=n=3:v=1:a=0[bg]; [bg]setpts=PTS-STARTPTS") != std::string::npos);
+    std::string windowFilter = BackgroundVideo::buildWindowFilter(cfg, clips, window);
+    for (size_t i = 0; i < window.size(); ++i) {
+        size_t clip = window[i].clip;
+        std::string open = "[" + std::to_string(clip) + ":v]";
+        size_t from = concatFilter.find(open) + open.size();
+        std::string chain = concatFilter.substr(from, concatFilter.find("[v" + std::to_string(clip) + "]", from) - from);
+        assert(windowFilter.find("[" + std::to_string(i) + ":v]" + chain + ",trim=start_pts=" +
+                                 std::to_string(window[i].startFrame) + ":end_pts=" +
+                                 std::to_string(window[i].endFrame) + ",setpts=PTS-STARTPTS[v" +
+                                 std::to_string(i) + "]") != std::string::npos);
+    }
+    assert(windowFilter.find("[v0][v1]concat=n=2:v=1:a=0[bg]; [bg]setpts=PTS-STARTPTS") != std::string::npos);
+}
+
+void testBackgroundPlateCache() {
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    fs::path tempCache = fs::temp_directory_path() / "qvm_plate_cache_test";
+    fs::remove_all(tempCache);
+    CacheUtils::setCacheRoot(tempCache);
+
+    fs::path source = tempCache / "source.mp4";
+    fs::create_directories(tempCache);
+    {
+        std::ofstream out(source, std::ios::binary);
+        out << "not really a video";
+    }
+
+    CLIOptions opts;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.assetBgVideo = source.string();
+    auto spec = BackgroundPlate::specFromConfig(cfg, true);
+    assert(spec.overlayColor == cfg.overlayColor);
+    assert(BackgroundPlate::specFromConfig(cfg, false).overlayColor.empty());
+
+    std::string key = BackgroundPlate::plateKey(spec);
+    assert(key == BackgroundPlate::plateKey(spec));
+    auto resized = spec;
+    resized.width += 2;
+    assert(BackgroundPlate::plateKey(resized) != key);
+    assert(BackgroundPlate::platePath(spec).parent_path() == tempCache / "plates");
+
+    // The source hash is remembered per file, but an edited source gets a new key.
+    {
+        std::ofstream out(source, std::ios::binary);
+        out << "an edited, longer source";
+    }
+    std::string editedKey = BackgroundPlate::plateKey(spec);
+    assert(editedKey != key);
+    assert(BackgroundPlate::plateKey(spec) == editedKey);
+    {
+        std::ofstream out(source, std::ios::binary);
+        out << "not really a video";
+    }
+    assert(BackgroundPlate::plateKey(spec) == key);
+
+    // The mock executor never writes the plate, so callers fall back to the source video.
+    auto mockProcessExecutor = std::make_shared<MockProcessExecutor>();
+    assert(BackgroundPlate::ensurePlate(spec, mockProcessExecutor).empty());
+    assert(mockProcessExecutor->getCommands().size() == 1);
+    assert(mockProcessExecutor->getCommands()[0].find("drawbox") != std::string::npos);
+
+    // An existing plate is reused without rendering.
+    {
+        std::ofstream out(BackgroundPlate::platePath(spec), std::ios::binary);
+        out << "plate";
+    }
+    assert(BackgroundPlate::ensurePlate(spec, mockProcessExecutor) == BackgroundPlate::platePath(spec).string());
+    assert(mockProcessExecutor->getCommands().size() == 1);
+
+    // Jobs building the same plate each write their own partial, then rename it into place.
+    fs::path plate = tempCache / "shared.mp4";
+    fs::path firstPartial = CacheUtils::uniquePartialPath(plate);
+    assert(firstPartial != CacheUtils::uniquePartialPath(plate));
+    assert(firstPartial.parent_path() == tempCache && firstPartial.extension() == ".mp4");
+    auto writingExecutor = std::make_shared<MockProcessExecutor>(true);
+    assert(BackgroundPlate::renderPlate(spec, plate, writingExecutor));
+    assert(BackgroundPlate::renderPlate(spec, plate, writingExecutor));
+    assert(writingExecutor->getCommands()[0] != writingExecutor->getCommands()[1]);
+    assert(CacheUtils::fileIsValid(plate));
+    for (const auto& entry : fs::directory_iterator(tempCache)) {
+        assert(entry.path().string().find(".partial") == std::string::npos);
+    }
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testBatchJobs() {
+    CLIOptions defaults;
+    defaults.reciterId = 7;
+    defaults.output = "out/from-cli.mp4";
+
+    nlohmann::json job = {{"id", "a"}, {"surah", 2}, {"from", 1}, {"to", 5},
+                          {"translationId", 20}, {"output", "out/a.mp4"}, {"seed", 9}};
+    CLIOptions opts = RenderJob::optionsFromJson(job, defaults);
+    assert(opts.surah == 2 && opts.from == 1 && opts.to == 5);
+    assert(opts.reciterId == 7);
+    assert(opts.translationId == 20);
+    assert(opts.output == "out/a.mp4");
+    assert(opts.videoSelection.seed == 9);
+
+    // Jobs never inherit the CLI output path.
+    assert(RenderJob::optionsFromJson({{"surah", 1}, {"from", 1}, {"to", 7}}, defaults).output.empty());
+
+    auto throwsInvalid = [&](const nlohmann::json& bad) {
+        try {
+            RenderJob::optionsFromJson(bad, defaults);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(throwsInvalid({{"surah", 1}, {"from", 1}, {"to", 7}, {"reciterID", 3}}));
+    assert(throwsInvalid({{"surah", "one"}, {"from", 1}, {"to", 7}}));
+    assert(throwsInvalid({{"from", 1}, {"to", 7}}));
+    assert(throwsInvalid(nlohmann::json::array()));
+
+    CLIOptions custom = opts;
+    custom.customAudioPath = "recitation.mp3";
+    assert(!RenderJob::normalizeOptions(custom).empty());
+    custom.customTimingFile = "timings.vtt";
+    assert(RenderJob::normalizeOptions(custom).empty());
+    assert(custom.recitationMode == "gapless");
+
+    CLIOptions chunks = opts;
+    chunks.renderChunks = -1;
+    assert(!RenderJob::normalizeOptions(chunks).empty());
+
+    fs::path jobsFile = fs::temp_directory_path() / "qvm_batch_test.jsonl";
+    {
+        std::ofstream out(jobsFile);
+        out << "# comment\n{\"surah\": 1, \"from\": 1, \"to\": 7}\n\n{\"surah\": 112, \"from\": 1, \"to\": 4}\n";
+    }
+    auto jobs = BatchRunner::readJobs(jobsFile.string());
+    assert(jobs.size() == 2);
+    assert(jobs[1]["surah"] == 112);
+    fs::remove(jobsFile);
+
+    // Default names carry the per-job reciter and translation; jobs that would still write the
+    // same files are rejected before any job starts.
+    CLIOptions named = RenderJob::optionsFromJson({{"surah", 1}, {"from", 1}, {"to", 7}, {"translationId", 20}}, defaults);
+    assert(RenderJob::normalizeOptions(named).empty());
+    assert(named.output == "out/surah-1_1-7-r7-t20.mp4");
+    CLIOptions single = defaults;  // a plain CLI run keeps the name backends look for
+    single.surah = 1;
+    single.from = 1;
+    single.to = 7;
+    single.translationId = 20;
+    single.output.clear();
+    assert(RenderJob::normalizeOptions(single).empty());
+    assert(single.output == "out/surah-1_1-7.mp4");
+    std::vector<nlohmann::json> batch = {
+        {{"surah", 1}, {"from", 1}, {"to", 7}, {"reciterId", 1}},
+        {{"surah", 1}, {"from", 1}, {"to", 7}, {"reciterId", 2}},
+        {{"surah", 1}, {"from", 1}, {"to", 7}, {"reciterId", 1}},
+        {{"surah", 2}, {"from", 1}, {"to", 5}, {"output", "out/a.mp4"}},
+        {{"surah", 2}, {"from", 6}, {"to", 9}, {"output", "out/a.mkv"}},
+        {{"surah", "bad"}},
+    };
+    auto conflicts = BatchRunner::outputConflicts(batch, defaults);
+    assert(conflicts[0].empty() && conflicts[1].empty() && conflicts[3].empty() && conflicts[5].empty());
+    assert(conflicts[2].find("batch job 1") != std::string::npos);
+    assert(conflicts[4].find("batch job 4") != std::string::npos);
+}
+
+void testRenderServerQueue() {
+    RenderServer::JobQueue queue(3);
+    auto makeJob = [](int priority, std::uint64_t sequence) {
+        RenderServer::QueuedJob job;
+        job.priority = priority;
+        job.sequence = sequence;
+        job.id = "job-" + std::to_string(sequence);
+        return job;
+    };
+    assert(queue.push(makeJob(0, 0)));
+    assert(queue.push(makeJob(5, 1)));
+    assert(queue.push(makeJob(0, 2)));
+    assert(!queue.push(makeJob(9, 3)));  // admission control: queue is full
+    assert(queue.size() == 3);
+
+    RenderServer::QueuedJob next;
+    assert(queue.pop(next) && next.id == "job-1");
+    assert(queue.pop(next) && next.id == "job-0");
+    assert(queue.pop(next) && next.id == "job-2");
+    queue.close();
+    assert(!queue.pop(next));
+    assert(!queue.push(makeJob(0, 4)));
+
+    // Queued and running jobs own their outputs; a job on the same directory and stem is refused.
+    RenderServer::OutputClaims claims;
+    CLIOptions jobDefaults;
+    CLIOptions fatiha = RenderJob::optionsFromJson({{"surah", 1}, {"from", 1}, {"to", 7}}, jobDefaults);
+    assert(RenderJob::normalizeOptions(fatiha).empty());
+    assert(claims.claim("first", RenderJob::outputPaths(fatiha)).empty());
+    CLIOptions again = RenderJob::optionsFromJson({{"surah", 1}, {"from", 1}, {"to", 7}, {"priority", 3}}, jobDefaults);
+    assert(RenderJob::normalizeOptions(again).empty());
+    assert(claims.claim("second", RenderJob::outputPaths(again)).find("job first") != std::string::npos);
+    assert(claims.claim("mkv", {"out/surah-1_1-7.mkv"}).find("job first") != std::string::npos);
+    assert(claims.claim("other", {"out/surah-1_1-7-t20.mp4", "out/surah-1_1-7.mp4"}).find("job first") != std::string::npos);
+    assert(claims.claim("other", {"out/surah-1_1-7-t20.mp4"}).empty());  // the refused claim took nothing
+    claims.release(RenderJob::outputPaths(fatiha));
+    assert(claims.claim("second", RenderJob::outputPaths(again)).empty());
+
+    std::vector<nlohmann::json> events;
+    {
+        Progress::ScopedSink sink([&](const std::string& payload) { events.push_back(nlohmann::json::parse(payload)); });
+        Progress::emit("encoding", "running", 50.0, 2.0, 2.0, "Half \"done\"");
+        Progress::emitStage("subtitles", "completed", "Subtitles generated");
+    }
+    assert(events.size() == 2);
+    assert(events[0]["stage"] == "encoding");
+    assert(events[0]["percent"] == 50.0);
+    assert(events[0]["message"] == "Half \"done\"");
+    assert(!events[1].contains("percent"));
+}
+
+void testEncoderTuning() {
+    // A single 1080p job on a big machine is capped by useful frame threads, not core count.
+    auto big = EncoderTuning::choose(32, 1, 1, 1080);
+    assert(big.encoderThreads == 16);
+    assert(big.lookaheadThreads == 2);
+    assert(big.filterThreads == 4);
+    assert(big.source == "auto");
+
+    // Concurrent jobs and chunks split the cores instead of oversubscribing them.
+    auto shared = EncoderTuning::choose(32, 2, 4, 1080);
+    assert(shared.encoderThreads == 4);
+    assert(shared.filterThreads == 1);
+    auto small = EncoderTuning::choose(4, 3, 1, 1080);
+    assert(small.encoderThreads == 1);
+
+    auto benchmarked = EncoderTuning::choose(32, 1, 1, 1080, 6);
+    assert(benchmarked.encoderThreads == 6);
+    assert(benchmarked.source == "benchmark");
+
+    Render::OptionList x264 = {{"c:v", "libx264"}};
+    EncoderTuning::apply(big, x264);
+    assert(Render::findOption(x264, "threads") == "16");
+    assert(Render::findOption(x264, "x264-params") == "lookahead-threads=2");
+    Render::OptionList hardware = {{"c:v", "h264_videotoolbox"}};
+    EncoderTuning::apply(big, hardware);
+    assert(Render::findOption(hardware, "x264-params").empty());
+
+    Render::Plan plan;
+    plan.filterComplex = "[0:v]null[v]";
+    plan.filterThreads = 3;
+    assert(Render::buildFfmpegCommand(plan).find("-filter_complex_threads 3 -filter_complex") != std::string::npos);
+
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    fs::path tempCache = fs::temp_directory_path() / "qvm_encoder_tuning_test";
+    fs::remove_all(tempCache);
+    CacheUtils::setCacheRoot(tempCache);
+    std::string key = EncoderTuning::benchmarkKey(1280, 720, "veryfast");
+    assert(EncoderTuning::lookupBenchmark(key) == 0);
+    EncoderTuning::saveBenchmark(key, 4, {{1, 9.0}, {2, 5.0}, {4, 3.0}});
+    assert(EncoderTuning::lookupBenchmark(key) == 4);
+    for (const auto& entry : fs::directory_iterator(EncoderTuning::benchmarkPath().parent_path())) {
+        assert(entry.path().filename().string().find(".partial") == std::string::npos);
+    }
+    assert(EncoderTuning::lookupBenchmark(EncoderTuning::benchmarkKey(1920, 1080, "veryfast")) == 0);
+
+    // The chosen settings are recorded in the render metadata sidecar.
+    CLIOptions opts;
+    opts.output = (tempCache / "tuned.mp4").string();
+    opts.configPath = (getProjectRoot() / "config.json").string();
+    AppConfig cfg = loadConfig(opts.configPath, opts);
+    MetadataWriter::writeMetadata(opts, cfg, {"qvm"});
+    MetadataWriter::mergeIntoMetadata(opts, "encoderTuning", EncoderTuning::toJson(shared));
+    std::ifstream sidecar(tempCache / "tuned.metadata.json");
+    auto metadata = nlohmann::json::parse(sidecar);
+    assert(metadata["encoderTuning"]["encoderThreads"] == 4);
+    assert(metadata.contains("command"));
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testQualityTuning() {
+    fs::path tempCache = fs::temp_directory_path() / "qvm_quality_tuning_test";
+    fs::remove_all(tempCache);
+    fs::create_directories(tempCache);
+
+    {
+        std::ofstream ssim(tempCache / "ssim.log");
+        ssim << "n:1 Y:0.990000 U:0.995000 V:0.995000 All:0.980000 (16.989700)\n"
+             << "n:2 Y:0.994000 U:0.997000 V:0.997000 All:0.990000 (20.000000)\n";
+        std::ofstream psnr(tempCache / "psnr.log");
+        psnr << "n:1 mse_avg:0.51 mse_y:0.60 mse_u:0.30 mse_v:0.30 psnr_avg:40.00 psnr_y:39.00\n"
+             << "n:2 mse_avg:0.00 mse_y:0.00 mse_u:0.00 mse_v:0.00 psnr_avg:inf psnr_y:inf\n";
+    }
+    assert(std::abs(QualityTuning::readScore(tempCache / "ssim.log", "ssim") - 0.985) < 1e-9);
+    assert(std::abs(QualityTuning::readScore(tempCache / "psnr.log", "psnr") - 70.0) < 1e-9);
+    assert(QualityTuning::readScore(tempCache / "missing.log", "ssim") < 0.0);
+
+    // Fastest setting that reaches the floor; a near-tie goes to the smaller file.
+    std::vector<QualityTuning::Measurement> measured = {
+        {"ultrafast", 28, 0.975, 1.0, 900},
+        {"ultrafast", 25, 0.986, 1.1, 1400},
+        {"superfast", 28, 0.987, 1.12, 1000},
+        {"fast", 28, 0.990, 3.0, 800}
+    };
+    auto best = QualityTuning::choose(measured, 0.985);
+    assert(best && best->preset == "superfast" && best->crf == 28);
+    assert(QualityTuning::choose(measured, 0.995) == std::nullopt);
+
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    CacheUtils::setCacheRoot(tempCache / "cache");
+    CLIOptions opts;
+    opts.output = (tempCache / "tuned.mp4").string();
+    opts.autoQuality = true;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    assert(cfg.autoQuality.enabled && cfg.autoQuality.metric == "ssim" && cfg.autoQuality.samples == 3);
+    cfg.assetBgVideo = (tempCache / "bg.mp4").string();
+    std::ofstream(cfg.assetBgVideo) << "background";
+    std::vector<VerseData> verses = {makeSampleVerse()};
+
+    // Without stats files from a real ffmpeg the samples cannot be scored; the profile stays.
+    auto executor = std::make_shared<MockProcessExecutor>();
+    assert(!QualityTuning::forJob(opts, cfg, verses, nullptr, executor));
+    const auto& commands = executor->getCommands();
+    assert(commands.size() == 3 + 2);
+    assert(commands[0].find("-qp 0") != std::string::npos);
+    assert(commands[0].find("setpts=PTS+") != std::string::npos);
+    assert(commands[3].find("-preset ultrafast -crf 28") != std::string::npos);
+    assert(commands[4].find("ssim=stats_file=") != std::string::npos);
+
+    // A saved decision for this background/resolution is reused without encoding anything.
+    std::string key = QualityTuning::decisionKey(cfg, cfg.autoQuality.presets, {28, 25, 22, 19});
+    QualityTuning::Decision saved;
+    saved.preset = "ultrafast";
+    saved.crf = 22;
+    saved.score = 0.988;
+    saved.metric = "ssim";
+    saved.measurements = {{"ultrafast", 22, 0.988, 0.8, 1200}};
+    QualityTuning::saveDecision(key, saved);
+    for (const auto& entry : fs::directory_iterator(QualityTuning::decisionPath().parent_path())) {
+        assert(entry.path().filename().string().find(".partial") == std::string::npos);
+    }
+    auto cachedExecutor = std::make_shared<MockProcessExecutor>();
+    auto cached = QualityTuning::forJob(opts, cfg, verses, nullptr, cachedExecutor);
+    assert(cached && cached->source == "cache" && cached->crf == 22);
+    assert(cachedExecutor->getCommands().empty());
+    cfg.width = 1920;
+    cfg.height = 1080;
+    assert(QualityTuning::lookupDecision(QualityTuning::decisionKey(cfg, cfg.autoQuality.presets, {28, 25, 22, 19})) == std::nullopt);
+
+    QualityTuning::apply(*cached, opts, cfg);
+    assert(opts.preset == "ultrafast" && opts.presetProvided && cfg.crf == 22);
+    assert(QualityTuning::toJson(*cached)["source"] == "cache");
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testPosixSpawnProcessExecutor() {
+#ifndef _WIN32
+    std::cout << "Testing posix_spawn executor..." << std::endl;
+    Progress::ScopedSink quiet([](const std::string&) {});
+    std::vector<PosixSpawnProcessExecutor::Usage> reported;
+    PosixSpawnProcessExecutor::Options options;
+    options.stallTimeoutSeconds = 1.0;
+    options.killGraceSeconds = 0.5;
+    PosixSpawnProcessExecutor executor(options, [&](const PosixSpawnProcessExecutor::Usage& usage) {
+        reported.push_back(usage);
+    });
+
+    // Arguments reach the child verbatim; no shell parses them.
+    fs::path marker = fs::temp_directory_path() / "qvm spawn $HOME `x` \"quoted\".txt";
+    fs::remove(marker);
+    assert(executor.executeArgs({"touch", marker.string()}) == 0);
+    assert(fs::exists(marker));
+    fs::remove(marker);
+
+    assert(executor.executeArgs({"sh", "-c", "echo failing >&2; exit 3"}) == 3);
+    assert(executor.execute("exit 4") == 4);
+    assert(reported.size() == 3);
+    assert(reported[1].exitCode == 3 && reported[1].termination == "exited");
+    assert(reported[0].maxRssKb > 0 && reported[0].wallSeconds >= 0.0);
+
+    executor.executeArgsWithProgress({"sh", "-c", "echo out_time_ms=10000000; echo progress=end"}, 10.0);
+    assert(executor.history().back().exitCode == 0);
+
+    // A progress run whose out_time_ms stops advancing is killed by the watchdog.
+    auto started = std::chrono::steady_clock::now();
+    bool stalled = false;
+    try {
+        executor.executeArgsWithProgress({"sh", "-c", "echo out_time_ms=1000000; echo progress=continue; exec sleep 30"}, 10.0);
+    } catch (const std::runtime_error& e) {
+        stalled = std::string(e.what()).find("no progress") != std::string::npos;
+    }
+    assert(stalled);
+    assert(executor.history().back().termination == "stalled");
+    assert(std::chrono::steady_clock::now() - started < std::chrono::seconds(10));
+
+    // Runs without progress are not watched for stalls, however long they stay quiet.
+    assert(executor.executeArgs({"sleep", "1.5"}) == 0);
+    assert(executor.history().back().termination == "exited");
+
+    // Without a sink, usage goes to history() and the trace instead of the console.
+    auto session = std::make_shared<Tracing::Session>();
+    {
+        Tracing::ScopedSession scope(session);
+        PosixSpawnProcessExecutor silent;
+        assert(silent.executeArgs({"true"}) == 0);
+        assert(silent.history().size() == 1);
+    }
+    assert(session->events().size() == 1);
+    assert(session->events()[0].name == "true" && session->events()[0].category == "process");
+
+    // cancel() stops the children running at the time; later runs start normally.
+    std::thread canceller([&executor] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        executor.cancel();
+    });
+    int code = executor.executeArgs({"sleep", "30"});
+    canceller.join();
+    assert(code != 0 && executor.history().back().termination == "cancelled");
+    assert(executor.executeArgs({"true"}) == 0);
+    assert(executor.history().back().termination == "exited");
+#endif
+}
+
+void testStillBackground() {
+    assert(BackgroundPlate::isStillImage("assets/bg.PNG"));
+    assert(BackgroundPlate::isStillImage("bg.jpeg"));
+    assert(!BackgroundPlate::isStillImage("bg.mp4"));
+
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    fs::path tempCache = fs::temp_directory_path() / "qvm_still_bg_test";
+    fs::remove_all(tempCache);
+    CacheUtils::setCacheRoot(tempCache);
+    fs::create_directories(tempCache);
+    fs::path image = tempCache / "background.png";
+    {
+        std::ofstream out(image, std::ios::binary);
+        out << "not really a png";
+    }
+
+    CLIOptions opts;
+    opts.output = (tempCache / "still.mp4").string();
+    opts.variableFrameRate = true;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.assetBgVideo = image.string();
+
+    // A cached still skips extraction; the render loops the single frame and drops repeats.
+    size_t at = cfg.overlayColor.find('@');
+    bool overlay = at == std::string::npos || std::stod(cfg.overlayColor.substr(at + 1)) > 0.0;
+    auto spec = BackgroundPlate::specFromConfig(cfg, overlay);
+    spec.still = true;
+    assert(BackgroundPlate::platePath(spec).extension() == ".png");
+    spec.still = false;
+    fs::path videoPlate = BackgroundPlate::platePath(spec);
+    spec.still = true;
+    assert(BackgroundPlate::platePath(spec).stem() != videoPlate.stem());
+    {
+        std::ofstream out(BackgroundPlate::platePath(spec), std::ios::binary);
+        out << "still";
+    }
+
+    std::vector<VerseData> verses = {makeSampleVerse()};
+    verses[0].localAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
+    auto mockProcessExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(opts, cfg, verses, mockProcessExecutor);
+    const auto& commands = mockProcessExecutor->getCommands();
+    assert(commands.size() == 1);
+    assert(commands[0].find("loop=loop=-1:size=1") != std::string::npos);
+    assert(commands[0].find("-stream_loop") == std::string::npos);
+    assert(commands[0].find("drawbox") == std::string::npos);
+    assert(commands[0].find("-tune stillimage") != std::string::npos);
+    assert(commands[0].find("mpdecimate") != std::string::npos);
+    assert(commands[0].find("-fps_mode vfr") != std::string::npos);
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testAudioTrackCache() {
+    fs::path originalCacheRoot = CacheUtils::getCacheRoot();
+    fs::path tempCache = fs::temp_directory_path() / "qvm_audio_track_test";
+    fs::remove_all(tempCache);
+    CacheUtils::setCacheRoot(tempCache);
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 1;
+    opts.output = (tempCache / "audio.mp4").string();
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    std::vector<VerseData> verses = {makeSampleVerse()};
+    verses[0].localAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
+
+    // The key follows everything that changes the mixed track, and nothing else.
+    std::string key = AudioTrack::trackKey(cfg, opts, verses);
+    assert(key == AudioTrack::trackKey(cfg, opts, verses));
+    AppConfig padded = cfg;
+    padded.introDuration += 1.0;
+    assert(AudioTrack::trackKey(padded, opts, verses) != key);
+    AppConfig otherReciter = cfg;
+    otherReciter.reciterId += 1;
+    assert(AudioTrack::trackKey(otherReciter, opts, verses) != key);
+    CLIOptions restyled = opts;
+    restyled.arabicFontSize = 120;
+    assert(AudioTrack::trackKey(cfg, restyled, verses) == key);
+
+    // Gapless surah audio is downloaded to a per-run directory; the same source keys the same.
+    AppConfig gapless = cfg;
+    gapless.recitationMode = RecitationMode::GAPLESS;
+    std::vector<VerseData> firstRun = verses;
+    firstRun[0].audioUrl = "https://example.com/surah_1.mp3";
+    firstRun[0].localAudioPath = (fs::temp_directory_path() / "quran_video_audio_1" / "surah_1_r7.mp3").string();
+    std::vector<VerseData> secondRun = firstRun;
+    secondRun[0].localAudioPath = (fs::temp_directory_path() / "quran_video_audio_2" / "surah_1_r7.mp3").string();
+    assert(AudioTrack::trackKey(gapless, opts, firstRun) == AudioTrack::trackKey(gapless, opts, secondRun));
+    secondRun[0].audioUrl = "https://example.com/other/surah_1.mp3";
+    assert(AudioTrack::trackKey(gapless, opts, firstRun) != AudioTrack::trackKey(gapless, opts, secondRun));
+
+    // Custom audio is keyed by contents, wherever the file lives.
+    fs::create_directories(tempCache);
+    std::ofstream(tempCache / "custom-a.mp3") << "recitation";
+    std::ofstream(tempCache / "custom-b.mp3") << "recitation";
+    std::vector<VerseData> customA = verses;
+    customA[0].fromCustomAudio = true;
+    customA[0].localAudioPath = (tempCache / "custom-a.mp3").string();
+    std::vector<VerseData> customB = customA;
+    customB[0].localAudioPath = (tempCache / "custom-b.mp3").string();
+    assert(AudioTrack::trackKey(cfg, opts, customA) == AudioTrack::trackKey(cfg, opts, customB));
+    std::ofstream(tempCache / "custom-b.mp3") << "edited recitation";
+    assert(AudioTrack::trackKey(cfg, opts, customA) != AudioTrack::trackKey(cfg, opts, customB));
+
+    fs::path track = AudioTrack::trackPath(key);
+    assert(track.parent_path() == tempCache / "audio-tracks");
+    assert(!AudioTrack::store(CacheUtils::uniquePartialPath(track), track));
+
+    // A miss writes the track from the same run; a hit stream-copies it.
+    auto missExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(opts, cfg, verses, missExecutor);
+    assert(missExecutor->getCommands().size() == 1);
+    // The miss encodes into a per-process partial next to the cached track.
+    const std::string& missCommand = missExecutor->getCommands()[0];
+    assert(missCommand.find(track.stem().string() + ".") != std::string::npos);
+    assert(missCommand.find(".partial" + track.extension().string()) != std::string::npos);
+
+    {
+        std::ofstream out(track, std::ios::binary);
+        out << "aac";
+    }
+    auto hitExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(opts, cfg, verses, hitExecutor);
+    assert(hitExecutor->getCommands().size() == 1);
+    assert(hitExecutor->getCommands()[0].find("-c:a copy") != std::string::npos);
+    assert(hitExecutor->getCommands()[0].find(track.filename().string()) != std::string::npos);
+
+    CacheUtils::setCacheRoot(originalCacheRoot);
+    fs::remove_all(tempCache);
+}
+
+void testTracing() {
+    {
+        // Without a session spans are free and record nothing.
+        Tracing::Span ignored("untraced");
+        assert(!Tracing::currentSession());
+    }
+
+    auto session = std::make_shared<Tracing::Session>();
+    {
+        Tracing::ScopedSession scope(session);
+        Tracing::Span outer("render");
+        {
+            Tracing::Span inner("encode", "encode");
+        }
+        auto worker = std::async(std::launch::async, [parent = Tracing::currentSession()]() {
+            Tracing::ScopedSession workerScope(parent);
+            Tracing::Span span("encode", "encode");
+        });
+        worker.get();
+    }
+    assert(!Tracing::currentSession());
+
+    auto events = session->events();
+    assert(events.size() == 3);
+    assert(events[0].name == "encode" && events[0].depth == 1 && events[0].threadId == 1);
+    assert(events[1].name == "encode" && events[1].depth == 0 && events[1].threadId == 2);
+    assert(events[2].name == "render" && events[2].depth == 0 && events[2].threadId == 1);
+    assert(events[2].startMicros <= events[0].startMicros);
+
+    nlohmann::json summary = session->summary();
+    assert(summary["spans"]["encode"]["count"] == 2);
+    assert(summary["spans"]["render"]["count"] == 1);
+    assert(summary["wallSeconds"].get<double>() >= 0.0);
+#ifndef _WIN32
+    assert(Tracing::processCpuSeconds() > 0.0);
+    assert(summary["spans"]["render"]["cpuSeconds"].get<double>() >= 0.0);
+#endif
+
+    nlohmann::json trace = session->toChromeTrace();
+    assert(trace["traceEvents"].size() == 3);
+    assert(trace["traceEvents"][0]["ph"] == "X");
+    assert(trace["traceEvents"][0]["cat"] == "encode");
+
+    fs::path tracePath = fs::temp_directory_path() / "qvm_trace_test.json";
+    session->writeChromeTrace(tracePath.string());
+    std::ifstream in(tracePath);
+    assert(nlohmann::json::parse(in)["traceEvents"].size() == 3);
+    fs::remove(tracePath);
+}
+
+void testClipIndex() {
+    std::cout << "Testing clip index..." << std::endl;
+    CLIOptions opts;
+    opts.surah = 2;
+    opts.from = 1;
+    opts.to = 3;
+    fs::path dir = fs::temp_directory_path() / "qvm_clip_index_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    opts.output = (dir / "surah.mp4").string();
+    opts.noCache = true;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.introDuration = 2.0;
+    cfg.pauseAfterIntroDuration = 1.0;
+    std::vector<VerseData> verses;
+    for (int i = 1; i <= 3; ++i) {
+        VerseData verse = makeSampleVerse();
+        verse.verseKey = "2:" + std::to_string(i);
+        verse.durationInSeconds = 2.0 * i;
+        verse.localAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
+        verses.push_back(verse);
+    }
+
+    auto entries = ClipIndex::timeline(cfg, verses, nullptr);
+    assert(entries.size() == 3);
+    assert(entries[1].verseKey == "2:2" && entries[1].startSeconds == 5.0 && entries[1].endSeconds == 9.0);
+    assert(ClipIndex::forceKeyFrames(entries) == "3.000,5.000,9.000");
+
+    // Every verse start becomes an IDR frame, and the index is written next to the output.
+    auto executor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(opts, cfg, verses, executor);
+    assert(executor->getCommands()[0].find("-force_key_frames 3.000,5.000,9.000") != std::string::npos);
+    assert(executor->getCommands()[0].find("-forced-idr 1") != std::string::npos);
+    ClipIndex::Index index = ClipIndex::read(opts.output);
+    assert(index.surah == 2 && index.media == "surah.mp4" && index.entries.size() == 3);
+    assert(index.entries[2].startSeconds == 9.0 && index.entries[2].keyframeSeconds < 0.0);
+
+    auto range = ClipIndex::verseRange(index, 2, 3);
+    assert(range.first.verseKey == "2:2" && range.second.endSeconds == 15.0);
+    bool rejected = false;
+    try {
+        ClipIndex::verseRange(index, 3, 4);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    index.entries[1].keyframeSeconds = 5.0;
+    ClipIndex::write(index, opts.output);
+    auto clipExecutor = std::make_shared<MockProcessExecutor>();
+    std::string clip = ClipIndex::extract(opts.output, 2, 3, "", clipExecutor);
+    assert(clip == (dir / "surah-2_2-3.mp4").string());
+    const std::string& command = clipExecutor->getCommands()[0];
+    assert(command.find("-ss 5 -i " + fs::path(opts.output).generic_string()) != std::string::npos);
+    assert(command.find("-t 10 -c copy") != std::string::npos);
+    fs::remove_all(dir);
+}
+
+void testDraftRender() {
+    std::cout << "Testing draft renders..." << std::endl;
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 2;
+    opts.output = (fs::temp_directory_path() / "draft.mp4").string();
+    opts.noCache = true;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.introDuration = 2.0;
+    cfg.pauseAfterIntroDuration = 1.0;
+    std::vector<VerseData> verses = {makeSampleVerse(), makeSampleVerse()};
+    verses[1].verseKey = "1:2";
+    verses[1].durationInSeconds = 4.0;
+    for (auto& verse : verses) verse.localAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
+
+    auto times = VideoGenerator::contactSheetTimes(cfg, verses, nullptr);
+    assert(times.size() == 2);
+    assert(std::abs(times[0] - 3.75) < 1e-9);
+    assert(std::abs(times[1] - 6.5) < 1e-9);
+    assert(VideoGenerator::contactSheetPath(opts) == (fs::temp_directory_path() / "draft-contact.jpg").string());
+
+    // One pass: a small, fast video and the contact sheet, from the full-size subtitle layout.
+    opts.draft = true;
+    opts.renderChunks = 4;
+    auto executor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(opts, cfg, verses, executor);
+    const auto& commands = executor->getCommands();
+    assert(commands.size() == 1);
+    assert(commands[0].find("fps=10,scale=640:360") != std::string::npos);
+    assert(commands[0].find("-preset ultrafast -crf 32") != std::string::npos);
+    assert(commands[0].find("select='eq(n,38)+eq(n,65)',scale=320:-2,tile=2x1") != std::string::npos);
+    assert(commands[0].find("draft-contact.jpg") != std::string::npos);
+    assert(commands[0].find("thumbnail.jpeg") == std::string::npos);
+    fs::remove(opts.output + ".metadata");
+}
+
+void testRenderWorkspace() {
+    std::cout << "Testing render workspaces..." << std::endl;
+    assert(RenderWorkspace::current() == nullptr);
+    assert(scratchFile("x.ass") == fs::temp_directory_path() / "x.ass");
+
+    fs::path root;
+    {
+        auto first = std::make_shared<RenderWorkspace>("test");
+        auto second = std::make_shared<RenderWorkspace>("test");
+        root = first->root();
+        assert(fs::is_directory(root) && fs::is_directory(second->root()));
+        assert(root != second->root());
+
+        RenderWorkspace::Scope scope(first);
+        assert(scratchFile("subtitles.ass") == root / "subtitles.ass");
+        std::ofstream(scratchFile("subtitles.ass")) << "[Script Info]";
+        assert(fs::is_directory(scratchDirectory("audio")));
+        auto adopted = std::async(std::launch::async, [workspace = RenderWorkspace::current()]() {
+            RenderWorkspace::Scope worker_scope(workspace);
+            return scratchFile("chunk.mp4");
+        }).get();
+        assert(adopted == root / "chunk.mp4");
+        {
+            RenderWorkspace::Scope inner(second);
+            assert(scratchFile("a") == second->root() / "a");
+        }
+        assert(RenderWorkspace::current() == first);
+    }
+    assert(RenderWorkspace::current() == nullptr);
+    assert(!fs::exists(root));
+
+#ifndef _WIN32
+    // Staleness is decided by the workspace lock, not by whether the pid in the name exists here:
+    // another container sharing /tmp may own that pid in its own namespace.
+    fs::path base = fs::temp_directory_path() / "qvm_workspace_test";
+    fs::remove_all(base);
+    fs::create_directories(base / "qvm-999999999-0" / "audio");  // owner died, lock released
+    std::ofstream(base / "qvm-999999999-0" / ".lock");
+    fs::create_directories(base / "qvm-999999999-1");            // other namespace, still locked
+    int held = open((base / "qvm-999999999-1" / ".lock").c_str(), O_RDWR | O_CREAT, 0600);
+    assert(held >= 0 && flock(held, LOCK_EX) == 0);
+    fs::create_directories(base / "qvm-999999999-2");            // no lock file: left alone
+    fs::create_directories(base / "unrelated");
+    assert(RenderWorkspace::removeStale(base) == 1);
+    assert(!fs::exists(base / "qvm-999999999-0") && fs::exists(base / "unrelated"));
+    assert(fs::exists(base / "qvm-999999999-1") && fs::exists(base / "qvm-999999999-2"));
+    close(held);
+    assert(RenderWorkspace::removeStale(base) == 1);
+    assert(!fs::exists(base / "qvm-999999999-1"));
+    fs::remove_all(base);
+
+    // A live workspace of this process holds its lock, so a sweep of its base keeps it.
+    {
+        RenderWorkspace live("test");
+        assert(fs::exists(live.root() / ".lock"));
+        RenderWorkspace::removeStale(live.root().parent_path());
+        assert(fs::is_directory(live.root()));
+    }
+#endif
+}
+
+void testRenditions() {
+    Rendition mobile = RenderJob::parseRendition("mobile:720x1280:speed");
+    assert(mobile.name == "mobile" && mobile.width == 720 && mobile.height == 1280);
+    assert(mobile.qualityProfile == "speed");
+    Rendition square = RenderJob::parseRendition("square:1080x1080");
+    assert(square.qualityProfile.empty());
+
+    auto throwsInvalid = [](const std::string& spec) {
+        try {
+            RenderJob::parseRendition(spec);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(throwsInvalid("mobile"));
+    assert(throwsInvalid("mobile:720"));
+    assert(throwsInvalid("mobile:720x12a0"));
+    assert(throwsInvalid(":720x1280"));
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 7;
+    opts.output = "out/fatiha.mp4";
+    opts.renditions = {mobile, square};
+    assert(RenderJob::normalizeOptions(opts).empty());
+    assert(opts.renditions[0].output == "out/fatiha-mobile.mp4");
+    assert(opts.renditions[1].output == "out/fatiha-square.mp4");
+
+    CLIOptions odd = opts;
+    odd.renditions = {RenderJob::parseRendition("odd:721x1280")};
+    assert(!RenderJob::normalizeOptions(odd).empty());
+
+    nlohmann::json job = {{"surah", 1}, {"from", 1}, {"to", 7},
+                          {"renditions", {"mobile:720x1280",
+                                          {{"name", "sd"}, {"width", 854}, {"height", 480}, {"output", "out/sd.mp4"}}}}};
+    CLIOptions fromJob = RenderJob::optionsFromJson(job, CLIOptions{});
+    assert(fromJob.renditions.size() == 2);
+    assert(fromJob.renditions[0].width == 720);
+    assert(fromJob.renditions[1].name == "sd" && fromJob.renditions[1].output == "out/sd.mp4");
+}
+
+void testStreamSegments() {
+    // Every verse start opens a segment and long verses are split evenly.
+    auto keyframes = VideoGenerator::planStreamKeyframes({0.0, 5.0, 8.0, 20.0}, 30.0, 6.0);
+    std::vector<double> expected = {0.0, 5.0, 8.0, 14.0, 20.0, 25.0};
+    assert(keyframes.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) assert(std::abs(keyframes[i] - expected[i]) < 1e-9);
+
+    CLIOptions opts;
+    opts.output = "out/surah-1_1-7.mp4";
+    assert(VideoGenerator::streamManifestPath(opts).empty());
+    opts.streamFormat = "hls";
+    assert(fs::path(VideoGenerator::streamManifestPath(opts)) == fs::path("out/surah-1_1-7/master.m3u8"));
+    opts.streamFormat = "dash";
+    assert(fs::path(VideoGenerator::streamManifestPath(opts)) == fs::path("out/surah-1_1-7/manifest.mpd"));
+
+    CLIOptions invalid;
+    invalid.surah = 1;
+    invalid.from = 1;
+    invalid.to = 7;
+    invalid.output = "out/fatiha.mp4";
+    invalid.streamFormat = "smooth";
+    assert(!RenderJob::normalizeOptions(invalid).empty());
+}
+
+void testSubtitleWindows() {
+    std::string ass =
+        "[Script Info]\nPlayResX: 1920\n\n[V4+ Styles]\nStyle: Arabic,Amiri,80\n\n[Events]\n"
+        "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n"
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Arabic,,0,0,0,,intro\n"
+        "Dialogue: 0,0:00:05.00,0:00:25.50,Arabic,,0,0,0,,first verse\n"
+        "Dialogue: 0,0:00:25.50,0:01:02.00,Arabic,,0,0,0,,second verse\n";
+
+    std::string early = VideoGenerator::subtitleEventsInWindow(ass, 0.0, 20.0);
+    assert(early.find("Style: Arabic") != std::string::npos);
+    assert(early.find("intro") != std::string::npos);
+    assert(early.find("first verse") != std::string::npos);
+    assert(early.find("second verse") == std::string::npos);
+
+    // An event spanning a cut belongs to both windows.
+    std::string late = VideoGenerator::subtitleEventsInWindow(ass, 20.0, 40.0);
+    assert(late.find("intro") == std::string::npos);
+    assert(late.find("first verse") != std::string::npos);
+    assert(late.find("second verse") != std::string::npos);
+
+    // Editing text in one window leaves the other window's key unchanged.
+    std::string edited = ass;
+    edited.replace(edited.find("second verse"), 12, "second VERSE");
+    assert(VideoGenerator::subtitleEventsInWindow(edited, 0.0, 20.0) == early);
+    assert(VideoGenerator::subtitleEventsInWindow(edited, 20.0, 40.0) != late);
+
+    // Style changes (font size, shifts) touch every window.
+    std::string restyled = ass;
+    restyled.replace(restyled.find("Amiri,80"), 8, "Amiri,90");
+    assert(VideoGenerator::subtitleEventsInWindow(restyled, 0.0, 20.0) != early);
+}
+
+void testIncrementalReuse() {
+    std::cout << "Testing incremental segment reuse..." << std::endl;
+    fs::path dir = fs::temp_directory_path() / "qvm_incremental_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::ofstream(dir / "verse.wav") << "audio";
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 3;
+    opts.output = (dir / "fatiha.mp4").string();
+    opts.incremental = true;
+    opts.noCache = true;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    std::vector<VerseData> verses;
+    for (int i = 0; i < 3; ++i) {
+        VerseData verse = makeSampleVerse();
+        verse.verseKey = "1:" + std::to_string(i + 1);
+        verse.durationInSeconds = 15.0;
+        verse.localAudioPath = (dir / "verse.wav").string();
+        verses.push_back(verse);
+    }
+
+    // Each render gets its own workspace, as render jobs do, so scratch paths differ per run.
+    auto render = [&]() {
+        auto executor = std::make_shared<MockProcessExecutor>(true);
+        RenderWorkspace::Scope scope(std::make_shared<RenderWorkspace>("test"));
+        MetadataWriter::writeMetadata(opts, cfg, {});
+        assert(VideoGenerator::generateVideo(opts, cfg, verses, executor));
+        std::ifstream metadata(dir / "fatiha.metadata.json");
+        return std::make_pair(executor->getCommands(), json::parse(metadata)["segments"]);
+    };
+
+    auto [firstCommands, firstSegments] = render();
+    assert(!firstSegments["audio"]["reused"].get<bool>());
+    assert(firstSegments["video"].size() >= 2);
+
+    auto [secondCommands, secondSegments] = render();
+    assert(secondSegments["audio"]["reused"].get<bool>());
+    assert(secondSegments["audio"]["hash"] == firstSegments["audio"]["hash"]);
+    for (size_t i = 0; i < secondSegments["video"].size(); ++i) {
+        assert(secondSegments["video"][i]["reused"].get<bool>());
+        assert(secondSegments["video"][i]["hash"] == firstSegments["video"][i]["hash"]);
+    }
+    for (const auto& command : secondCommands) assert(command.find(".partial") == std::string::npos);
+    // The separate thumbnail extract scales the background like the chunks do.
+    const std::string& thumbnailCommand = secondCommands.back();
+    assert(thumbnailCommand.find(VideoGenerator::thumbnailPath(opts)) != std::string::npos);
+    assert(thumbnailCommand.find("[0:v]scale=" + std::to_string(cfg.width) + ":" + std::to_string(cfg.height) +
+                                 ",fps=" + std::to_string(cfg.fps) + ",ass=") != std::string::npos);
+    assert(secondCommands.size() + firstSegments["video"].size() + 1 == firstCommands.size());
+
+    fs::remove_all(dir);
+}
+
 void testGenerateBackendMetadata() {
     fs::path tempDir = "temp_backend_metadata";
     fs::path tempPath = tempDir / "backend-metadata-test.json";
@@ -275,13 +1605,36 @@ int main() {
     testApi();
     testMetadataWriter();
     testVideoGenerator();
+    testRenderPlan();
+    testChunkPlanning();
+    testBackgroundPlateCache();
+    testBatchJobs();
+    testRenderServerQueue();
+    testEncoderTuning();
+    testQualityTuning();
+    testPosixSpawnProcessExecutor();
+    testStillBackground();
+    testAudioTrackCache();
+    testTracing();
+    testRenderWorkspace();
+    testDraftRender();
+    testClipIndex();
+    testSubtitleWindows();
+    testIncrementalReuse();
+    testRenditions();
+    testStreamSegments();
     testConfigLoader();
     testCacheUtils();
     testLocalization();
     testRecitationUtils();
     testTimingParser();
     testSubtitleBuilder();
+    testParallelSubtitleLayout();
     testTextLayoutEngine();
+    testFontPool();
+    testWordAdvanceWrapping();
+    testLayoutCache();
+    testUtf8();
     testCustomAudioPlan();
     testGenerateBackendMetadata();
     std::cout << "All unit tests passed.\n";